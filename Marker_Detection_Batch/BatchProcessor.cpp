@@ -0,0 +1,255 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Parallel frame processor of the batch tool
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cstring>
+
+/* Helper includes */
+#include "BatchProcessor.h"
+
+
+/*  Creates a processor with its workers and slot ring
+ *
+ *	@param config: The detector configuration, tracking mode and parallel validation are turned off
+ *	@param threadCount: The number of worker threads
+ *	@param slotCount: The number of frames that can be in flight, at least the number of workers
+ *	@param markerLimit: The most markers kept per frame
+ */
+BatchProcessor::BatchProcessor(const DetectorConfig &config, int threadCount, int slotCount, int markerLimit) :
+	maxMarkers(std::max(1, markerLimit)), source(nullptr), frameLimit(0), nextIndex(0), ended(false) {
+
+	// Frames are spread over the workers rather than their candidates, and have no history
+	DetectorConfig workerConfig = config;
+	workerConfig.trackingMode = 0;
+	workerConfig.warmStartPose = 0;
+	workerConfig.parallelCandidates = 0;
+	workerConfig.drawOverlay = 0;
+	workerConfig.collectStats = 1;
+
+	threadCount = std::max(1, threadCount);
+	for (int i = 0; i < threadCount; i++) {
+		detectors.emplace_back(new MarkerDetector(workerConfig));
+		frames.emplace_back(new FrameState());
+		scratch.emplace_back(maxMarkers);
+	}
+
+	slotCount = std::max(slotCount, threadCount);
+	for (int i = 0; i < slotCount; i++) {
+		slots.emplace_back(new BatchSlot());
+		slots.back()->markers.resize(maxMarkers);
+	}
+}
+
+
+/*  Processes frames until the source ends, writing them in order
+ *	The calling thread writes the frames while the workers detect them.
+ *
+ *	@param frameSource: The input
+ *	@param writer: The output
+ *	@param limit: The most frames to take, 0 for no limit
+ *	@param summary: Container to hold the totals of the run
+ *
+ *	@return void
+ */
+void BatchProcessor::run(FrameSource &frameSource, DetectionWriter &writer, long long limit, BatchSummary &summary) {
+
+	summary.frames = 0;
+	summary.failedFrames = 0;
+	summary.markers = 0;
+	summary.writeFailed = false;
+	summary.read.reset();
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		summary.stages[i].reset();
+	}
+
+	source = &frameSource;
+	frameLimit = limit;
+	nextIndex = 0;
+	ended = false;
+	for (size_t i = 0; i < slots.size(); i++) {
+		slots[i]->state = SLOT_FREE;
+	}
+
+	double start = statsClockMs();
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < detectors.size(); i++) {
+		workers.emplace_back(&BatchProcessor::workerLoop, this, (int)i);
+	}
+
+	// Write the frames in order, handing each slot back as soon as it is written
+	for (long long index = 0;; index++) {
+		BatchSlot &slot = *slots[index % slots.size()];
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [&] { return slot.state == SLOT_DONE || slot.state == SLOT_END; });
+			if (slot.state == SLOT_END) {
+				break;
+			}
+		}
+
+		if (!writer.writeFrame((int)slot.index, slot.markers.data(), slot.markerCount)) {
+			summary.writeFailed = true;
+		}
+		summary.frames++;
+		summary.markers += slot.markerCount;
+		if (slot.status == FRAME_FAILED) {
+			summary.failedFrames++;
+		}
+		else {
+			summary.read.add(slot.readMs);
+			for (int i = 0; i < STAGE_COUNT; i++) {
+				summary.stages[i].add(slot.stats.stageMs[i]);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		slot.state = SLOT_FREE;
+		if (summary.writeFailed) {
+			ended = true;
+		}
+		changed.notify_all();
+		if (summary.writeFailed) {
+			break;
+		}
+	}
+
+	// Workers still waiting for a slot see the end and return
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ended = true;
+		changed.notify_all();
+	}
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+
+	if (!writer.finish()) {
+		summary.writeFailed = true;
+	}
+	summary.wallMs = statsClockMs() - start;
+	source = nullptr;
+}
+
+
+/*  Takes, loads and detects frames until the input ends
+ *	Frames are taken in order under the reading lock, after waiting for the slot of the
+ *	frame to be written out, then loaded and detected outside of it.
+ *
+ *	@param worker: The number of the worker
+ *
+ *	@return void
+ */
+void BatchProcessor::workerLoop(int worker) {
+
+	for (;;) {
+		std::unique_lock<std::mutex> readLock(readMutex);
+		BatchSlot* slot;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (ended) {
+				return;
+			}
+			slot = slots[nextIndex % slots.size()].get();
+			changed.wait(lock, [&] { return slot->state == SLOT_FREE || ended; });
+			if (ended) {
+				return;
+			}
+			slot->state = SLOT_BUSY;
+		}
+
+		slot->index = nextIndex++;
+		if (frameLimit > 0 && slot->index >= frameLimit) {
+			endInput(*slot);
+			return;
+		}
+
+		double start = statsClockMs();
+		int status = source->next(slot->buffer);
+		if (status == FRAME_END) {
+			endInput(*slot);
+			return;
+		}
+		readLock.unlock();
+
+		// Decoding image files is the slow part of reading, so it runs on every worker at once
+		status = source->load(slot->buffer);
+		if (status == FRAME_END) {
+			endInput(*slot);
+			return;
+		}
+		slot->status = status;
+		slot->readMs = statsClockMs() - start;
+
+		if (status == FRAME_OK) {
+			detectFrame(worker, *slot);
+		}
+		else {
+			slot->markerCount = 0;
+			slot->stats.clear();
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		slot->state = SLOT_DONE;
+		changed.notify_all();
+	}
+}
+
+
+/*  Runs detection on the frame of a slot and keeps its markers and timings
+ *
+ *	@param worker: The number of the worker running detection
+ *	@param slot: The slot holding the frame
+ *
+ *	@return void
+ */
+void BatchProcessor::detectFrame(int worker, BatchSlot &slot) {
+
+	MarkerDetector &detector = *detectors[worker];
+	FrameState &frame = *frames[worker];
+
+	slot.markerCount = 0;
+	if (!detector.extractCandidates(frame, slot.buffer.image)) {
+		slot.stats.clear();
+		return;
+	}
+	detector.validateCandidates(frame);
+	int count = detector.collectMarkers(frame, scratch[worker].data(), maxMarkers);
+
+	// The reported markers are the first valid results, which also hold the corners
+	for (size_t i = 0; i < frame.results.size() && slot.markerCount < count; i++) {
+		const CandidateResult &result = frame.results[i];
+		if (!result.valid) {
+			continue;
+		}
+		BatchMarker &marker = slot.markers[slot.markerCount++];
+		marker.marker = result.marker;
+		for (int c = 0; c < 4; c++) {
+			marker.corners[2 * c] = result.corners[c].x;
+			marker.corners[2 * c + 1] = result.corners[c].y;
+		}
+	}
+	slot.stats = frame.stats;
+}
+
+
+/*  Marks the end of the input in a slot, so the writer stops there and no more frames are taken
+ *
+ *	@param slot: The slot taken for the frame that does not exist
+ *
+ *	@return void
+ */
+void BatchProcessor::endInput(BatchSlot &slot) {
+	std::lock_guard<std::mutex> lock(mutex);
+	ended = true;
+	slot.state = SLOT_END;
+	changed.notify_all();
+}
@@ -0,0 +1,102 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the parallel frame processor of the batch tool
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Helper includes */
+#include "UnityStructs.h"
+#include "MarkerDetector.h"
+#include "DetectorStatistics.h"
+#include "FrameSource.h"
+#include "DetectionWriter.h"
+
+
+/*  Totals of a batch run */
+struct BatchSummary
+{
+	long long frames;						// Frames written, including failed ones
+	long long failedFrames;					// Frames that could not be read
+	long long markers;						// Markers written
+	double wallMs;							// Time from the first frame taken to the last frame written
+	bool writeFailed;						// True if the output could not be written
+	LatencyTotals read;						// Time spent taking and loading each frame
+	LatencyTotals stages[STAGE_COUNT];		// Time spent in each detection stage of each frame
+};
+
+
+/*  Runs detection over every frame of a source on several threads at once.
+ *	Each worker owns its own detector and takes the next frame as soon as it is free,
+ *	so frames finish out of order. They go through a fixed ring of slots, frame i using
+ *	slot i modulo the ring size, and a slot is only reused once its frame has been written.
+ *	Memory therefore stays bounded however long the input is, and the writer sees the
+ *	frames strictly in order.
+ *	Frames are independent, so tracking mode and warm-started poses are always turned off.
+ */
+class BatchProcessor
+{
+public:
+	/*  Creates a processor with its workers and slot ring */
+	BatchProcessor(const DetectorConfig &config, int threadCount, int slotCount, int markerLimit);
+
+	/*  Processes frames until the source ends or frameLimit frames are taken (0 for no limit) */
+	void run(FrameSource &source, DetectionWriter &writer, long long frameLimit, BatchSummary &summary);
+
+private:
+	/*  Progress of a slot */
+	enum SlotState
+	{
+		SLOT_FREE,							// Ready for a new frame
+		SLOT_BUSY,							// Holding a frame being loaded or detected
+		SLOT_DONE,							// Holding a finished frame waiting to be written
+		SLOT_END							// Holding the end of the input
+	};
+
+	/*  One frame in flight and its output */
+	struct BatchSlot
+	{
+		FrameBuffer buffer;					// Pixels of the frame
+		long long index;					// Frame number
+		int state;							// One of SlotState
+		int status;							// One of FrameStatus
+		double readMs;						// Time spent taking and loading the frame
+		FrameStats stats;					// Timings and counts of the frame
+		std::vector<BatchMarker> markers;	// Markers found in the frame
+		int markerCount;					// Number of valid entries in markers
+	};
+
+	/*  Takes, loads and detects frames until the input ends */
+	void workerLoop(int worker);
+
+	/*  Runs detection on the frame of a slot */
+	void detectFrame(int worker, BatchSlot &slot);
+
+	/*  Marks the end of the input in a slot so the writer stops there */
+	void endInput(BatchSlot &slot);
+
+	std::vector<std::unique_ptr<MarkerDetector>> detectors;	// Detector of each worker
+	std::vector<std::unique_ptr<FrameState>> frames;		// Detection buffers of each worker
+	std::vector<std::vector<Marker2>> scratch;				// Markers reported to each worker
+	std::vector<std::unique_ptr<BatchSlot>> slots;			// Ring of frames in flight
+	int maxMarkers;											// Most markers kept per frame
+	FrameSource* source;									// Input of the current run
+	long long frameLimit;									// Most frames to take, 0 for no limit
+	long long nextIndex;									// Number of the next frame to take
+	bool ended;												// Set once no more frames will be taken
+	std::mutex readMutex;									// Serializes taking frames from the source
+	std::mutex mutex;										// Guards the slot states and ended
+	std::condition_variable changed;						// Signalled whenever a slot state changes
+};
@@ -0,0 +1,273 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Offline batch detection over image sequences and raw video
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+/* Helper includes */
+#include "UnityStructs.h"
+#include "MarkerDetector.h"
+#include "DetectorStatistics.h"
+#include "FrameSource.h"
+#include "DetectionWriter.h"
+#include "BatchProcessor.h"
+
+
+/*  Pixel formats accepted for raw input, by name */
+static const struct { const char* name; int format; } RAW_FORMATS[] = {
+	{ "rgba", PIXEL_RGBA32 }, { "bgra", PIXEL_BGRA32 }, { "gray", PIXEL_GRAY8 }, { "nv12", PIXEL_NV12 },
+	{ "nv21", PIXEL_NV21 }, { "yuyv", PIXEL_YUYV }, { "uyvy", PIXEL_UYVY }
+};
+
+
+/*  Prints the command line options
+ *
+ *	@param program: The name of the program
+ *
+ *	@return void
+ */
+static void printUsage(const char* program) {
+	fprintf(stderr,
+		"Usage: %s INPUT [options]\n"
+		"Input, one of:\n"
+		"  --images PATTERN       numbered image files such as frames/%%06d.png\n"
+		"  --start N              number of the first image file (default 0)\n"
+		"  --list FILE            text file naming one image file per line\n"
+		"  --raw FILE             raw frames stored back to back, - for the standard input\n"
+		"  --width W --height H   size of the raw frames\n"
+		"  --format F             pixel format of the raw frames: rgba, bgra, gray, nv12, nv21, yuyv or uyvy\n"
+		"Options:\n"
+		"  --output FILE          detections file, - for the standard output (default detections.csv)\n"
+		"  --binary               write binary records instead of CSV\n"
+		"  --threads N            worker threads (default one per core)\n"
+		"  --queue N              frames in flight, bounding memory (default twice the threads)\n"
+		"  --count N              stop after N frames\n"
+		"  --max-markers N        most markers kept per frame (default 256)\n"
+		"  --threshold T          binary threshold\n"
+		"  --marker-size S        marker side length, in the units of the translation\n"
+		"  --camera FX,FY,CX,CY   focal lengths and principal point of the camera in pixels\n"
+		"  --distortion K1,K2,P1,P2[,K3]  lens distortion coefficients of the camera\n"
+		"  --pyramid L            search for quads on an image downsampled 2^L times\n"
+		"  --run-length           find quads with the run-length extractor\n"
+		"  --gradient-refinement  refine edges on the gradient image shared by the candidates of a frame\n",
+		program);
+}
+
+
+/*  Prints the latency of one stage over the run
+ *
+ *	@param report: The output of the report
+ *	@param name: The name of the stage
+ *	@param totals: The latency of the stage
+ *
+ *	@return void
+ */
+static void printLatency(FILE* report, const char* name, const LatencyTotals &totals) {
+	fprintf(report, "  %-16s %9.3f %9.3f %9.3f %9.3f\n", name,
+		totals.mean(), totals.percentile(0.5), totals.percentile(0.99), totals.max());
+}
+
+
+int main(int argc, char** argv) {
+
+	const char* imagePattern = nullptr;
+	const char* listPath = nullptr;
+	const char* rawPath = nullptr;
+	const char* outputPath = "detections.csv";
+	int start = 0;
+	int width = 0;
+	int height = 0;
+	int format = -1;
+	bool binary = false;
+	int threads = std::max(1, (int)std::thread::hardware_concurrency());
+	int queue = 0;
+	long long count = 0;
+	int maxMarkers = 256;
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+
+	for (int i = 1; i < argc; i++) {
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--images") == 0 && hasValue) {
+			imagePattern = argv[++i];
+		}
+		else if (strcmp(argv[i], "--start") == 0 && hasValue) {
+			start = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--list") == 0 && hasValue) {
+			listPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--raw") == 0 && hasValue) {
+			rawPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--width") == 0 && hasValue) {
+			width = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--height") == 0 && hasValue) {
+			height = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--format") == 0 && hasValue) {
+			const char* name = argv[++i];
+			for (size_t f = 0; f < sizeof(RAW_FORMATS) / sizeof(RAW_FORMATS[0]); f++) {
+				if (strcmp(name, RAW_FORMATS[f].name) == 0) {
+					format = RAW_FORMATS[f].format;
+				}
+			}
+			if (format < 0) {
+				fprintf(stderr, "Unknown pixel format %s\n", name);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+			outputPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--binary") == 0) {
+			binary = true;
+		}
+		else if (strcmp(argv[i], "--threads") == 0 && hasValue) {
+			threads = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--queue") == 0 && hasValue) {
+			queue = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--count") == 0 && hasValue) {
+			count = std::max(0LL, atoll(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--max-markers") == 0 && hasValue) {
+			maxMarkers = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--threshold") == 0 && hasValue) {
+			config.binaryThreshold = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--marker-size") == 0 && hasValue) {
+			config.markerSize = (float)atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--camera") == 0 && hasValue) {
+			CameraIntrinsics &camera = config.camera;
+			if (sscanf(argv[++i], "%f,%f,%f,%f", &camera.focalX, &camera.focalY, &camera.principalX, &camera.principalY) != 4) {
+				fprintf(stderr, "--camera needs FX,FY,CX,CY\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--distortion") == 0 && hasValue) {
+			float* k = config.camera.distortion;
+			k[4] = 0.0f;
+			if (sscanf(argv[++i], "%f,%f,%f,%f,%f", &k[0], &k[1], &k[2], &k[3], &k[4]) < 4) {
+				fprintf(stderr, "--distortion needs K1,K2,P1,P2 and optionally K3\n");
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--pyramid") == 0 && hasValue) {
+			config.pyramidLevels = std::max(0, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--run-length") == 0) {
+			config.runLengthExtraction = 1;
+		}
+		else if (strcmp(argv[i], "--gradient-refinement") == 0) {
+			config.gradientRefinement = 1;
+		}
+		else {
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if ((imagePattern != nullptr) + (listPath != nullptr) + (rawPath != nullptr) != 1) {
+		printUsage(argv[0]);
+		return 1;
+	}
+	if (queue == 0) {
+		queue = 2 * threads;
+	}
+
+#ifdef _WIN32
+	// Raw frames and binary records must not go through newline translation
+	_setmode(_fileno(stdin), _O_BINARY);
+	if (binary) {
+		_setmode(_fileno(stdout), _O_BINARY);
+	}
+#endif
+
+	// Open the input
+	std::unique_ptr<FrameSource> source;
+	if (imagePattern) {
+		source.reset(new PatternSource(imagePattern, start));
+	}
+	else if (listPath) {
+		FILE* list = fopen(listPath, "r");
+		if (!list) {
+			fprintf(stderr, "Could not open %s\n", listPath);
+			return 1;
+		}
+		source.reset(new ListSource(list));
+	}
+	else {
+		if (RawSource::frameBytes(format, width, height) == 0) {
+			fprintf(stderr, "Raw input needs --width, --height and --format, with an even size for the chroma formats\n");
+			return 1;
+		}
+		FILE* raw = strcmp(rawPath, "-") == 0 ? stdin : fopen(rawPath, "rb");
+		if (!raw) {
+			fprintf(stderr, "Could not open %s\n", rawPath);
+			return 1;
+		}
+		source.reset(new RawSource(raw, format, width, height));
+	}
+
+	// Open the output, the report goes to the standard error when the detections use the standard output
+	bool toStdout = strcmp(outputPath, "-") == 0;
+	FILE* out = toStdout ? stdout : fopen(outputPath, binary ? "wb" : "w");
+	if (!out) {
+		fprintf(stderr, "Could not open %s\n", outputPath);
+		return 1;
+	}
+	FILE* report = toStdout ? stderr : stdout;
+	std::unique_ptr<DetectionWriter> writer;
+	if (binary) {
+		writer.reset(new BinaryWriter(out));
+	}
+	else {
+		writer.reset(new CsvWriter(out));
+	}
+
+	BatchProcessor processor(config, threads, queue, maxMarkers);
+	BatchSummary summary;
+	processor.run(*source, *writer, count, summary);
+	writer.reset();
+
+	if (summary.writeFailed) {
+		fprintf(stderr, "Could not write %s\n", outputPath);
+		return 1;
+	}
+
+	double seconds = summary.wallMs / 1000.0;
+	fprintf(report, "%lld frames (%lld unreadable), %lld markers, %d threads, %d frames in flight\n",
+		summary.frames, summary.failedFrames, summary.markers, threads, std::max(queue, threads));
+	fprintf(report, "%.3f s, %.1f frames per second\n", seconds, seconds > 0.0 ? summary.frames / seconds : 0.0);
+
+	const char* stageNames[STAGE_COUNT] = { "conversion", "contours", "polygon_filter", "refinement", "decoding", "pose", "total" };
+	fprintf(report, "%-18s %9s %9s %9s %9s\n", "Latency (ms)", "mean", "p50", "p99", "max");
+	printLatency(report, "read", summary.read);
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		printLatency(report, stageNames[i], summary.stages[i]);
+	}
+	return 0;
+}
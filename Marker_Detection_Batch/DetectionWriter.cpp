@@ -0,0 +1,139 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Detection writers of the batch tool
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <cstdint>
+
+/* Helper includes */
+#include "DetectionWriter.h"
+
+
+/*  Closes an output unless it is the standard output
+ *
+ *	@param out: The output to close
+ *
+ *	@return closed: False if buffered data could not be written
+ */
+static bool closeOutput(FILE* out) {
+	if (!out) {
+		return true;
+	}
+	if (out == stdout) {
+		return fflush(out) == 0;
+	}
+	return fclose(out) == 0;
+}
+
+
+/*  Creates a CSV writer and writes the header row
+ *
+ *	@param output: The open output, closed with the writer unless it is the standard output
+ */
+CsvWriter::CsvWriter(FILE* output) : out(output) {
+	fprintf(out, "frame,id,distance,center_x,center_y,"
+		"corner0_x,corner0_y,corner1_x,corner1_y,corner2_x,corner2_y,corner3_x,corner3_y,"
+		"translate_x,translate_y,translate_z,"
+		"rotate_11,rotate_12,rotate_13,rotate_21,rotate_22,rotate_23,rotate_31,rotate_32,rotate_33\n");
+}
+
+
+/*  Closes the output */
+CsvWriter::~CsvWriter() {
+	closeOutput(out);
+}
+
+
+/*  Writes one row per marker of a frame
+ *
+ *	@param frame: The frame number
+ *	@param markers: The markers of the frame
+ *	@param count: The number of markers
+ *
+ *	@return written: False if the output could not be written
+ */
+bool CsvWriter::writeFrame(int frame, const BatchMarker* markers, int count) {
+
+	for (int i = 0; i < count; i++) {
+		const Marker2 &m = markers[i].marker;
+		const float* c = markers[i].corners;
+		fprintf(out, "%d,%d,%.6g,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.6g,%.6g,%.6g,"
+			"%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+			frame, m.id, m.distance, m.center_x, m.center_y,
+			c[0], c[1], c[2], c[3], c[4], c[5], c[6], c[7],
+			m.translate_x, m.translate_y, m.translate_z,
+			m.rotate_11, m.rotate_12, m.rotate_13, m.rotate_21, m.rotate_22, m.rotate_23, m.rotate_31, m.rotate_32, m.rotate_33);
+	}
+	return !ferror(out);
+}
+
+
+/*  Flushes the output
+ *
+ *	@return written: False if the output could not be written
+ */
+bool CsvWriter::finish() {
+	return fflush(out) == 0 && !ferror(out);
+}
+
+
+/*  Creates a binary writer, the header is written with the first frame
+ *
+ *	@param output: The open output, closed with the writer unless it is the standard output
+ */
+BinaryWriter::BinaryWriter(FILE* output) : out(output), headerWritten(false) {
+}
+
+
+/*  Closes the output */
+BinaryWriter::~BinaryWriter() {
+	closeOutput(out);
+}
+
+
+/*  Writes the file header once, before the first frame
+ *
+ *	@return void
+ */
+void BinaryWriter::writeHeader() {
+	if (!headerWritten) {
+		const uint32_t header[2] = { (uint32_t)VERSION, (uint32_t)sizeof(BatchMarker) };
+		fwrite("MKRB", 1, 4, out);
+		fwrite(header, sizeof(header), 1, out);
+		headerWritten = true;
+	}
+}
+
+
+/*  Writes the frame number, the marker count and the marker records of a frame
+ *
+ *	@param frame: The frame number
+ *	@param markers: The markers of the frame
+ *	@param count: The number of markers
+ *
+ *	@return written: False if the output could not be written
+ */
+bool BinaryWriter::writeFrame(int frame, const BatchMarker* markers, int count) {
+
+	writeHeader();
+	const int32_t frameHeader[2] = { (int32_t)frame, (int32_t)count };
+	fwrite(frameHeader, sizeof(frameHeader), 1, out);
+	if (count > 0) {
+		fwrite(markers, sizeof(BatchMarker), count, out);
+	}
+	return !ferror(out);
+}
+
+
+/*  Flushes the output, writing the header if no frame was written
+ *
+ *	@return written: False if the output could not be written
+ */
+bool BinaryWriter::finish() {
+	writeHeader();
+	return fflush(out) == 0 && !ferror(out);
+}
@@ -0,0 +1,79 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the detection writers of the batch tool
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <cstdio>
+
+/* Helper includes */
+#include "UnityStructs.h"
+
+
+/*  One detected marker as written by the batch tool */
+struct BatchMarker
+{
+	Marker2 marker;				// ID, distance, center and pose of the marker
+	float corners[8];			// Refined corners as x, y pairs, in image coordinates
+};
+
+
+/*  Writes the markers of each frame, in frame order */
+class DetectionWriter
+{
+public:
+	virtual ~DetectionWriter() {}
+
+	/*  Writes the markers of one frame, returning false if the output could not be written */
+	virtual bool writeFrame(int frame, const BatchMarker* markers, int count) = 0;
+
+	/*  Flushes the output, returning false if it could not be written */
+	virtual bool finish() = 0;
+};
+
+
+/*  Writes one CSV row per marker, with a header row naming the columns */
+class CsvWriter : public DetectionWriter
+{
+public:
+	explicit CsvWriter(FILE* output);
+	~CsvWriter();
+
+	bool writeFrame(int frame, const BatchMarker* markers, int count);
+	bool finish();
+
+private:
+	FILE* out;					// Open output, closed with the writer
+};
+
+
+/*  Writes little-endian binary records.
+ *	The file starts with the bytes MKRB, a 32-bit version and the 32-bit size of a marker
+ *	record. Each frame follows as a 32-bit frame number, a 32-bit marker count and that
+ *	many BatchMarker records, so frames without markers are still listed.
+ */
+class BinaryWriter : public DetectionWriter
+{
+public:
+	explicit BinaryWriter(FILE* output);
+	~BinaryWriter();
+
+	bool writeFrame(int frame, const BatchMarker* markers, int count);
+	bool finish();
+
+	static const int VERSION = 1;	// Version written in the header
+
+private:
+	/*  Writes the file header if it is not in the output yet */
+	void writeHeader();
+
+	FILE* out;					// Open output, closed with the writer
+	bool headerWritten;			// True once the header is in the output
+};
@@ -0,0 +1,216 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Frame sources of the batch tool
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+/* Standard includes */
+#include <cstring>
+
+/* Helper includes */
+#include "FrameSource.h"
+
+
+/*  Longest file name read from a list */
+static const int MAX_PATH_LENGTH = 4096;
+
+
+/*  Loads an image file as an 8-bit grayscale frame
+ *	Detection only needs the luma, so decoding straight to gray avoids a colour copy.
+ *
+ *	@param frame: The frame whose path is loaded, its pixels and descriptor are filled in
+ *
+ *	@return loaded: False if the file could not be read
+ */
+static bool loadGrayImage(FrameBuffer &frame) {
+
+	frame.pixels = cv::imread(frame.path, cv::IMREAD_GRAYSCALE);
+	if (frame.pixels.empty()) {
+		return false;
+	}
+
+	memset(&frame.image, 0, sizeof(frame.image));
+	frame.image.format = PIXEL_GRAY8;
+	frame.image.width = frame.pixels.cols;
+	frame.image.height = frame.pixels.rows;
+	frame.image.planes[0] = frame.pixels.data;
+	frame.image.strides[0] = (int)frame.pixels.step;
+	return true;
+}
+
+
+/*  Creates a source over numbered image files
+ *
+ *	@param namePattern: The printf pattern of the file names, with one integer conversion
+ *	@param firstIndex: The number of the first file
+ */
+PatternSource::PatternSource(const std::string &namePattern, int firstIndex) :
+	pattern(namePattern), nextIndex(firstIndex) {
+}
+
+
+/*  Takes the next file name of the sequence
+ *
+ *	@param frame: The frame to hold the file name
+ *
+ *	@return status: Always FRAME_OK, the end is only found when a file cannot be loaded
+ */
+FrameStatus PatternSource::next(FrameBuffer &frame) {
+
+	char path[MAX_PATH_LENGTH];
+	snprintf(path, sizeof(path), pattern.c_str(), nextIndex);
+	frame.path = path;
+	nextIndex++;
+	return FRAME_OK;
+}
+
+
+/*  Loads a numbered image file
+ *
+ *	@param frame: The frame taken by next
+ *
+ *	@return status: FRAME_END if the file cannot be read, which ends the sequence
+ */
+FrameStatus PatternSource::load(FrameBuffer &frame) {
+	return loadGrayImage(frame) ? FRAME_OK : FRAME_END;
+}
+
+
+/*  Creates a source over a list of image files
+ *
+ *	@param listFile: The open list, one file name per line
+ */
+ListSource::ListSource(FILE* listFile) : list(listFile) {
+}
+
+
+/*  Closes the list */
+ListSource::~ListSource() {
+	if (list) {
+		fclose(list);
+	}
+}
+
+
+/*  Reads the next file name of the list, skipping empty lines
+ *
+ *	@param frame: The frame to hold the file name
+ *
+ *	@return status: FRAME_END once the list is exhausted
+ */
+FrameStatus ListSource::next(FrameBuffer &frame) {
+
+	char line[MAX_PATH_LENGTH];
+	while (fgets(line, sizeof(line), list)) {
+		size_t length = strlen(line);
+		while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+			line[--length] = '\0';
+		}
+		if (length > 0) {
+			frame.path = line;
+			return FRAME_OK;
+		}
+	}
+	return FRAME_END;
+}
+
+
+/*  Loads a listed image file
+ *
+ *	@param frame: The frame taken by next
+ *
+ *	@return status: FRAME_FAILED if the file cannot be read, the list goes on after it
+ */
+FrameStatus ListSource::load(FrameBuffer &frame) {
+	return loadGrayImage(frame) ? FRAME_OK : FRAME_FAILED;
+}
+
+
+/*  Creates a source over raw frames
+ *
+ *	@param input: The open input, closed with the source unless it is the standard input
+ *	@param frameFormat: The pixel format of the frames, one of PixelFormat
+ *	@param frameWidth: The width of the frames in pixels
+ *	@param frameHeight: The height of the frames in pixels
+ */
+RawSource::RawSource(FILE* input, int frameFormat, int frameWidth, int frameHeight) :
+	file(input), format(frameFormat), width(frameWidth), height(frameHeight), bytes(frameBytes(frameFormat, frameWidth, frameHeight)) {
+}
+
+
+/*  Closes the input */
+RawSource::~RawSource() {
+	if (file && file != stdin) {
+		fclose(file);
+	}
+}
+
+
+/*  Returns the number of bytes of one frame
+ *	Rows are tightly packed, and NV12 and NV21 frames hold the Y plane followed by the interleaved
+ *	chroma plane at half resolution, which needs an even width and height.
+ *
+ *	@param format: The pixel format of the frames, one of PixelFormat
+ *	@param width: The width of the frames in pixels
+ *	@param height: The height of the frames in pixels
+ *
+ *	@return bytes: The size of one frame, or 0 if the format and size do not fit
+ */
+size_t RawSource::frameBytes(int format, int width, int height) {
+
+	if (width <= 0 || height <= 0) {
+		return 0;
+	}
+
+	size_t pixels = (size_t)width * height;
+	switch (format) {
+	case PIXEL_RGBA32:
+	case PIXEL_BGRA32:
+		return 4 * pixels;
+	case PIXEL_GRAY8:
+		return pixels;
+	case PIXEL_NV12:
+	case PIXEL_NV21:
+		return (width % 2 || height % 2) ? 0 : pixels + pixels / 2;
+	case PIXEL_YUYV:
+	case PIXEL_UYVY:
+		return (width % 2) ? 0 : 2 * pixels;
+	default:
+		return 0;
+	}
+}
+
+
+/*  Reads the next raw frame into the frame buffer, which keeps its allocation between frames
+ *
+ *	@param frame: The frame to hold the pixels
+ *
+ *	@return status: FRAME_END at the end of the input, including a truncated last frame
+ */
+FrameStatus RawSource::next(FrameBuffer &frame) {
+
+	frame.pixels.create(1, (int)bytes, CV_8UC1);
+	size_t read = fread(frame.pixels.data, 1, bytes, file);
+	if (read != bytes) {
+		if (read > 0) {
+			fprintf(stderr, "Ignoring a truncated last frame of %zu bytes out of %zu\n", read, bytes);
+		}
+		return FRAME_END;
+	}
+
+	memset(&frame.image, 0, sizeof(frame.image));
+	frame.image.format = format;
+	frame.image.width = width;
+	frame.image.height = height;
+	frame.image.planes[0] = frame.pixels.data;
+	if (format == PIXEL_NV12 || format == PIXEL_NV21) {
+		frame.image.planes[1] = frame.pixels.data + (size_t)width * height;
+	}
+	return FRAME_OK;
+}
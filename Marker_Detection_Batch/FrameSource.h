@@ -0,0 +1,110 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the frame sources of the batch tool
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/* Helper includes */
+#include "UnityStructs.h"
+
+
+/*  Outcome of loading one frame */
+enum FrameStatus
+{
+	FRAME_OK,					// The frame was loaded
+	FRAME_FAILED,				// The frame exists but could not be read, it is reported without markers
+	FRAME_END					// There are no more frames
+};
+
+
+/*  One frame of the input and the buffers holding its pixels, reused from frame to frame */
+struct FrameBuffer
+{
+	std::string path;			// File holding the frame, for image inputs
+	cv::Mat pixels;				// Pixels of the frame
+	ImageDescriptor image;		// Description of the pixels handed to the detector
+};
+
+
+/*  Input of the batch tool, giving its frames in order.
+ *	Taking a frame is split in two: next runs under a lock shared by every worker, so that
+ *	frames are taken strictly in order, and load runs outside of it, so that expensive
+ *	decoding happens on several workers at once.
+ */
+class FrameSource
+{
+public:
+	virtual ~FrameSource() {}
+
+	/*  Takes the next frame of the input, called in frame order under the reading lock */
+	virtual FrameStatus next(FrameBuffer &frame) = 0;
+
+	/*  Finishes loading a frame taken by next, called outside of the reading lock */
+	virtual FrameStatus load(FrameBuffer &frame) { (void)frame; return FRAME_OK; }
+};
+
+
+/*  Image files named by a printf pattern with one integer, such as frames/%06d.png.
+ *	The sequence ends at the first index whose file cannot be read.
+ */
+class PatternSource : public FrameSource
+{
+public:
+	PatternSource(const std::string &namePattern, int firstIndex);
+
+	FrameStatus next(FrameBuffer &frame);
+	FrameStatus load(FrameBuffer &frame);
+
+private:
+	std::string pattern;		// Pattern of the file names
+	int nextIndex;				// Index of the next file
+};
+
+
+/*  Image files listed one per line in a text file, read as the frames are taken */
+class ListSource : public FrameSource
+{
+public:
+	explicit ListSource(FILE* listFile);
+	~ListSource();
+
+	FrameStatus next(FrameBuffer &frame);
+	FrameStatus load(FrameBuffer &frame);
+
+private:
+	FILE* list;					// Open list of file names, closed with the source
+};
+
+
+/*  Raw frames of a fixed size and pixel format stored back to back, as written by a camera
+ *	recorder or by ffmpeg with -f rawvideo. The input may be a pipe, since it is read once in order.
+ */
+class RawSource : public FrameSource
+{
+public:
+	RawSource(FILE* input, int frameFormat, int frameWidth, int frameHeight);
+	~RawSource();
+
+	FrameStatus next(FrameBuffer &frame);
+
+	/*  Returns the number of bytes of one frame, or 0 if the format and size do not fit */
+	static size_t frameBytes(int format, int width, int height);
+
+private:
+	FILE* file;					// Open input, closed with the source
+	int format;					// Pixel format of the frames, one of PixelFormat
+	int width;					// Width of the frames in pixels
+	int height;					// Height of the frames in pixels
+	size_t bytes;				// Bytes of one frame
+};
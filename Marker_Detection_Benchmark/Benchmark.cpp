@@ -0,0 +1,771 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Per-stage and end-to-end benchmark on synthetic marker scenes
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/* Helper includes */
+#include "SyntheticScene.h"
+#include "MarkerExport.h"
+#include "UnityStructs.h"
+#include "MarkerDetector.h"
+#include "MarkerHelpers.h"
+#include "MarkerCodes.h"
+#include "MarkerDecoder.h"
+#include "EdgeRefinement.h"
+#include "ColorConversion.h"
+#include "PoseEstimation.h"
+#include "PoseBatch.h"
+#include "CpuFeatures.h"
+#include "KernelDispatch.h"
+
+
+/*  Entry point of the detection library, defined in main.cpp */
+extern "C" void MARKER_CALL FindMarkers2(Marker2** outMarks, Color32** raw, int width, int height, int maxOutMarkerCount, int& outMarkerDetected);
+
+
+/* Largest number of markers reported per frame */
+static const int MAX_MARKERS = 256;
+
+
+/*  Timing samples of one measured quantity, in milliseconds */
+struct Timing
+{
+	std::vector<double> samples;
+
+	void add(double ms) { samples.push_back(ms); }
+};
+
+
+/*  Accuracy of the detector on a scene, measured against the ground truth */
+struct Accuracy
+{
+	int expected;			// Markers in the scene
+	int found;				// Markers detected with the right ID near the right place
+	int falsePositives;		// Detections that match no marker
+	double centerError;		// Mean distance between detected and true centers, in pixels
+};
+
+
+/*  One scene of the benchmark and everything measured on it */
+struct Scenario
+{
+	std::string name;
+	SceneSpec spec;
+	std::vector<Color32> pixels;
+	std::vector<SceneMarker> markers;
+};
+
+
+/*  Returns the current time in milliseconds */
+static double nowMs() {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+/*  Returns a percentile of the samples
+ *
+ *	@param sorted: The samples in increasing order
+ *	@param percent: The percentile, from 0 to 100
+ *
+ *	@return value: The sample at that percentile
+ */
+static double percentile(const std::vector<double> &sorted, double percent) {
+
+	if (sorted.empty()) {
+		return 0.0;
+	}
+	size_t index = (size_t)std::min((double)sorted.size() - 1, floor(percent / 100.0 * (sorted.size() - 1) + 0.5));
+	return sorted[index];
+}
+
+
+/*  Writes the summary of a timing as a JSON object
+ *
+ *	@param out: The file to write to
+ *	@param timing: The timing samples
+ *
+ *	@return void
+ */
+static void writeTiming(FILE* out, const Timing &timing) {
+
+	std::vector<double> sorted = timing.samples;
+	std::sort(sorted.begin(), sorted.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < sorted.size(); i++) {
+		sum += sorted[i];
+	}
+
+	fprintf(out, "{\"samples\": %d, \"mean_ms\": %.6f, \"median_ms\": %.6f, \"p99_ms\": %.6f, \"min_ms\": %.6f}",
+		(int)sorted.size(), sorted.empty() ? 0.0 : sum / sorted.size(), percentile(sorted, 50), percentile(sorted, 99),
+		sorted.empty() ? 0.0 : sorted[0]);
+}
+
+
+/*  Compares the detected markers with the ground truth of the scene
+ *	A detection matches a marker if its ID is the marker's, read either way round,
+ *	and its center is within a fifth of the marker size of the true center.
+ *
+ *	@param scenario: The scene with its ground truth
+ *	@param detected: The detected markers
+ *	@param count: The number of detected markers
+ *
+ *	@return accuracy: The detection accuracy
+ */
+static Accuracy measureAccuracy(const Scenario &scenario, const Marker2* detected, int count) {
+
+	Accuracy accuracy = { (int)scenario.markers.size(), 0, 0, 0.0 };
+	std::vector<bool> used(scenario.markers.size(), false);
+
+	for (int d = 0; d < count; d++) {
+		bool matched = false;
+		for (size_t m = 0; m < scenario.markers.size() && !matched; m++) {
+			const SceneMarker &marker = scenario.markers[m];
+			float dx = detected[d].center_x - marker.center.x;
+			float dy = detected[d].center_y - marker.center.y;
+			float error = sqrtf(dx * dx + dy * dy);
+			float size = (float)cv::norm(marker.corners[1] - marker.corners[0]);
+			if (used[m] || error > 0.2f * size || (detected[d].id != marker.id && detected[d].id != marker.mirroredId)) {
+				continue;
+			}
+
+			used[m] = true;
+			matched = true;
+			accuracy.found++;
+			accuracy.centerError += error;
+		}
+
+		if (!matched) {
+			accuracy.falsePositives++;
+		}
+	}
+
+	if (accuracy.found > 0) {
+		accuracy.centerError /= accuracy.found;
+	}
+	return accuracy;
+}
+
+
+/*  Times every stage of the detection separately, following the same steps as MarkerDetector
+ *	The stages run one after the other on all of the data of the frame, so that each one
+ *	can be timed on its own: conversion, threshold, contours, polygon filter, refinement,
+ *	decoding and pose.
+ *
+ *	@param scenario: The scene to process
+ *	@param config: The detector configuration
+ *	@param iterations: The number of times to run every stage
+ *	@param stages: Container to hold the timing of the seven stages
+ *	@param counts: Container to hold the number of contours, quads and decoded markers
+ *
+ *	@return void
+ */
+static void timeStages(const Scenario &scenario, const DetectorConfig &config, int iterations, Timing* stages, int* counts) {
+
+	const SceneSpec &spec = scenario.spec;
+	cv::Mat rgba(spec.height, spec.width, CV_8UC4, (void*)&scenario.pixels[0]);
+	cv::Mat gray, binary;
+	ContourArena contours;
+	std::vector<cv::Point> polygon;
+	std::vector<MarkerCandidate> quads;
+	DuplicateFilter duplicateFilter;
+	ContourLimits limits(config, 1);
+	std::vector<std::vector<cv::Point2f>> refined;
+	std::vector<std::vector<cv::Point2f>> decoded;
+
+	for (int it = 0; it < iterations; it++) {
+
+		double start = nowMs();
+		rgbaToGray(rgba, gray);
+		double converted = nowMs();
+		cv::threshold(gray, binary, config.binaryThreshold, 255, cv::THRESH_BINARY);
+		double thresholded = nowMs();
+		contours.reset();
+		contours.findContours(binary, cv::Point(0, 0));
+		double contoured = nowMs();
+
+		// Polygon filter and duplicate suppression, as in MarkerDetector::extractCandidates
+		quads.clear();
+		for (int i = 0; i < contours.size(); i++) {
+			if (filterContour(contours.contour(i), contours.length(i), limits, polygon) != CONTOUR_ACCEPTED) {
+				continue;
+			}
+
+			MarkerCandidate candidate;
+			for (int k = 0; k < 4; k++) {
+				candidate.rect[k] = polygon[k];
+			}
+			quads.push_back(candidate);
+		}
+		if (config.suppressDuplicates) {
+			duplicateFilter.filter(quads, std::max(std::sqrt(config.minMarkerArea), 8.0f));
+		}
+		double filtered = nowMs();
+
+		// Edge refinement and corner intersection
+		refined.resize(quads.size());
+		for (size_t i = 0; i < quads.size(); i++) {
+			float lineParameters[16];
+			refineEdges(lineParameters, quads[i].rect, gray);
+			refined[i].resize(4);
+			findCorners(&refined[i][0], lineParameters);
+		}
+		double refinedTime = nowMs();
+
+		// Cell sampling, border check and code reading
+		decoded.clear();
+		for (size_t i = 0; i < refined.size(); i++) {
+			int pattern;
+			if (!decodeMarkerCells(gray, &refined[i][0], config.cellThreshold, pattern)) {
+				continue;
+			}
+
+			const MarkerCode &markerCode = lookupMarkerCode(pattern);
+			if (!markerCode.valid) {
+				continue;
+			}
+			rotateCorners(&refined[i][0], markerCode.rotation);
+			decoded.push_back(refined[i]);
+		}
+		double decodedTime = nowMs();
+
+		// Pose of every decoded marker
+		float checksum = 0.0f;
+		for (size_t i = 0; i < decoded.size(); i++) {
+			cv::Point2f cameraCorners[4];
+			for (int k = 0; k < 4; k++) {
+				cameraCorners[k].x = decoded[i][k].x - spec.width * 0.5f;
+				cameraCorners[k].y = -decoded[i][k].y + spec.height * 0.5f;
+			}
+
+			float transformMatrix[16];
+			estimateSquarePose(transformMatrix, cameraCorners, config.markerSize);
+			checksum += transformMatrix[11];
+		}
+		double posed = nowMs();
+
+		// Keep the pose results alive so that the compiler cannot drop the stage
+		if (checksum == 1e30f) {
+			printf(" ");
+		}
+
+		stages[0].add(converted - start);
+		stages[1].add(thresholded - converted);
+		stages[2].add(contoured - thresholded);
+		stages[3].add(filtered - contoured);
+		stages[4].add(refinedTime - filtered);
+		stages[5].add(decodedTime - refinedTime);
+		stages[6].add(posed - decodedTime);
+
+		counts[0] = (int)contours.size();
+		counts[1] = (int)quads.size();
+		counts[2] = (int)decoded.size();
+	}
+}
+
+
+/*  Times the end-to-end FindMarkers2 call
+ *	The input is restored before every call, since the outlines are drawn into it.
+ *
+ *	@param scenario: The scene to process
+ *	@param iterations: The number of calls to time
+ *	@param timing: Container to hold the timing
+ *
+ *	@return accuracy: The detection accuracy of the last call
+ */
+static Accuracy timeFindMarkers2(const Scenario &scenario, int iterations, Timing &timing) {
+
+	std::vector<Color32> frame(scenario.pixels.size());
+	std::vector<Marker2> markers(MAX_MARKERS);
+	Marker2* outMarks = &markers[0];
+	int detected = 0;
+
+	for (int it = 0; it < iterations; it++) {
+		std::copy(scenario.pixels.begin(), scenario.pixels.end(), frame.begin());
+		Color32* raw = &frame[0];
+
+		double start = nowMs();
+		FindMarkers2(&outMarks, &raw, scenario.spec.width, scenario.spec.height, MAX_MARKERS, detected);
+		timing.add(nowMs() - start);
+	}
+
+	return measureAccuracy(scenario, outMarks, detected);
+}
+
+
+/*  Times a persistent detector with a given configuration
+ *
+ *	@param scenario: The scene to process
+ *	@param config: The detector configuration
+ *	@param iterations: The number of frames to time
+ *	@param timing: Container to hold the timing
+ *
+ *	@return accuracy: The detection accuracy of the last frame
+ */
+static Accuracy timeDetector(const Scenario &scenario, const DetectorConfig &config, int iterations, Timing &timing) {
+
+	MarkerDetector detector;
+	detector.configure(config);
+	std::vector<Color32> frame(scenario.pixels.size());
+	std::vector<Marker2> markers(MAX_MARKERS);
+	int detected = 0;
+
+	for (int it = 0; it < iterations; it++) {
+		std::copy(scenario.pixels.begin(), scenario.pixels.end(), frame.begin());
+
+		double start = nowMs();
+		detected = detector.detect(&markers[0], MAX_MARKERS, &frame[0], scenario.spec.width, scenario.spec.height);
+		timing.add(nowMs() - start);
+	}
+
+	return measureAccuracy(scenario, &markers[0], detected);
+}
+
+
+/*  Measures how far the refined corners of the detected markers are from the true corners
+ *	Every valid candidate is matched to a marker as in measureAccuracy. The detector may report
+ *	the corners from any of them and in either direction, so the error of a marker is its
+ *	smallest mean corner distance over the four rotations and both directions.
+ *
+ *	@param scenario: The scene with its ground truth
+ *	@param frame: The frame state after validation
+ *
+ *	@return error: The mean corner error over the matched markers, in pixels
+ */
+static double measureCornerError(const Scenario &scenario, const FrameState &frame) {
+
+	double total = 0.0;
+	int matched = 0;
+	std::vector<bool> used(scenario.markers.size(), false);
+
+	for (size_t r = 0; r < frame.results.size(); r++) {
+		const CandidateResult &result = frame.results[r];
+		if (!result.valid) {
+			continue;
+		}
+
+		for (size_t m = 0; m < scenario.markers.size(); m++) {
+			const SceneMarker &marker = scenario.markers[m];
+			float dx = result.marker.center_x - marker.center.x;
+			float dy = result.marker.center_y - marker.center.y;
+			float size = (float)cv::norm(marker.corners[1] - marker.corners[0]);
+			if (used[m] || sqrtf(dx * dx + dy * dy) > 0.2f * size || (result.marker.id != marker.id && result.marker.id != marker.mirroredId)) {
+				continue;
+			}
+
+			double best = DBL_MAX;
+			for (int start = 0; start < 4; start++) {
+				for (int direction = -1; direction <= 1; direction += 2) {
+					double sum = 0.0;
+					for (int k = 0; k < 4; k++) {
+						sum += cv::norm(result.corners[k] - marker.corners[(start + direction * k + 4) % 4]);
+					}
+					best = std::min(best, sum / 4.0);
+				}
+			}
+
+			used[m] = true;
+			total += best;
+			matched++;
+			break;
+		}
+	}
+
+	return matched > 0 ? total / matched : 0.0;
+}
+
+
+/*  Times a detector on the downsampled quad search, through the stages so that the refined corners can be read
+ *
+ *	@param scenario: The scene to process
+ *	@param config: The detector configuration, with pyramidLevels set
+ *	@param iterations: The number of frames to time
+ *	@param timing: Container to hold the timing
+ *	@param cornerError: Container to hold the mean corner error of the last frame, in pixels
+ *
+ *	@return accuracy: The detection accuracy of the last frame
+ */
+static Accuracy timePyramid(const Scenario &scenario, const DetectorConfig &config, int iterations, Timing &timing, double &cornerError) {
+
+	MarkerDetector detector(config);
+	FrameState frame;
+	std::vector<Color32> pixels(scenario.pixels.size());
+	std::vector<Marker2> markers(MAX_MARKERS);
+	int detected = 0;
+
+	for (int it = 0; it < iterations; it++) {
+		std::copy(scenario.pixels.begin(), scenario.pixels.end(), pixels.begin());
+
+		double start = nowMs();
+		detected = 0;
+		if (detector.extractCandidates(frame, &pixels[0], scenario.spec.width, scenario.spec.height)) {
+			detector.validateCandidates(frame);
+			detected = detector.collectMarkers(frame, &markers[0], MAX_MARKERS);
+		}
+		timing.add(nowMs() - start);
+	}
+
+	cornerError = measureCornerError(scenario, frame);
+	return measureAccuracy(scenario, &markers[0], detected);
+}
+
+
+/*  Times edge refinement, decoding and pose estimation per marker, on the true corners of the scene
+ *	Both refinement implementations are timed, so that the stripe engine can be compared
+ *	with the pixel by pixel reference, and likewise the direct cell sampling is compared
+ *	with warping the marker into a 6x6 image. The pose is timed from scratch with the
+ *	original fixed iterations, and warm started from the pose of the previous pass with the
+ *	default refinement settings, as a marker that stays in view is. The same warm started
+ *	poses are also solved together in batches, several markers per instruction.
+ *
+ *	@param scenario: The scene to process
+ *	@param iterations: The number of passes over the markers
+ *	@param reference: Container to hold the reference refinement time per marker
+ *	@param refinement: Container to hold the refinement time per marker
+ *	@param decodeReference: Container to hold the warp based decoding time per marker
+ *	@param decoding: Container to hold the decoding time per marker
+ *	@param pose: Container to hold the pose estimation time per marker
+ *	@param poseWarm: Container to hold the warm started pose estimation time per marker
+ *	@param poseBatch: Container to hold the batched warm started pose estimation time per marker
+ *
+ *	@return void
+ */
+static void timePerMarker(const Scenario &scenario, int iterations, Timing &reference, Timing &refinement,
+	Timing &decodeReference, Timing &decoding, Timing &pose, Timing &poseWarm, Timing &poseBatch) {
+
+	if (scenario.markers.empty()) {
+		return;
+	}
+
+	cv::Mat rgba(scenario.spec.height, scenario.spec.width, CV_8UC4, (void*)&scenario.pixels[0]);
+	cv::Mat gray;
+	rgbaToGray(rgba, gray);
+
+	std::vector<cv::Point> corners(4 * scenario.markers.size());
+	for (size_t m = 0; m < scenario.markers.size(); m++) {
+		for (int k = 0; k < 4; k++) {
+			corners[4 * m + k] = cv::Point((int)scenario.markers[m].corners[k].x, (int)scenario.markers[m].corners[k].y);
+		}
+	}
+
+	const cv::Point2f squareCorners[4] = {
+		cv::Point2f(-0.5f, -0.5f), cv::Point2f(5.5f, -0.5f),
+		cv::Point2f(5.5f, 5.5f), cv::Point2f(-0.5f, 5.5f)
+	};
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	PoseSolver::RefineOptions<float> refine;
+	refine.maxIterations = config.poseIterations;
+	refine.errorTolerance = config.poseErrorTolerance;
+	refine.stepTolerance = config.poseStepTolerance;
+	refine.priorTolerance = config.warmStartTolerance;
+	std::vector<float> priors(7 * scenario.markers.size());
+	std::vector<PoseBatch> batches((scenario.markers.size() + PoseBatch::SIZE - 1) / PoseBatch::SIZE);
+	for (size_t m = 0; m < scenario.markers.size(); m++) {
+		PoseBatch &batch = batches[m / PoseBatch::SIZE];
+		int lane = (int)(m % PoseBatch::SIZE);
+		batch.count = lane + 1;
+		for (int k = 0; k < 4; k++) {
+			batch.cornerX[k][lane] = scenario.markers[m].corners[k].x - scenario.spec.width * 0.5f;
+			batch.cornerY[k][lane] = -scenario.markers[m].corners[k].y + scenario.spec.height * 0.5f;
+		}
+		batch.markerSize[lane] = scenario.spec.markerSize;
+	}
+
+	double count = (double)scenario.markers.size();
+	float lineParameters[16];
+	cv::Mat lineParamsMat(cv::Size(4, 4), CV_32F, lineParameters);
+	cv::Mat planarMarker;
+	int checksum = 0;
+	for (int it = 0; it < iterations; it++) {
+
+		double start = nowMs();
+		for (size_t m = 0; m < scenario.markers.size(); m++) {
+			refineEdgesReference(lineParamsMat, &corners[4 * m], gray);
+		}
+		double referenceDone = nowMs();
+		for (size_t m = 0; m < scenario.markers.size(); m++) {
+			refineEdges(lineParameters, &corners[4 * m], gray);
+		}
+		double refinementDone = nowMs();
+		for (size_t m = 0; m < scenario.markers.size(); m++) {
+			cv::Matx33d projectionMatrix;
+			findPerspectiveTransform(scenario.markers[m].corners, squareCorners, projectionMatrix);
+			cv::warpPerspective(gray, planarMarker, cv::Mat(3, 3, CV_64F, projectionMatrix.val), cv::Size(6, 6));
+			cv::threshold(planarMarker, planarMarker, 100, 255, cv::THRESH_BINARY);
+			if (checkBorderIsBlack(planarMarker)) {
+				checksum += lookupMarkerCode(packMarkerCells(planarMarker)).id;
+			}
+		}
+		double decodeReferenceDone = nowMs();
+		for (size_t m = 0; m < scenario.markers.size(); m++) {
+			int pattern;
+			if (decodeMarkerCells(gray, scenario.markers[m].corners, 100, pattern)) {
+				checksum += lookupMarkerCode(pattern).id;
+			}
+		}
+		double decodingDone = nowMs();
+		for (size_t m = 0; m < scenario.markers.size(); m++) {
+			cv::Point2f cameraCorners[4];
+			for (int k = 0; k < 4; k++) {
+				cameraCorners[k].x = scenario.markers[m].corners[k].x - scenario.spec.width * 0.5f;
+				cameraCorners[k].y = -scenario.markers[m].corners[k].y + scenario.spec.height * 0.5f;
+			}
+			float transformMatrix[16];
+			estimateSquarePose(transformMatrix, cameraCorners, scenario.spec.markerSize);
+		}
+		double poseDone = nowMs();
+		for (size_t m = 0; m < scenario.markers.size(); m++) {
+			cv::Point2f cameraCorners[4];
+			for (int k = 0; k < 4; k++) {
+				cameraCorners[k].x = scenario.markers[m].corners[k].x - scenario.spec.width * 0.5f;
+				cameraCorners[k].y = -scenario.markers[m].corners[k].y + scenario.spec.height * 0.5f;
+			}
+			float transformMatrix[16];
+			estimateSquarePose(transformMatrix, &priors[7 * m], it > 0, cameraCorners, scenario.spec.markerSize,
+				SCENE_FOCAL_LENGTH, SCENE_FOCAL_LENGTH, refine);
+		}
+		double poseWarmDone = nowMs();
+		for (size_t b = 0; b < batches.size(); b++) {
+			std::fill(batches[b].hasPrior, batches[b].hasPrior + PoseBatch::SIZE, it > 0);
+			estimateSquarePoses(batches[b], SCENE_FOCAL_LENGTH, SCENE_FOCAL_LENGTH, refine);
+		}
+		double poseBatchDone = nowMs();
+
+		reference.add((referenceDone - start) / count);
+		refinement.add((refinementDone - referenceDone) / count);
+		decodeReference.add((decodeReferenceDone - refinementDone) / count);
+		decoding.add((decodingDone - decodeReferenceDone) / count);
+		pose.add((poseDone - decodingDone) / count);
+		poseWarm.add((poseWarmDone - poseDone) / count);
+		poseBatch.add((poseBatchDone - poseWarmDone) / count);
+	}
+
+	// Keep the decoded IDs alive so that the compiler cannot drop the loops
+	if (checksum == -1) {
+		printf(" ");
+	}
+}
+
+
+/*  Writes the accuracy of a run as JSON fields
+ *
+ *	@param out: The file to write to
+ *	@param accuracy: The accuracy to write
+ *
+ *	@return void
+ */
+static void writeAccuracy(FILE* out, const Accuracy &accuracy) {
+	fprintf(out, "\"expected\": %d, \"found\": %d, \"false_positives\": %d, \"center_error_px\": %.4f",
+		accuracy.expected, accuracy.found, accuracy.falsePositives, accuracy.centerError);
+}
+
+
+/*  Builds the default set of scenes: resolutions, marker counts, tilts and clutter levels
+ *
+ *	@param quick: True for a reduced set that runs in a few seconds
+ *
+ *	@return scenarios: The scenes to benchmark
+ */
+static std::vector<Scenario> defaultScenarios(bool quick) {
+
+	struct Preset { const char* name; int width, height, markers; float pixels, tilt; int clutter, noise; };
+	const Preset presets[] = {
+		{ "vga_1_marker", 640, 480, 1, 120.0f, 20.0f, 0, 4 },
+		{ "vga_8_markers_clutter", 640, 480, 8, 70.0f, 35.0f, 40, 6 },
+		{ "hd_16_markers", 1280, 720, 16, 90.0f, 35.0f, 20, 6 },
+		{ "hd_16_markers_heavy_clutter", 1280, 720, 16, 90.0f, 45.0f, 300, 10 },
+		{ "fullhd_32_markers", 1920, 1080, 32, 100.0f, 40.0f, 100, 6 },
+		{ "fullhd_4_small_markers", 1920, 1080, 4, 45.0f, 30.0f, 50, 6 },
+		{ "uhd_12_large_markers", 3840, 2160, 12, 360.0f, 40.0f, 150, 6 },
+	};
+
+	std::vector<Scenario> scenarios;
+	int numPresets = quick ? 2 : (int)(sizeof(presets) / sizeof(presets[0]));
+	for (int i = 0; i < numPresets; i++) {
+		Scenario scenario;
+		scenario.name = presets[i].name;
+		scenario.spec.width = presets[i].width;
+		scenario.spec.height = presets[i].height;
+		scenario.spec.markerCount = presets[i].markers;
+		scenario.spec.markerPixels = presets[i].pixels;
+		scenario.spec.maxTilt = presets[i].tilt;
+		scenario.spec.markerSize = 4.5f;
+		scenario.spec.clutter = presets[i].clutter;
+		scenario.spec.noise = presets[i].noise;
+		scenario.spec.seed = 1234u + (unsigned int)i;
+		renderScene(scenario.spec, scenario.pixels, scenario.markers);
+		scenarios.push_back(scenario);
+	}
+
+	return scenarios;
+}
+
+
+/*  Runs the benchmark and writes the results as JSON
+ *	Usage: Marker_Detection_Benchmark [--iterations N] [--output file.json] [--quick]
+ */
+int main(int argc, char** argv) {
+
+	int iterations = 50;
+	const char* outputPath = "benchmark.json";
+	bool quick = false;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+			iterations = std::max(1, atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			outputPath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--quick") == 0) {
+			quick = true;
+		}
+		else {
+			fprintf(stderr, "Usage: %s [--iterations N] [--output file.json] [--quick]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	FILE* out = fopen(outputPath, "w");
+	if (!out) {
+		fprintf(stderr, "Could not open %s\n", outputPath);
+		return 1;
+	}
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+
+	const char* stageNames[7] = { "conversion", "threshold", "contours", "polygon_filter", "refinement", "decoding", "pose" };
+	const char* countNames[3] = { "contours", "quads", "decoded" };
+
+	// The kernel level is recorded so that runs with different MARKER_CPU_LEVEL settings can be told apart
+	const char* kernelLevel = cpuLevelName(activeKernels().level);
+	printf("Kernels: %s (processor supports %s)\n", kernelLevel, cpuLevelName(detectCpuLevel()));
+
+	std::vector<Scenario> scenarios = defaultScenarios(quick);
+	fprintf(out, "{\n  \"iterations\": %d,\n  \"kernel_level\": \"%s\",\n  \"scenarios\": [\n", iterations, kernelLevel);
+	for (size_t s = 0; s < scenarios.size(); s++) {
+		const Scenario &scenario = scenarios[s];
+		const SceneSpec &spec = scenario.spec;
+		printf("%s (%dx%d, %d markers)\n", scenario.name.c_str(), spec.width, spec.height, spec.markerCount);
+
+		fprintf(out, "    {\n      \"name\": \"%s\", \"width\": %d, \"height\": %d, \"markers\": %d, "
+			"\"marker_pixels\": %.1f, \"max_tilt\": %.1f, \"clutter\": %d, \"noise\": %d,\n",
+			scenario.name.c_str(), spec.width, spec.height, spec.markerCount, spec.markerPixels, spec.maxTilt, spec.clutter, spec.noise);
+
+		// Per-stage timing
+		Timing stages[7];
+		int counts[3] = { 0, 0, 0 };
+		timeStages(scenario, config, iterations, stages, counts);
+		fprintf(out, "      \"stages\": {\n");
+		for (int i = 0; i < 7; i++) {
+			fprintf(out, "        \"%s\": ", stageNames[i]);
+			writeTiming(out, stages[i]);
+			fprintf(out, ",\n");
+		}
+		fprintf(out, "        \"counts\": {");
+		for (int i = 0; i < 3; i++) {
+			fprintf(out, "\"%s\": %d%s", countNames[i], counts[i], i < 2 ? ", " : "");
+		}
+		fprintf(out, "}\n      },\n");
+
+		// End-to-end through the exported function
+		Timing endToEnd;
+		Accuracy accuracy = timeFindMarkers2(scenario, iterations, endToEnd);
+		fprintf(out, "      \"find_markers2\": {\"time\": ");
+		writeTiming(out, endToEnd);
+		fprintf(out, ", ");
+		writeAccuracy(out, accuracy);
+		fprintf(out, "},\n");
+
+		// Detector variants: serial validation, the run-length extractor and the refinement on the shared gradient image
+		struct Variant { const char* name; int parallel; int runLength; int gradient; };
+		const Variant variants[] = {
+			{ "serial", 0, 0, 0 }, { "parallel", 1, 0, 0 },
+			{ "run_length_serial", 0, 1, 0 }, { "run_length", 1, 1, 0 },
+			{ "gradient_refinement_serial", 0, 0, 1 }, { "gradient_refinement", 1, 0, 1 }
+		};
+		const int variantCount = (int)(sizeof(variants) / sizeof(variants[0]));
+		fprintf(out, "      \"variants\": [\n");
+		for (int v = 0; v < variantCount; v++) {
+			DetectorConfig variantConfig = config;
+			variantConfig.parallelCandidates = variants[v].parallel;
+			variantConfig.runLengthExtraction = variants[v].runLength;
+			variantConfig.gradientRefinement = variants[v].gradient;
+
+			Timing timing;
+			Accuracy variantAccuracy = timeDetector(scenario, variantConfig, iterations, timing);
+			fprintf(out, "        {\"name\": \"%s\", \"time\": ", variants[v].name);
+			writeTiming(out, timing);
+			fprintf(out, ", ");
+			writeAccuracy(out, variantAccuracy);
+			fprintf(out, "}%s\n", v + 1 < variantCount ? "," : "");
+		}
+		fprintf(out, "      ],\n");
+
+		// Quad search on the image downsampled 1, 2, 4 and 8 times, which trades the smallest markers
+		// for speed. The corners are always refined at full resolution, which the corner error shows.
+		fprintf(out, "      \"pyramid\": [\n");
+		for (int levels = 0; levels <= 3; levels++) {
+			DetectorConfig pyramidConfig = config;
+			pyramidConfig.pyramidLevels = levels;
+
+			Timing timing;
+			double cornerError = 0.0;
+			Accuracy pyramidAccuracy = timePyramid(scenario, pyramidConfig, iterations, timing, cornerError);
+			fprintf(out, "        {\"levels\": %d, \"time\": ", levels);
+			writeTiming(out, timing);
+			fprintf(out, ", ");
+			writeAccuracy(out, pyramidAccuracy);
+			fprintf(out, ", \"detection_rate\": %.4f, \"corner_error_px\": %.4f}%s\n",
+				pyramidAccuracy.expected > 0 ? pyramidAccuracy.found / (double)pyramidAccuracy.expected : 0.0,
+				cornerError, levels < 3 ? "," : "");
+		}
+		fprintf(out, "      ],\n");
+
+		// Per-marker micro benchmarks
+		Timing reference, refinement, decodeReference, decoding, pose, poseWarm, poseBatch;
+		timePerMarker(scenario, iterations, reference, refinement, decodeReference, decoding, pose, poseWarm, poseBatch);
+		fprintf(out, "      \"per_marker\": {\n        \"refinement_reference\": ");
+		writeTiming(out, reference);
+		fprintf(out, ",\n        \"refinement\": ");
+		writeTiming(out, refinement);
+		fprintf(out, ",\n        \"decoding_reference\": ");
+		writeTiming(out, decodeReference);
+		fprintf(out, ",\n        \"decoding\": ");
+		writeTiming(out, decoding);
+		fprintf(out, ",\n        \"pose\": ");
+		writeTiming(out, pose);
+		fprintf(out, ",\n        \"pose_warm_start\": ");
+		writeTiming(out, poseWarm);
+		fprintf(out, ",\n        \"pose_batch\": ");
+		writeTiming(out, poseBatch);
+		fprintf(out, "\n      }\n    }%s\n", s + 1 < scenarios.size() ? "," : "");
+
+		printf("  end to end %.3f ms, found %d of %d\n", endToEnd.samples.empty() ? 0.0 : endToEnd.samples.back(),
+			accuracy.found, accuracy.expected);
+	}
+	fprintf(out, "  ]\n}\n");
+	fclose(out);
+
+	printf("Results written to %s\n", outputPath);
+	return 0;
+}
@@ -0,0 +1,304 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Synthetic marker scene generator
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+/* Helper includes */
+#include "SyntheticScene.h"
+#include "MarkerHelpers.h"
+
+
+/* Gray levels of the black and white marker cells */
+static const int BLACK_LEVEL = 30;
+static const int WHITE_LEVEL = 225;
+
+/* Gray level of the scene background */
+static const int BACKGROUND_LEVEL = 190;
+
+static const float PI = 3.14159265f;
+
+
+/*  Tells whether a cell of the 6x6 marker is black
+ *	Bit i of the code is row (i / 4) + 1 and column 4 - (i % 4) of the marker,
+ *	which is how getMarkerIDs reads it back.
+ *
+ *	@param code: The 16-bit code of the marker
+ *	@param row: The cell row, from 0 to 5
+ *	@param col: The cell column, from 0 to 5
+ *
+ *	@return black: True if the cell is black
+ */
+static bool cellIsBlack(int code, int row, int col) {
+
+	if (row == 0 || row == 5 || col == 0 || col == 5) {
+		return true;
+	}
+
+	int bit = (row - 1) * 4 + (4 - col);
+	return ((code >> bit) & 1) != 0;
+}
+
+
+/*  Returns the ID the detector reports for a code
+ *	The code is drawn into a rectified 6x6 marker and read back with getMarkerIDs,
+ *	so this always agrees with the detector.
+ *
+ *	@param code: The 16-bit code of the marker
+ *	@param mirrored: True to read the marker mirrored along its diagonal
+ *
+ *	@return id: The minimum code over the four rotations
+ */
+int markerIdForCode(int code, bool mirrored) {
+
+	cv::Mat planarMarker(6, 6, CV_8UC1);
+	for (int row = 0; row < 6; row++) {
+		for (int col = 0; col < 6; col++) {
+			bool black = mirrored ? cellIsBlack(code, col, row) : cellIsBlack(code, row, col);
+			planarMarker.at<uchar>(row, col) = black ? 0 : 255;
+		}
+	}
+
+	int codes[4];
+	getMarkerIDs(planarMarker, codes);
+	return std::min(std::min(codes[0], codes[1]), std::min(codes[2], codes[3]));
+}
+
+
+/*  Projects a point on the marker plane into the image
+ *	Uses the same camera as the pose estimation: the camera looks down the negative z axis,
+ *	and image y grows downwards while camera y grows upwards.
+ *
+ *	@param R: The 3x3 rotation of the marker in row-major order
+ *	@param t: The translation of the marker
+ *	@param x: The x coordinate on the marker plane
+ *	@param y: The y coordinate on the marker plane
+ *	@param spec: The scene, for the image size
+ *
+ *	@return image: The image coordinates of the point
+ */
+static cv::Point2f projectMarkerPoint(const float* R, const float* t, float x, float y, const SceneSpec &spec) {
+
+	float px = R[0] * x + R[1] * y + t[0];
+	float py = R[3] * x + R[4] * y + t[1];
+	float pz = R[6] * x + R[7] * y + t[2];
+
+	return cv::Point2f(spec.width * 0.5f + SCENE_FOCAL_LENGTH * px / -pz,
+		spec.height * 0.5f - SCENE_FOCAL_LENGTH * py / -pz);
+}
+
+
+/*  Draws distractor shapes: dark quads without a valid code, circles and lines
+ *
+ *	@param image: The RGBA image to draw into
+ *	@param spec: The scene parameters
+ *	@param rng: The random generator of the scene
+ *
+ *	@return void
+ */
+static void drawClutter(cv::Mat &image, const SceneSpec &spec, std::mt19937 &rng) {
+
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float maxSize = std::max(8.0f, spec.markerPixels);
+
+	for (int i = 0; i < spec.clutter; i++) {
+		cv::Point center((int)(unit(rng) * spec.width), (int)(unit(rng) * spec.height));
+		int level = (int)(unit(rng) * BACKGROUND_LEVEL * 0.6f);
+		cv::Scalar color(level, level, level, 255);
+		float size = maxSize * (0.2f + unit(rng));
+
+		switch (i % 3) {
+		case 0: {
+			// A dark quad, which passes the polygon filter but not the border or code checks
+			cv::Point quad[4];
+			float angle = unit(rng) * 2 * PI;
+			for (int k = 0; k < 4; k++) {
+				float a = angle + k * PI / 2 + (unit(rng) - 0.5f) * 0.3f;
+				quad[k] = cv::Point(center.x + (int)(size * 0.7f * cosf(a)), center.y + (int)(size * 0.7f * sinf(a)));
+			}
+			cv::fillConvexPoly(image, quad, 4, color, cv::LINE_AA);
+			break;
+		}
+		case 1:
+			cv::circle(image, center, (int)(size * 0.5f), color, cv::FILLED, cv::LINE_AA);
+			break;
+		default: {
+			float angle = unit(rng) * 2 * PI;
+			cv::Point end(center.x + (int)(size * cosf(angle)), center.y + (int)(size * sinf(angle)));
+			cv::line(image, center, end, color, 1 + (int)(unit(rng) * 4), cv::LINE_AA);
+			break;
+		}
+		}
+	}
+}
+
+
+/*  Draws one marker with its white quiet zone
+ *	Every pixel is supersampled 2x2 through the homography from the image to the marker cells.
+ *
+ *	@param image: The RGBA image to draw into
+ *	@param imageCorners: The image positions of the corners of the quiet zone
+ *	@param code: The 16-bit code of the marker
+ *
+ *	@return void
+ */
+static void drawMarker(cv::Mat &image, const cv::Point2f* imageCorners, int code) {
+
+	// The quiet zone is one cell wide, so it spans cells -1 to 7
+	const cv::Point2f cellCorners[4] = {
+		cv::Point2f(-1.0f, -1.0f), cv::Point2f(7.0f, -1.0f), cv::Point2f(7.0f, 7.0f), cv::Point2f(-1.0f, 7.0f)
+	};
+	cv::Matx33d toCells;
+	findPerspectiveTransform(imageCorners, cellCorners, toCells);
+
+	float minX = imageCorners[0].x, maxX = minX, minY = imageCorners[0].y, maxY = minY;
+	for (int k = 1; k < 4; k++) {
+		minX = std::min(minX, imageCorners[k].x);
+		maxX = std::max(maxX, imageCorners[k].x);
+		minY = std::min(minY, imageCorners[k].y);
+		maxY = std::max(maxY, imageCorners[k].y);
+	}
+	int x0 = std::max(0, (int)floorf(minX)), x1 = std::min(image.cols - 1, (int)ceilf(maxX));
+	int y0 = std::max(0, (int)floorf(minY)), y1 = std::min(image.rows - 1, (int)ceilf(maxY));
+
+	const double* h = toCells.val;
+	for (int y = y0; y <= y1; y++) {
+		Color32* row = image.ptr<Color32>(y);
+		for (int x = x0; x <= x1; x++) {
+
+			int sum = 0;
+			int covered = 0;
+			for (int s = 0; s < 4; s++) {
+				double sx = x + ((s & 1) ? 0.25 : -0.25);
+				double sy = y + ((s & 2) ? 0.25 : -0.25);
+				double w = h[6] * sx + h[7] * sy + h[8];
+				double cx = (h[0] * sx + h[1] * sy + h[2]) / w;
+				double cy = (h[3] * sx + h[4] * sy + h[5]) / w;
+				if (cx < -1.0 || cx >= 7.0 || cy < -1.0 || cy >= 7.0) {
+					sum += row[x].r;
+					continue;
+				}
+
+				bool inside = cx >= 0.0 && cx < 6.0 && cy >= 0.0 && cy < 6.0;
+				sum += (inside && cellIsBlack(code, (int)cy, (int)cx)) ? BLACK_LEVEL : WHITE_LEVEL;
+				covered++;
+			}
+
+			if (covered > 0) {
+				uchar value = (uchar)((sum + 2) / 4);
+				row[x].r = row[x].g = row[x].b = value;
+			}
+		}
+	}
+}
+
+
+/*  Renders a scene of markers and clutter into an RGBA image
+ *	Markers are spread over a grid so that they do not overlap, each with a random
+ *	in-plane rotation and tilt. Clutter is drawn first so that it never covers a marker.
+ *
+ *	@param spec: The scene parameters
+ *	@param pixels: Container to hold the width x height RGBA image
+ *	@param markers: Container to hold the ground truth of every marker
+ *
+ *	@return void
+ */
+void renderScene(const SceneSpec &spec, std::vector<Color32> &pixels, std::vector<SceneMarker> &markers) {
+
+	std::mt19937 rng(spec.seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	const Color32 background = { (uchar)BACKGROUND_LEVEL, (uchar)BACKGROUND_LEVEL, (uchar)BACKGROUND_LEVEL, 255 };
+	pixels.assign((size_t)spec.width * spec.height, background);
+	markers.clear();
+	cv::Mat image(spec.height, spec.width, CV_8UC4, &pixels[0]);
+
+	drawClutter(image, spec, rng);
+
+	// Split the image into a grid with one marker per cell
+	int columns = (int)ceil(sqrt((double)std::max(1, spec.markerCount) * spec.width / spec.height));
+	int rows = (spec.markerCount + columns - 1) / std::max(1, columns);
+	float cellWidth = spec.width / (float)columns;
+	float cellHeight = spec.height / (float)std::max(1, rows);
+
+	for (int i = 0; i < spec.markerCount; i++) {
+
+		// Shrink the marker if it would not fit its cell together with the quiet zone
+		float pixelsPerSide = std::min(spec.markerPixels, 0.6f * std::min(cellWidth, cellHeight));
+		float u = (i % columns + 0.5f) * cellWidth + (unit(rng) - 0.5f) * 0.1f * cellWidth;
+		float v = (i / columns + 0.5f) * cellHeight + (unit(rng) - 0.5f) * 0.1f * cellHeight;
+
+		// Place the marker at the depth that gives the requested size, along the ray through (u, v)
+		float depth = SCENE_FOCAL_LENGTH * spec.markerSize / pixelsPerSide;
+		float t[3] = {
+			(u - spec.width * 0.5f) * depth / SCENE_FOCAL_LENGTH,
+			-(v - spec.height * 0.5f) * depth / SCENE_FOCAL_LENGTH,
+			-depth
+		};
+
+		// Rotate in the plane, then tilt around a random axis in the plane
+		float spin = unit(rng) * 2 * PI;
+		float tilt = unit(rng) * spec.maxTilt * PI / 180.0f;
+		float axis = unit(rng) * 2 * PI;
+		float ax = cosf(axis), ay = sinf(axis), c = cosf(tilt), s = sinf(tilt);
+		float tiltR[9] = {
+			c + ax * ax * (1 - c), ax * ay * (1 - c), ay * s,
+			ax * ay * (1 - c), c + ay * ay * (1 - c), -ax * s,
+			-ay * s, ax * s, c
+		};
+		float spinR[9] = { cosf(spin), -sinf(spin), 0, sinf(spin), cosf(spin), 0, 0, 0, 1 };
+		float R[9];
+		for (int r = 0; r < 3; r++) {
+			for (int k = 0; k < 3; k++) {
+				R[3 * r + k] = tiltR[3 * r] * spinR[k] + tiltR[3 * r + 1] * spinR[3 + k] + tiltR[3 * r + 2] * spinR[6 + k];
+			}
+		}
+
+		// Pick a code the detector accepts, which excludes all black and all white
+		int code = 1 + (int)(unit(rng) * 0xfffe);
+
+		SceneMarker marker;
+		marker.code = code;
+		marker.id = markerIdForCode(code, false);
+		marker.mirroredId = markerIdForCode(code, true);
+		for (int k = 0; k < 3; k++) {
+			marker.translation[k] = t[k];
+		}
+
+		// Project the corners of the black border and of the quiet zone
+		float half = spec.markerSize * 0.5f;
+		float quiet = half * 8.0f / 6.0f;
+		const float signX[4] = { -1, 1, 1, -1 };
+		const float signY[4] = { 1, 1, -1, -1 };
+		cv::Point2f quietCorners[4];
+		marker.center = cv::Point2f(0, 0);
+		for (int k = 0; k < 4; k++) {
+			marker.corners[k] = projectMarkerPoint(R, t, signX[k] * half, signY[k] * half, spec);
+			quietCorners[k] = projectMarkerPoint(R, t, signX[k] * quiet, signY[k] * quiet, spec);
+			marker.center += marker.corners[k] * 0.25f;
+		}
+
+		drawMarker(image, quietCorners, code);
+		markers.push_back(marker);
+	}
+
+	// Add sensor noise
+	if (spec.noise > 0) {
+		std::uniform_int_distribution<int> noise(-spec.noise, spec.noise);
+		for (size_t p = 0; p < pixels.size(); p++) {
+			int value = std::min(255, std::max(0, pixels[p].r + noise(rng)));
+			pixels[p].r = pixels[p].g = pixels[p].b = (uchar)value;
+		}
+	}
+}
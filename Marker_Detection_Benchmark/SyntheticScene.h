@@ -0,0 +1,55 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the synthetic marker scene generator
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <vector>
+
+/* Helper includes */
+#include "UnityStructs.h"
+
+
+/* Focal length in pixels assumed by the pose estimation, used to place the markers */
+static const float SCENE_FOCAL_LENGTH = 400.0f;
+
+
+/*  Parameters of a synthetic scene */
+struct SceneSpec
+{
+	int width;				// Width of the image in pixels
+	int height;				// Height of the image in pixels
+	int markerCount;		// Number of markers to place in the image
+	float markerPixels;		// Approximate side length of each marker in pixels
+	float maxTilt;			// Largest out of plane rotation of a marker, in degrees
+	float markerSize;		// Side length of the marker, in the units of the returned translation
+	int clutter;			// Number of distractor shapes drawn behind the markers
+	int noise;				// Amplitude of the uniform noise added to every pixel
+	unsigned int seed;		// Seed of the random generator, so that scenes can be reproduced
+};
+
+
+/*  Ground truth of one marker placed in a scene */
+struct SceneMarker
+{
+	int code;				// Raw 16-bit code in the inner cells of the marker
+	int id;					// ID the detector reports for this code
+	int mirroredId;			// ID the detector reports if it reads the marker mirrored
+	cv::Point2f corners[4];	// Corners of the black border, in image coordinates
+	cv::Point2f center;		// Center of the marker, in image coordinates
+	float translation[3];	// Translation of the marker, in the convention of Marker2
+};
+
+
+/*  Returns the ID the detector reports for a code, as the minimum over the four rotations */
+int markerIdForCode(int code, bool mirrored);
+
+/*  Renders a scene of markers and clutter into an RGBA image */
+void renderScene(const SceneSpec &spec, std::vector<Color32> &pixels, std::vector<SceneMarker> &markers);
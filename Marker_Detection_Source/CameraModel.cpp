@@ -0,0 +1,137 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Camera model used by the pose estimation
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <cmath>
+#include <cstring>
+
+/* Helper includes */
+#include "CameraModel.h"
+
+
+/* Fixed-point iterations used to invert the distortion, past the 5 cv::undistortPoints stops at by default */
+static const int UNDISTORT_ITERATIONS = 20;
+
+
+/*  Builds the model of a camera for images of the given size
+ *	A negative principal point stands for the image center, which is what the detector has
+ *	always assumed. With any distortion, the undistortion table is filled in here.
+ *
+ *	@param intrinsics: The calibration of the camera
+ *	@param imageWidth: The width of the images in pixels
+ *	@param imageHeight: The height of the images in pixels
+ */
+CameraModel::CameraModel(const CameraIntrinsics &intrinsics, int imageWidth, int imageHeight) :
+	calibration(intrinsics), width(imageWidth), height(imageHeight), gridCols(0), gridRows(0) {
+
+	fx = intrinsics.focalX;
+	fy = intrinsics.focalY;
+	cx = intrinsics.principalX < 0.0f ? width * 0.5f : intrinsics.principalX;
+	cy = intrinsics.principalY < 0.0f ? height * 0.5f : intrinsics.principalY;
+
+	distorted = false;
+	for (int i = 0; i < 5; i++) {
+		distorted |= intrinsics.distortion[i] != 0.0f;
+	}
+	if (!distorted) {
+		return;
+	}
+
+	// One entry every GRID_STEP pixels, up to the first entry at or past the last pixel
+	gridCols = (width - 1) / GRID_STEP + 2;
+	gridRows = (height - 1) / GRID_STEP + 2;
+	grid.resize((size_t)gridCols * gridRows);
+	for (int row = 0; row < gridRows; row++) {
+		for (int col = 0; col < gridCols; col++) {
+			grid[(size_t)row * gridCols + col] = undistort((float)(col * GRID_STEP), (float)(row * GRID_STEP));
+		}
+	}
+}
+
+
+/*  Returns true if the model was built from the same calibration and image size
+ *
+ *	@param intrinsics: The calibration of the camera
+ *	@param imageWidth: The width of the images in pixels
+ *	@param imageHeight: The height of the images in pixels
+ *
+ *	@return matches: True if the model can be reused
+ */
+bool CameraModel::matches(const CameraIntrinsics &intrinsics, int imageWidth, int imageHeight) const {
+	return width == imageWidth && height == imageHeight && memcmp(&calibration, &intrinsics, sizeof(intrinsics)) == 0;
+}
+
+
+/*  Removes the distortion from an image point
+ *	Inverts the distortion model with the fixed-point iteration of cv::undistortPoints.
+ *
+ *	@param x: The x coordinate of the point in pixels
+ *	@param y: The y coordinate of the point in pixels
+ *
+ *	@return point: The undistorted point in normalized camera coordinates, with y down
+ */
+cv::Point2f CameraModel::undistort(float x, float y) const {
+
+	const float* k = calibration.distortion;
+	double x0 = (x - cx) / (double)fx;
+	double y0 = (y - cy) / (double)fy;
+	double u = x0, v = y0;
+	for (int i = 0; i < UNDISTORT_ITERATIONS; i++) {
+		double r2 = u * u + v * v;
+		double radial = 1.0 / (1.0 + ((k[4] * r2 + k[1]) * r2 + k[0]) * r2);
+		double deltaX = 2.0 * k[2] * u * v + k[3] * (r2 + 2.0 * u * u);
+		double deltaY = k[2] * (r2 + 2.0 * v * v) + 2.0 * k[3] * u * v;
+		u = (x0 - deltaX) * radial;
+		v = (y0 - deltaY) * radial;
+	}
+
+	return cv::Point2f((float)u, (float)v);
+}
+
+
+/*  Converts an image point to the coordinates of the pose solver
+ *	Without distortion this is only the shift to the principal point. Otherwise the point is
+ *	undistorted by interpolating the table, falling back to the iterative solve for points
+ *	outside of the image.
+ *
+ *	@param point: The point in image pixels
+ *
+ *	@return camera: The undistorted point in pixels relative to the principal point, with y up
+ */
+cv::Point2f CameraModel::toCamera(const cv::Point2f &point) const {
+
+	if (!distorted) {
+		return cv::Point2f(point.x - cx, cy - point.y);
+	}
+
+	cv::Point2f normalized;
+	float gx = point.x / GRID_STEP;
+	float gy = point.y / GRID_STEP;
+	if (gx >= 0.0f && gy >= 0.0f && gx < gridCols - 1 && gy < gridRows - 1) {
+		int col = (int)gx;
+		int row = (int)gy;
+		float ax = gx - col;
+		float ay = gy - row;
+		const cv::Point2f* top = &grid[(size_t)row * gridCols + col];
+		const cv::Point2f* bottom = top + gridCols;
+		float topX = top[0].x + (top[1].x - top[0].x) * ax;
+		float topY = top[0].y + (top[1].y - top[0].y) * ax;
+		float bottomX = bottom[0].x + (bottom[1].x - bottom[0].x) * ax;
+		float bottomY = bottom[0].y + (bottom[1].y - bottom[0].y) * ax;
+		normalized.x = topX + (bottomX - topX) * ay;
+		normalized.y = topY + (bottomY - topY) * ay;
+	}
+	else {
+		normalized = undistort(point.x, point.y);
+	}
+
+	return cv::Point2f(normalized.x * fx, -normalized.y * fy);
+}
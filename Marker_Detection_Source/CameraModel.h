@@ -0,0 +1,62 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the camera model used by the pose estimation
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <vector>
+
+/* Helper includes */
+#include "UnityStructs.h"
+
+
+/*  Calibrated camera for one image size, turning refined corners into the coordinates the
+ *	pose solver works in.
+ *	Lens distortion is removed from the four corners of each marker only, never from the whole
+ *	frame. The undistorted position of every pixel on a coarse grid is computed once when the
+ *	model is built, so correcting a corner is a bilinear lookup instead of an iterative solve.
+ *	A model does not change once built, so frames in flight can share it across threads.
+ */
+class CameraModel
+{
+public:
+	/*  Builds the model of a camera for images of the given size */
+	CameraModel(const CameraIntrinsics &intrinsics, int width, int height);
+
+	/*  Returns true if the model was built from the same calibration and image size */
+	bool matches(const CameraIntrinsics &intrinsics, int width, int height) const;
+
+	/*  Converts an image point to undistorted pixels relative to the principal point, with y up */
+	cv::Point2f toCamera(const cv::Point2f &point) const;
+
+	/*  Returns the focal length along x in pixels */
+	float focalX() const { return fx; }
+
+	/*  Returns the focal length along y in pixels */
+	float focalY() const { return fy; }
+
+	static const int GRID_STEP = 8;		// Pixels between the entries of the undistortion table
+
+private:
+	/*  Removes the distortion from an image point, returning normalized camera coordinates */
+	cv::Point2f undistort(float x, float y) const;
+
+	CameraIntrinsics calibration;		// Calibration the model was built from
+	int width;							// Width of the images in pixels
+	int height;							// Height of the images in pixels
+	float fx;							// Focal length along x in pixels
+	float fy;							// Focal length along y in pixels
+	float cx;							// x coordinate of the principal point in pixels
+	float cy;							// y coordinate of the principal point in pixels
+	bool distorted;						// False for an ideal lens, which needs no table
+	int gridCols;						// Entries of the table along x
+	int gridRows;						// Entries of the table along y
+	std::vector<cv::Point2f> grid;		// Normalized undistorted position of every GRID_STEP-th pixel, row by row
+};
@@ -0,0 +1,584 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Colour conversion kernels
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Helper includes */
+#include "UnityStructs.h"
+#include "ColorConversion.h"
+#include "KernelDispatch.h"
+
+/* SIMD includes */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MARKER_SSE2 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+
+/*  Fixed-point weights used by OpenCV for RGB to grayscale (scaled by 2^14)
+ *	Using the same weights and rounding keeps the output identical to
+ *	cvtColor(RGBA2BGR) followed by cvtColor(BGR2GRAY).
+ */
+static const int GRAY_SHIFT = 14;
+static const int GRAY_R = 4899;
+static const int GRAY_G = 9617;
+static const int GRAY_B = 1868;
+static const int GRAY_ROUND = 1 << (GRAY_SHIFT - 1);
+
+
+#ifndef MARKER_ISA_VARIANT
+/*  Converts one row of four-channel pixels to grayscale, optionally thresholding it in the same pass
+ *	The green channel is always second, the weights of the first and third channels select RGBA or BGRA.
+ *	This is the reference implementation that the SIMD paths must match bit for bit.
+ *
+ *	@param pixels: Pointer to the first pixel of the row
+ *	@param gray: Pointer to the output grayscale row
+ *	@param binary: Pointer to the output binary row, or NULL to skip thresholding
+ *	@param width: The number of pixels in the row
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary row
+ *	@param firstWeight: The weight of the first channel
+ *	@param thirdWeight: The weight of the third channel
+ *
+ *	@return void
+ */
+void colorToGrayRowScalar(const uchar* pixels, uchar* gray, uchar* binary, int width, int thresh, int firstWeight, int thirdWeight) {
+
+	for (int x = 0; x < width; x++) {
+		const uchar* p = pixels + 4 * x;
+		int value = (p[0] * firstWeight + p[1] * GRAY_G + p[2] * thirdWeight + GRAY_ROUND) >> GRAY_SHIFT;
+		gray[x] = (uchar)value;
+
+		if (binary) {
+			binary[x] = (value > thresh) ? 255 : 0;
+		}
+	}
+}
+
+
+/*  Converts one row of RGBA pixels to grayscale, optionally thresholding it in the same pass
+ *	This is the reference implementation that the SIMD paths must match bit for bit.
+ *
+ *	@param rgba: Pointer to the first RGBA pixel of the row
+ *	@param gray: Pointer to the output grayscale row
+ *	@param binary: Pointer to the output binary row, or NULL to skip thresholding
+ *	@param width: The number of pixels in the row
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary row
+ *
+ *	@return void
+ */
+void rgbaToGrayRowScalar(const uchar* rgba, uchar* gray, uchar* binary, int width, int thresh) {
+	colorToGrayRowScalar(rgba, gray, binary, width, thresh, GRAY_R, GRAY_B);
+}
+
+
+/*  Copies the luma of one row of packed 4:2:2 pixels, optionally thresholding it in the same pass
+ *	This is the reference implementation that the SIMD paths must match bit for bit.
+ *
+ *	@param yuv: Pointer to the first pixel of the row
+ *	@param gray: Pointer to the output grayscale row
+ *	@param binary: Pointer to the output binary row, or NULL to skip thresholding
+ *	@param width: The number of pixels in the row
+ *	@param lumaOffset: The position of the luma within each pixel, 0 for YUYV and 1 for UYVY
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary row
+ *
+ *	@return void
+ */
+void yuv422ToGrayRowScalar(const uchar* yuv, uchar* gray, uchar* binary, int width, int lumaOffset, int thresh) {
+
+	for (int x = 0; x < width; x++) {
+		uchar value = yuv[2 * x + lumaOffset];
+		gray[x] = value;
+
+		if (binary) {
+			binary[x] = (value > thresh) ? 255 : 0;
+		}
+	}
+}
+#endif
+
+
+namespace MARKER_ISA {
+
+
+MARKER_BEGIN_UNDEFINED_LANES
+
+
+/*  Converts one row of four-channel pixels to grayscale, optionally thresholding it in the same pass
+ *	Uses AVX-512, AVX2, SSE2 or NEON depending on the level it is compiled for, with the scalar path
+ *	for the row tail. The widest loop runs first and the narrower ones take what it leaves.
+ *
+ *	@param pixels: Pointer to the first pixel of the row
+ *	@param gray: Pointer to the output grayscale row
+ *	@param binary: Pointer to the output binary row, or NULL to skip thresholding
+ *	@param width: The number of pixels in the row
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary row
+ *	@param firstWeight: The weight of the first channel
+ *	@param thirdWeight: The weight of the third channel
+ *
+ *	@return void
+ */
+static void colorToGrayRow(const uchar* pixels, uchar* gray, uchar* binary, int width, int thresh, int firstWeight, int thirdWeight) {
+
+	// Thresholds outside of the 8 bit range cannot be compared in unsigned byte lanes
+	if (binary && (thresh < 0 || thresh > 254)) {
+		colorToGrayRowScalar(pixels, gray, binary, width, thresh, firstWeight, thirdWeight);
+		return;
+	}
+
+	int x = 0;
+
+#if defined(__AVX512BW__)
+	// Same lane layout as the AVX2 path, with four lanes of four pixels per register
+	const __m512i weights512 = _mm512_set1_epi64((long long)(((unsigned long long)thirdWeight << 32) |
+		((unsigned long long)GRAY_G << 16) | (unsigned long long)firstWeight));
+	const __m512i round512 = _mm512_set1_epi32(GRAY_ROUND);
+	const __m512i zero512 = _mm512_setzero_si512();
+	const __m512i order512 = _mm512_setr_epi32(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+	const __m512i thresh512 = _mm512_set1_epi8((char)thresh);
+
+	// Each iteration converts 64 pixels
+	for (; x <= width - 64; x += 64) {
+		__m512i sums[4];
+		for (int k = 0; k < 4; k++) {
+			__m512i px = _mm512_loadu_si512((const void*)(pixels + 4 * x + 64 * k));
+			__m512i lo = _mm512_madd_epi16(_mm512_unpacklo_epi8(px, zero512), weights512);
+			__m512i hi = _mm512_madd_epi16(_mm512_unpackhi_epi8(px, zero512), weights512);
+
+			__m512 even = _mm512_shuffle_ps(_mm512_castsi512_ps(lo), _mm512_castsi512_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+			__m512 odd = _mm512_shuffle_ps(_mm512_castsi512_ps(lo), _mm512_castsi512_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+			__m512i sum = _mm512_add_epi32(_mm512_castps_si512(even), _mm512_castps_si512(odd));
+			sums[k] = _mm512_srli_epi32(_mm512_add_epi32(sum, round512), GRAY_SHIFT);
+		}
+
+		// Pack down to bytes, then gather the groups of four pixels spread over the lanes
+		__m512i words0 = _mm512_packs_epi32(sums[0], sums[1]);
+		__m512i words1 = _mm512_packs_epi32(sums[2], sums[3]);
+		__m512i bytes = _mm512_permutexvar_epi32(order512, _mm512_packus_epi16(words0, words1));
+		_mm512_storeu_si512((void*)(gray + x), bytes);
+
+		if (binary) {
+			_mm512_storeu_si512((void*)(binary + x), _mm512_movm_epi8(_mm512_cmpgt_epu8_mask(bytes, thresh512)));
+		}
+	}
+#endif
+
+#if defined(__AVX2__)
+	// Weights are paired as (R, G) and (B, A) so that madd sums each pixel into two 32 bit lanes
+	const __m256i weights = _mm256_setr_epi16(firstWeight, GRAY_G, thirdWeight, 0, firstWeight, GRAY_G, thirdWeight, 0,
+		firstWeight, GRAY_G, thirdWeight, 0, firstWeight, GRAY_G, thirdWeight, 0);
+	const __m256i round = _mm256_set1_epi32(GRAY_ROUND);
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+	const __m256i signFlip = _mm256_set1_epi8((char)0x80);
+	const __m256i threshVec = _mm256_set1_epi8((char)(thresh ^ 0x80));
+
+	// Each iteration converts 32 pixels
+	for (; x <= width - 32; x += 32) {
+		__m256i sums[4];
+		for (int k = 0; k < 4; k++) {
+			__m256i px = _mm256_loadu_si256((const __m256i*)(pixels + 4 * x + 32 * k));
+			__m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi8(px, zero), weights);
+			__m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi8(px, zero), weights);
+
+			// Add the (R, G) and (B, A) partial sums of each pixel, keeping pixel order within each lane
+			__m256 even = _mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+			__m256 odd = _mm256_shuffle_ps(_mm256_castsi256_ps(lo), _mm256_castsi256_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+			__m256i sum = _mm256_add_epi32(_mm256_castps_si256(even), _mm256_castps_si256(odd));
+			sums[k] = _mm256_srli_epi32(_mm256_add_epi32(sum, round), GRAY_SHIFT);
+		}
+
+		// Pack down to bytes, then undo the per-lane interleaving of the packs
+		__m256i words0 = _mm256_packs_epi32(sums[0], sums[1]);
+		__m256i words1 = _mm256_packs_epi32(sums[2], sums[3]);
+		__m256i bytes = _mm256_packus_epi16(words0, words1);
+		bytes = _mm256_permutevar8x32_epi32(bytes, order);
+		_mm256_storeu_si256((__m256i*)(gray + x), bytes);
+
+		if (binary) {
+			__m256i mask = _mm256_cmpgt_epi8(_mm256_xor_si256(bytes, signFlip), threshVec);
+			_mm256_storeu_si256((__m256i*)(binary + x), mask);
+		}
+	}
+
+#elif defined(MARKER_SSE2)
+	// Weights are paired as (R, G) and (B, A) so that madd sums each pixel into two 32 bit lanes
+	const __m128i weights = _mm_setr_epi16(firstWeight, GRAY_G, thirdWeight, 0, firstWeight, GRAY_G, thirdWeight, 0);
+	const __m128i round = _mm_set1_epi32(GRAY_ROUND);
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i signFlip = _mm_set1_epi8((char)0x80);
+	const __m128i threshVec = _mm_set1_epi8((char)(thresh ^ 0x80));
+
+	// Each iteration converts 16 pixels
+	for (; x <= width - 16; x += 16) {
+		__m128i sums[4];
+		for (int k = 0; k < 4; k++) {
+			__m128i px = _mm_loadu_si128((const __m128i*)(pixels + 4 * x + 16 * k));
+			__m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), weights);
+			__m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), weights);
+
+			// Add the (R, G) and (B, A) partial sums of each pixel
+			__m128 even = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1));
+			__m128i sum = _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+			sums[k] = _mm_srli_epi32(_mm_add_epi32(sum, round), GRAY_SHIFT);
+		}
+
+		// Pack down to bytes
+		__m128i words0 = _mm_packs_epi32(sums[0], sums[1]);
+		__m128i words1 = _mm_packs_epi32(sums[2], sums[3]);
+		__m128i bytes = _mm_packus_epi16(words0, words1);
+		_mm_storeu_si128((__m128i*)(gray + x), bytes);
+
+		if (binary) {
+			__m128i mask = _mm_cmpgt_epi8(_mm_xor_si128(bytes, signFlip), threshVec);
+			_mm_storeu_si128((__m128i*)(binary + x), mask);
+		}
+	}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	const uint8x16_t threshVec = vdupq_n_u8((uint8_t)thresh);
+
+	// Each iteration converts 16 pixels, with the channels deinterleaved by the load
+	for (; x <= width - 16; x += 16) {
+		uint8x16x4_t px = vld4q_u8(pixels + 4 * x);
+
+		uint16x8_t rLo = vmovl_u8(vget_low_u8(px.val[0]));
+		uint16x8_t gLo = vmovl_u8(vget_low_u8(px.val[1]));
+		uint16x8_t bLo = vmovl_u8(vget_low_u8(px.val[2]));
+		uint16x8_t rHi = vmovl_u8(vget_high_u8(px.val[0]));
+		uint16x8_t gHi = vmovl_u8(vget_high_u8(px.val[1]));
+		uint16x8_t bHi = vmovl_u8(vget_high_u8(px.val[2]));
+
+		// Weighted sums in 32 bit lanes, then a rounding narrow shift
+		uint32x4_t s0 = vmull_n_u16(vget_low_u16(rLo), (uint16_t)firstWeight);
+		uint32x4_t s1 = vmull_n_u16(vget_high_u16(rLo), (uint16_t)firstWeight);
+		uint32x4_t s2 = vmull_n_u16(vget_low_u16(rHi), (uint16_t)firstWeight);
+		uint32x4_t s3 = vmull_n_u16(vget_high_u16(rHi), (uint16_t)firstWeight);
+		s0 = vmlal_n_u16(s0, vget_low_u16(gLo), GRAY_G);
+		s1 = vmlal_n_u16(s1, vget_high_u16(gLo), GRAY_G);
+		s2 = vmlal_n_u16(s2, vget_low_u16(gHi), GRAY_G);
+		s3 = vmlal_n_u16(s3, vget_high_u16(gHi), GRAY_G);
+		s0 = vmlal_n_u16(s0, vget_low_u16(bLo), (uint16_t)thirdWeight);
+		s1 = vmlal_n_u16(s1, vget_high_u16(bLo), (uint16_t)thirdWeight);
+		s2 = vmlal_n_u16(s2, vget_low_u16(bHi), (uint16_t)thirdWeight);
+		s3 = vmlal_n_u16(s3, vget_high_u16(bHi), (uint16_t)thirdWeight);
+
+		uint16x8_t wordsLo = vcombine_u16(vrshrn_n_u32(s0, GRAY_SHIFT), vrshrn_n_u32(s1, GRAY_SHIFT));
+		uint16x8_t wordsHi = vcombine_u16(vrshrn_n_u32(s2, GRAY_SHIFT), vrshrn_n_u32(s3, GRAY_SHIFT));
+		uint8x16_t bytes = vcombine_u8(vmovn_u16(wordsLo), vmovn_u16(wordsHi));
+		vst1q_u8(gray + x, bytes);
+
+		if (binary) {
+			vst1q_u8(binary + x, vcgtq_u8(bytes, threshVec));
+		}
+	}
+#endif
+
+	// Convert whatever is left over
+	colorToGrayRowScalar(pixels + 4 * x, gray + x, binary ? binary + x : NULL, width - x, thresh, firstWeight, thirdWeight);
+}
+
+
+/*  Converts one row of RGBA pixels to grayscale, optionally thresholding it in the same pass
+ *	Kernel for the level of this namespace, reached through activeKernels.
+ *
+ *	@param rgba: Pointer to the first RGBA pixel of the row
+ *	@param gray: Pointer to the output grayscale row
+ *	@param binary: Pointer to the output binary row, or NULL to skip thresholding
+ *	@param width: The number of pixels in the row
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary row
+ *
+ *	@return void
+ */
+static void rgbaToGrayRow(const uchar* rgba, uchar* gray, uchar* binary, int width, int thresh) {
+	colorToGrayRow(rgba, gray, binary, width, thresh, GRAY_R, GRAY_B);
+}
+
+
+/*  Converts one row of BGRA pixels to grayscale, optionally thresholding it in the same pass
+ *	Kernel for the level of this namespace, reached through activeKernels.
+ *
+ *	@param bgra: Pointer to the first BGRA pixel of the row
+ *	@param gray: Pointer to the output grayscale row
+ *	@param binary: Pointer to the output binary row, or NULL to skip thresholding
+ *	@param width: The number of pixels in the row
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary row
+ *
+ *	@return void
+ */
+static void bgraToGrayRow(const uchar* bgra, uchar* gray, uchar* binary, int width, int thresh) {
+	colorToGrayRow(bgra, gray, binary, width, thresh, GRAY_B, GRAY_R);
+}
+
+
+/*  Copies the luma of one row of packed 4:2:2 pixels, optionally thresholding it in the same pass
+ *	Every pixel takes two bytes, its luma and one of the chroma samples it shares with its neighbour,
+ *	so the luma bytes only have to be gathered. Uses AVX-512, AVX2, SSE2 or NEON depending on the
+ *	level it is compiled for, the widest loop first.
+ *
+ *	@param yuv: Pointer to the first pixel of the row
+ *	@param gray: Pointer to the output grayscale row
+ *	@param binary: Pointer to the output binary row, or NULL to skip thresholding
+ *	@param width: The number of pixels in the row
+ *	@param lumaOffset: The position of the luma within each pixel, 0 for YUYV and 1 for UYVY
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary row
+ *
+ *	@return void
+ */
+static void yuv422ToGrayRow(const uchar* yuv, uchar* gray, uchar* binary, int width, int lumaOffset, int thresh) {
+
+	// Thresholds outside of the 8 bit range cannot be compared in unsigned byte lanes
+	if (binary && (thresh < 0 || thresh > 254)) {
+		yuv422ToGrayRowScalar(yuv, gray, binary, width, lumaOffset, thresh);
+		return;
+	}
+
+	int x = 0;
+
+#if defined(__AVX512BW__)
+	const __m512i lowBytes512 = _mm512_set1_epi16(0x00ff);
+	const __m512i thresh512 = _mm512_set1_epi8((char)thresh);
+	const __m512i order512 = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+
+	// Each iteration gathers 64 pixels, then undoes the per-lane interleaving of the pack
+	for (; x <= width - 64; x += 64) {
+		__m512i lo = _mm512_loadu_si512((const void*)(yuv + 2 * x));
+		__m512i hi = _mm512_loadu_si512((const void*)(yuv + 2 * x + 64));
+		if (lumaOffset) {
+			lo = _mm512_srli_epi16(lo, 8);
+			hi = _mm512_srli_epi16(hi, 8);
+		}
+		__m512i bytes = _mm512_packus_epi16(_mm512_and_si512(lo, lowBytes512), _mm512_and_si512(hi, lowBytes512));
+		bytes = _mm512_permutexvar_epi64(order512, bytes);
+		_mm512_storeu_si512((void*)(gray + x), bytes);
+
+		if (binary) {
+			_mm512_storeu_si512((void*)(binary + x), _mm512_movm_epi8(_mm512_cmpgt_epu8_mask(bytes, thresh512)));
+		}
+	}
+#endif
+
+#if defined(__AVX2__)
+	const __m256i lowBytes256 = _mm256_set1_epi16(0x00ff);
+	const __m256i signFlip256 = _mm256_set1_epi8((char)0x80);
+	const __m256i thresh256 = _mm256_set1_epi8((char)(thresh ^ 0x80));
+
+	// Each iteration gathers 32 pixels, then undoes the per-lane interleaving of the pack
+	for (; x <= width - 32; x += 32) {
+		__m256i lo = _mm256_loadu_si256((const __m256i*)(yuv + 2 * x));
+		__m256i hi = _mm256_loadu_si256((const __m256i*)(yuv + 2 * x + 32));
+		if (lumaOffset) {
+			lo = _mm256_srli_epi16(lo, 8);
+			hi = _mm256_srli_epi16(hi, 8);
+		}
+		__m256i bytes = _mm256_packus_epi16(_mm256_and_si256(lo, lowBytes256), _mm256_and_si256(hi, lowBytes256));
+		bytes = _mm256_permute4x64_epi64(bytes, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256((__m256i*)(gray + x), bytes);
+
+		if (binary) {
+			__m256i mask = _mm256_cmpgt_epi8(_mm256_xor_si256(bytes, signFlip256), thresh256);
+			_mm256_storeu_si256((__m256i*)(binary + x), mask);
+		}
+	}
+#endif
+
+#if defined(__AVX2__) || defined(MARKER_SSE2)
+	const __m128i lowBytes = _mm_set1_epi16(0x00ff);
+	const __m128i signFlip = _mm_set1_epi8((char)0x80);
+	const __m128i threshVec = _mm_set1_epi8((char)(thresh ^ 0x80));
+
+	// Each iteration gathers 16 pixels, moving the luma to the low byte of each word for UYVY
+	for (; x <= width - 16; x += 16) {
+		__m128i lo = _mm_loadu_si128((const __m128i*)(yuv + 2 * x));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(yuv + 2 * x + 16));
+		if (lumaOffset) {
+			lo = _mm_srli_epi16(lo, 8);
+			hi = _mm_srli_epi16(hi, 8);
+		}
+		__m128i bytes = _mm_packus_epi16(_mm_and_si128(lo, lowBytes), _mm_and_si128(hi, lowBytes));
+		_mm_storeu_si128((__m128i*)(gray + x), bytes);
+
+		if (binary) {
+			__m128i mask = _mm_cmpgt_epi8(_mm_xor_si128(bytes, signFlip), threshVec);
+			_mm_storeu_si128((__m128i*)(binary + x), mask);
+		}
+	}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	const uint8x16_t threshVec = vdupq_n_u8((uint8_t)thresh);
+
+	// Each iteration gathers 16 pixels, with luma and chroma deinterleaved by the load
+	for (; x <= width - 16; x += 16) {
+		uint8x16x2_t px = vld2q_u8(yuv + 2 * x);
+		uint8x16_t bytes = lumaOffset ? px.val[1] : px.val[0];
+		vst1q_u8(gray + x, bytes);
+
+		if (binary) {
+			vst1q_u8(binary + x, vcgtq_u8(bytes, threshVec));
+		}
+	}
+#endif
+
+	// Copy whatever is left over
+	yuv422ToGrayRowScalar(yuv + 2 * x, gray + x, binary ? binary + x : NULL, width - x, lumaOffset, thresh);
+}
+
+
+MARKER_END_UNDEFINED_LANES
+
+
+/*  Fills a table with the colour conversion kernels of this level
+ *
+ *	@param table: Container to hold the kernels
+ *
+ *	@return void
+ */
+void fillColorKernels(KernelTable &table) {
+	table.rgbaToGrayRow = rgbaToGrayRow;
+	table.bgraToGrayRow = bgraToGrayRow;
+	table.yuv422ToGrayRow = yuv422ToGrayRow;
+}
+
+}
+
+
+#ifndef MARKER_ISA_VARIANT
+/*  Converts one row of RGBA pixels to grayscale, optionally thresholding it in the same pass
+ *	Runs the kernel chosen for this processor, see activeKernels.
+ *
+ *	@param rgba: Pointer to the first RGBA pixel of the row
+ *	@param gray: Pointer to the output grayscale row
+ *	@param binary: Pointer to the output binary row, or NULL to skip thresholding
+ *	@param width: The number of pixels in the row
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary row
+ *
+ *	@return void
+ */
+void rgbaToGrayRow(const uchar* rgba, uchar* gray, uchar* binary, int width, int thresh) {
+	activeKernels().rgbaToGrayRow(rgba, gray, binary, width, thresh);
+}
+
+
+/*  Converts one row of BGRA pixels to grayscale, optionally thresholding it in the same pass
+ *	Runs the kernel chosen for this processor, see activeKernels.
+ *
+ *	@param bgra: Pointer to the first BGRA pixel of the row
+ *	@param gray: Pointer to the output grayscale row
+ *	@param binary: Pointer to the output binary row, or NULL to skip thresholding
+ *	@param width: The number of pixels in the row
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary row
+ *
+ *	@return void
+ */
+void bgraToGrayRow(const uchar* bgra, uchar* gray, uchar* binary, int width, int thresh) {
+	activeKernels().bgraToGrayRow(bgra, gray, binary, width, thresh);
+}
+
+
+/*  Copies the luma of one row of packed 4:2:2 pixels, optionally thresholding it in the same pass
+ *	Every pixel takes two bytes, its luma and one of the chroma samples it shares with its neighbour,
+ *	so the luma bytes only have to be gathered. Runs the kernel chosen for this processor, see activeKernels.
+ *
+ *	@param yuv: Pointer to the first pixel of the row
+ *	@param gray: Pointer to the output grayscale row
+ *	@param binary: Pointer to the output binary row, or NULL to skip thresholding
+ *	@param width: The number of pixels in the row
+ *	@param lumaOffset: The position of the luma within each pixel, 0 for YUYV and 1 for UYVY
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary row
+ *
+ *	@return void
+ */
+void yuv422ToGrayRow(const uchar* yuv, uchar* gray, uchar* binary, int width, int lumaOffset, int thresh) {
+	activeKernels().yuv422ToGrayRow(yuv, gray, binary, width, lumaOffset, thresh);
+}
+
+
+/*  Converts an RGBA image to grayscale in a single pass
+ *
+ *	@param rgba_im: The RGBA input image (CV_8UC4)
+ *	@param gray_im: The grayscale output image, (re)allocated if needed
+ *
+ *	@return void
+ */
+void rgbaToGray(const cv::Mat &rgba_im, cv::Mat &gray_im) {
+
+	gray_im.create(rgba_im.rows, rgba_im.cols, CV_8UC1);
+
+	for (int y = 0; y < rgba_im.rows; y++) {
+		rgbaToGrayRow(rgba_im.ptr<uchar>(y), gray_im.ptr<uchar>(y), NULL, rgba_im.cols, 0);
+	}
+}
+
+
+/*  Converts an RGBA image to grayscale and binarizes it in a single pass
+ *	Equivalent to cvtColor to grayscale followed by threshold with THRESH_BINARY and a max value of 255.
+ *
+ *	@param rgba_im: The RGBA input image (CV_8UC4)
+ *	@param gray_im: The grayscale output image, (re)allocated if needed
+ *	@param binary_im: The binary output image, (re)allocated if needed
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary image
+ *
+ *	@return void
+ */
+void rgbaToGrayThreshold(const cv::Mat &rgba_im, cv::Mat &gray_im, cv::Mat &binary_im, int thresh) {
+
+	gray_im.create(rgba_im.rows, rgba_im.cols, CV_8UC1);
+	binary_im.create(rgba_im.rows, rgba_im.cols, CV_8UC1);
+
+	for (int y = 0; y < rgba_im.rows; y++) {
+		rgbaToGrayRow(rgba_im.ptr<uchar>(y), gray_im.ptr<uchar>(y), binary_im.ptr<uchar>(y), rgba_im.cols, thresh);
+	}
+}
+
+
+/*  Converts an image in a packed colour or 4:2:2 format to grayscale, optionally binarizing it in the same pass
+ *	The luma formats need no conversion, since their first plane already is the grayscale image.
+ *
+ *	@param pixels: The input image, as wrapped by wrapImage (CV_8UC4 or CV_8UC2)
+ *	@param format: The pixel format of the input, one of PixelFormat
+ *	@param gray_im: The grayscale output image, (re)allocated if needed
+ *	@param binary_im: The binary output image, (re)allocated if needed, or NULL to skip thresholding
+ *	@param thresh: Pixels brighter than this value are set to 255 in the binary image
+ *
+ *	@return void
+ */
+void convertToGray(const cv::Mat &pixels, int format, cv::Mat &gray_im, cv::Mat* binary_im, int thresh) {
+
+	gray_im.create(pixels.rows, pixels.cols, CV_8UC1);
+	if (binary_im) {
+		binary_im->create(pixels.rows, pixels.cols, CV_8UC1);
+	}
+
+	for (int y = 0; y < pixels.rows; y++) {
+		const uchar* row = pixels.ptr<uchar>(y);
+		uchar* gray = gray_im.ptr<uchar>(y);
+		uchar* binary = binary_im ? binary_im->ptr<uchar>(y) : NULL;
+
+		switch (format) {
+		case PIXEL_BGRA32:
+			bgraToGrayRow(row, gray, binary, pixels.cols, thresh);
+			break;
+		case PIXEL_YUYV:
+			yuv422ToGrayRow(row, gray, binary, pixels.cols, 0, thresh);
+			break;
+		case PIXEL_UYVY:
+			yuv422ToGrayRow(row, gray, binary, pixels.cols, 1, thresh);
+			break;
+		default:
+			rgbaToGrayRow(row, gray, binary, pixels.cols, thresh);
+			break;
+		}
+	}
+}
+
+#endif
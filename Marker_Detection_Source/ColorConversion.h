@@ -0,0 +1,39 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for colour conversion kernels
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+
+/*  Converts one row of four-channel pixels to grayscale with the given weights for the first and third channels (reference path) */
+void colorToGrayRowScalar(const uchar* pixels, uchar* gray, uchar* binary, int width, int thresh, int firstWeight, int thirdWeight);
+
+/*  Converts one row of RGBA pixels to grayscale, optionally thresholding it in the same pass (reference path) */
+void rgbaToGrayRowScalar(const uchar* rgba, uchar* gray, uchar* binary, int width, int thresh);
+
+/*  Converts one row of RGBA pixels to grayscale, optionally thresholding it in the same pass (SIMD path chosen at runtime) */
+void rgbaToGrayRow(const uchar* rgba, uchar* gray, uchar* binary, int width, int thresh);
+
+/*  Converts one row of BGRA pixels to grayscale, optionally thresholding it in the same pass (SIMD path chosen at runtime) */
+void bgraToGrayRow(const uchar* bgra, uchar* gray, uchar* binary, int width, int thresh);
+
+/*  Copies the luma of one row of YUYV or UYVY pixels, optionally thresholding it in the same pass (reference path) */
+void yuv422ToGrayRowScalar(const uchar* yuv, uchar* gray, uchar* binary, int width, int lumaOffset, int thresh);
+
+/*  Copies the luma of one row of YUYV or UYVY pixels, optionally thresholding it in the same pass (SIMD path chosen at runtime) */
+void yuv422ToGrayRow(const uchar* yuv, uchar* gray, uchar* binary, int width, int lumaOffset, int thresh);
+
+/*  Converts an RGBA image to grayscale in a single pass */
+void rgbaToGray(const cv::Mat &rgba_im, cv::Mat &gray_im);
+
+/*  Converts an RGBA image to grayscale and binarizes it in a single pass */
+void rgbaToGrayThreshold(const cv::Mat &rgba_im, cv::Mat &gray_im, cv::Mat &binary_im, int thresh);
+
+/*  Converts an image in a packed colour or 4:2:2 format to grayscale, optionally binarizing it in the same pass */
+void convertToGray(const cv::Mat &pixels, int format, cv::Mat &gray_im, cv::Mat* binary_im, int thresh);
@@ -0,0 +1,186 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Flat contour storage of a frame
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cstring>
+
+/* Helper includes */
+#include "ContourArena.h"
+
+
+/* Steps to the eight neighbours of a pixel, in the chain code order of OpenCV: right first, then counter-clockwise */
+static const int STEP_X[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int STEP_Y[8] = { 0, -1, -1, -1, 0, 1, 1, 1 };
+
+/* Marks of the padded image, as the tracer of OpenCV leaves them */
+static const schar UNVISITED = 1;					// Foreground pixel not on a border followed so far
+static const schar VISITED = 2;						// Pixel of a followed border
+static const schar RIGHT_BORDER = (schar)(2 | -128);	// Pixel of a followed border with background on its right
+
+
+/*  Forgets the contours of the previous frame, keeping the memory
+ *	The point buffer and the spans keep their capacity for the next frame.
+ *
+ *	@return void
+ */
+void ContourArena::reset() {
+	points.clear();
+	spans.clear();
+}
+
+
+/*  Follows one border from its first pixel and appends its points
+ *	This is the border following of Suzuki and Abe as OpenCV writes it for CHAIN_APPROX_SIMPLE:
+ *	the neighbours are searched counter-clockwise, pixels are marked as they are passed, and a
+ *	point is kept only where the direction changes. Keeping the same marks and the same search
+ *	order is what gives the same points as cv::findContours.
+ *
+ *	@param start: The first pixel of the border in the padded image
+ *	@param step: The row step of the padded image in bytes
+ *	@param point: The position of the first pixel in frame coordinates
+ *	@param hole: True for the border of a hole, which starts on the foreground pixel left of it
+ *
+ *	@return void
+ */
+void ContourArena::followBorder(schar* start, int step, cv::Point point, bool hole) {
+
+	// The directions twice over, so that a search can run past the last one without wrapping
+	int deltas[16];
+	for (int k = 0; k < 8; k++) {
+		deltas[k] = STEP_Y[k] * step + STEP_X[k];
+		deltas[k + 8] = deltas[k];
+	}
+
+	ContourSpan span;
+	span.offset = (int)points.size();
+
+	// Looks clockwise from the background side for the last pixel of the border
+	int s = hole ? 0 : 4;
+	int sEnd = s;
+	schar* last;
+	do {
+		s = (s - 1) & 7;
+		last = start + deltas[s];
+	} while (*last == 0 && s != sEnd);
+
+	if (s == sEnd) {
+
+		// A pixel on its own is a contour of one point
+		*start = RIGHT_BORDER;
+		points.push_back(point);
+	}
+	else {
+		schar* current = start;
+		schar* next;
+		int previous = s ^ 4;
+
+		for (;;) {
+
+			// Looks counter-clockwise from the pixel before for the pixel after
+			sEnd = s;
+			do {
+				next = current + deltas[++s];
+			} while (*next == 0 && s < 15);
+			s &= 7;
+
+			if ((unsigned)(s - 1) < (unsigned)sEnd) {
+				*current = RIGHT_BORDER;
+			}
+			else if (*current == UNVISITED) {
+				*current = VISITED;
+			}
+
+			if (s != previous) {
+				points.push_back(point);
+				previous = s;
+			}
+			point.x += STEP_X[s];
+			point.y += STEP_Y[s];
+
+			if (next == start && current == last) {
+				break;
+			}
+			current = next;
+			s = (s + 4) & 7;
+		}
+	}
+
+	span.length = (int)points.size() - span.offset;
+	spans.push_back(span);
+}
+
+
+/*  Traces the contours of a binary image and appends them to the arena
+ *	Takes the same steps as cv::findContours with RETR_LIST and CHAIN_APPROX_SIMPLE: the
+ *	image is copied as marks inside a zero border, so the tracer can neither change it nor
+ *	look beyond it, and the rows are scanned for the start of every outer and hole border.
+ *	cv::findContours lists the borders from the last one found to the first, and so does the
+ *	arena, but it writes their points into the point buffer instead of a vector each.
+ *
+ *	@param binary: The binary image to trace, possibly a region of a larger image
+ *	@param offset: Shift added to every point, such as the position of the region in the frame
+ *
+ *	@return count: The number of contours added
+ */
+int ContourArena::findContours(const cv::Mat &binary, const cv::Point &offset) {
+
+	// Search regions change size from frame to frame, so the marks go into the corner of a
+	// buffer that only ever grows rather than into a buffer of the exact size
+	int rows = binary.rows + 2;
+	int cols = binary.cols + 2;
+	if (paddedBuffer.rows < rows || paddedBuffer.cols < cols) {
+		paddedBuffer.create(std::max(paddedBuffer.rows, rows), std::max(paddedBuffer.cols, cols), CV_8SC1);
+	}
+	cv::Mat padded = paddedBuffer(cv::Rect(0, 0, cols, rows));
+	int step = (int)padded.step;
+
+	memset(padded.ptr<schar>(0), 0, cols);
+	memset(padded.ptr<schar>(rows - 1), 0, cols);
+	for (int y = 0; y < binary.rows; y++) {
+		const uchar* in = binary.ptr<uchar>(y);
+		schar* out = padded.ptr<schar>(y + 1);
+		out[0] = 0;
+		for (int x = 0; x < binary.cols; x++) {
+			out[x + 1] = (in[x] != 0) ? UNVISITED : 0;
+		}
+		out[cols - 1] = 0;
+	}
+
+	// An outer border starts where background meets an unvisited pixel, a hole border where
+	// a foreground pixel that is not the right end of a border meets background. Following a
+	// border marks the row ahead, so every mark is read after the borders before it.
+	int first = (int)spans.size();
+	for (int y = 1; y < rows - 1; y++) {
+		schar* row = padded.ptr<schar>(y);
+		int previous = 0;
+		for (int x = 1; x < cols - 1; x++) {
+			int p = row[x];
+			if (p == previous) {
+				continue;
+			}
+
+			bool outer = (previous == 0 && p == UNVISITED);
+			bool hole = (p == 0 && previous >= UNVISITED);
+			if (outer || hole) {
+				int startX = hole ? x - 1 : x;
+				followBorder(row + startX, step, cv::Point(startX - 1 + offset.x, y - 1 + offset.y), hole);
+				previous = row[x];
+			}
+			else {
+				previous = p;
+			}
+		}
+	}
+
+	std::reverse(spans.begin() + first, spans.end());
+	return (int)spans.size() - first;
+}
@@ -0,0 +1,63 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the flat contour storage of a frame
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <vector>
+
+
+/*  Where one contour lies in the point buffer of an arena */
+struct ContourSpan
+{
+	int offset;					// Index of the first point of the contour
+	int length;					// Number of points of the contour
+};
+
+
+/*  Contours of a frame, stored back to back in one flat point buffer.
+ *	cv::findContours returns a vector per contour, so a noisy frame costs thousands of
+ *	heap allocations. The arena follows the borders itself, with the border following of
+ *	cv::findContours, and writes their points one after the other into its buffer, with
+ *	one span per contour. Nothing is freed when the arena is reset, so after the first few
+ *	frames the contours cost no allocation. An arena belongs to one frame state and cannot
+ *	be copied.
+ */
+class ContourArena
+{
+public:
+	ContourArena() {}
+
+	/*  Forgets the contours of the previous frame, keeping the memory */
+	void reset();
+
+	/*  Traces the contours of a binary image and appends them in the order of cv::findContours, returning how many were added */
+	int findContours(const cv::Mat &binary, const cv::Point &offset);
+
+	/*  Number of contours held */
+	int size() const { return (int)spans.size(); }
+
+	/*  Returns the first point of a contour */
+	const cv::Point* contour(int index) const { return &points[spans[index].offset]; }
+
+	/*  Returns the number of points of a contour */
+	int length(int index) const { return spans[index].length; }
+
+private:
+	ContourArena(const ContourArena &);
+	ContourArena &operator=(const ContourArena &);
+
+	/*  Follows one border from its first pixel and appends its points */
+	void followBorder(schar* start, int step, cv::Point point, bool hole);
+
+	std::vector<cv::Point> points;		// Points of every contour, back to back
+	std::vector<ContourSpan> spans;		// Position of each contour in points
+	cv::Mat paddedBuffer;				// Marks of the binary image inside a zero border, as large as the largest one so far
+};
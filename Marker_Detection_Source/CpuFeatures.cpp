@@ -0,0 +1,155 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Runtime CPU feature detection
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <cstring>
+
+/* Platform includes */
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define MARKER_X86 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define MARKER_X86 1
+#endif
+
+/* Helper includes */
+#include "CpuFeatures.h"
+
+
+/* Names of the instruction set levels */
+static const char* const CPU_LEVEL_NAMES[CPU_LEVEL_COUNT] = { "baseline", "sse4.2", "avx2", "avx512" };
+
+
+#if MARKER_X86
+/*  Runs the cpuid instruction for a leaf and subleaf
+ *
+ *	@param leaf: The leaf to query
+ *	@param subleaf: The subleaf to query
+ *	@param regs: Container to hold eax, ebx, ecx and edx
+ *
+ *	@return void
+ */
+static void cpuid(unsigned leaf, unsigned subleaf, unsigned* regs) {
+
+#if defined(_MSC_VER)
+	int values[4];
+	__cpuidex(values, (int)leaf, (int)subleaf);
+	for (int i = 0; i < 4; i++) {
+		regs[i] = (unsigned)values[i];
+	}
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+
+/*  Reads the register state that the OS saves on context switches
+ *	Only valid when cpuid reports OSXSAVE.
+ *
+ *	@return mask: The value of XCR0
+ */
+static unsigned long long xcr0() {
+
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+#endif
+
+
+/*  Finds the highest instruction set level supported by both the processor and the OS
+ *	AVX2 and AVX-512 also need the OS to save the wider registers, which is read from XCR0.
+ *	Processors other than x86 always run the baseline kernels.
+ *
+ *	@return level: One of CpuLevel
+ */
+int detectCpuLevel() {
+
+#if MARKER_X86
+	unsigned regs[4];
+	cpuid(0, 0, regs);
+	unsigned maxLeaf = regs[0];
+	if (maxLeaf < 1) {
+		return CPU_BASELINE;
+	}
+
+	cpuid(1, 0, regs);
+	unsigned ecx1 = regs[2];
+	bool sse42 = (ecx1 & (1u << 20)) && (ecx1 & (1u << 23));
+	if (!sse42) {
+		return CPU_BASELINE;
+	}
+
+	// AVX needs both the processor flag and the OS saving the YMM state
+	bool osxsave = (ecx1 & (1u << 27)) != 0;
+	bool avx = (ecx1 & (1u << 28)) != 0;
+	bool fma = (ecx1 & (1u << 12)) != 0;
+	if (!osxsave || !avx || !fma || maxLeaf < 7) {
+		return CPU_SSE42;
+	}
+	unsigned long long xcr = xcr0();
+	if ((xcr & 0x6) != 0x6) {
+		return CPU_SSE42;
+	}
+
+	cpuid(7, 0, regs);
+	unsigned ebx7 = regs[1];
+	if (!(ebx7 & (1u << 5))) {
+		return CPU_SSE42;
+	}
+
+	// AVX-512 F, BW and VL, with the opmask and ZMM state saved
+	bool avx512 = (ebx7 & (1u << 16)) && (ebx7 & (1u << 30)) && (ebx7 & (1u << 31));
+	if (!avx512 || (xcr & 0xe6) != 0xe6) {
+		return CPU_AVX2;
+	}
+	return CPU_AVX512;
+#else
+	return CPU_BASELINE;
+#endif
+}
+
+
+/*  Returns the name of an instruction set level
+ *
+ *	@param level: One of CpuLevel
+ *
+ *	@return name: The name of the level, or "unknown"
+ */
+const char* cpuLevelName(int level) {
+
+	if (level < 0 || level >= CPU_LEVEL_COUNT) {
+		return "unknown";
+	}
+	return CPU_LEVEL_NAMES[level];
+}
+
+
+/*  Reads the name of an instruction set level
+ *
+ *	@param name: The name of the level, as given by cpuLevelName
+ *
+ *	@return level: One of CpuLevel, or -1 if the name is not known
+ */
+int parseCpuLevel(const char* name) {
+
+	if (!name) {
+		return -1;
+	}
+	for (int level = 0; level < CPU_LEVEL_COUNT; level++) {
+		if (strcmp(name, CPU_LEVEL_NAMES[level]) == 0) {
+			return level;
+		}
+	}
+	return -1;
+}
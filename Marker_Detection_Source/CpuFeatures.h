@@ -0,0 +1,28 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for runtime CPU feature detection
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+
+/*  Instruction set levels that the hot kernels are compiled for, in increasing order */
+enum CpuLevel
+{
+	CPU_BASELINE = 0,		// Whatever the library is compiled for, SSE2 on x86-64
+	CPU_SSE42,				// SSE4.2 and POPCNT
+	CPU_AVX2,				// AVX2 and FMA, with the AVX state enabled by the OS
+	CPU_AVX512,				// AVX-512 F, BW and VL, with the AVX-512 state enabled by the OS
+	CPU_LEVEL_COUNT
+};
+
+/*  Finds the highest instruction set level supported by both the processor and the OS */
+int detectCpuLevel();
+
+/*  Returns the name of an instruction set level, as accepted by parseCpuLevel */
+const char* cpuLevelName(int level);
+
+/*  Reads the name of an instruction set level, returning -1 if it is not known */
+int parseCpuLevel(const char* name);
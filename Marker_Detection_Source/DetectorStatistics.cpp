@@ -0,0 +1,283 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Runtime detection statistics
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+/* Helper includes */
+#include "DetectorStatistics.h"
+
+
+/* Number of buckets per doubling of the latency */
+static const int BUCKETS_PER_OCTAVE = 4;
+
+
+/*  Zeroes every timing and count
+ *
+ *	@return void
+ */
+void FrameStats::clear() {
+	for (int s = 0; s < STAGE_COUNT; s++) {
+		stageMs[s] = 0.0;
+	}
+	contoursFound = 0;
+	quadsPassed = 0;
+	borderRejects = 0;
+	codeRejects = 0;
+	markersEmitted = 0;
+	duplicatesSuppressed = 0;
+	rejectedPointCount = 0;
+	rejectedBoundingBox = 0;
+	rejectedAspectRatio = 0;
+	rejectedPerimeter = 0;
+	rejectedPolygon = 0;
+}
+
+
+/*  Returns a monotonic time stamp in milliseconds
+ *
+ *	@return ms: Milliseconds since an arbitrary fixed point
+ */
+double statsClockMs() {
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration<double, std::milli>(now).count();
+}
+
+
+/*  Finds the bucket of a latency
+ *	Bucket 0 holds everything under a microsecond, bucket b the quarter octave ending at 2^(b/4) us.
+ *
+ *	@param ms: The latency in milliseconds
+ *
+ *	@return bucket: The index of the bucket
+ */
+static int latencyBucket(double ms) {
+
+	double us = ms * 1000.0;
+	if (!(us >= 1.0)) {
+		return 0;
+	}
+	int bucket = (int)(std::log2(us) * BUCKETS_PER_OCTAVE) + 1;
+	return std::min(bucket, LatencyHistogram::BUCKET_COUNT - 1);
+}
+
+
+/*  Returns the latency at a given fraction of the samples of a histogram
+ *	The result is the geometric middle of the bucket holding that rank.
+ *
+ *	@param counts: The number of samples in each bucket
+ *	@param samples: The total number of samples
+ *	@param fraction: The fraction of samples at or below the returned latency
+ *
+ *	@return ms: The latency in milliseconds
+ */
+template <typename Count>
+static float bucketPercentile(const Count* counts, Count samples, double fraction) {
+
+	if (samples == 0) {
+		return 0.0f;
+	}
+
+	Count rank = std::max((Count)1, (Count)std::ceil(fraction * samples));
+	Count seen = 0;
+	int bucket = 0;
+	for (; bucket < LatencyHistogram::BUCKET_COUNT - 1; bucket++) {
+		seen += counts[bucket];
+		if (seen >= rank) {
+			break;
+		}
+	}
+
+	if (bucket == 0) {
+		return 0.0005f;
+	}
+	return (float)(std::exp2((bucket - 0.5) / BUCKETS_PER_OCTAVE) / 1000.0);
+}
+
+
+/*  Creates an empty histogram */
+LatencyHistogram::LatencyHistogram() {
+	reset();
+}
+
+
+/*  Forgets every sample
+ *
+ *	@return void
+ */
+void LatencyHistogram::reset() {
+	memset(counts, 0, sizeof(counts));
+	memset(window, 0, sizeof(window));
+	next = 0;
+	samples = 0;
+	last = 0.0f;
+}
+
+
+/*  Adds the latency of one frame
+ *	Once the window is full the oldest sample is dropped from its bucket.
+ *
+ *	@param ms: The latency in milliseconds
+ *
+ *	@return void
+ */
+void LatencyHistogram::add(double ms) {
+
+	int bucket = latencyBucket(ms);
+	if (samples == WINDOW_SIZE) {
+		counts[window[next]]--;
+	}
+	else {
+		samples++;
+	}
+
+	window[next] = (unsigned char)bucket;
+	counts[bucket]++;
+	next = (next + 1) % WINDOW_SIZE;
+	last = (float)ms;
+}
+
+
+/*  Returns the latency at a given fraction of the window
+ *	The result is the geometric middle of the bucket holding that rank.
+ *
+ *	@param fraction: The fraction of samples at or below the returned latency
+ *
+ *	@return ms: The latency in milliseconds
+ */
+float LatencyHistogram::percentile(double fraction) const {
+	return bucketPercentile(counts, samples, fraction);
+}
+
+
+/*  Fills in the median, 99th percentile and latest latency of the window
+ *
+ *	@param latency: Container to hold the summary
+ *
+ *	@return void
+ */
+void LatencyHistogram::summarize(StageLatency &latency) const {
+	latency.p50 = percentile(0.50);
+	latency.p99 = percentile(0.99);
+	latency.last = last;
+	latency.samples = samples;
+}
+
+
+/*  Creates an empty histogram */
+LatencyTotals::LatencyTotals() {
+	reset();
+}
+
+
+/*  Forgets every sample
+ *
+ *	@return void
+ */
+void LatencyTotals::reset() {
+	memset(counts, 0, sizeof(counts));
+	samples = 0;
+	sum = 0.0;
+	maxMs = 0.0;
+}
+
+
+/*  Adds the latency of one frame
+ *
+ *	@param ms: The latency in milliseconds
+ *
+ *	@return void
+ */
+void LatencyTotals::add(double ms) {
+	counts[latencyBucket(ms)]++;
+	samples++;
+	sum += ms;
+	maxMs = std::max(maxMs, ms);
+}
+
+
+/*  Returns the latency at a given fraction of the samples
+ *	The result is the geometric middle of the bucket holding that rank, capped at
+ *	the longest latency so that it never reads above the maximum.
+ *
+ *	@param fraction: The fraction of samples at or below the returned latency
+ *
+ *	@return ms: The latency in milliseconds
+ */
+float LatencyTotals::percentile(double fraction) const {
+	return (float)std::min((double)bucketPercentile(counts, samples, fraction), maxMs);
+}
+
+
+/*  Creates a recorder with no frames */
+StatsRecorder::StatsRecorder() : frames(0) {
+	latest.clear();
+}
+
+
+/*  Adds the statistics of a finished frame
+ *
+ *	@param frame: The timings and counts of the frame
+ *
+ *	@return void
+ */
+void StatsRecorder::record(const FrameStats &frame) {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int s = 0; s < STAGE_COUNT; s++) {
+		histograms[s].add(frame.stageMs[s]);
+	}
+	latest = frame;
+	frames++;
+}
+
+
+/*  Copies the current statistics
+ *
+ *	@param stats: Container to hold the statistics
+ *
+ *	@return void
+ */
+void StatsRecorder::read(DetectorStats &stats) {
+	std::lock_guard<std::mutex> lock(mutex);
+	stats.frames = frames;
+	histograms[STAGE_CONVERSION].summarize(stats.conversion);
+	histograms[STAGE_CONTOURS].summarize(stats.contours);
+	histograms[STAGE_POLYGON_FILTER].summarize(stats.polygonFilter);
+	histograms[STAGE_REFINEMENT].summarize(stats.refinement);
+	histograms[STAGE_DECODING].summarize(stats.decoding);
+	histograms[STAGE_POSE].summarize(stats.pose);
+	histograms[STAGE_TOTAL].summarize(stats.total);
+	stats.contoursFound = latest.contoursFound;
+	stats.quadsPassed = latest.quadsPassed;
+	stats.borderRejects = latest.borderRejects;
+	stats.codeRejects = latest.codeRejects;
+	stats.markersEmitted = latest.markersEmitted;
+	stats.duplicatesSuppressed = latest.duplicatesSuppressed;
+	stats.rejectedPointCount = latest.rejectedPointCount;
+	stats.rejectedBoundingBox = latest.rejectedBoundingBox;
+	stats.rejectedAspectRatio = latest.rejectedAspectRatio;
+	stats.rejectedPerimeter = latest.rejectedPerimeter;
+	stats.rejectedPolygon = latest.rejectedPolygon;
+}
+
+
+/*  Forgets every recorded frame
+ *
+ *	@return void
+ */
+void StatsRecorder::reset() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int s = 0; s < STAGE_COUNT; s++) {
+		histograms[s].reset();
+	}
+	latest.clear();
+	frames = 0;
+}
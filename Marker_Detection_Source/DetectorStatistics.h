@@ -0,0 +1,151 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the runtime detection statistics
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <mutex>
+
+/* Helper includes */
+#include "UnityStructs.h"
+
+
+/*  Stages of detection whose latency is recorded */
+enum DetectorStage
+{
+	STAGE_CONVERSION,			// Grayscale conversion and thresholding
+	STAGE_CONTOURS,				// Contour extraction
+	STAGE_POLYGON_FILTER,		// Polygon approximation and quad filter
+	STAGE_REFINEMENT,			// Edge refinement and corner finding
+	STAGE_DECODING,				// Rectification and code reading
+	STAGE_POSE,					// Pose estimation
+	STAGE_TOTAL,				// Whole frame
+	STAGE_COUNT
+};
+
+
+/*  Timings and counts of one frame, filled in while the frame moves through detection */
+struct FrameStats
+{
+	double stageMs[STAGE_COUNT];	// Latency of each stage in milliseconds
+	int contoursFound;				// Contours found in the frame
+	int quadsPassed;				// Quads that passed the polygon filter
+	int borderRejects;				// Candidates whose border was not black
+	int codeRejects;				// Candidates with an all black or all white code
+	int markersEmitted;				// Markers reported to the caller
+	int duplicatesSuppressed;		// Duplicate quads dropped before validation
+	int rejectedPointCount;			// Contours with too few points
+	int rejectedBoundingBox;		// Contours whose bounding box is too small
+	int rejectedAspectRatio;		// Contours whose bounding box is too elongated
+	int rejectedPerimeter;			// Contours too short or too long
+	int rejectedPolygon;			// Contours that are not a large convex quad
+
+	/*  Zeroes every timing and count */
+	void clear();
+};
+
+
+/*  Returns a monotonic time stamp in milliseconds */
+double statsClockMs();
+
+
+/*  Histogram of the latency of one stage over a rolling window of recent frames.
+ *	Latencies fall into logarithmic buckets a quarter octave wide starting at one
+ *	microsecond, so percentiles are accurate to about 10% over any range. The window
+ *	remembers the bucket of each recent sample, so adding one is constant time and
+ *	never allocates.
+ */
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	/*  Forgets every sample */
+	void reset();
+
+	/*  Adds the latency of one frame */
+	void add(double ms);
+
+	/*  Fills in the median, 99th percentile and latest latency of the window */
+	void summarize(StageLatency &latency) const;
+
+	static const int BUCKET_COUNT = 128;	// Number of buckets, covering up to about half an hour
+	static const int WINDOW_SIZE = 512;		// Number of recent frames the percentiles are taken over
+
+private:
+	/*  Returns the latency in milliseconds at a given fraction of the window */
+	float percentile(double fraction) const;
+
+	int counts[BUCKET_COUNT];				// Samples of the window in each bucket
+	unsigned char window[WINDOW_SIZE];		// Bucket of each sample of the window, oldest first from next
+	int next;								// Position of the oldest sample in the window
+	int samples;							// Number of valid samples in the window
+	float last;								// Latest latency added
+};
+
+
+/*  Histogram of the latency of one stage over every frame since the last reset.
+ *	Uses the same buckets as LatencyHistogram, so it takes constant memory however
+ *	many frames are added, which suits offline runs over long recordings.
+ */
+class LatencyTotals
+{
+public:
+	LatencyTotals();
+
+	/*  Forgets every sample */
+	void reset();
+
+	/*  Adds the latency of one frame */
+	void add(double ms);
+
+	/*  Returns the latency in milliseconds at a given fraction of the samples */
+	float percentile(double fraction) const;
+
+	/*  Returns the mean latency in milliseconds */
+	double mean() const { return samples ? sum / samples : 0.0; }
+
+	/*  Returns the longest latency in milliseconds */
+	double max() const { return maxMs; }
+
+	/*  Returns the number of samples added */
+	long long count() const { return samples; }
+
+private:
+	long long counts[LatencyHistogram::BUCKET_COUNT];	// Samples in each bucket
+	long long samples;									// Number of samples added
+	double sum;											// Sum of the latencies
+	double maxMs;										// Longest latency added
+};
+
+
+/*  Collects the statistics of every frame a detector processes.
+ *	Frames are recorded on the detection threads and read from any other thread.
+ */
+class StatsRecorder
+{
+public:
+	StatsRecorder();
+
+	/*  Adds the statistics of a finished frame */
+	void record(const FrameStats &frame);
+
+	/*  Copies the current statistics */
+	void read(DetectorStats &stats);
+
+	/*  Forgets every recorded frame */
+	void reset();
+
+private:
+	std::mutex mutex;								// Guards everything below
+	LatencyHistogram histograms[STAGE_COUNT];		// Rolling latency of each stage
+	FrameStats latest;								// Statistics of the latest frame
+	int frames;										// Frames recorded since the last reset
+};
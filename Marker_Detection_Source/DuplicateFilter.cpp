@@ -0,0 +1,156 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Duplicate quad filter
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+
+/* Helper includes */
+#include "DuplicateFilter.h"
+#include "MarkerDetector.h"
+
+
+/* Smallest ratio between the areas of two quads for them to be the same square */
+static const float MIN_AREA_RATIO = 0.72f;
+
+/* Largest distance between the centroids of two duplicates, relative to the side of the larger */
+static const float MAX_CENTROID_OFFSET = 0.1f;
+
+
+/*  Hashes a cell of the centroid grid
+ *
+ *	@param cellX: The column of the cell
+ *	@param cellY: The row of the cell
+ *
+ *	@return hash: A well mixed hash of the cell
+ */
+static inline unsigned int hashCell(int cellX, int cellY) {
+	return (unsigned int)cellX * 73856093u ^ (unsigned int)cellY * 19349663u;
+}
+
+
+/*  Returns true if two quads are the same square
+ *	They must have nearly the same size and centre. A marker printed with a narrow margin
+ *	is nested in a quad of a similar centre, but the margin keeps their areas apart.
+ *
+ *	@param a: The first quad
+ *	@param b: The second quad
+ *
+ *	@return duplicate: True if the quads should be merged
+ */
+bool DuplicateFilter::isDuplicate(const QuadShape &a, const QuadShape &b) {
+
+	float smaller = std::min(a.area, b.area);
+	float larger = std::max(a.area, b.area);
+	if (smaller < MIN_AREA_RATIO * larger) {
+		return false;
+	}
+
+	float dx = a.centroid.x - b.centroid.x;
+	float dy = a.centroid.y - b.centroid.y;
+	return dx * dx + dy * dy <= MAX_CENTROID_OFFSET * MAX_CENTROID_OFFSET * larger;
+}
+
+
+/*  Removes the duplicate quads in place, keeping contour order
+ *	Each quad is compared with the quads in the hash cells around its centroid, out to the
+ *	farthest a duplicate of its size can be. That is a tenth of the side of the larger of the
+ *	two, which is at most the quad's own area over MIN_AREA_RATIO, so a large marker searches
+ *	more cells than the 3x3 block of a small one.
+ *
+ *	@param candidates: The quads of the frame, filtered in place
+ *	@param cellSize: The side of a hash cell in pixels, around the smallest marker side
+ *
+ *	@return removedCount: The number of quads that were removed
+ */
+int DuplicateFilter::filter(std::vector<MarkerCandidate> &candidates, float cellSize) {
+
+	int count = (int)candidates.size();
+	if (count < 2) {
+		return 0;
+	}
+
+	// Use a power of two number of slots, at least twice the number of quads
+	int slotCount = 16;
+	while (slotCount < 2 * count) {
+		slotCount <<= 1;
+	}
+	unsigned int mask = (unsigned int)slotCount - 1;
+	float inverseCell = 1.0f / std::max(cellSize, 1.0f);
+
+	shapes.resize(count);
+	heads.assign(slotCount, -1);
+	next.assign(count, -1);
+	removed.assign(count, 0);
+
+	int removedCount = 0;
+	for (int i = 0; i < count; i++) {
+
+		// Centroid and shoelace area of the quad
+		const cv::Point* rect = candidates[i].rect;
+		QuadShape &shape = shapes[i];
+		float doubleArea = 0.0f;
+		for (int k = 0; k < 4; k++) {
+			const cv::Point &p = rect[k];
+			const cv::Point &q = rect[(k + 1) % 4];
+			doubleArea += (float)p.x * q.y - (float)q.x * p.y;
+		}
+		shape.area = std::fabs(doubleArea) * 0.5f;
+		shape.centroid.x = (rect[0].x + rect[1].x + rect[2].x + rect[3].x) * 0.25f;
+		shape.centroid.y = (rect[0].y + rect[1].y + rect[2].y + rect[3].y) * 0.25f;
+		shape.cellX = (int)std::floor(shape.centroid.x * inverseCell);
+		shape.cellY = (int)std::floor(shape.centroid.y * inverseCell);
+
+		// Look for a quad it repeats in the cells a duplicate's centroid can be in
+		float reach = MAX_CENTROID_OFFSET * std::sqrt(shape.area / MIN_AREA_RATIO);
+		int reachCells = std::max((int)std::ceil(reach * inverseCell), 1);
+		int duplicate = -1;
+		for (int dy = -reachCells; dy <= reachCells && duplicate < 0; dy++) {
+			for (int dx = -reachCells; dx <= reachCells && duplicate < 0; dx++) {
+				int cellX = shape.cellX + dx;
+				int cellY = shape.cellY + dy;
+				for (int j = heads[hashCell(cellX, cellY) & mask]; j >= 0; j = next[j]) {
+					if (!removed[j] && shapes[j].cellX == cellX && shapes[j].cellY == cellY && isDuplicate(shape, shapes[j])) {
+						duplicate = j;
+						break;
+					}
+				}
+			}
+		}
+
+		// Keep the outer quad of the two
+		if (duplicate >= 0) {
+			removedCount++;
+			if (shape.area <= shapes[duplicate].area) {
+				removed[i] = 1;
+				continue;
+			}
+			removed[duplicate] = 1;
+		}
+
+		unsigned int slot = hashCell(shape.cellX, shape.cellY) & mask;
+		next[i] = heads[slot];
+		heads[slot] = i;
+	}
+
+	// Compact the quads that are left, in their original order
+	if (removedCount > 0) {
+		int kept = 0;
+		for (int i = 0; i < count; i++) {
+			if (!removed[i]) {
+				candidates[kept++] = candidates[i];
+			}
+		}
+		candidates.resize(kept);
+	}
+
+	return removedCount;
+}
@@ -0,0 +1,50 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the duplicate quad filter
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <vector>
+
+
+struct MarkerCandidate;
+
+
+/*  Drops quads that repeat another quad of the same frame, before they are validated.
+ *	findContours with RETR_LIST reports both sides of a thin dark outline, and a marker
+ *	can be traced more than once, so the same square often reaches validation twice.
+ *	Quads are put in a spatial hash of their centroids, so each one is only compared
+ *	with the quads around it. Of two duplicates the larger, outer one is kept.
+ *	The hash buffers are reused between frames.
+ */
+class DuplicateFilter
+{
+public:
+	/*  Removes the duplicate quads in place, keeping contour order, and returns how many were removed */
+	int filter(std::vector<MarkerCandidate> &candidates, float cellSize);
+
+private:
+	/*  Centroid and area of a quad */
+	struct QuadShape
+	{
+		cv::Point2f centroid;		// Mean of the corners
+		float area;					// Area enclosed by the corners
+		int cellX;					// Column of the hash cell holding the centroid
+		int cellY;					// Row of the hash cell holding the centroid
+	};
+
+	/*  Returns true if two quads are the same square */
+	static bool isDuplicate(const QuadShape &a, const QuadShape &b);
+
+	std::vector<QuadShape> shapes;	// Shape of each candidate
+	std::vector<int> heads;			// First candidate of each hash slot, or -1
+	std::vector<int> next;			// Next candidate in the same hash slot, or -1
+	std::vector<char> removed;		// Nonzero for the candidates that were dropped
+};
@@ -12,7 +12,36 @@
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 
+/* SIMD includes */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MARKER_SSE2 1
+#define MARKER_SSE41 1
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define MARKER_SSE2 1
+#define MARKER_SSE41 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MARKER_SSE2 1
+#endif
+
+/* Helper includes */
+#include "EdgeRefinement.h"
+#include "KernelDispatch.h"
+#include "GradientCache.h"
+
+
+/* Longest stripe the refinement keeps on the stack, enough for edges of about 4400 pixels */
+static const int MAX_STRIPE_LENGTH = 511;
+
+
+#ifndef MARKER_ISA_VARIANT
 /*  Finds the parameters of the stripes used for line refinement
  *	
  *  @param stripeLength: The length of each stripe (perpendicular to edge)
@@ -90,7 +119,7 @@ int subpixSampleSafe2(const cv::Mat &gray_im, const cv::Point2f &p)
  *
  *	@return max_pos: The pixel position with the maximum value (edge)
  */
-double findMaxInStripe(std::vector<double> sobelValues, const int stripeLength, int &maxIndex) {
+double findMaxInStripe(const std::vector<double> &sobelValues, const int stripeLength, int &maxIndex) {
 
 	// Find the maximum value in the stripe
 	double maxVal = -1;
@@ -124,7 +153,8 @@ double findMaxInStripe(std::vector<double> sobelValues, const int stripeLength,
 }
 
 
-/*  Refine edges to get a better estimate.
+/*  Refine edges to get a better estimate, sampling one pixel at a time.
+ *	This is the reference implementation that the stripe engine in refineEdges is checked against.
  *	
  *	@param linParamsMat: Matrix to save the line parameters
  *	@param corners: The coordinates of the corners of the marker
@@ -132,7 +162,10 @@ double findMaxInStripe(std::vector<double> sobelValues, const int stripeLength,
  *
  *	@return void
  */
-void refineEdges(cv::Mat lineParamsMat, const cv::Point* corners, cv::Mat &gray_frame) {
+void refineEdgesReference(cv::Mat lineParamsMat, const cv::Point* corners, const cv::Mat &gray_frame) {
+
+	cv::Mat edgeStripe;
+	std::vector<double> sobelValues;
 
 	// Refines edges one edge at a time
 	for (int i = 0; i < 4; i++) {
@@ -149,7 +182,7 @@ void refineEdges(cv::Mat lineParamsMat, const cv::Point* corners, cv::Mat &gray_
 		int nStart = -nStop;
 
 		// Contains to hold the pixel values in each stripe
-		cv::Mat edgeStripe(stripeSize, CV_8UC1);
+		edgeStripe.create(stripeSize, CV_8UC1);
 		cv::Point2f true_edge[6];
 
 		// Goes through each stripe in the edge
@@ -183,7 +216,7 @@ void refineEdges(cv::Mat lineParamsMat, const cv::Point* corners, cv::Mat &gray_
 			}
 
 			// Perform sobel operator on all inner cells in the stripe
-			std::vector<double> sobelValues(stripeLength - 2);
+			sobelValues.resize(stripeLength - 2);
 			for (int n = 1; n < stripeLength - 1; n++) {
 				unsigned char* stripePointer = &(edgeStripe.at<uchar>(n - 1, 0));
 				double row_top = -stripePointer[0] - 2 * stripePointer[1] - stripePointer[2];
@@ -217,4 +250,854 @@ void refineEdges(cv::Mat lineParamsMat, const cv::Point* corners, cv::Mat &gray_
 		cv::fitLine(mat, lineParamsMat.col(i), cv::DIST_L2, 0.0, 0.01, 0.01);
 
 	}
-}
\ No newline at end of file
+}
+#endif
+
+
+namespace MARKER_ISA {
+
+
+#if MARKER_SSE2
+/*  Blends two vectors of pixel values with 8-bit fixed-point weights, as a + ((w * (b - a)) >> 8)
+ *	SSE2 has no 32-bit multiply, so the product is formed by madd on the low 16 bits of each lane.
+ *	Both give the same result, since the weight and the difference fit in 16 bits.
+ *
+ *	@param a: The values at weight 0
+ *	@param b: The values at weight 256
+ *	@param w: The weights, between 0 and 255
+ *
+ *	@return blended: The blended values
+ */
+static inline __m128i blendFixed(__m128i a, __m128i b, __m128i w) {
+
+#if MARKER_SSE41
+	return _mm_add_epi32(a, _mm_srai_epi32(_mm_mullo_epi32(w, _mm_sub_epi32(b, a)), 8));
+#else
+	__m128i diff = _mm_and_si128(_mm_sub_epi32(b, a), _mm_set1_epi32(0xffff));
+	return _mm_add_epi32(a, _mm_srai_epi32(_mm_madd_epi16(w, diff), 8));
+#endif
+}
+#endif
+
+
+#if defined(__AVX2__)
+/*  Blends two vectors of eight pixel values with 8-bit fixed-point weights, as a + ((w * (b - a)) >> 8)
+ *
+ *	@param a: The values at weight 0
+ *	@param b: The values at weight 256
+ *	@param w: The weights, between 0 and 255
+ *
+ *	@return blended: The blended values
+ */
+static inline __m256i blendFixed8(__m256i a, __m256i b, __m256i w) {
+	return _mm256_add_epi32(a, _mm256_srai_epi32(_mm256_mullo_epi32(w, _mm256_sub_epi32(b, a)), 8));
+}
+#endif
+
+
+/*  Samples one column of a stripe, giving the same values as subpixSampleSafe2 at every position
+ *	The positions are generated in double precision and rounded to float exactly like the
+ *	reference, then eight of them are sampled at a time with AVX2 and four with SSE. Only the
+ *	pixel loads are scalar, since a gather would read past the end of the image.
+ *
+ *	@param gray_im: The grayscale image to sample
+ *	@param baseX: The x coordinate of the column at n = 0
+ *	@param baseY: The y coordinate of the column at n = 0
+ *	@param stepX: The x step for each pixel along the column
+ *	@param stepY: The y step for each pixel along the column
+ *	@param nStart: The index n of the first pixel
+ *	@param length: The number of pixels in the column
+ *	@param column: Container to hold the sampled pixel values
+ *
+ *	@return void
+ */
+static void sampleStripeColumn(const cv::Mat &gray_im, double baseX, double baseY, float stepX, float stepY,
+	int nStart, int length, float* column) {
+
+	int k = 0;
+
+#if defined(__AVX2__)
+	const __m256d stepX4 = _mm256_set1_pd(stepX), stepY4 = _mm256_set1_pd(stepY);
+	const __m256d baseX4 = _mm256_set1_pd(baseX), baseY4 = _mm256_set1_pd(baseY);
+	const __m256d lanes4 = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0), four = _mm256_set1_pd(4.0);
+	const __m256i minusOne8 = _mm256_set1_epi32(-1);
+	const __m256i limitX8 = _mm256_set1_epi32(gray_im.cols - 1), limitY8 = _mm256_set1_epi32(gray_im.rows - 1);
+	const __m256 scale8 = _mm256_set1_ps(256.0f);
+
+	for (; k + 8 <= length; k += 8) {
+
+		// Positions of the eight pixels, rounded to float after the double precision sum
+		__m256d nLo = _mm256_add_pd(_mm256_set1_pd((double)(nStart + k)), lanes4);
+		__m256d nHi = _mm256_add_pd(nLo, four);
+		__m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_add_pd(baseX4, _mm256_mul_pd(nLo, stepX4)))),
+			_mm256_cvtpd_ps(_mm256_add_pd(baseX4, _mm256_mul_pd(nHi, stepX4))), 1);
+		__m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_add_pd(baseY4, _mm256_mul_pd(nLo, stepY4)))),
+			_mm256_cvtpd_ps(_mm256_add_pd(baseY4, _mm256_mul_pd(nHi, stepY4))), 1);
+
+		// Floor of the positions and fixed-point weights of the right and bottom neighbours
+		__m256 xf = _mm256_floor_ps(x), yf = _mm256_floor_ps(y);
+		__m256i xi = _mm256_cvttps_epi32(xf), yi = _mm256_cvttps_epi32(yf);
+		__m256i dx = _mm256_cvttps_epi32(_mm256_mul_ps(scale8, _mm256_sub_ps(x, xf)));
+		__m256i dy = _mm256_cvttps_epi32(_mm256_mul_ps(scale8, _mm256_sub_ps(y, yf)));
+
+		// Pixels off the image take the intermediate value of 127
+		__m256i inside = _mm256_and_si256(_mm256_and_si256(_mm256_cmpgt_epi32(xi, minusOne8), _mm256_cmpgt_epi32(limitX8, xi)),
+			_mm256_and_si256(_mm256_cmpgt_epi32(yi, minusOne8), _mm256_cmpgt_epi32(limitY8, yi)));
+
+		alignas(32) int xs[8], ys[8], valid[8];
+		alignas(32) int p00[8], p01[8], p10[8], p11[8];
+		_mm256_store_si256((__m256i*)xs, xi);
+		_mm256_store_si256((__m256i*)ys, yi);
+		_mm256_store_si256((__m256i*)valid, inside);
+		for (int l = 0; l < 8; l++) {
+			if (!valid[l]) {
+				p00[l] = p01[l] = p10[l] = p11[l] = 127;
+				continue;
+			}
+
+			const uchar* i = gray_im.data + ys[l] * gray_im.step + xs[l];
+			p00[l] = i[0];
+			p01[l] = i[1];
+			p10[l] = i[gray_im.step];
+			p11[l] = i[gray_im.step + 1];
+		}
+
+		// Blend horizontally, then vertically
+		__m256i a = blendFixed8(_mm256_load_si256((const __m256i*)p00), _mm256_load_si256((const __m256i*)p01), dx);
+		__m256i b = blendFixed8(_mm256_load_si256((const __m256i*)p10), _mm256_load_si256((const __m256i*)p11), dx);
+		_mm256_storeu_ps(column + k, _mm256_cvtepi32_ps(blendFixed8(a, b, dy)));
+	}
+#endif
+
+#if MARKER_SSE2
+	const uchar* data = gray_im.data;
+	const size_t step = gray_im.step;
+	const __m128d stepXd = _mm_set1_pd(stepX), stepYd = _mm_set1_pd(stepY);
+	const __m128d baseXd = _mm_set1_pd(baseX), baseYd = _mm_set1_pd(baseY);
+	const __m128d laneLo = _mm_set_pd(1.0, 0.0), laneHi = _mm_set_pd(3.0, 2.0);
+	const __m128i minusOne = _mm_set1_epi32(-1);
+	const __m128i limitX = _mm_set1_epi32(gray_im.cols - 1), limitY = _mm_set1_epi32(gray_im.rows - 1);
+	const __m128 scale = _mm_set1_ps(256.0f);
+
+	for (; k + 4 <= length; k += 4) {
+
+		// Positions of the four pixels, rounded to float after the double precision sum
+		__m128d n = _mm_set1_pd((double)(nStart + k));
+		__m128d nLo = _mm_add_pd(n, laneLo), nHi = _mm_add_pd(n, laneHi);
+		__m128 x = _mm_movelh_ps(_mm_cvtpd_ps(_mm_add_pd(baseXd, _mm_mul_pd(nLo, stepXd))),
+			_mm_cvtpd_ps(_mm_add_pd(baseXd, _mm_mul_pd(nHi, stepXd))));
+		__m128 y = _mm_movelh_ps(_mm_cvtpd_ps(_mm_add_pd(baseYd, _mm_mul_pd(nLo, stepYd))),
+			_mm_cvtpd_ps(_mm_add_pd(baseYd, _mm_mul_pd(nHi, stepYd))));
+
+		// Floor of the positions, as truncation corrected for negative values without SSE4.1
+#if MARKER_SSE41
+		__m128i xi = _mm_cvttps_epi32(_mm_floor_ps(x)), yi = _mm_cvttps_epi32(_mm_floor_ps(y));
+#else
+		__m128i xi = _mm_cvttps_epi32(x), yi = _mm_cvttps_epi32(y);
+		xi = _mm_add_epi32(xi, _mm_castps_si128(_mm_cmplt_ps(x, _mm_cvtepi32_ps(xi))));
+		yi = _mm_add_epi32(yi, _mm_castps_si128(_mm_cmplt_ps(y, _mm_cvtepi32_ps(yi))));
+#endif
+
+		// Fixed-point weights of the right and bottom neighbours
+		__m128i dx = _mm_cvttps_epi32(_mm_mul_ps(scale, _mm_sub_ps(x, _mm_cvtepi32_ps(xi))));
+		__m128i dy = _mm_cvttps_epi32(_mm_mul_ps(scale, _mm_sub_ps(y, _mm_cvtepi32_ps(yi))));
+
+		// Pixels off the image take the intermediate value of 127
+		__m128i inside = _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi32(xi, minusOne), _mm_cmplt_epi32(xi, limitX)),
+			_mm_and_si128(_mm_cmpgt_epi32(yi, minusOne), _mm_cmplt_epi32(yi, limitY)));
+
+		alignas(16) int xs[4], ys[4], valid[4];
+		alignas(16) int p00[4], p01[4], p10[4], p11[4];
+		_mm_store_si128((__m128i*)xs, xi);
+		_mm_store_si128((__m128i*)ys, yi);
+		_mm_store_si128((__m128i*)valid, inside);
+		for (int l = 0; l < 4; l++) {
+			if (!valid[l]) {
+				p00[l] = p01[l] = p10[l] = p11[l] = 127;
+				continue;
+			}
+
+			const uchar* i = data + ys[l] * step + xs[l];
+			p00[l] = i[0];
+			p01[l] = i[1];
+			p10[l] = i[step];
+			p11[l] = i[step + 1];
+		}
+
+		// Blend horizontally, then vertically
+		__m128i a = blendFixed(_mm_load_si128((const __m128i*)p00), _mm_load_si128((const __m128i*)p01), dx);
+		__m128i b = blendFixed(_mm_load_si128((const __m128i*)p10), _mm_load_si128((const __m128i*)p11), dx);
+		_mm_storeu_ps(column + k, _mm_cvtepi32_ps(blendFixed(a, b, dy)));
+	}
+#endif
+
+	// Remaining pixels one at a time
+	for (; k < length; k++) {
+		double n = (double)(nStart + k);
+		cv::Point2f subPixel;
+		subPixel.x = baseX + n * stepX;
+		subPixel.y = baseY + n * stepY;
+		column[k] = (float)subpixSampleSafe2(gray_im, subPixel);
+	}
+}
+
+
+/*  Computes the sobel response down the middle column of a stripe
+ *	Each output is the weighted row below minus the weighted row above, with weights 1, 2, 1.
+ *
+ *	@param columns: The three sampled columns of the stripe
+ *	@param stripeLength: The length of the stripe
+ *	@param weighted: Buffer to hold the weighted rows
+ *	@param sobelValues: Container to hold the stripeLength - 2 sobel values
+ *
+ *	@return void
+ */
+static void stripeSobel(const float* const* columns, int stripeLength, float* weighted, float* sobelValues) {
+
+	const float* left = columns[0];
+	const float* middle = columns[1];
+	const float* right = columns[2];
+
+	int n = 0;
+#if defined(__AVX2__)
+	for (; n + 8 <= stripeLength; n += 8) {
+		__m256 m = _mm256_loadu_ps(middle + n);
+		_mm256_storeu_ps(weighted + n, _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(left + n), _mm256_loadu_ps(right + n)), _mm256_add_ps(m, m)));
+	}
+#endif
+#if MARKER_SSE2
+	for (; n + 4 <= stripeLength; n += 4) {
+		__m128 m = _mm_loadu_ps(middle + n);
+		_mm_storeu_ps(weighted + n, _mm_add_ps(_mm_add_ps(_mm_loadu_ps(left + n), _mm_loadu_ps(right + n)), _mm_add_ps(m, m)));
+	}
+#endif
+	for (; n < stripeLength; n++) {
+		weighted[n] = left[n] + 2 * middle[n] + right[n];
+	}
+
+	n = 0;
+#if defined(__AVX2__)
+	for (; n + 8 <= stripeLength - 2; n += 8) {
+		_mm256_storeu_ps(sobelValues + n, _mm256_sub_ps(_mm256_loadu_ps(weighted + n + 2), _mm256_loadu_ps(weighted + n)));
+	}
+#endif
+#if MARKER_SSE2
+	for (; n + 4 <= stripeLength - 2; n += 4) {
+		_mm_storeu_ps(sobelValues + n, _mm_sub_ps(_mm_loadu_ps(weighted + n + 2), _mm_loadu_ps(weighted + n)));
+	}
+#endif
+	for (; n < stripeLength - 2; n++) {
+		sobelValues[n] = weighted[n + 2] - weighted[n];
+	}
+}
+
+
+/*  Fits a line to points by least squares, in closed form
+ *	Same computation as cv::fitLine with DIST_L2: the line goes through the centroid,
+ *	along the principal axis of the point covariance.
+ *
+ *	@param points: The points to fit
+ *	@param count: The number of points, at least 2
+ *	@param line: Container to hold the direction (vx, vy) and a point (x0, y0) of the line
+ *
+ *	@return void
+ */
+static void fitLineL2(const cv::Point2f* points, int count, float* line) {
+
+	// Accumulate the moments of the points
+	double x = 0, y = 0, x2 = 0, y2 = 0, xy = 0;
+	for (int i = 0; i < count; i++) {
+		x += points[i].x;
+		y += points[i].y;
+		x2 += points[i].x * points[i].x;
+		y2 += points[i].y * points[i].y;
+		xy += points[i].x * points[i].y;
+	}
+	x /= count;
+	y /= count;
+	x2 /= count;
+	y2 /= count;
+	xy /= count;
+
+	// The angle of the principal axis of the covariance matrix
+	double dx2 = x2 - x * x;
+	double dy2 = y2 - y * y;
+	double dxy = xy - x * y;
+	float t = (float)atan2(2 * dxy, dx2 - dy2) / 2;
+
+	line[0] = (float)cos(t);
+	line[1] = (float)sin(t);
+	line[2] = (float)x;
+	line[3] = (float)y;
+}
+
+
+/*  Finds the edge along one stripe from its sobel values
+ *	The maximum is refined with a parabola through its neighbours, as in findMaxInStripe.
+ *
+ *	@param sobelValues: The stripeLength - 2 sobel values of the stripe
+ *	@param stripeLength: The length of the stripe
+ *	@param p: The pixel the stripe is centered on
+ *	@param stripeVecY: The unit vector along the stripe
+ *	@param edge: Container to hold the position of the edge
+ *
+ *	@return found: False if the stripe has no sharp maximum
+ */
+static bool findStripeEdge(const float* sobelValues, int stripeLength, const cv::Point &p, const cv::Point2f &stripeVecY, cv::Point2f &edge) {
+
+	// Find the maximum value in the stripe
+	int maxIndex = 0;
+	float maxVal = -1;
+	for (int n = 0; n < stripeLength - 2; n++) {
+		if (sobelValues[n] > maxVal) {
+			maxIndex = n;
+			maxVal = sobelValues[n];
+		}
+	}
+
+	// Find the maximum value of parabola given three points, as in findMaxInStripe
+	double p0 = (maxIndex > 0) ? sobelValues[maxIndex - 1] : 0;
+	double p1 = sobelValues[maxIndex];
+	double p2 = (maxIndex < stripeLength - 3) ? sobelValues[maxIndex + 1] : 0;
+	double max_pos = (p2 - p0) / (4 * p1 - 2 * p0 - 2 * p2);
+
+	// Check max value for validity
+	if (!std::isfinite(max_pos)) {
+		return false;
+	}
+
+	int maxIndexShift = maxIndex - (stripeLength >> 1);
+	edge.x = (double)p.x + (((double)maxIndexShift + max_pos) * stripeVecY.x);
+	edge.y = (double)p.y + (((double)maxIndexShift + max_pos) * stripeVecY.y);
+	return true;
+}
+
+
+/*  Fits the line of one edge to the edge positions of its stripes
+ *	An edge with fewer than two positions keeps the line through its two corners.
+ *
+ *	@param true_edge: The edge positions found along the stripes
+ *	@param numEdges: The number of edge positions
+ *	@param corners: The coordinates of the corners of the marker
+ *	@param i: The edge, from corner i to corner i + 1
+ *	@param lineParameters: Container to hold the 4x4 line parameters, with one edge per column
+ *
+ *	@return void
+ */
+static void fitEdgeLine(const cv::Point2f* true_edge, int numEdges, const cv::Point* corners, int i, float* lineParameters) {
+
+	float line[4];
+	if (numEdges >= 2) {
+		fitLineL2(true_edge, numEdges, line);
+	}
+	else {
+		const cv::Point &a = corners[i];
+		const cv::Point &b = corners[(i + 1) % 4];
+		double length = sqrt((double)(b.x - a.x) * (b.x - a.x) + (double)(b.y - a.y) * (b.y - a.y));
+		line[0] = (length > 0) ? (float)((b.x - a.x) / length) : 1.0f;
+		line[1] = (length > 0) ? (float)((b.y - a.y) / length) : 0.0f;
+		line[2] = 0.5f * (a.x + b.x);
+		line[3] = 0.5f * (a.y + b.y);
+	}
+
+	lineParameters[i] = line[0];
+	lineParameters[4 + i] = line[1];
+	lineParameters[8 + i] = line[2];
+	lineParameters[12 + i] = line[3];
+}
+
+
+/*  Reads the gradient of one pixel, from its tile if computed or from the grayscale image otherwise
+ *	Every pixel the refinement reads should be inside a computed tile, so the fallback only
+ *	guards against a region that was requested too small.
+ *
+ *	@param image: The gradients of the frame
+ *	@param x: The column of the pixel
+ *	@param y: The row of the pixel
+ *	@param gradient: Container to hold the x and y gradients
+ *
+ *	@return void
+ */
+static inline void pixelGradient(const GradientImage &image, int x, int y, int* gradient) {
+
+	int slot = image.tileSlots[(y >> image.tileShift) * image.tileCols + (x >> image.tileShift)];
+	if (slot >= 0 && slot < image.computedTiles) {
+		int mask = (1 << image.tileShift) - 1;
+		const short* g = image.tiles + slot * image.tileStride + 2 * ((y & mask) * image.tilePitch + (x & mask));
+		gradient[0] = g[0];
+		gradient[1] = g[1];
+		return;
+	}
+
+	// Same 3x3 sobel as sobelGradients, repeating the border pixels
+	int left = (x > 0) ? x - 1 : 0;
+	int right = (x < image.cols - 1) ? x + 1 : x;
+	const uchar* above = image.gray + ((y > 0) ? y - 1 : 0) * image.grayStep;
+	const uchar* middle = image.gray + y * image.grayStep;
+	const uchar* below = image.gray + ((y < image.rows - 1) ? y + 1 : y) * image.grayStep;
+	gradient[0] = (above[right] - above[left]) + 2 * (middle[right] - middle[left]) + (below[right] - below[left]);
+	gradient[1] = (below[left] + 2 * below[x] + below[right]) - (above[left] + 2 * above[x] + above[right]);
+}
+
+
+/*  Refine edges to get a better estimate.
+ *	Each stripe is sampled a column at a time into stack buffers, so no memory is allocated.
+ *	The result matches refineEdgesReference exactly whenever every stripe has a sharp maximum.
+ *	Stripes without one are left out of the line fit, where the reference fits them as (0, 0),
+ *	and an edge with fewer than two good stripes keeps the line through its two corners.
+ *	Kernel for the level of this namespace, reached through activeKernels.
+ *	
+ *	@param lineParameters: Container to hold the 4x4 line parameters, with one edge per column
+ *	@param corners: The coordinates of the corners of the marker
+ *	@param gray_frame: The grayscaled image
+ *
+ *	@return void
+ */
+static void refineEdges(float* lineParameters, const cv::Point* corners, const cv::Mat &gray_frame) {
+
+	alignas(16) float columnValues[3][MAX_STRIPE_LENGTH];
+	alignas(16) float weighted[MAX_STRIPE_LENGTH];
+	alignas(16) float sobelValues[MAX_STRIPE_LENGTH];
+	const float* columns[3] = { columnValues[0], columnValues[1], columnValues[2] };
+
+	// Refines edges one edge at a time
+	for (int i = 0; i < 4; i++) {
+
+		// Find size and directions of the stripes, with 6 stripes in total
+		int stripeLength = 0;
+		double dx = (corners[(i + 1) % 4].x - corners[i].x) / 7.0;
+		double dy = (corners[(i + 1) % 4].y - corners[i].y) / 7.0;
+		cv::Point2f stripeVecX, stripeVecY;
+		setStripes(stripeLength, stripeVecX, stripeVecY, dx, dy);
+		if (stripeLength > MAX_STRIPE_LENGTH) {
+			stripeLength = MAX_STRIPE_LENGTH;
+		}
+
+		// Find the start position
+		int nStart = -(stripeLength >> 1);
+
+		cv::Point2f true_edge[6];
+		int numEdges = 0;
+
+		// Goes through each stripe in the edge
+		for (int j = 1; j < 7; ++j) {
+
+			// Find the location of each stripe
+			double px = (double)corners[i].x + (double)j * dx;
+			double py = (double)corners[i].y + (double)j * dy;
+
+			cv::Point p;
+			p.x = (int)px;
+			p.y = (int)py;
+
+			// Sample the three columns of the stripe. The y offset across the stripe uses
+			// stripeVecX.x like the reference does, so that both sample the same pixels
+			for (int m = -1; m <= 1; ++m) {
+				sampleStripeColumn(gray_frame, px + (double)m * stripeVecX.x, py + (double)m * stripeVecX.x,
+					stripeVecY.x, stripeVecY.y, nStart, stripeLength, columnValues[m + 1]);
+			}
+
+			// Perform sobel operator on all inner cells in the stripe
+			stripeSobel(columns, stripeLength, weighted, sobelValues);
+
+			// Find the center of the edge given the maximum position in this stripe
+			if (findStripeEdge(sobelValues, stripeLength, p, stripeVecY, true_edge[numEdges])) {
+				numEdges++;
+			}
+		}
+
+		fitEdgeLine(true_edge, numEdges, corners, i, lineParameters);
+	}
+}
+
+
+/*  Samples the gradient of the image along the edge normal, with bilinear interpolation
+ *	Pixels off the image have no gradient, just as the stripes see them as flat 127.
+ *
+ *	@param image: The gradients of the frame
+ *	@param x: The x coordinate of the sample
+ *	@param y: The y coordinate of the sample
+ *	@param normalX: The x component of the unit normal
+ *	@param normalY: The y component of the unit normal
+ *
+ *	@return response: The gradient projected on the normal, scaled like the stripe sobel values
+ */
+static float sampleNormalGradient(const GradientImage &image, float x, float y, float normalX, float normalY) {
+
+	int xi = (int)floorf(x);
+	int yi = (int)floorf(y);
+	if (xi < 0 || yi < 0 || xi >= image.cols - 1 || yi >= image.rows - 1) {
+		return 0.0f;
+	}
+
+	int g00[2], g01[2], g10[2], g11[2];
+	pixelGradient(image, xi, yi, g00);
+	pixelGradient(image, xi + 1, yi, g01);
+	pixelGradient(image, xi, yi + 1, g10);
+	pixelGradient(image, xi + 1, yi + 1, g11);
+
+	float fx = x - (float)xi;
+	float fy = y - (float)yi;
+	float response[2];
+	for (int c = 0; c < 2; c++) {
+		float top = (float)g00[c] + fx * (float)(g01[c] - g00[c]);
+		float bottom = (float)g10[c] + fx * (float)(g11[c] - g10[c]);
+		response[c] = top + fy * (bottom - top);
+	}
+	return response[0] * normalX + response[1] * normalY;
+}
+
+
+/*  Checks whether a stripe lies inside the image and inside computed tiles
+ *
+ *	@param image: The gradients of the frame
+ *	@param px: The x coordinate of the stripe center
+ *	@param py: The y coordinate of the stripe center
+ *	@param stripeVecY: The unit vector along the stripe
+ *	@param first: The offset of the first sample from the center
+ *	@param last: The offset of the last sample from the center
+ *
+ *	@return computed: True if every pixel the samples read has its gradient computed
+ */
+static bool stripeComputed(const GradientImage &image, double px, double py, const cv::Point2f &stripeVecY, int first, int last) {
+
+	// The samples lie between the two ends, so the floor of their positions lies inside this box,
+	// and their right and bottom neighbours are held by the same tile
+	float x0 = (float)(px + (double)first * stripeVecY.x), x1 = (float)(px + (double)last * stripeVecY.x);
+	float y0 = (float)(py + (double)first * stripeVecY.y), y1 = (float)(py + (double)last * stripeVecY.y);
+	int left = (int)floorf(std::min(x0, x1)), right = (int)floorf(std::max(x0, x1));
+	int top = (int)floorf(std::min(y0, y1)), bottom = (int)floorf(std::max(y0, y1));
+	if (left < 0 || top < 0 || right >= image.cols - 1 || bottom >= image.rows - 1) {
+		return false;
+	}
+
+	for (int ty = top >> image.tileShift; ty <= bottom >> image.tileShift; ty++) {
+		for (int tx = left >> image.tileShift; tx <= right >> image.tileShift; tx++) {
+			int slot = image.tileSlots[ty * image.tileCols + tx];
+			if (slot < 0 || slot >= image.computedTiles) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+
+/*  Samples the gradient along a stripe whose pixels are all computed, see stripeComputed
+ *	Same values as sampleNormalGradient, without checking the image border or the tiles,
+ *	several samples at a time like sampleStripeColumn.
+ *
+ *	@param image: The gradients of the frame
+ *	@param px: The x coordinate of the stripe center
+ *	@param py: The y coordinate of the stripe center
+ *	@param stripeVecY: The unit vector along the stripe, which is also the edge normal
+ *	@param nStart: The offset of the first sample from the center
+ *	@param length: The number of samples
+ *	@param response: Container to hold the gradient projected on the normal at each sample
+ *
+ *	@return void
+ */
+static void sampleStripeGradient(const GradientImage &image, double px, double py, const cv::Point2f &stripeVecY,
+	int nStart, int length, float* response) {
+
+	const int mask = (1 << image.tileShift) - 1;
+	const int step = 2 * image.tilePitch;
+	int n = 0;
+
+#if defined(__AVX2__)
+	// Eight samples at a time, gathering each gradient pair as one 32-bit value
+	const int* pairs = (const int*)image.tiles;
+	const __m256d stepX4 = _mm256_set1_pd(stripeVecY.x), stepY4 = _mm256_set1_pd(stripeVecY.y);
+	const __m256d baseX4 = _mm256_set1_pd(px), baseY4 = _mm256_set1_pd(py);
+	const __m256d laneLo = _mm256_set_pd(3.0, 2.0, 1.0, 0.0), laneHi = _mm256_set_pd(7.0, 6.0, 5.0, 4.0);
+	const __m256 normalX = _mm256_set1_ps(stripeVecY.x), normalY = _mm256_set1_ps(stripeVecY.y);
+	const __m128i shift = _mm_cvtsi32_si128(image.tileShift);
+	const __m256i mask8 = _mm256_set1_epi32(mask), tileCols8 = _mm256_set1_epi32(image.tileCols);
+	const __m256i pitch8 = _mm256_set1_epi32(image.tilePitch), stride8 = _mm256_set1_epi32(image.tileStride / 2);
+	const __m256i one8 = _mm256_set1_epi32(1);
+
+	for (; n + 8 <= length; n += 8) {
+
+		// Positions of the eight samples, rounded to float after the double precision sum
+		__m256d offset = _mm256_set1_pd((double)(nStart + n));
+		__m256d nLo = _mm256_add_pd(offset, laneLo), nHi = _mm256_add_pd(offset, laneHi);
+		__m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_add_pd(baseX4, _mm256_mul_pd(nLo, stepX4)))),
+			_mm256_cvtpd_ps(_mm256_add_pd(baseX4, _mm256_mul_pd(nHi, stepX4))), 1);
+		__m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(_mm256_add_pd(baseY4, _mm256_mul_pd(nLo, stepY4)))),
+			_mm256_cvtpd_ps(_mm256_add_pd(baseY4, _mm256_mul_pd(nHi, stepY4))), 1);
+		__m256i xi = _mm256_cvttps_epi32(x), yi = _mm256_cvttps_epi32(y);
+		__m256 fx = _mm256_sub_ps(x, _mm256_cvtepi32_ps(xi));
+		__m256 fy = _mm256_sub_ps(y, _mm256_cvtepi32_ps(yi));
+
+		// Position of each top left pair within the packed tiles
+		__m256i tile = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srl_epi32(yi, shift), tileCols8), _mm256_srl_epi32(xi, shift));
+		__m256i slot = _mm256_i32gather_epi32(image.tileSlots, tile, 4);
+		__m256i index = _mm256_add_epi32(_mm256_mullo_epi32(slot, stride8),
+			_mm256_add_epi32(_mm256_mullo_epi32(_mm256_and_si256(yi, mask8), pitch8), _mm256_and_si256(xi, mask8)));
+		__m256i below = _mm256_add_epi32(index, pitch8);
+		__m256i p00 = _mm256_i32gather_epi32(pairs, index, 4);
+		__m256i p01 = _mm256_i32gather_epi32(pairs, _mm256_add_epi32(index, one8), 4);
+		__m256i p10 = _mm256_i32gather_epi32(pairs, below, 4);
+		__m256i p11 = _mm256_i32gather_epi32(pairs, _mm256_add_epi32(below, one8), 4);
+
+		// The x gradient is the low half of each pair and the y gradient the high half
+		__m256i x00 = _mm256_srai_epi32(_mm256_slli_epi32(p00, 16), 16), y00 = _mm256_srai_epi32(p00, 16);
+		__m256i x01 = _mm256_srai_epi32(_mm256_slli_epi32(p01, 16), 16), y01 = _mm256_srai_epi32(p01, 16);
+		__m256i x10 = _mm256_srai_epi32(_mm256_slli_epi32(p10, 16), 16), y10 = _mm256_srai_epi32(p10, 16);
+		__m256i x11 = _mm256_srai_epi32(_mm256_slli_epi32(p11, 16), 16), y11 = _mm256_srai_epi32(p11, 16);
+
+		// Blend horizontally, then vertically, then project on the normal
+		__m256 topX = _mm256_add_ps(_mm256_cvtepi32_ps(x00), _mm256_mul_ps(fx, _mm256_cvtepi32_ps(_mm256_sub_epi32(x01, x00))));
+		__m256 topY = _mm256_add_ps(_mm256_cvtepi32_ps(y00), _mm256_mul_ps(fx, _mm256_cvtepi32_ps(_mm256_sub_epi32(y01, y00))));
+		__m256 bottomX = _mm256_add_ps(_mm256_cvtepi32_ps(x10), _mm256_mul_ps(fx, _mm256_cvtepi32_ps(_mm256_sub_epi32(x11, x10))));
+		__m256 bottomY = _mm256_add_ps(_mm256_cvtepi32_ps(y10), _mm256_mul_ps(fx, _mm256_cvtepi32_ps(_mm256_sub_epi32(y11, y10))));
+		__m256 gx = _mm256_add_ps(topX, _mm256_mul_ps(fy, _mm256_sub_ps(bottomX, topX)));
+		__m256 gy = _mm256_add_ps(topY, _mm256_mul_ps(fy, _mm256_sub_ps(bottomY, topY)));
+		_mm256_storeu_ps(response + n, _mm256_add_ps(_mm256_mul_ps(gx, normalX), _mm256_mul_ps(gy, normalY)));
+	}
+#endif
+
+#if MARKER_SSE2
+	// Four samples at a time, reading the gradients one sample at a time
+	const __m128d stepXd = _mm_set1_pd(stripeVecY.x), stepYd = _mm_set1_pd(stripeVecY.y);
+	const __m128d baseXd = _mm_set1_pd(px), baseYd = _mm_set1_pd(py);
+	const __m128d pairLo = _mm_set_pd(1.0, 0.0), pairHi = _mm_set_pd(3.0, 2.0);
+	const __m128 normalX4 = _mm_set1_ps(stripeVecY.x), normalY4 = _mm_set1_ps(stripeVecY.y);
+
+	for (; n + 4 <= length; n += 4) {
+
+		// Positions of the four samples, rounded to float after the double precision sum
+		__m128d offset = _mm_set1_pd((double)(nStart + n));
+		__m128d nLo = _mm_add_pd(offset, pairLo), nHi = _mm_add_pd(offset, pairHi);
+		__m128 x = _mm_movelh_ps(_mm_cvtpd_ps(_mm_add_pd(baseXd, _mm_mul_pd(nLo, stepXd))),
+			_mm_cvtpd_ps(_mm_add_pd(baseXd, _mm_mul_pd(nHi, stepXd))));
+		__m128 y = _mm_movelh_ps(_mm_cvtpd_ps(_mm_add_pd(baseYd, _mm_mul_pd(nLo, stepYd))),
+			_mm_cvtpd_ps(_mm_add_pd(baseYd, _mm_mul_pd(nHi, stepYd))));
+		__m128i xi = _mm_cvttps_epi32(x), yi = _mm_cvttps_epi32(y);
+		__m128 fx = _mm_sub_ps(x, _mm_cvtepi32_ps(xi));
+		__m128 fy = _mm_sub_ps(y, _mm_cvtepi32_ps(yi));
+
+		alignas(16) int xs[4], ys[4];
+		alignas(16) int x00[4], x01[4], x10[4], x11[4], y00[4], y01[4], y10[4], y11[4];
+		_mm_store_si128((__m128i*)xs, xi);
+		_mm_store_si128((__m128i*)ys, yi);
+		for (int l = 0; l < 4; l++) {
+			int slot = image.tileSlots[(ys[l] >> image.tileShift) * image.tileCols + (xs[l] >> image.tileShift)];
+			const short* g0 = image.tiles + slot * image.tileStride + (ys[l] & mask) * step + 2 * (xs[l] & mask);
+			const short* g1 = g0 + step;
+			x00[l] = g0[0];
+			y00[l] = g0[1];
+			x01[l] = g0[2];
+			y01[l] = g0[3];
+			x10[l] = g1[0];
+			y10[l] = g1[1];
+			x11[l] = g1[2];
+			y11[l] = g1[3];
+		}
+
+		// Blend horizontally, then vertically, then project on the normal
+		__m128i a00 = _mm_load_si128((const __m128i*)x00), a01 = _mm_load_si128((const __m128i*)x01);
+		__m128i a10 = _mm_load_si128((const __m128i*)x10), a11 = _mm_load_si128((const __m128i*)x11);
+		__m128i b00 = _mm_load_si128((const __m128i*)y00), b01 = _mm_load_si128((const __m128i*)y01);
+		__m128i b10 = _mm_load_si128((const __m128i*)y10), b11 = _mm_load_si128((const __m128i*)y11);
+		__m128 topX = _mm_add_ps(_mm_cvtepi32_ps(a00), _mm_mul_ps(fx, _mm_cvtepi32_ps(_mm_sub_epi32(a01, a00))));
+		__m128 topY = _mm_add_ps(_mm_cvtepi32_ps(b00), _mm_mul_ps(fx, _mm_cvtepi32_ps(_mm_sub_epi32(b01, b00))));
+		__m128 bottomX = _mm_add_ps(_mm_cvtepi32_ps(a10), _mm_mul_ps(fx, _mm_cvtepi32_ps(_mm_sub_epi32(a11, a10))));
+		__m128 bottomY = _mm_add_ps(_mm_cvtepi32_ps(b10), _mm_mul_ps(fx, _mm_cvtepi32_ps(_mm_sub_epi32(b11, b10))));
+		__m128 gx = _mm_add_ps(topX, _mm_mul_ps(fy, _mm_sub_ps(bottomX, topX)));
+		__m128 gy = _mm_add_ps(topY, _mm_mul_ps(fy, _mm_sub_ps(bottomY, topY)));
+		_mm_storeu_ps(response + n, _mm_add_ps(_mm_mul_ps(gx, normalX4), _mm_mul_ps(gy, normalY4)));
+	}
+#endif
+
+	// Remaining samples one at a time
+	for (; n < length; n++) {
+		double offset = (double)(nStart + n);
+		float x = (float)(px + offset * stripeVecY.x);
+		float y = (float)(py + offset * stripeVecY.y);
+
+		// The samples are inside the image, so truncation is the floor
+		int xi = (int)x;
+		int yi = (int)y;
+		float fx = x - (float)xi;
+		float fy = y - (float)yi;
+
+		int slot = image.tileSlots[(yi >> image.tileShift) * image.tileCols + (xi >> image.tileShift)];
+		const short* g0 = image.tiles + slot * image.tileStride + (yi & mask) * step + 2 * (xi & mask);
+		const short* g1 = g0 + step;
+		float topX = (float)g0[0] + fx * (float)(g0[2] - g0[0]);
+		float topY = (float)g0[1] + fx * (float)(g0[3] - g0[1]);
+		float bottomX = (float)g1[0] + fx * (float)(g1[2] - g1[0]);
+		float bottomY = (float)g1[1] + fx * (float)(g1[3] - g1[1]);
+		float gx = topX + fy * (bottomX - topX);
+		float gy = topY + fy * (bottomY - topY);
+		response[n] = gx * stripeVecY.x + gy * stripeVecY.y;
+	}
+}
+
+
+/*  Refine edges to get a better estimate, from the gradients shared by the candidates of a frame.
+ *	Takes the same stripes as refineEdges, but reads the response of each stripe pixel from the
+ *	gradient image projected on the edge normal instead of resampling the image around it, so
+ *	that overlapping candidates do not compute the same gradients again. The maxima and the
+ *	line fit are those of refineEdges, and the results differ from it only by interpolating
+ *	the gradients rather than the pixels.
+ *	Kernel for the level of this namespace, reached through activeKernels.
+ *
+ *	@param lineParameters: Container to hold the 4x4 line parameters, with one edge per column
+ *	@param corners: The coordinates of the corners of the marker
+ *	@param image: The gradients of the frame, computed over the regions given by refinementRegions
+ *
+ *	@return void
+ */
+static void refineEdgesGradient(float* lineParameters, const cv::Point* corners, const GradientImage &image) {
+
+	float sobelValues[MAX_STRIPE_LENGTH];
+
+	// Refines edges one edge at a time
+	for (int i = 0; i < 4; i++) {
+
+		// Find size and directions of the stripes, with 6 stripes in total
+		int stripeLength = 0;
+		double dx = (corners[(i + 1) % 4].x - corners[i].x) / 7.0;
+		double dy = (corners[(i + 1) % 4].y - corners[i].y) / 7.0;
+		cv::Point2f stripeVecX, stripeVecY;
+		setStripes(stripeLength, stripeVecX, stripeVecY, dx, dy);
+		if (stripeLength > MAX_STRIPE_LENGTH) {
+			stripeLength = MAX_STRIPE_LENGTH;
+		}
+
+		// The sobel value n sits on the stripe pixel n + 1
+		int nStart = -(stripeLength >> 1) + 1;
+
+		cv::Point2f true_edge[6];
+		int numEdges = 0;
+
+		// Goes through each stripe in the edge
+		for (int j = 1; j < 7; ++j) {
+
+			// Find the location of each stripe
+			double px = (double)corners[i].x + (double)j * dx;
+			double py = (double)corners[i].y + (double)j * dy;
+
+			cv::Point p;
+			p.x = (int)px;
+			p.y = (int)py;
+
+			// Read the gradient along the middle of the stripe, straight from the tiles when they hold all of it
+			if (stripeComputed(image, px, py, stripeVecY, nStart, nStart + stripeLength - 3)) {
+				sampleStripeGradient(image, px, py, stripeVecY, nStart, stripeLength - 2, sobelValues);
+			}
+			else {
+				for (int n = 0; n < stripeLength - 2; n++) {
+					double offset = (double)(nStart + n);
+					sobelValues[n] = sampleNormalGradient(image, (float)(px + offset * stripeVecY.x), (float)(py + offset * stripeVecY.y),
+						stripeVecY.x, stripeVecY.y);
+				}
+			}
+
+			// Find the center of the edge given the maximum position in this stripe
+			if (findStripeEdge(sobelValues, stripeLength, p, stripeVecY, true_edge[numEdges])) {
+				numEdges++;
+			}
+		}
+
+		fitEdgeLine(true_edge, numEdges, corners, i, lineParameters);
+	}
+}
+
+
+/*  Fills a table with the edge refinement kernels of this level
+ *
+ *	@param table: Container to hold the kernels
+ *
+ *	@return void
+ */
+void fillEdgeKernels(KernelTable &table) {
+	table.refineEdges = refineEdges;
+	table.refineEdgesGradient = refineEdgesGradient;
+}
+
+}
+
+
+#ifndef MARKER_ISA_VARIANT
+/*  Refine edges to get a better estimate.
+ *	Each stripe is sampled a column at a time into stack buffers, so no memory is allocated.
+ *	The result matches refineEdgesReference exactly whenever every stripe has a sharp maximum.
+ *	Stripes without one are left out of the line fit, where the reference fits them as (0, 0),
+ *	and an edge with fewer than two good stripes keeps the line through its two corners.
+ *	Runs the kernel chosen for this processor, see activeKernels.
+ *	
+ *	@param lineParameters: Container to hold the 4x4 line parameters, with one edge per column
+ *	@param corners: The coordinates of the corners of the marker
+ *	@param gray_frame: The grayscaled image
+ *
+ *	@return void
+ */
+void refineEdges(float* lineParameters, const cv::Point* corners, const cv::Mat &gray_frame) {
+	activeKernels().refineEdges(lineParameters, corners, gray_frame);
+}
+
+
+/*  Refine edges to get a better estimate, from the gradients shared by the candidates of a frame.
+ *	Takes the same stripes, maxima and line fit as refineEdges, reading the response of each
+ *	stripe pixel from the gradient image instead of resampling the image around it.
+ *	Runs the kernel chosen for this processor, see activeKernels.
+ *
+ *	@param lineParameters: Container to hold the 4x4 line parameters, with one edge per column
+ *	@param corners: The coordinates of the corners of the marker
+ *	@param gradients: The gradients of the frame, computed over the regions given by refinementRegions
+ *
+ *	@return void
+ */
+void refineEdges(float* lineParameters, const cv::Point* corners, const GradientImage &gradients) {
+	activeKernels().refineEdgesGradient(lineParameters, corners, gradients);
+}
+
+
+/*  Finds the regions of the image that the refinement of a quad reads
+ *	The stripes of an edge reach half their length to either side of it, and the bilinear
+ *	samples one pixel more. The inside of the quad is never read.
+ *
+ *	@param corners: The coordinates of the corners of the quad
+ *	@param regions: Container to hold the bounding box of each edge grown by its half stripe
+ *
+ *	@return void
+ */
+void refinementRegions(const cv::Point* corners, cv::Rect* regions) {
+
+	for (int i = 0; i < 4; i++) {
+		const cv::Point &a = corners[i];
+		const cv::Point &b = corners[(i + 1) % 4];
+		int stripeLength = 0;
+		cv::Point2f stripeVecX, stripeVecY;
+		setStripes(stripeLength, stripeVecX, stripeVecY, (b.x - a.x) / 7.0, (b.y - a.y) / 7.0);
+		int margin = (std::min(stripeLength, MAX_STRIPE_LENGTH) >> 1) + 2;
+
+		int left = std::min(a.x, b.x), top = std::min(a.y, b.y);
+		regions[i] = cv::Rect(left - margin, top - margin, std::abs(b.x - a.x) + 1 + 2 * margin, std::abs(b.y - a.y) + 1 + 2 * margin);
+	}
+}
+
+
+/*  Refine edges to get a better estimate.
+ *	
+ *	@param linParamsMat: Matrix to save the line parameters
+ *	@param corners: The coordinates of the corners of the marker
+ *	@param gray_frame: The grayscaled image
+ *
+ *	@return void
+ */
+void refineEdges(cv::Mat lineParamsMat, const cv::Point* corners, cv::Mat &gray_frame) {
+
+	float lineParameters[16];
+	refineEdges(lineParameters, corners, gray_frame);
+
+	for (int r = 0; r < 4; r++) {
+		for (int c = 0; c < 4; c++) {
+			lineParamsMat.at<float>(r, c) = lineParameters[4 * r + c];
+		}
+	}
+}
+#endif
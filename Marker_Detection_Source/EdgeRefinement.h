@@ -14,6 +14,10 @@
 #include <opencv2/highgui.hpp>
 
 
+/*  Gradients shared by the candidates of a frame, see GradientCache.h */
+struct GradientImage;
+
+
 /*  Finds the parameters of the stripes used for line refinement */
 cv::Size setStripes(int &stripeLength, cv::Point2f &stripeVecX, cv::Point2f &stripeVecY, double dx, double dy);
 
@@ -21,7 +25,19 @@ cv::Size setStripes(int &stripeLength, cv::Point2f &stripeVecX, cv::Point2f &str
 int subpixSampleSafe2(const cv::Mat &gray_im, const cv::Point2f &p);
 
 /*  Finds the pixel location with the maximum value in the stripe using quadratic fitting */
-double findMaxInStripe(std::vector<double> sobelValues, const int stripeLength, int &maxIndex);
+double findMaxInStripe(const std::vector<double> &sobelValues, const int stripeLength, int &maxIndex);
+
+/*  Refine edges to get a better estimate, sampling one pixel at a time */
+void refineEdgesReference(cv::Mat lineParamsMat, const cv::Point* corners, const cv::Mat &gray_frame);
+
+/*  Refine edges to get a better estimate, without allocating any memory */
+void refineEdges(float* lineParameters, const cv::Point* corners, const cv::Mat &gray_frame);
+
+/*  Refine edges to get a better estimate, from the gradients shared by the candidates of a frame */
+void refineEdges(float* lineParameters, const cv::Point* corners, const GradientImage &gradients);
+
+/*  Finds the regions of the image that the refinement of the four edges of a quad reads */
+void refinementRegions(const cv::Point* corners, cv::Rect* regions);
 
 /*  Refine edges to get a better estimate */
 void refineEdges(cv::Mat lineParamsMat, const cv::Point* corners, cv::Mat &gray_frame);
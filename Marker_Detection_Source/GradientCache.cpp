@@ -0,0 +1,291 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Gradient image shared by the candidates of a frame
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+
+/* SIMD includes */
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MARKER_SSE2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MARKER_SSE2 1
+#endif
+
+/* Helper includes */
+#include "GradientCache.h"
+#include "KernelDispatch.h"
+
+
+namespace MARKER_ISA {
+
+#if defined(__AVX2__)
+/*  Loads 16 pixels of a row, widened to 16 bits
+ *
+ *	@param pixels: The first pixel to load
+ *
+ *	@return widened: The pixels as shorts
+ */
+static inline __m256i loadWidened16(const uchar* pixels) {
+	return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)pixels));
+}
+#endif
+
+
+#if MARKER_SSE2
+/*  Loads 8 pixels of a row, widened to 16 bits
+ *
+ *	@param pixels: The first pixel to load
+ *
+ *	@return widened: The pixels as shorts
+ */
+static inline __m128i loadWidened8(const uchar* pixels) {
+	return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)pixels), _mm_setzero_si128());
+}
+#endif
+
+
+/*  Computes the Sobel gradient of one pixel from its three rows and the columns around it
+ *
+ *	@param above: The row above the pixel
+ *	@param middle: The row of the pixel
+ *	@param below: The row below the pixel
+ *	@param left: The column left of the pixel
+ *	@param x: The column of the pixel
+ *	@param right: The column right of the pixel
+ *	@param gradient: Container to hold the x and y gradients
+ *
+ *	@return void
+ */
+static inline void sobelPixel(const uchar* above, const uchar* middle, const uchar* below, int left, int x, int right, short* gradient) {
+	gradient[0] = (short)((above[right] - above[left]) + 2 * (middle[right] - middle[left]) + (below[right] - below[left]));
+	gradient[1] = (short)((below[left] + 2 * below[x] + below[right]) - (above[left] + 2 * above[x] + above[right]));
+}
+
+
+/*  Computes the Sobel gradients of a region of a grayscale image
+ *	Pixels on the border of the image repeat their neighbours inside it, as BORDER_REPLICATE does.
+ *	Kernel for the level of this namespace, reached through activeKernels.
+ *
+ *	@param gray: The grayscale image
+ *	@param region: The region to compute, inside the image
+ *	@param gradients: Container to hold the interleaved x and y gradients of the region
+ *	@param gradientStep: Shorts from one row of gradients to the next
+ *
+ *	@return void
+ */
+static void sobelGradients(const cv::Mat &gray, const cv::Rect &region, short* gradients, size_t gradientStep) {
+
+	const int last = gray.cols - 1;
+
+	// Columns away from the left and right border of the image have both of their neighbours
+	const int start = region.x;
+	const int end = region.x + region.width;
+	const int innerStart = std::max(start, 1);
+	const int innerEnd = std::min(end, last);
+
+	for (int y = region.y; y < region.y + region.height; y++) {
+		const uchar* above = gray.ptr<uchar>(std::max(y - 1, 0));
+		const uchar* middle = gray.ptr<uchar>(y);
+		const uchar* below = gray.ptr<uchar>(std::min(y + 1, gray.rows - 1));
+		short* out = gradients + (size_t)(y - region.y) * gradientStep;
+
+		int x = start;
+		for (; x < innerStart; x++) {
+			sobelPixel(above, middle, below, std::max(x - 1, 0), x, std::min(x + 1, last), out + 2 * (x - start));
+		}
+
+#if defined(__AVX2__)
+		for (; x + 16 <= innerEnd; x += 16) {
+			__m256i aboveLeft = loadWidened16(above + x - 1), aboveMiddle = loadWidened16(above + x), aboveRight = loadWidened16(above + x + 1);
+			__m256i middleLeft = loadWidened16(middle + x - 1), middleRight = loadWidened16(middle + x + 1);
+			__m256i belowLeft = loadWidened16(below + x - 1), belowMiddle = loadWidened16(below + x), belowRight = loadWidened16(below + x + 1);
+
+			__m256i middleDiff = _mm256_sub_epi16(middleRight, middleLeft);
+			__m256i gx = _mm256_add_epi16(_mm256_add_epi16(_mm256_sub_epi16(aboveRight, aboveLeft), _mm256_sub_epi16(belowRight, belowLeft)),
+				_mm256_add_epi16(middleDiff, middleDiff));
+			__m256i gy = _mm256_sub_epi16(
+				_mm256_add_epi16(_mm256_add_epi16(belowLeft, belowRight), _mm256_add_epi16(belowMiddle, belowMiddle)),
+				_mm256_add_epi16(_mm256_add_epi16(aboveLeft, aboveRight), _mm256_add_epi16(aboveMiddle, aboveMiddle)));
+
+			// Interleave within each 128-bit half, then put the halves back in pixel order
+			__m256i low = _mm256_unpacklo_epi16(gx, gy);
+			__m256i high = _mm256_unpackhi_epi16(gx, gy);
+			_mm256_storeu_si256((__m256i*)(out + 2 * (x - start)), _mm256_permute2x128_si256(low, high, 0x20));
+			_mm256_storeu_si256((__m256i*)(out + 2 * (x - start) + 16), _mm256_permute2x128_si256(low, high, 0x31));
+		}
+#endif
+
+#if MARKER_SSE2
+		for (; x + 8 <= innerEnd; x += 8) {
+			__m128i aboveLeft = loadWidened8(above + x - 1), aboveMiddle = loadWidened8(above + x), aboveRight = loadWidened8(above + x + 1);
+			__m128i middleLeft = loadWidened8(middle + x - 1), middleRight = loadWidened8(middle + x + 1);
+			__m128i belowLeft = loadWidened8(below + x - 1), belowMiddle = loadWidened8(below + x), belowRight = loadWidened8(below + x + 1);
+
+			__m128i middleDiff = _mm_sub_epi16(middleRight, middleLeft);
+			__m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(aboveRight, aboveLeft), _mm_sub_epi16(belowRight, belowLeft)),
+				_mm_add_epi16(middleDiff, middleDiff));
+			__m128i gy = _mm_sub_epi16(
+				_mm_add_epi16(_mm_add_epi16(belowLeft, belowRight), _mm_add_epi16(belowMiddle, belowMiddle)),
+				_mm_add_epi16(_mm_add_epi16(aboveLeft, aboveRight), _mm_add_epi16(aboveMiddle, aboveMiddle)));
+
+			_mm_storeu_si128((__m128i*)(out + 2 * (x - start)), _mm_unpacklo_epi16(gx, gy));
+			_mm_storeu_si128((__m128i*)(out + 2 * (x - start) + 8), _mm_unpackhi_epi16(gx, gy));
+		}
+#endif
+
+		for (; x < innerEnd; x++) {
+			sobelPixel(above, middle, below, x - 1, x, x + 1, out + 2 * (x - start));
+		}
+		for (; x < end; x++) {
+			sobelPixel(above, middle, below, std::max(x - 1, 0), x, std::min(x + 1, last), out + 2 * (x - start));
+		}
+	}
+}
+
+
+/*  Fills a table with the gradient kernel of this level
+ *
+ *	@param table: Container to hold the kernels
+ *
+ *	@return void
+ */
+void fillGradientKernels(KernelTable &table) {
+	table.sobelGradients = sobelGradients;
+}
+
+}
+
+
+#ifndef MARKER_ISA_VARIANT
+/*  Computes the Sobel gradients of a region of a grayscale image
+ *	Gives the same values as cv::Sobel with a 3x3 aperture and BORDER_REPLICATE, with the
+ *	x and y gradients of each pixel next to each other.
+ *	Runs the kernel chosen for this processor, see activeKernels.
+ *
+ *	@param gray: The grayscale image
+ *	@param region: The region to compute, inside the image
+ *	@param gradients: Container to hold the interleaved x and y gradients of the region
+ *	@param gradientStep: Shorts from one row of gradients to the next
+ *
+ *	@return void
+ */
+void sobelGradients(const cv::Mat &gray, const cv::Rect &region, short* gradients, size_t gradientStep) {
+	activeKernels().sobelGradients(gray, region, gradients, gradientStep);
+}
+
+
+/*  Creates an empty cache
+ *	The tiles are only allocated when the first region is requested.
+ */
+GradientCache::GradientCache() : tileCols(0), tileRows(0), computed(0) {
+}
+
+
+/*  Forgets the gradients of the previous frame and takes those of a new grayscale image
+ *	The tiles keep their memory for the next frame.
+ *
+ *	@param newGray: The grayscale image of the frame
+ *
+ *	@return void
+ */
+void GradientCache::reset(const cv::Mat &newGray) {
+	gray = newGray;
+	tileCols = (gray.cols + TILE_SIZE - 1) >> TILE_SHIFT;
+	tileRows = (gray.rows + TILE_SIZE - 1) >> TILE_SHIFT;
+	tileSlots.assign((size_t)tileCols * tileRows, -1);
+	slotTiles.clear();
+	computed = 0;
+}
+
+
+/*  Requests the gradients of a region of the image
+ *	Tiles that an earlier region already requested are not requested again. Room for the
+ *	new tiles is made here, so that they can then be computed at the same time.
+ *
+ *	@param region: The region, which may reach past the image
+ *
+ *	@return count: The number of tiles newly requested
+ */
+int GradientCache::request(const cv::Rect &region) {
+
+	cv::Rect inside = region & cv::Rect(0, 0, gray.cols, gray.rows);
+	if (inside.empty()) {
+		return 0;
+	}
+
+	int count = 0;
+	int lastX = (inside.x + inside.width - 1) >> TILE_SHIFT;
+	int lastY = (inside.y + inside.height - 1) >> TILE_SHIFT;
+	for (int ty = inside.y >> TILE_SHIFT; ty <= lastY; ty++) {
+		for (int tx = inside.x >> TILE_SHIFT; tx <= lastX; tx++) {
+			int tile = ty * tileCols + tx;
+			if (tileSlots[tile] < 0) {
+				tileSlots[tile] = (int)slotTiles.size();
+				slotTiles.push_back(tile);
+				count++;
+			}
+		}
+	}
+
+	size_t needed = slotTiles.size() * TILE_STRIDE;
+	if (tiles.size() < needed) {
+		tiles.resize(std::max(needed, 2 * tiles.size()));
+	}
+	return count;
+}
+
+
+/*  Computes one of the requested tiles, with the column and row of its next neighbours
+ *	Each tile writes only its own gradients, so different tiles can be computed by different threads.
+ *
+ *	@param index: The position of the tile among the pending tiles
+ *
+ *	@return void
+ */
+void GradientCache::computePending(int index) {
+	int slot = computed + index;
+	int tile = slotTiles[slot];
+	cv::Rect region((tile % tileCols) << TILE_SHIFT, (tile / tileCols) << TILE_SHIFT, TILE_PITCH, TILE_PITCH);
+	sobelGradients(gray, region & cv::Rect(0, 0, gray.cols, gray.rows), &tiles[(size_t)slot * TILE_STRIDE], 2 * TILE_PITCH);
+}
+
+
+/*  Marks the requested tiles as computed
+ *
+ *	@return void
+ */
+void GradientCache::finishPending() {
+	computed = (int)slotTiles.size();
+}
+
+
+/*  Returns the view that the refinement reads
+ *
+ *	@return image: Pointers to the tiles, their positions and the grayscale image
+ */
+GradientImage GradientCache::view() const {
+	GradientImage image;
+	image.tiles = tiles.empty() ? NULL : &tiles[0];
+	image.tileSlots = tileSlots.empty() ? NULL : &tileSlots[0];
+	image.computedTiles = computed;
+	image.tileCols = tileCols;
+	image.tileShift = TILE_SHIFT;
+	image.tilePitch = TILE_PITCH;
+	image.tileStride = TILE_STRIDE;
+	image.gray = gray.ptr<uchar>();
+	image.grayStep = gray.step;
+	image.cols = gray.cols;
+	image.rows = gray.rows;
+	return image;
+}
+#endif
@@ -0,0 +1,90 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the gradient image shared by the candidates of a frame
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <vector>
+
+
+/*  Read-only view of a gradient cache, as handed to the refinement kernels
+ *	Gradients are the 3x3 Sobel responses of the grayscale image, eight times the
+ *	derivative like the sobel values of the stripes, stored as interleaved x and y shorts.
+ *	Each computed tile holds its pixels and one more column and row, so that a bilinear
+ *	sample never needs a second tile.
+ */
+struct GradientImage
+{
+	const short* tiles;			// Gradients of the computed tiles, one tile after another
+	const int* tileSlots;		// Position of each tile of the image among the computed tiles, or -1, row after row
+	int computedTiles;			// Number of computed tiles, positions past it are not computed yet
+	int tileCols;				// Number of tiles across the image
+	int tileShift;				// Base 2 logarithm of the tile size
+	int tilePitch;				// Pixels from one row of a tile to the next
+	int tileStride;				// Shorts from one tile to the next
+	const uchar* gray;			// Grayscale image the gradients are taken from
+	size_t grayStep;			// Bytes from one row of the grayscale image to the next
+	int cols;					// Width of the image
+	int rows;					// Height of the image
+};
+
+
+/*  Sobel gradients of a frame, computed only over the regions the markers cover.
+ *	The image is split into square tiles that are computed at most once per frame, so
+ *	candidates that overlap, such as adjacent markers or quads found twice, share the
+ *	gradients of their pixels. The computed tiles are packed one after the other, so the
+ *	gradients of a stripe lie close together in memory. Tiles are requested for every
+ *	candidate first and then computed together, after which the cache is only read and
+ *	can be shared by threads.
+ */
+class GradientCache
+{
+public:
+	static const int TILE_SHIFT = 5;					// Tiles are 32 by 32 pixels
+	static const int TILE_SIZE = 1 << TILE_SHIFT;
+	static const int TILE_PITCH = TILE_SIZE + 1;		// Pixels per tile row, with the column of the next tile
+	static const int TILE_STRIDE = 2 * TILE_PITCH * TILE_PITCH;	// Shorts per tile, with the row of the next tile
+
+	GradientCache();
+
+	/*  Forgets the gradients of the previous frame and takes those of a new grayscale image */
+	void reset(const cv::Mat &gray);
+
+	/*  Requests the gradients of a region of the image, returning the number of new tiles it needs */
+	int request(const cv::Rect &region);
+
+	/*  Number of tiles requested and not computed yet */
+	int pendingCount() const { return (int)slotTiles.size() - computed; }
+
+	/*  Computes one of the requested tiles, and may be called for different tiles at once */
+	void computePending(int index);
+
+	/*  Marks the requested tiles as computed, once computePending has run for each of them */
+	void finishPending();
+
+	/*  Number of tiles computed since the last reset */
+	int computedCount() const { return computed; }
+
+	/*  Returns the view that the refinement reads */
+	GradientImage view() const;
+
+private:
+	cv::Mat gray;							// Header over the grayscale image of the frame
+	std::vector<short> tiles;				// Gradients of the requested tiles, in the order they were requested
+	std::vector<int> tileSlots;				// Position of each tile of the image in tiles, or -1 if not requested
+	std::vector<int> slotTiles;				// Tile of the image held at each position of tiles
+	int tileCols;							// Number of tiles across the image
+	int tileRows;							// Number of tiles down the image
+	int computed;							// Requested tiles computed since the last reset
+};
+
+
+/*  Computes the Sobel gradients of a region of a grayscale image, repeating its border pixels */
+void sobelGradients(const cv::Mat &gray, const cv::Rect &region, short* gradients, size_t gradientStep);
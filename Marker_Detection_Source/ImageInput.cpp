@@ -0,0 +1,125 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Input image descriptors
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Helper includes */
+#include "ImageInput.h"
+
+
+/*  Returns true if the first plane of a pixel format already is the grayscale image
+ *	The detector then reads that plane in place, without converting or copying it.
+ *
+ *	@param format: The pixel format, one of PixelFormat
+ *
+ *	@return luma: True for 8-bit grayscale and the planar NV12 and NV21 formats
+ */
+bool formatHasLumaPlane(int format) {
+	return format == PIXEL_GRAY8 || format == PIXEL_NV12 || format == PIXEL_NV21;
+}
+
+
+/*  Returns true if outlines can be drawn in colour into the pixels of a format
+ *	Green sits in the second byte of both RGBA and BGRA, so the same colour works for both.
+ *
+ *	@param format: The pixel format, one of PixelFormat
+ *
+ *	@return colour: True for the packed four-channel formats
+ */
+bool formatHasColour(int format) {
+	return format == PIXEL_RGBA32 || format == PIXEL_BGRA32;
+}
+
+
+/*  Wraps the first plane of an image as a cv::Mat without copying it
+ *	Four-channel formats become CV_8UC4, packed 4:2:2 formats CV_8UC2 with one element per
+ *	pixel, and the luma formats CV_8UC1 over the Y plane. Rows keep the stride of the caller.
+ *	Chroma is shared by pairs of pixels in the 4:2:2 formats and by 2x2 blocks in NV12 and NV21,
+ *	so their sides must be even, and NV12 and NV21 must come with their chroma plane even though
+ *	it is never read.
+ *
+ *	@param image: The description of the input image
+ *	@param pixels: Container to hold the header over the first plane
+ *
+ *	@return valid: False if the format is unknown, the image is empty, a stride is too short,
+ *	a subsampled side is odd or the chroma plane is missing
+ */
+bool wrapImage(const ImageDescriptor &image, cv::Mat &pixels) {
+
+	if (!image.planes[0] || image.width <= 0 || image.height <= 0) {
+		return false;
+	}
+
+	// Bytes taken by one pixel of the first plane
+	int type;
+	int pixelBytes;
+	switch (image.format) {
+	case PIXEL_RGBA32:
+	case PIXEL_BGRA32:
+		type = CV_8UC4;
+		pixelBytes = 4;
+		break;
+	case PIXEL_GRAY8:
+		type = CV_8UC1;
+		pixelBytes = 1;
+		break;
+	case PIXEL_NV12:
+	case PIXEL_NV21:
+		// Each row of the chroma plane holds one U, V pair for each pair of Y bytes
+		if (!image.planes[1] || (image.width & 1) || (image.height & 1) ||
+			(image.strides[1] > 0 && image.strides[1] < image.width)) {
+			return false;
+		}
+		type = CV_8UC1;
+		pixelBytes = 1;
+		break;
+	case PIXEL_YUYV:
+	case PIXEL_UYVY:
+		if (image.width & 1) {
+			return false;
+		}
+		type = CV_8UC2;
+		pixelBytes = 2;
+		break;
+	default:
+		return false;
+	}
+
+	// A stride of zero means the rows are tightly packed
+	size_t rowBytes = (size_t)image.width * pixelBytes;
+	size_t stride = image.strides[0] > 0 ? (size_t)image.strides[0] : rowBytes;
+	if (stride < rowBytes) {
+		return false;
+	}
+
+	pixels = cv::Mat(image.height, image.width, type, image.planes[0], stride);
+	return true;
+}
+
+
+/*  Describes a tightly packed RGBA image, as given to FindMarkers2
+ *
+ *	@param raw: The raw colour image
+ *	@param width: The width of the image
+ *	@param height: The height of the image
+ *
+ *	@return image: The description of the image
+ */
+ImageDescriptor describeRgbaImage(Color32* raw, int width, int height) {
+
+	ImageDescriptor image;
+	image.format = PIXEL_RGBA32;
+	image.width = width;
+	image.height = height;
+	image.planes[0] = raw;
+	image.planes[1] = NULL;
+	image.strides[0] = 0;
+	image.strides[1] = 0;
+	return image;
+}
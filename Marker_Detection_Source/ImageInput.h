@@ -0,0 +1,27 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for input image descriptors
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Helper includes */
+#include "UnityStructs.h"
+
+
+/*  Returns true if the first plane of a pixel format already is the grayscale image */
+bool formatHasLumaPlane(int format);
+
+/*  Returns true if outlines can be drawn in colour into the pixels of a format */
+bool formatHasColour(int format);
+
+/*  Wraps the first plane of an image as a cv::Mat without copying it, returning false if the descriptor is invalid */
+bool wrapImage(const ImageDescriptor &image, cv::Mat &pixels);
+
+/*  Describes a tightly packed RGBA image, as given to FindMarkers2 */
+ImageDescriptor describeRgbaImage(Color32* raw, int width, int height);
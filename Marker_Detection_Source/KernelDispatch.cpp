@@ -0,0 +1,130 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Runtime choice of the hot kernels
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <cstdlib>
+
+/* Helper includes */
+#include "CpuFeatures.h"
+#include "KernelDispatch.h"
+
+
+/*  Highest instruction set level that the kernels were compiled for
+ *	Builds without MARKER_CPU_DISPATCH only have the baseline kernels.
+ */
+#if MARKER_CPU_DISPATCH
+static const int MAX_KERNEL_LEVEL = CPU_AVX512;
+#else
+static const int MAX_KERNEL_LEVEL = CPU_BASELINE;
+#endif
+
+
+/*  Fills a table with the kernels of one instruction set level
+ *
+ *	@param level: One of CpuLevel, no higher than MAX_KERNEL_LEVEL
+ *	@param table: Container to hold the kernels
+ *
+ *	@return void
+ */
+static void fillKernels(int level, KernelTable &table) {
+
+	switch (level) {
+#if MARKER_CPU_DISPATCH
+	case CPU_AVX512:
+		isa_avx512::fillColorKernels(table);
+		isa_avx512::fillEdgeKernels(table);
+		isa_avx512::fillGradientKernels(table);
+		isa_avx512::fillDecoderKernels(table);
+		isa_avx512::fillPoseKernels(table);
+		break;
+	case CPU_AVX2:
+		isa_avx2::fillColorKernels(table);
+		isa_avx2::fillEdgeKernels(table);
+		isa_avx2::fillGradientKernels(table);
+		isa_avx2::fillDecoderKernels(table);
+		isa_avx2::fillPoseKernels(table);
+		break;
+	case CPU_SSE42:
+		isa_sse42::fillColorKernels(table);
+		isa_sse42::fillEdgeKernels(table);
+		isa_sse42::fillGradientKernels(table);
+		isa_sse42::fillDecoderKernels(table);
+		isa_sse42::fillPoseKernels(table);
+		break;
+#endif
+	default:
+		isa_baseline::fillColorKernels(table);
+		isa_baseline::fillEdgeKernels(table);
+		isa_baseline::fillGradientKernels(table);
+		isa_baseline::fillDecoderKernels(table);
+		isa_baseline::fillPoseKernels(table);
+		break;
+	}
+	table.level = level;
+}
+
+
+/*  Chooses the kernels for the processor
+ *	Takes the highest level supported by both the processor and the build. Setting the
+ *	environment variable MARKER_CPU_LEVEL to a level name lowers it, which is used to compare
+ *	the levels on one machine, but never raises it above what the processor supports.
+ *
+ *	@return table: The chosen kernels
+ */
+static KernelTable chooseKernels() {
+
+	int level = detectCpuLevel();
+	if (level > MAX_KERNEL_LEVEL) {
+		level = MAX_KERNEL_LEVEL;
+	}
+
+	int requested = parseCpuLevel(getenv("MARKER_CPU_LEVEL"));
+	if (requested >= 0 && requested < level) {
+		level = requested;
+	}
+
+	KernelTable table;
+	fillKernels(level, table);
+	return table;
+}
+
+
+/*  Returns the kernels for the best instruction set level of this processor
+ *	The choice is made once, on the first call from any thread.
+ *
+ *	@return table: The chosen kernels
+ */
+const KernelTable &activeKernels() {
+
+	static const KernelTable table = chooseKernels();
+	return table;
+}
+
+
+/*  Fills a table with the kernels of one instruction set level, whatever activeKernels chose
+ *	Used to run the levels side by side, as the tests do to check that they agree.
+ *
+ *	@param level: One of CpuLevel
+ *	@param table: Container to hold the kernels
+ *
+ *	@return available: False if the level was not compiled or the processor does not support it
+ */
+bool kernelsForLevel(int level, KernelTable &table) {
+
+	int highest = detectCpuLevel();
+	if (highest > MAX_KERNEL_LEVEL) {
+		highest = MAX_KERNEL_LEVEL;
+	}
+
+	if (level < CPU_BASELINE || level > highest) {
+		return false;
+	}
+
+	fillKernels(level, table);
+	return true;
+}
@@ -0,0 +1,88 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the runtime choice of the hot kernels
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Helper includes */
+#include "PoseSolver.h"
+
+
+/*  Markers whose poses are solved together, see PoseBatch.h */
+struct PoseBatch;
+
+/*  Gradients shared by the candidates of a frame, see GradientCache.h */
+struct GradientImage;
+
+
+/*  Namespace that the kernels of a translation unit are compiled into
+ *	The build compiles the kernel sources once more for each instruction set level, defining
+ *	MARKER_ISA_VARIANT and MARKER_ISA as isa_sse42, isa_avx2 or isa_avx512 together with the
+ *	matching compiler flags. Such a variant only holds the kernels, the rest of each source is
+ *	compiled once into the baseline.
+ */
+#ifndef MARKER_ISA
+#define MARKER_ISA isa_baseline
+#endif
+
+
+/*  Brackets code using the AVX-512 intrinsics that leave lanes undefined, such as _mm512_sqrt_ps
+ *	GCC 12 and older warn that these read an uninitialized value inside their own header
+ *	(GCC bug 105593, fixed in GCC 13), so the warning is turned off around the code that calls them.
+ */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 13
+#define MARKER_BEGIN_UNDEFINED_LANES \
+	_Pragma("GCC diagnostic push") \
+	_Pragma("GCC diagnostic ignored \"-Wuninitialized\"") \
+	_Pragma("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+#define MARKER_END_UNDEFINED_LANES _Pragma("GCC diagnostic pop")
+#else
+#define MARKER_BEGIN_UNDEFINED_LANES
+#define MARKER_END_UNDEFINED_LANES
+#endif
+
+
+/*  Entry points of the hot kernels compiled for one instruction set level */
+struct KernelTable
+{
+	void (*rgbaToGrayRow)(const uchar* rgba, uchar* gray, uchar* binary, int width, int thresh);
+	void (*bgraToGrayRow)(const uchar* bgra, uchar* gray, uchar* binary, int width, int thresh);
+	void (*yuv422ToGrayRow)(const uchar* yuv, uchar* gray, uchar* binary, int width, int lumaOffset, int thresh);
+	void (*refineEdges)(float* lineParameters, const cv::Point* corners, const cv::Mat &gray_frame);
+	void (*refineEdgesGradient)(float* lineParameters, const cv::Point* corners, const GradientImage &gradients);
+	void (*sobelGradients)(const cv::Mat &gray, const cv::Rect &region, short* gradients, size_t gradientStep);
+	bool (*decodeMarkerCells)(const cv::Mat &gray_frame, const cv::Point2f* corners, int cellThreshold, int &pattern);
+	void (*estimateSquarePoses)(PoseBatch &batch, float focalX, float focalY, const PoseSolver::RefineOptions<float> &options);
+	int level;				// Instruction set level of the kernels, one of CpuLevel
+};
+
+
+/*  Declares the functions that fill a table with the kernels of one instruction set level */
+#define MARKER_DECLARE_KERNELS(isa) \
+	namespace isa { \
+		void fillColorKernels(KernelTable &table); \
+		void fillEdgeKernels(KernelTable &table); \
+		void fillGradientKernels(KernelTable &table); \
+		void fillDecoderKernels(KernelTable &table); \
+		void fillPoseKernels(KernelTable &table); \
+	}
+
+MARKER_DECLARE_KERNELS(isa_baseline)
+#if MARKER_CPU_DISPATCH
+MARKER_DECLARE_KERNELS(isa_sse42)
+MARKER_DECLARE_KERNELS(isa_avx2)
+MARKER_DECLARE_KERNELS(isa_avx512)
+#endif
+
+
+/*  Returns the kernels for the best instruction set level of this processor, chosen on first use */
+const KernelTable &activeKernels();
+
+/*  Fills a table with the kernels of one level, returning false if the build or the processor lacks it */
+bool kernelsForLevel(int level, KernelTable &table);
@@ -0,0 +1,344 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Boards of markers with a known layout
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+
+/* Helper includes */
+#include "MarkerBoard.h"
+
+
+/* Number of points the board solve can hold, four corners per marker */
+static const int MAX_POINTS = 4 * MarkerBoard::MAX_MARKERS;
+
+/* Fewest iterations given to a solve that does not start from the previous board pose */
+static const int COLD_START_ITERATIONS = 10;
+
+
+/*  Creates a board with no layout */
+MarkerBoard::MarkerBoard() : hasPrior(false) {
+}
+
+
+/*  Replaces the layout of the board
+ *	Each marker is given by the board coordinates of its four corners, in the order of the
+ *	corners of a lone marker: (-s/2, s/2, 0), (-s/2, -s/2, 0), (s/2, -s/2, 0) and (s/2, s/2, 0)
+ *	in the frame of the marker with its cells read as its ID. The solve uses the corners as given, while the marker frame,
+ *	made orthonormal, only serves to start the solve and to report the marker poses.
+ *
+ *	@param ids: The ID of each marker, or NULL with a count of 0 to remove the board
+ *	@param corners: The 12 coordinates of the four corners of each marker, in the order of ids
+ *	@param markerCount: The number of markers on the board
+ *
+ *	@return valid: False if the layout has too many markers, a repeated ID or a degenerate marker
+ */
+bool MarkerBoard::setLayout(const int* ids, const float* corners, int markerCount) {
+
+	if (markerCount < 0 || markerCount > MAX_MARKERS || (markerCount > 0 && (ids == NULL || corners == NULL))) {
+		return false;
+	}
+
+	std::vector<Placement> layout(markerCount);
+	for (int m = 0; m < markerCount; m++) {
+		Placement &placement = layout[m];
+		placement.id = ids[m];
+		for (int i = 0; i < m; i++) {
+			if (layout[i].id == placement.id) {
+				return false;
+			}
+		}
+
+		const float* c = corners + 12 * m;
+		float side = 0.0f;
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		for (int i = 0; i < 4; i++) {
+			const float* next = c + 3 * ((i + 1) % 4);
+			float dx = next[0] - c[3 * i], dy = next[1] - c[3 * i + 1], dz = next[2] - c[3 * i + 2];
+			side += std::sqrt(dx * dx + dy * dy + dz * dz);
+			for (int k = 0; k < 3; k++) {
+				placement.corners[i][k] = c[3 * i + k];
+				center[k] += c[3 * i + k] / 4;
+			}
+		}
+		placement.size = side / 4;
+
+		// The x axis runs from corner 0 to corner 3 and the y axis from corner 1 to corner 0
+		float x[3], y[3], z[3];
+		for (int k = 0; k < 3; k++) {
+			x[k] = c[9 + k] - c[k];
+			y[k] = c[k] - c[3 + k];
+		}
+		float xLen = std::sqrt(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+		if (!(xLen > 0.0f) || !(placement.size < 1e30f)) {
+			return false;
+		}
+		float dot = 0.0f;
+		for (int k = 0; k < 3; k++) {
+			x[k] /= xLen;
+			dot += x[k] * y[k];
+		}
+		for (int k = 0; k < 3; k++) {
+			y[k] -= dot * x[k];
+		}
+		float yLen = std::sqrt(y[0] * y[0] + y[1] * y[1] + y[2] * y[2]);
+		if (!(yLen > 1e-3f * xLen)) {
+			return false;
+		}
+		for (int k = 0; k < 3; k++) {
+			y[k] /= yLen;
+		}
+		z[0] = x[1] * y[2] - x[2] * y[1];
+		z[1] = x[2] * y[0] - x[0] * y[2];
+		z[2] = x[0] * y[1] - x[1] * y[0];
+
+		// The columns of the rotation are the marker axes, the translation is the marker center
+		for (int k = 0; k < 3; k++) {
+			placement.transform[4 * k] = x[k];
+			placement.transform[4 * k + 1] = y[k];
+			placement.transform[4 * k + 2] = z[k];
+			placement.transform[4 * k + 3] = center[k];
+		}
+	}
+
+	markers.swap(layout);
+	hasPrior = false;
+	return true;
+}
+
+
+/*  Returns the position of a marker in the layout
+ *
+ *	@param id: The marker ID
+ *
+ *	@return index: The position of the marker, or -1 if it is not on the board
+ */
+int MarkerBoard::find(int id) const {
+	for (size_t i = 0; i < markers.size(); i++) {
+		if (markers[i].id == id) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+
+/*  Estimates the pose of the board from the markers of the board found in a frame
+ *	All of the corners go into one Levenberg-Marquardt solve, which starts from the board
+ *	pose of the previous frame when it still reprojects within the prior tolerance. Otherwise
+ *	the homography of every marker found gives a board pose and its mirror image, and the
+ *	marker that best fits all of the corners is refined from both, keeping the better result.
+ *	This avoids the flipped pose a single small marker can give, at the price of a second solve
+ *	and a few more iterations on the frames that do not start from the previous pose.
+ *	Everything lives on the stack.
+ *
+ *	@param observations: The markers of the board found in the frame, each at most once
+ *	@param count: The number of observations
+ *	@param fx: The focal length along x in pixels
+ *	@param fy: The focal length along y in pixels
+ *	@param options: The iteration cap and the tolerances of the refinement
+ *	@param warmStart: True to try the board pose of the previous frame first
+ *	@param mat: Container to hold the board pose as a 4x4 matrix in row-major order
+ *	@param boardPose: Container to hold the board pose sent back to the caller
+ *
+ *	@return found: False if no marker of the board was found, or its corners are degenerate
+ */
+bool MarkerBoard::estimate(const BoardObservation* observations, int count, float fx, float fy,
+	const PoseSolver::RefineOptions<float> &options, bool warmStart, float* mat, BoardPose &boardPose) {
+
+	boardPose = BoardPose();
+	count = std::min(count, MAX_MARKERS);
+	if (count <= 0) {
+		hasPrior = false;
+		return false;
+	}
+
+	// Pair the board coordinates of every corner with its image position
+	float points3D[MAX_POINTS][3];
+	float points2D[MAX_POINTS][2];
+	int pointCount = 0;
+	for (int i = 0; i < count; i++) {
+		const Placement &placement = markers[observations[i].index];
+		for (int j = 0; j < 4; j++) {
+			std::copy(placement.corners[j], placement.corners[j] + 3, points3D[pointCount]);
+			points2D[pointCount][0] = observations[i].corners[j].x;
+			points2D[pointCount][1] = observations[i].corners[j].y;
+			pointCount++;
+		}
+	}
+
+	// Keep the previous pose only if it still fits the corners, which also rejects a pose that is not finite
+	float pose[7];
+	float error[2 * MAX_POINTS];
+	float newError[2 * MAX_POINTS];
+	bool warm = false;
+	if (warmStart && hasPrior) {
+		std::copy(prior, prior + 7, pose);
+		float errorSq = PoseSolver::reprojectionError(error, points3D, points2D, pointCount, pose, fx, fy);
+		warm = errorSq <= options.priorTolerance * options.priorTolerance * pointCount;
+	}
+	int iterations;
+	float errorSq;
+	if (warm) {
+		errorSq = PoseSolver::optimizePose(pose, points3D, points2D, pointCount, fx, fy, options, iterations, error, newError);
+	}
+	else {
+
+		// Pick the marker whose homography best fits the whole board
+		float best[2][7];
+		float bestErrorSq = -1.0f;
+		for (int i = 0; i < count; i++) {
+			float candidates[2][7];
+			if (!initialPoses(observations[i], fx, fy, candidates)) {
+				continue;
+			}
+			for (int p = 0; p < 2; p++) {
+				float candidateErrorSq = PoseSolver::reprojectionError(error, points3D, points2D, pointCount, candidates[p], fx, fy);
+				if (bestErrorSq < 0.0f || candidateErrorSq < bestErrorSq) {
+					bestErrorSq = candidateErrorSq;
+					std::copy(candidates[0], candidates[0] + 7, best[0]);
+					std::copy(candidates[1], candidates[1] + 7, best[1]);
+				}
+			}
+		}
+		if (!(bestErrorSq >= 0.0f)) {
+			hasPrior = false;
+			return false;
+		}
+
+		// The two mirrored poses fit about equally before refinement, so both are refined
+		PoseSolver::RefineOptions<float> refine = options;
+		refine.maxIterations = std::max(refine.maxIterations, COLD_START_ITERATIONS);
+		errorSq = PoseSolver::optimizePose(best[0], points3D, points2D, pointCount, fx, fy, refine, iterations, error, newError);
+		float mirroredErrorSq = PoseSolver::optimizePose(best[1], points3D, points2D, pointCount, fx, fy, refine, iterations, error, newError);
+		int kept = (mirroredErrorSq < errorSq) ? 1 : 0;
+		errorSq = std::min(errorSq, mirroredErrorSq);
+		std::copy(best[kept], best[kept] + 7, pose);
+	}
+
+	PoseSolver::poseToMatrix(mat, pose);
+	std::copy(pose, pose + 7, prior);
+	hasPrior = true;
+
+	boardPose.markers = count;
+	boardPose.error = std::sqrt(errorSq / pointCount);
+	boardPose.distance = std::sqrt(mat[3] * mat[3] + mat[7] * mat[7] + mat[11] * mat[11]);
+	boardPose.translate_x = mat[3];
+	boardPose.translate_y = mat[7];
+	boardPose.translate_z = mat[11];
+	boardPose.rotate_11 = mat[0];
+	boardPose.rotate_12 = mat[1];
+	boardPose.rotate_13 = mat[2];
+	boardPose.rotate_21 = mat[4];
+	boardPose.rotate_22 = mat[5];
+	boardPose.rotate_23 = mat[6];
+	boardPose.rotate_31 = mat[8];
+	boardPose.rotate_32 = mat[9];
+	boardPose.rotate_33 = mat[10];
+	return true;
+}
+
+
+/*  Computes the pose of one marker of the board from the pose of the board
+ *
+ *	@param mat: Container to hold the marker pose as a 4x4 matrix in row-major order
+ *	@param index: The position of the marker in the layout
+ *	@param boardMat: The board pose as a 4x4 matrix in row-major order
+ *
+ *	@return void
+ */
+void MarkerBoard::markerPose(float* mat, int index, const float* boardMat) const {
+
+	const float* transform = markers[index].transform;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 4; c++) {
+			float value = (c == 3) ? boardMat[4 * r + 3] : 0.0f;
+			for (int k = 0; k < 3; k++) {
+				value += boardMat[4 * r + k] * transform[4 * k + c];
+			}
+			mat[4 * r + c] = value;
+		}
+	}
+	mat[12] = mat[13] = mat[14] = 0.0f;
+	mat[15] = 1.0f;
+}
+
+
+/*  Computes the board poses implied by the homography of one of its markers
+ *	The marker pose is taken through the inverse of the placement of the marker on the board.
+ *	A square seen nearly face on fits two poses almost equally well, whose normals mirror each
+ *	other about the line of sight, and the homography may give either one. The mirrored pose,
+ *	a half turn about the line of sight after a half turn about the marker normal, is given too.
+ *
+ *	@param observation: The marker to start from
+ *	@param fx: The focal length along x in pixels
+ *	@param fy: The focal length along y in pixels
+ *	@param poses: Container to hold the 7 pose parameters of the board, then of the mirrored board
+ *
+ *	@return valid: False if the corners of the marker are degenerate
+ */
+bool MarkerBoard::initialPoses(const BoardObservation &observation, float fx, float fy, float (*poses)[7]) const {
+
+	const Placement &placement = markers[observation.index];
+	float corners[8];
+	for (int i = 0; i < 4; i++) {
+		corners[2 * i] = observation.corners[i].x;
+		corners[2 * i + 1] = observation.corners[i].y;
+	}
+	float H[9];
+	if (!PoseSolver::squareHomography(H, corners)) {
+		return false;
+	}
+
+	float markerPose[7];
+	float markerMat[16];
+	PoseSolver::poseFromHomography(markerPose, H, placement.size, fx, fy);
+	PoseSolver::poseToMatrix(markerMat, markerPose);
+
+	// The mirrored marker rotation is (2 v v^T - I) R diag(-1, -1, 1), with v along the line of sight
+	float translation[3] = { markerMat[3], markerMat[7], markerMat[11] };
+	float length = std::sqrt(translation[0] * translation[0] + translation[1] * translation[1] + translation[2] * translation[2]);
+	if (!(length > 0.0f)) {
+		return false;
+	}
+	float v[3] = { translation[0] / length, translation[1] / length, translation[2] / length };
+	float markerRotations[2][9];
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			markerRotations[0][3 * r + c] = markerMat[4 * r + c];
+			float mirrored = 0.0f;
+			for (int k = 0; k < 3; k++) {
+				mirrored += (2 * v[r] * v[k] - (r == k ? 1.0f : 0.0f)) * markerMat[4 * k + c];
+			}
+			markerRotations[1][3 * r + c] = (c == 2) ? mirrored : -mirrored;
+		}
+	}
+
+	// Board to camera is marker to camera times board to marker, the transpose of the placement rotation
+	const float* transform = placement.transform;
+	for (int p = 0; p < 2; p++) {
+		const float* markerRotation = markerRotations[p];
+		float R[9];
+		for (int r = 0; r < 3; r++) {
+			for (int c = 0; c < 3; c++) {
+				R[3 * r + c] = 0.0f;
+				for (int k = 0; k < 3; k++) {
+					R[3 * r + c] += markerRotation[3 * r + k] * transform[4 * c + k];
+				}
+			}
+		}
+		for (int r = 0; r < 3; r++) {
+			poses[p][4 + r] = translation[r];
+			for (int k = 0; k < 3; k++) {
+				poses[p][4 + r] -= R[3 * r + k] * transform[4 * k + 3];
+			}
+		}
+		PoseSolver::matrixToQuaternion(R, poses[p]);
+	}
+	return true;
+}
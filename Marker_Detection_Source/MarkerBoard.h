@@ -0,0 +1,81 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for boards of markers with a known layout
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <vector>
+
+/* Helper includes */
+#include "UnityStructs.h"
+#include "PoseSolver.h"
+
+
+/*  One marker of a board found in a frame */
+struct BoardObservation
+{
+	int index;					// Position of the marker in the board layout
+	cv::Point2f corners[4];		// Undistorted corners relative to the principal point with y up, as the pose solver takes them
+};
+
+
+/*  Rigid layout of several markers, such as markers mounted on one fixture.
+ *	The pose of the board is solved once from the corners of all of its visible markers,
+ *	which is steadier than the pose of any one of them, and the pose of each marker of the
+ *	board follows from it. The layout is only replaced while no frame is in flight, so it
+ *	can be read by several validation threads at once.
+ */
+class MarkerBoard
+{
+public:
+	/*  Most markers a board can hold, which bounds the stack space of the solve */
+	static const int MAX_MARKERS = 64;
+
+	MarkerBoard();
+
+	/*  Replaces the layout, returning false and keeping the old one if it is invalid */
+	bool setLayout(const int* ids, const float* corners, int markerCount);
+
+	/*  Tells whether no layout is set */
+	bool empty() const { return markers.empty(); }
+
+	/*  Returns the position of a marker in the layout, or -1 if it is not on the board */
+	int find(int id) const;
+
+	/*  Returns the side length of a marker of the layout */
+	float markerSize(int index) const { return markers[index].size; }
+
+	/*  Forgets the board pose of the previous frame */
+	void reset() { hasPrior = false; }
+
+	/*  Estimates the board pose from the markers of the board found in a frame, returning false if it cannot */
+	bool estimate(const BoardObservation* observations, int count, float fx, float fy,
+		const PoseSolver::RefineOptions<float> &options, bool warmStart, float* mat, BoardPose &boardPose);
+
+	/*  Computes the pose of one marker of the board from the pose of the board */
+	void markerPose(float* mat, int index, const float* boardMat) const;
+
+private:
+	/*  Placement of one marker on the board */
+	struct Placement
+	{
+		int id;					// Marker ID
+		float corners[4][3];	// Corners in board coordinates, in the order of the corners of a lone marker
+		float transform[12];	// Marker to board transformation as a 3x4 matrix in row-major order
+		float size;				// Side length of the marker
+	};
+
+	/*  Computes the board pose implied by the homography of one of its markers, and its mirror image */
+	bool initialPoses(const BoardObservation &observation, float fx, float fy, float (*poses)[7]) const;
+
+	std::vector<Placement> markers;		// Layout of the board
+	float prior[7];						// Board pose of the previous frame, only touched while collecting markers
+	bool hasPrior;						// True if prior holds a pose
+};
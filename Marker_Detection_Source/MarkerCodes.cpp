@@ -0,0 +1,112 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Marker code lookup table
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <vector>
+
+/* Helper includes */
+#include "MarkerCodes.h"
+
+
+/* Number of distinct 16-bit cell patterns */
+static const int PATTERN_COUNT = 1 << 16;
+
+
+/*  Rotates a raw cell pattern by a quarter turn, as getMarkerIDs does for codes[1]
+ *	Bit i of a pattern is the cell in row i / 4 and column 3 - i % 4 of the inner grid.
+ *
+ *	@param pattern: The raw cell pattern
+ *
+ *	@return rotated: The pattern of the marker turned by a quarter
+ */
+static int rotatePattern(int pattern) {
+	int rotated = 0;
+	for (int i = 0; i < 16; i++) {
+		int row = i >> 2;
+		int col = i & 3;
+		rotated |= ((pattern >> ((3 - col) * 4 + row)) & 1) << i;
+	}
+	return rotated;
+}
+
+
+/*  Builds the entry of every cell pattern
+ *	Ties between rotations go to the earliest one, like correctCornerOrder.
+ *
+ *	@return table: The ID, rotation and validity of each pattern
+ */
+static std::vector<MarkerCode> buildMarkerCodeTable() {
+
+	std::vector<MarkerCode> table(PATTERN_COUNT);
+	for (int pattern = 0; pattern < PATTERN_COUNT; pattern++) {
+		int code = pattern;
+		int rotation = 0;
+		int rotated = pattern;
+		for (int r = 1; r < 4; r++) {
+			rotated = rotatePattern(rotated);
+			if (rotated < code) {
+				code = rotated;
+				rotation = r;
+			}
+		}
+
+		table[pattern].id = (unsigned short)code;
+		table[pattern].rotation = (unsigned char)rotation;
+		table[pattern].valid = (pattern != 0 && pattern != 0xffff);
+	}
+	return table;
+}
+
+
+/*  Returns the table of all 65536 cell patterns
+ *	The table is built once, the first time any thread asks for it.
+ *
+ *	@return table: Entries indexed by the raw cell pattern
+ */
+const MarkerCode* markerCodeTable() {
+	static const std::vector<MarkerCode> table = buildMarkerCodeTable();
+	return table.data();
+}
+
+
+/*  Packs the inner 4x4 cells of a thresholded 6x6 marker into a raw cell pattern
+ *	Black cells are ones, in the bit order of codes[0] from getMarkerIDs.
+ *
+ *	@param planarMarker: The thresholded 6x6 marker
+ *
+ *	@return pattern: The raw 16-bit cell pattern
+ */
+int packMarkerCells(const cv::Mat &planarMarker) {
+	int pattern = 0;
+	for (int row = 0; row < 4; row++) {
+		const uchar* cells = planarMarker.ptr<uchar>(row + 1);
+		for (int col = 0; col < 4; col++) {
+			pattern |= (cells[col + 1] == 0) << (row * 4 + 3 - col);
+		}
+	}
+	return pattern;
+}
+
+
+/*  Reorders the corners so that the first one matches the rotation of the marker ID
+ *
+ *	@param corners: The corners of the marker, reordered in place
+ *	@param rotation: The rotation from the code table
+ *
+ *	@return void
+ */
+void rotateCorners(cv::Point2f* corners, int rotation) {
+	if (rotation != 0) {
+		cv::Point2f rotated[4];
+		for (int i = 0; i < 4; i++) rotated[(i + rotation) % 4] = corners[i];
+		for (int i = 0; i < 4; i++) corners[i] = rotated[i];
+	}
+}
@@ -0,0 +1,35 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the marker code lookup table
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+
+/*  Decoded meaning of one raw 16-bit cell pattern */
+struct MarkerCode
+{
+	unsigned short id;			// Smallest code over the four rotations, reported as the marker ID
+	unsigned char rotation;		// Rotation that gives the ID, as used to reorder the corners
+	unsigned char valid;		// Zero for the all black and all white patterns
+};
+
+
+/*  Returns the table of all 65536 cell patterns, built on first use */
+const MarkerCode* markerCodeTable();
+
+/*  Looks up the ID, rotation and validity of a raw cell pattern */
+inline const MarkerCode &lookupMarkerCode(int pattern) {
+	return markerCodeTable()[pattern & 0xffff];
+}
+
+/*  Packs the inner 4x4 cells of a thresholded 6x6 marker into a raw cell pattern */
+int packMarkerCells(const cv::Mat &planarMarker);
+
+/*  Reorders the corners so that the first one matches the rotation of the marker ID */
+void rotateCorners(cv::Point2f* corners, int rotation);
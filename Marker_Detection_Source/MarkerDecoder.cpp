@@ -0,0 +1,222 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Direct marker cell decoder
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <cmath>
+
+/* Helper includes */
+#include "MarkerDecoder.h"
+#include "KernelDispatch.h"
+
+
+/* Number of cells along each side of a marker, including the border */
+static const int MARKER_CELLS = 6;
+
+/* Cells of the border in the order they are checked, as row and column */
+static const int BORDER_CELLS[20][2] = {
+	{ 0, 0 }, { 0, 1 }, { 0, 2 }, { 0, 3 }, { 0, 4 }, { 0, 5 },
+	{ 5, 0 }, { 5, 1 }, { 5, 2 }, { 5, 3 }, { 5, 4 }, { 5, 5 },
+	{ 1, 0 }, { 2, 0 }, { 3, 0 }, { 4, 0 },
+	{ 1, 5 }, { 2, 5 }, { 3, 5 }, { 4, 5 }
+};
+
+
+#ifndef MARKER_ISA_VARIANT
+/*  Finds the homography that maps the unit square onto a quad
+ *	Uses the closed form of Heckbert for the square to quad case, so no linear system
+ *	has to be solved. The corners (0, 0), (1, 0), (1, 1) and (0, 1) map onto corners 0 to 3.
+ *
+ *	@param corners: The four corners of the quad
+ *	@param H: Container to hold the 3x3 homography in row-major order
+ *
+ *	@return valid: False if the quad is degenerate
+ */
+bool squareToQuad(const cv::Point2f* corners, double* H) {
+
+	double x0 = corners[0].x, y0 = corners[0].y;
+	double x1 = corners[1].x, y1 = corners[1].y;
+	double x2 = corners[2].x, y2 = corners[2].y;
+	double x3 = corners[3].x, y3 = corners[3].y;
+
+	// The perspective terms vanish when the quad is a parallelogram
+	double sx = x0 - x1 + x2 - x3;
+	double sy = y0 - y1 + y2 - y3;
+	double dx1 = x1 - x2, dx2 = x3 - x2;
+	double dy1 = y1 - y2, dy2 = y3 - y2;
+	double det = dx1 * dy2 - dx2 * dy1;
+	if (!(std::fabs(det) > 1e-12)) {
+		return false;
+	}
+
+	double g = (sx * dy2 - dx2 * sy) / det;
+	double h = (dx1 * sy - sx * dy1) / det;
+	H[0] = x1 - x0 + g * x1;
+	H[1] = x3 - x0 + h * x3;
+	H[2] = x0;
+	H[3] = y1 - y0 + g * y1;
+	H[4] = y3 - y0 + h * y3;
+	H[5] = y0;
+	H[6] = g;
+	H[7] = h;
+	H[8] = 1.0;
+	return true;
+}
+#endif
+
+
+namespace MARKER_ISA {
+
+
+/*  Returns a pixel of the image, or black outside of it like BORDER_CONSTANT
+ *
+ *	@param gray_frame: The grayscale image
+ *	@param x: The column of the pixel
+ *	@param y: The row of the pixel
+ *
+ *	@return value: The pixel value
+ */
+static inline int pixelOrBlack(const cv::Mat &gray_frame, int x, int y) {
+	if (x < 0 || y < 0 || x >= gray_frame.cols || y >= gray_frame.rows) {
+		return 0;
+	}
+	return gray_frame.ptr<uchar>(y)[x];
+}
+
+
+/*  Tells whether the cell at a marker position is white
+ *	The cell centre is mapped into the image and interpolated bilinearly, then rounded
+ *	and compared with the threshold, as warpPerspective followed by threshold would do.
+ *
+ *	@param gray_frame: The grayscale image
+ *	@param H: The homography from the unit square onto the marker
+ *	@param row: The row of the cell
+ *	@param col: The column of the cell
+ *	@param cellThreshold: Values above this are white
+ *
+ *	@return white: True if the cell is white
+ */
+static inline bool cellIsWhite(const cv::Mat &gray_frame, const double* H, int row, int col, int cellThreshold) {
+
+	// Centre of the cell in the unit square
+	double u = (col + 0.5) / MARKER_CELLS;
+	double v = (row + 0.5) / MARKER_CELLS;
+	double w = 1.0 / (H[6] * u + H[7] * v + H[8]);
+	float x = (float)((H[0] * u + H[1] * v + H[2]) * w);
+	float y = (float)((H[3] * u + H[4] * v + H[5]) * w);
+
+	// A cell whose centre projects to nowhere cannot be read
+	if (!(std::fabs(x) < 1e6f && std::fabs(y) < 1e6f)) {
+		return true;
+	}
+
+	int ix = (int)std::floor(x);
+	int iy = (int)std::floor(y);
+	float fx = x - ix;
+	float fy = y - iy;
+
+	// Read the four neighbours directly when they are all inside the image
+	int p00, p01, p10, p11;
+	if (ix >= 0 && iy >= 0 && ix + 1 < gray_frame.cols && iy + 1 < gray_frame.rows) {
+		const uchar* top = gray_frame.ptr<uchar>(iy) + ix;
+		const uchar* bottom = gray_frame.ptr<uchar>(iy + 1) + ix;
+		p00 = top[0];
+		p01 = top[1];
+		p10 = bottom[0];
+		p11 = bottom[1];
+	}
+	else {
+		p00 = pixelOrBlack(gray_frame, ix, iy);
+		p01 = pixelOrBlack(gray_frame, ix + 1, iy);
+		p10 = pixelOrBlack(gray_frame, ix, iy + 1);
+		p11 = pixelOrBlack(gray_frame, ix + 1, iy + 1);
+	}
+
+	float top = p00 + (p01 - p00) * fx;
+	float bottom = p10 + (p11 - p10) * fx;
+	int value = (int)(top + (bottom - top) * fy + 0.5f);
+	return value > cellThreshold;
+}
+
+
+/*  Samples the 6x6 cells of a marker straight from the image
+ *	Replaces warping the marker into a 6x6 image, thresholding it and reading it back.
+ *	The border cells are read first, stopping at the first white one, so most false
+ *	quads cost only a few samples. The inner cells are then packed into the raw pattern
+ *	used by the code table, with black cells as ones.
+ *	Kernel for the level of this namespace, reached through activeKernels.
+ *
+ *	@param gray_frame: The grayscale image
+ *	@param corners: The refined corners of the marker
+ *	@param cellThreshold: Values above this are white
+ *	@param pattern: Container to hold the raw 16-bit cell pattern
+ *
+ *	@return valid: False if the border is not black
+ */
+static bool decodeMarkerCells(const cv::Mat &gray_frame, const cv::Point2f* corners, int cellThreshold, int &pattern) {
+
+	double H[9];
+	if (!squareToQuad(corners, H)) {
+		return false;
+	}
+
+	// Check if the border is black for a valid marker
+	for (int i = 0; i < 20; i++) {
+		if (cellIsWhite(gray_frame, H, BORDER_CELLS[i][0], BORDER_CELLS[i][1], cellThreshold)) {
+			return false;
+		}
+	}
+
+	// Pack the inner cells in the bit order of getMarkerIDs
+	pattern = 0;
+	for (int row = 0; row < 4; row++) {
+		for (int col = 0; col < 4; col++) {
+			if (!cellIsWhite(gray_frame, H, row + 1, col + 1, cellThreshold)) {
+				pattern |= 1 << (row * 4 + 3 - col);
+			}
+		}
+	}
+
+	return true;
+}
+
+
+/*  Fills a table with the marker decoding kernel of this level
+ *
+ *	@param table: Container to hold the kernels
+ *
+ *	@return void
+ */
+void fillDecoderKernels(KernelTable &table) {
+	table.decodeMarkerCells = decodeMarkerCells;
+}
+
+}
+
+
+#ifndef MARKER_ISA_VARIANT
+/*  Samples the 6x6 cells of a marker straight from the image
+ *	Replaces warping the marker into a 6x6 image, thresholding it and reading it back.
+ *	The border cells are read first, stopping at the first white one, so most false
+ *	quads cost only a few samples. The inner cells are then packed into the raw pattern
+ *	used by the code table, with black cells as ones.
+ *	Runs the kernel chosen for this processor, see activeKernels.
+ *
+ *	@param gray_frame: The grayscale image
+ *	@param corners: The refined corners of the marker
+ *	@param cellThreshold: Values above this are white
+ *	@param pattern: Container to hold the raw 16-bit cell pattern
+ *
+ *	@return valid: False if the border is not black
+ */
+bool decodeMarkerCells(const cv::Mat &gray_frame, const cv::Point2f* corners, int cellThreshold, int &pattern) {
+	return activeKernels().decodeMarkerCells(gray_frame, corners, cellThreshold, pattern);
+}
+#endif
@@ -0,0 +1,18 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the direct marker cell decoder
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+
+/*  Finds the homography that maps the unit square onto a quad, in closed form */
+bool squareToQuad(const cv::Point2f* corners, double* H);
+
+/*  Samples the 6x6 cells of a marker straight from the image, returning false if its border is not black */
+bool decodeMarkerCells(const cv::Mat &gray_frame, const cv::Point2f* corners, int cellThreshold, int &pattern);
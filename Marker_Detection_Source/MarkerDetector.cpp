@@ -0,0 +1,1002 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Persistent marker detector
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+/* Helper function includes */
+#include "MarkerDetector.h"
+#include "PoseEstimation.h"
+#include "PoseBatch.h"
+#include "MarkerHelpers.h"
+#include "MarkerCodes.h"
+#include "MarkerDecoder.h"
+#include "EdgeRefinement.h"
+#include "ColorConversion.h"
+#include "ImageInput.h"
+#include "ThreadPool.h"
+
+
+/* Deepest pyramid level used for the quad search (8 times downsampled) */
+static const int MAX_PYRAMID_LEVELS = 3;
+
+
+/*  Fills in the default detector configuration
+ *	FindMarkers2 and FindMarkersInImage start from these, but refine every pose from scratch with
+ *	three full iterations as they always have, and FindMarkers2 also draws the overlay.
+ *
+ *	@param config: The configuration to fill in
+ *
+ *	@return void
+ */
+void getDefaultConfig(DetectorConfig &config) {
+	config.binaryThreshold = 105;
+	config.cellThreshold = 100;
+	config.minMarkerArea = 1000.0f;
+	config.markerSize = 4.5f;
+	config.parallelCandidates = 1;
+	config.trackingMode = 0;
+	config.reacquireInterval = 30;
+	config.trackingMargin = 0.5f;
+	config.pyramidLevels = 0;
+	config.collectStats = 0;
+	config.suppressDuplicates = 1;
+	config.minContourPoints = 4;
+	config.maxAspectRatio = 10.0f;
+	config.maxMarkerPerimeter = 0.0f;
+	config.runLengthExtraction = 0;
+	config.drawOverlay = 0;
+
+	// Focal length that has always been assumed, with the principal point at the image center
+	config.camera.focalX = 400.0f;
+	config.camera.focalY = 400.0f;
+	config.camera.principalX = -1.0f;
+	config.camera.principalY = -1.0f;
+	for (int i = 0; i < 5; i++) {
+		config.camera.distortion[i] = 0.0f;
+	}
+
+	// The refinement never runs more iterations than it always has, but stops once it converges
+	config.poseIterations = 3;
+	config.poseErrorTolerance = 0.02f;
+	config.poseStepTolerance = 1e-3f;
+	config.warmStartPose = 1;
+	config.warmStartTolerance = 2.0f;
+
+	// Solving the markers of a frame together gives the same poses as solving them one at a time
+	config.batchPose = 1;
+
+	// Refining on the shared gradient image moves the corners by a fraction of a pixel, so it is opt-in
+	config.gradientRefinement = 0;
+}
+
+
+/*  Derives the contour filter limits from the configuration
+ *
+ *	@param config: The detector parameters
+ *	@param scale: How many times smaller the searched image is than the frame
+ */
+ContourLimits::ContourLimits(const DetectorConfig &config, int scale) {
+
+	// The minimum area shrinks with the square of the downsampling
+	minArea = config.minMarkerArea / (double)(scale * scale);
+
+	// A quad of that area is at least as long as a square, and the contour around it is longer still
+	minPerimeter = 4.0 * std::sqrt(minArea);
+	maxPerimeter = config.maxMarkerPerimeter > 0.0f ? config.maxMarkerPerimeter / scale : DBL_MAX;
+	maxAspectRatio = config.maxAspectRatio > 0.0f ? config.maxAspectRatio : DBL_MAX;
+	minPoints = std::max(config.minContourPoints, 4);
+}
+
+
+/*  Decides whether a contour could be a marker, trying the cheap tests first
+ *	The point count, bounding box and minimum perimeter tests are exact bounds, so they
+ *	never reject a contour that the polygon test would accept. Only the survivors go
+ *	through arcLength, approxPolyDP and the convexity test.
+ *
+ *	@param contour: The points of the contour to test
+ *	@param length: The number of points
+ *	@param limits: The thresholds of each test
+ *	@param polygon: Container to hold the quad, if accepted
+ *
+ *	@return stage: CONTOUR_ACCEPTED, or the test that rejected the contour
+ */
+int filterContour(const cv::Point* contour, int length, const ContourLimits &limits, std::vector<cv::Point> &polygon) {
+
+	// A quad needs at least four points
+	if (length < limits.minPoints) {
+		return CONTOUR_POINT_COUNT;
+	}
+
+	// Header over the points, which OpenCV reads as it would a vector of them
+	const cv::Mat points(length, 1, CV_32SC2, (void*)contour);
+
+	// The polygon lies within the bounding box, so the box bounds its area
+	cv::Rect box = cv::boundingRect(points);
+	double boxWidth = box.width - 1;
+	double boxHeight = box.height - 1;
+	if (boxWidth * boxHeight < limits.minArea) {
+		return CONTOUR_BOUNDING_BOX;
+	}
+
+	// Thin slivers such as lines and text strokes cannot be markers
+	if (std::max(boxWidth, boxHeight) > limits.maxAspectRatio * std::min(boxWidth, boxHeight)) {
+		return CONTOUR_ASPECT_RATIO;
+	}
+
+	double perimeter = cv::arcLength(points, true);
+	if (perimeter < limits.minPerimeter || perimeter > limits.maxPerimeter) {
+		return CONTOUR_PERIMETER;
+	}
+
+	// Approximate contour to polygon with accuracy proportional to contour perimeter
+	cv::approxPolyDP(points, polygon, perimeter * 0.02, true);
+
+	// We ignore the polygon if it is too small, is nonconvex, or does not have 4 sides
+	if (polygon.size() != 4 || fabs(cv::contourArea(polygon)) < limits.minArea || !cv::isContourConvex(polygon)) {
+		return CONTOUR_POLYGON;
+	}
+
+	return CONTOUR_ACCEPTED;
+}
+
+
+/*  Creates a detector with the default configuration
+ *	No buffers are allocated until the first frame is processed.
+ */
+MarkerDetector::MarkerDetector() {
+	getDefaultConfig(config);
+
+	// Build the code table now rather than while timing the first frame
+	markerCodeTable();
+}
+
+
+/*  Creates a detector with the given configuration
+ *	No buffers are allocated until the first frame is processed.
+ *
+ *	@param initialConfig: The detector parameters
+ */
+MarkerDetector::MarkerDetector(const DetectorConfig &initialConfig) : config(initialConfig) {
+	markerCodeTable();
+}
+
+
+/*  Replaces the detector configuration
+ *
+ *	@param newConfig: The new detector parameters
+ *
+ *	@return void
+ */
+void MarkerDetector::configure(const DetectorConfig &newConfig) {
+	config = newConfig;
+	tracker.reset();
+	poseHistory.reset();
+	board.reset();
+}
+
+
+/*  Replaces the layout of the marker board
+ *	Markers of the board then share one pose solve per frame, read with getBoardPose,
+ *	and their own poses follow from the board pose. Must not be called while a frame is in flight.
+ *
+ *	@param ids: The ID of each marker on the board, or NULL with a count of 0 to remove the board
+ *	@param corners: The board coordinates of the four corners of each marker, 12 values per marker
+ *	@param markerCount: The number of markers on the board
+ *
+ *	@return valid: False if the layout is invalid, in which case the previous one is kept
+ */
+bool MarkerDetector::setBoard(const int* ids, const float* corners, int markerCount) {
+	return board.setLayout(ids, corners, markerCount);
+}
+
+
+/*  Finds and locates the markers in an RGBA image
+ *	Candidates are validated in parallel, but markers are reported in contour order,
+ *	so the output is the same as validating them one after the other.
+ *	The input image is only written to if drawOverlay is set, to draw the marker outlines.
+ *
+ *	@param outMarks: Array to hold a Marker2 for each marker detected in the image
+ *	@param maxOutMarkerCount: The maximum number of markers to be found in the image
+ *	@param raw: The raw colour image that we want to locate markers in
+ *	@param width: The width of the input image
+ *	@param height: The height of the input image
+ *
+ *	@return outMarkerDetected: The number of markers detected in the image
+ */
+int MarkerDetector::detect(Marker2* outMarks, int maxOutMarkerCount, Color32* raw, int width, int height) {
+	return detect(outMarks, maxOutMarkerCount, describeRgbaImage(raw, width, height));
+}
+
+
+/*  Finds and locates the markers in an image of any supported pixel format
+ *	Grayscale and NV12 or NV21 images are searched directly in their Y plane without
+ *	any copy, the other formats are converted to grayscale first.
+ *
+ *	@param outMarks: Array to hold a Marker2 for each marker detected in the image
+ *	@param maxOutMarkerCount: The maximum number of markers to be found in the image
+ *	@param image: The description of the input image
+ *
+ *	@return outMarkerDetected: The number of markers detected in the image
+ */
+int MarkerDetector::detect(Marker2* outMarks, int maxOutMarkerCount, const ImageDescriptor &image) {
+
+	// If there is nowhere to put the markers, we return
+	if (maxOutMarkerCount <= 0) {
+		return 0;
+	}
+
+	if (!extractCandidates(syncFrame, image)) {
+		return 0;
+	}
+
+	validateCandidates(syncFrame);
+	return collectMarkers(syncFrame, outMarks, maxOutMarkerCount);
+}
+
+
+/*  Stage 1: converts the input and finds the quads that could be markers
+ *
+ *	@param frame: The frame state to fill in
+ *	@param raw: The raw colour image that we want to locate markers in
+ *	@param width: The width of the input image
+ *	@param height: The height of the input image
+ *
+ *	@return valid: False if there is nothing in the input image
+ */
+bool MarkerDetector::extractCandidates(FrameState &frame, Color32* raw, int width, int height) {
+	return extractCandidates(frame, describeRgbaImage(raw, width, height));
+}
+
+
+/*  Stage 1: converts the input and finds the quads that could be markers
+ *	The input is only wrapped, the grayscale image is either its Y plane or converted into
+ *	a buffer of the frame.
+ *
+ *	@param frame: The frame state to fill in
+ *	@param image: The description of the input image
+ *
+ *	@return valid: False if there is nothing in the input image
+ */
+bool MarkerDetector::extractCandidates(FrameState &frame, const ImageDescriptor &image) {
+
+	frame.contours.reset();
+	frame.candidates.clear();
+	frame.results.clear();
+	frame.stats.clear();
+	frame.rgba_frame.release();
+	frame.board = BoardPose();
+
+	// Wrap the input image as a cv::Mat without copying it, returning if there is nothing in it
+	if (!wrapImage(image, frame.input_frame)) {
+		frame.input_frame.release();
+		return false;
+	}
+	frame.format = image.format;
+	int width = image.width;
+	int height = image.height;
+
+	// The camera model is only rebuilt when the calibration or the frame size changes.
+	// Frames still being validated keep the model they started with.
+	if (!camera || !camera->matches(config.camera, width, height)) {
+		camera = std::make_shared<CameraModel>(config.camera, width, height);
+	}
+	frame.camera = camera;
+
+	// The input is read-only unless outlines are requested, and those are only drawn into colour images
+	if (config.drawOverlay && formatHasColour(image.format)) {
+		frame.rgba_frame = frame.input_frame;
+	}
+
+	// The grayscale image is the Y plane itself when there is one, so it is never written to
+	if (formatHasLumaPlane(image.format)) {
+		frame.gray_frame = frame.input_frame;
+	}
+	else {
+		frame.gray_buffer.create(height, width, CV_8UC1);
+		frame.gray_frame = frame.gray_buffer;
+	}
+
+	// The clock is only read when statistics are requested
+	bool timing = config.collectStats != 0;
+	double start = timing ? statsClockMs() : 0.0;
+
+	// The run-length extractor thresholds the grayscale image itself
+	bool runLength = config.runLengthExtraction != 0;
+
+	// In tracking mode we may only have to look around the markers of the previous frames
+	frame.fullScan = !config.trackingMode || tracker.planSearch(width, height, config, frame.searchRegions);
+
+	if (frame.fullScan && config.pyramidLevels > 0) {
+
+		// Search for quads on a downsampled image, the refinement still uses the full resolution image
+		int scale = 1 << std::min(config.pyramidLevels, MAX_PYRAMID_LEVELS);
+		double convertStart = timing ? statsClockMs() : 0.0;
+		convertRegion(frame, cv::Rect(0, 0, width, height), false);
+		cv::resize(frame.gray_frame, frame.pyramid_gray, cv::Size(width / scale, height / scale), 0, 0, cv::INTER_AREA);
+		if (!runLength) {
+			cv::threshold(frame.pyramid_gray, frame.pyramid_binary, config.binaryThreshold, 255, cv::THRESH_BINARY);
+		}
+		if (timing) {
+			frame.stats.stageMs[STAGE_CONVERSION] += statsClockMs() - convertStart;
+		}
+		if (runLength) {
+			findRunLengthCandidates(frame, frame.pyramid_gray, cv::Point(0, 0), scale);
+		}
+		else {
+			findCandidates(frame, frame.pyramid_binary, cv::Point(0, 0), scale);
+		}
+	}
+	else if (frame.fullScan) {
+
+		// We find the grayscale image and binarize it, reusing the buffers of the previous frame
+		if (!runLength) {
+			frame.binary_im.create(height, width, CV_8UC1);
+		}
+		double convertStart = timing ? statsClockMs() : 0.0;
+		convertRegion(frame, cv::Rect(0, 0, width, height), !runLength);
+		if (timing) {
+			frame.stats.stageMs[STAGE_CONVERSION] += statsClockMs() - convertStart;
+		}
+
+		// We then find the quads that could be markers
+		if (runLength) {
+			findRunLengthCandidates(frame, frame.gray_frame, cv::Point(0, 0), 1);
+		}
+		else {
+			findCandidates(frame, frame.binary_im, cv::Point(0, 0), 1);
+		}
+	}
+	else {
+
+		// Only convert, binarize and search the regions around the tracked markers
+		if (!runLength) {
+			frame.binary_im.create(height, width, CV_8UC1);
+		}
+		for (size_t r = 0; r < frame.searchRegions.size(); r++) {
+			const cv::Rect &region = frame.searchRegions[r];
+			double convertStart = timing ? statsClockMs() : 0.0;
+			convertRegion(frame, region, !runLength);
+			if (timing) {
+				frame.stats.stageMs[STAGE_CONVERSION] += statsClockMs() - convertStart;
+			}
+			if (runLength) {
+				findRunLengthCandidates(frame, frame.gray_frame(region), region.tl(), 1);
+			}
+			else {
+				cv::Mat binaryRegion = frame.binary_im(region);
+				findCandidates(frame, binaryRegion, region.tl(), 1);
+			}
+		}
+	}
+
+	frame.stats.quadsPassed = (int)frame.candidates.size();
+
+	// Drop the quads found more than once before any of them is validated
+	if (config.suppressDuplicates) {
+		double filterStart = timing ? statsClockMs() : 0.0;
+		float cellSize = std::max(std::sqrt(config.minMarkerArea), 8.0f);
+		frame.stats.duplicatesSuppressed = frame.duplicateFilter.filter(frame.candidates, cellSize);
+		if (timing) {
+			frame.stats.stageMs[STAGE_POLYGON_FILTER] += statsClockMs() - filterStart;
+		}
+	}
+
+	if (timing) {
+		frame.stats.stageMs[STAGE_TOTAL] += statsClockMs() - start;
+	}
+	return true;
+}
+
+
+/*  Stage 2: refines, decodes and estimates the pose of every candidate
+ *	Candidates are spread over the thread pool if enabled. With gradientRefinement, the
+ *	gradients they read are computed first, and with batchPose, the poses are solved
+ *	afterwards for all of the markers together.
+ *
+ *	@param frame: The frame state holding the candidates
+ *
+ *	@return void
+ */
+void MarkerDetector::validateCandidates(FrameState &frame) {
+
+	double start = config.collectStats ? statsClockMs() : 0.0;
+	frame.results.resize(frame.candidates.size());
+	if (config.gradientRefinement) {
+		computeGradients(frame);
+	}
+
+	// The candidates read the previous poses from the frame's own copy, without locking
+	if (config.warmStartPose) {
+		poseHistory.snapshot(frame.priorPoses);
+	}
+
+	auto validate = [this, &frame](int i, int) {
+		processCandidate(frame, frame.candidates[i], frame.results[i]);
+	};
+
+	if (config.parallelCandidates) {
+		ThreadPool::shared().parallelFor((int)frame.candidates.size(), validate);
+	}
+	else {
+		for (int i = 0; i < (int)frame.candidates.size(); i++) {
+			validate(i, 0);
+		}
+	}
+
+	if (config.batchPose) {
+		estimatePoses(frame);
+	}
+
+	if (config.collectStats) {
+		frame.stats.stageMs[STAGE_TOTAL] += statsClockMs() - start;
+	}
+}
+
+
+/*  Stage 3: reports the valid markers in contour order and draws their outlines if requested
+ *	Also records the statistics of the frame if they are being collected.
+ *
+ *	@param frame: The frame state holding the validated candidates
+ *	@param outMarks: Array to hold a Marker2 for each marker detected in the image
+ *	@param maxOutMarkerCount: The maximum number of markers to be reported
+ *
+ *	@return outMarkerDetected: The number of markers reported
+ */
+int MarkerDetector::collectMarkers(FrameState &frame, Marker2* outMarks, int maxOutMarkerCount) {
+
+	double start = config.collectStats ? statsClockMs() : 0.0;
+	if (!board.empty()) {
+		estimateBoard(frame);
+	}
+
+	int outMarkerDetected = 0;
+	for (size_t i = 0; i < frame.results.size() && outMarkerDetected < maxOutMarkerCount; i++) {
+		if (!frame.results[i].valid) {
+			continue;
+		}
+
+		// We draw the edges of the marker directly on the colour image for display when returned,
+		// which only touches the pixels under the lines. Green is the second channel of both RGBA and
+		// BGRA, and the fourth makes the lines opaque, while the other pixels keep the caller's alpha.
+		if (!frame.rgba_frame.empty()) {
+			const cv::Point2f* corners = frame.results[i].corners;
+			const cv::Scalar green(0, 255, 0, 255);
+			cv::line(frame.rgba_frame, corners[0], corners[1], green, 2, 8, 0);
+			cv::line(frame.rgba_frame, corners[1], corners[2], green, 2, 8, 0);
+			cv::line(frame.rgba_frame, corners[2], corners[3], green, 2, 8, 0);
+			cv::line(frame.rgba_frame, corners[3], corners[0], green, 2, 8, 0);
+		}
+
+		outMarks[outMarkerDetected] = frame.results[i].marker;
+		outMarkerDetected++;
+	}
+
+	// Remember where every marker was, including those beyond the requested count
+	if (config.trackingMode) {
+		for (size_t i = 0; i < frame.results.size(); i++) {
+			if (frame.results[i].valid) {
+				tracker.update(frame.results[i].marker.id, frame.results[i].corners);
+			}
+		}
+		tracker.endFrame(frame.fullScan);
+	}
+
+	// Keep the pose of every marker to start the next frame from, including those beyond the requested count.
+	// Markers of the board start from the board pose instead.
+	if (config.warmStartPose) {
+		for (size_t i = 0; i < frame.results.size(); i++) {
+			if (frame.results[i].valid && frame.results[i].boardIndex < 0) {
+				poseHistory.add(frame.results[i].marker.id, frame.results[i].pose);
+			}
+		}
+		poseHistory.endFrame();
+	}
+
+	if (config.collectStats) {
+
+		// Per-candidate timings are summed, so with parallel validation they can exceed the frame time
+		FrameStats &stats = frame.stats;
+		for (size_t i = 0; i < frame.results.size(); i++) {
+			const CandidateResult &result = frame.results[i];
+			stats.stageMs[STAGE_REFINEMENT] += result.refineMs;
+			stats.stageMs[STAGE_DECODING] += result.decodeMs;
+			stats.stageMs[STAGE_POSE] += result.poseMs;
+			stats.borderRejects += (result.rejection == REJECT_BORDER);
+			stats.codeRejects += (result.rejection == REJECT_CODE);
+		}
+		stats.markersEmitted = outMarkerDetected;
+		stats.stageMs[STAGE_TOTAL] += statsClockMs() - start;
+		recorder.record(stats);
+	}
+
+	return outMarkerDetected;
+}
+
+
+/*  Fills in the grayscale image of a region of the frame, and its binary image if requested
+ *	Formats with a Y plane are already grayscale and only need thresholding, the others are
+ *	converted and thresholded in a single pass.
+ *
+ *	@param frame: The frame state holding the wrapped input and the output images
+ *	@param region: The region of the frame to convert
+ *	@param binarize: True to also fill in the binary image
+ *
+ *	@return void
+ */
+void MarkerDetector::convertRegion(FrameState &frame, const cv::Rect &region, bool binarize) {
+
+	cv::Mat binaryRegion;
+	if (binarize) {
+		binaryRegion = frame.binary_im(region);
+	}
+
+	if (formatHasLumaPlane(frame.format)) {
+		if (binarize) {
+			cv::threshold(frame.gray_frame(region), binaryRegion, config.binaryThreshold, 255, cv::THRESH_BINARY);
+		}
+		return;
+	}
+
+	cv::Mat grayRegion = frame.gray_frame(region);
+	convertToGray(frame.input_frame(region), frame.format, grayRegion, binarize ? &binaryRegion : NULL, config.binaryThreshold);
+}
+
+
+/*  Finds the quads in a binary image that could be markers
+ *	Candidates are appended in contour order, in full resolution image coordinates.
+ *	The binary image may be a region of the frame, or a downsampled version of it.
+ *
+ *	@param frame: The frame state to add the candidates to
+ *	@param binary: The binary image to search
+ *	@param offset: The position of the binary image in the frame
+ *	@param scale: How many times smaller the binary image is than the frame
+ *
+ *	@return void
+ */
+void MarkerDetector::findCandidates(FrameState &frame, cv::Mat &binary, const cv::Point &offset, int scale) {
+
+	bool timing = config.collectStats != 0;
+	double start = timing ? statsClockMs() : 0.0;
+
+	// We find the contours from the binary image, after those of the regions already searched
+	ContourArena &contours = frame.contours;
+	int first = contours.size();
+	frame.stats.contoursFound += contours.findContours(binary, offset);
+
+	double filterStart = timing ? statsClockMs() : 0.0;
+	if (timing) {
+		frame.stats.stageMs[STAGE_CONTOURS] += filterStart - start;
+	}
+
+	// The limits shrink with the downsampling
+	ContourLimits limits(config, scale);
+
+	// We then process each contour individually, reading them in sequence from the arena
+	std::vector<cv::Point> &polygon = frame.polygon;
+	FrameStats &stats = frame.stats;
+	for (int i = first; i < contours.size(); i++) {
+
+		// Count where the contour left the cascade, if it did
+		switch (filterContour(contours.contour(i), contours.length(i), limits, polygon)) {
+		case CONTOUR_ACCEPTED:
+			break;
+		case CONTOUR_POINT_COUNT:
+			stats.rejectedPointCount++;
+			continue;
+		case CONTOUR_BOUNDING_BOX:
+			stats.rejectedBoundingBox++;
+			continue;
+		case CONTOUR_ASPECT_RATIO:
+			stats.rejectedAspectRatio++;
+			continue;
+		case CONTOUR_PERIMETER:
+			stats.rejectedPerimeter++;
+			continue;
+		default:
+			stats.rejectedPolygon++;
+			continue;
+		}
+
+		// Scale the corners back up to the center of the pixels they cover at full resolution
+		MarkerCandidate candidate;
+		for (int k = 0; k < 4; k++) {
+			candidate.rect[k].x = polygon[k].x * scale + scale / 2;
+			candidate.rect[k].y = polygon[k].y * scale + scale / 2;
+		}
+		frame.candidates.push_back(candidate);
+	}
+
+	if (timing) {
+		frame.stats.stageMs[STAGE_POLYGON_FILTER] += statsClockMs() - filterStart;
+	}
+}
+
+
+/*  Finds the quads in a grayscale image that could be markers, with the run-length extractor
+ *	Thresholding, region labelling and the contour filter are fused into one pass over the
+ *	image, so no binary image or contour is built. The extractor applies the same limits
+ *	and counts its rejections in the same counters as the contour filter.
+ *
+ *	@param frame: The frame state to add the candidates to
+ *	@param gray: The grayscale image to search, possibly downsampled or a region of the frame
+ *	@param offset: The position of the searched image within the frame
+ *	@param scale: How many times smaller the searched image is than the frame
+ *
+ *	@return void
+ */
+void MarkerDetector::findRunLengthCandidates(FrameState &frame, const cv::Mat &gray, const cv::Point &offset, int scale) {
+
+	bool timing = config.collectStats != 0;
+	double start = timing ? statsClockMs() : 0.0;
+
+	// Label the bands of the image in parallel when the candidates are also processed in parallel
+	ContourLimits limits(config, scale);
+	int bandCount = config.parallelCandidates ? ThreadPool::shared().slotCount() : 1;
+	frame.quadCorners.clear();
+	int quadCount = frame.runLength.extract(gray, config.binaryThreshold, limits, bandCount, frame.quadCorners, frame.stats);
+
+	// Scale the corners back up to the center of the pixels they cover at full resolution
+	for (int i = 0; i < quadCount; i++) {
+		MarkerCandidate candidate;
+		for (int k = 0; k < 4; k++) {
+			const cv::Point &corner = frame.quadCorners[4 * i + k];
+			candidate.rect[k].x = (corner.x + offset.x) * scale + scale / 2;
+			candidate.rect[k].y = (corner.y + offset.y) * scale + scale / 2;
+		}
+		frame.candidates.push_back(candidate);
+	}
+
+	if (timing) {
+		frame.stats.stageMs[STAGE_CONTOURS] += statsClockMs() - start;
+	}
+}
+
+
+/*  Gathers the pose refinement settings of the configuration
+ *
+ *	@param config: The detector parameters
+ *
+ *	@return options: The iteration cap and the tolerances of the refinement
+ */
+static PoseSolver::RefineOptions<float> refineOptions(const DetectorConfig &config) {
+	PoseSolver::RefineOptions<float> refine;
+	refine.maxIterations = config.poseIterations;
+	refine.errorTolerance = config.poseErrorTolerance;
+	refine.stepTolerance = config.poseStepTolerance;
+	refine.priorTolerance = config.warmStartTolerance;
+	return refine;
+}
+
+
+/*  Fills in the distance, translation and rotation of a marker from its pose
+ *
+ *	@param marker: The marker to update
+ *	@param transformMatrix: The pose of the marker as a 4x4 matrix in row-major order
+ *
+ *	@return void
+ */
+static void setMarkerPose(Marker2 &marker, const float* transformMatrix) {
+
+	// Find the distance from the marker to the optical center
+	float x = transformMatrix[3];
+	float y = transformMatrix[7];
+	float z = transformMatrix[11];
+	marker.distance = sqrt(x * x + y * y + z * z);
+
+	marker.translate_x = transformMatrix[3];
+	marker.translate_y = transformMatrix[7];
+	marker.translate_z = transformMatrix[11];
+	marker.rotate_11 = transformMatrix[0];
+	marker.rotate_12 = transformMatrix[1];
+	marker.rotate_13 = transformMatrix[2];
+	marker.rotate_21 = transformMatrix[4];
+	marker.rotate_22 = transformMatrix[5];
+	marker.rotate_23 = transformMatrix[6];
+	marker.rotate_31 = transformMatrix[8];
+	marker.rotate_32 = transformMatrix[9];
+	marker.rotate_33 = transformMatrix[10];
+}
+
+
+/*  Refines, decodes and estimates the pose of one quad candidate
+ *	Only reads shared detector state and allocates nothing, so candidates can be
+ *	processed concurrently.
+ *
+ *	@param frame: The frame state holding the grayscale image
+ *	@param candidate: The quad to validate
+ *	@param result: Container to hold the refined corners and marker, if valid
+ *
+ *	@return void
+ */
+void MarkerDetector::processCandidate(const FrameState &frame, const MarkerCandidate &candidate, CandidateResult &result) {
+
+	result.valid = false;
+	result.boardIndex = -1;
+	result.rotation = 0;
+	result.rejection = REJECT_NONE;
+	result.refineMs = 0.0f;
+	result.decodeMs = 0.0f;
+	result.poseMs = 0.0f;
+	cv::Point2f* corners = result.corners;
+
+	bool timing = config.collectStats != 0;
+	double start = timing ? statsClockMs() : 0.0;
+
+	float lineParameters[16];					// Container to hold edge line equation parameters
+
+	// Refines line position, on the gradients of the frame if they were computed
+	if (config.gradientRefinement) {
+		refineEdges(lineParameters, candidate.rect, frame.gradients.view());
+	}
+	else {
+		refineEdges(lineParameters, candidate.rect, frame.gray_frame);
+	}
+
+	// Finds the refined corners given the refined lines
+	findCorners(corners, lineParameters);
+
+	double decodeStart = timing ? statsClockMs() : 0.0;
+	if (timing) {
+		result.refineMs = (float)(decodeStart - start);
+	}
+
+	// Sample the cells of the marker through its homography, checking that the border is black.
+	// If it is not, we skip this polygon.
+	int pattern;
+	if (!decodeMarkerCells(frame.gray_frame, corners, config.cellThreshold, pattern)) {
+		result.rejection = REJECT_BORDER;
+		if (timing) {
+			result.decodeMs = (float)(statsClockMs() - decodeStart);
+		}
+		return;
+	}
+
+	// Find the marker ID and orientation of the cell pattern in the code table
+	const MarkerCode &markerCode = lookupMarkerCode(pattern);
+
+	// If they're all black or white then it is an invalid marker
+	if (!markerCode.valid) {
+		result.rejection = REJECT_CODE;
+		if (timing) {
+			result.decodeMs = (float)(statsClockMs() - decodeStart);
+		}
+		return;
+	}
+	// Reorder the corners so that the first one matches the orientation of the ID
+	rotateCorners(corners, markerCode.rotation);
+	result.rotation = markerCode.rotation;
+	int code = markerCode.id;
+
+	double poseStart = timing ? statsClockMs() : 0.0;
+	if (timing) {
+		result.decodeMs = (float)(poseStart - decodeStart);
+	}
+
+	// Obtain the center of the marker
+	float center_x, center_y;
+	findMarkerCenter(corners, center_x, center_y);
+
+	// Transfer screen coordinates to camera coordinates, removing the lens distortion from the corners only
+	const CameraModel &cameraModel = *frame.camera;
+	cv::Point2f* cameraCorners = result.cameraCorners;
+	for (int i = 0; i < 4; i++) {
+		cameraCorners[i] = cameraModel.toCamera(corners[i]);
+	}
+
+	// Create the Marker2 object to be sent to Unity
+	result.marker = Marker2();
+	result.marker.id = code;
+	result.marker.center_x = center_x;
+	result.marker.center_y = center_y;
+
+	// Markers of the board get their pose from the board pose once the frame is collected,
+	// and with batchPose the others get theirs together once every candidate is validated
+	result.boardIndex = board.find(code);
+	if (result.boardIndex < 0 && !config.batchPose) {
+
+		// Estimate the transformation matrix from optical center to marker center, starting from
+		// the pose of the same marker in the previous frame when there is one
+		bool hasPrior = config.warmStartPose && frame.priorPoses.find(code, result.pose);
+		float transformMatrix[16];
+		estimateSquarePose(transformMatrix, result.pose, hasPrior, cameraCorners, config.markerSize,
+			cameraModel.focalX(), cameraModel.focalY(), refineOptions(config));
+		setMarkerPose(result.marker, transformMatrix);
+	}
+
+	if (timing) {
+		result.poseMs = (float)(statsClockMs() - poseStart);
+	}
+	result.valid = true;
+}
+
+
+/*  Computes the gradients of the frame over the regions the refinement of the candidates reads
+ *	Every candidate requests the tiles around its edges, and each tile is then computed once, however
+ *	many candidates cover it, so the cost follows the area of the markers rather than their
+ *	number. The tiles are spread over the thread pool if enabled.
+ *
+ *	@param frame: The frame state holding the grayscale image and the candidates
+ *
+ *	@return void
+ */
+void MarkerDetector::computeGradients(FrameState &frame) {
+
+	double start = config.collectStats ? statsClockMs() : 0.0;
+	GradientCache &gradients = frame.gradients;
+	gradients.reset(frame.gray_frame);
+	for (size_t i = 0; i < frame.candidates.size(); i++) {
+		cv::Rect regions[4];
+		refinementRegions(frame.candidates[i].rect, regions);
+		for (int k = 0; k < 4; k++) {
+			gradients.request(regions[k]);
+		}
+	}
+
+	auto compute = [&gradients](int i, int) {
+		gradients.computePending(i);
+	};
+	if (config.parallelCandidates) {
+		ThreadPool::shared().parallelFor(gradients.pendingCount(), compute);
+	}
+	else {
+		for (int i = 0; i < gradients.pendingCount(); i++) {
+			compute(i, 0);
+		}
+	}
+	gradients.finishPending();
+
+	if (config.collectStats) {
+		frame.stats.stageMs[STAGE_REFINEMENT] += statsClockMs() - start;
+	}
+}
+
+
+/*  Estimates the poses of the valid markers that are not on the board, several at once
+ *	The undistorted corners and the priors of the markers are gathered into batches, one value
+ *	per marker in each array, and every batch is solved by the vector kernel of this processor.
+ *	The poses are the same as those processCandidate finds one marker at a time.
+ *
+ *	@param frame: The frame state holding the validated candidates
+ *
+ *	@return void
+ */
+void MarkerDetector::estimatePoses(FrameState &frame) {
+
+	bool timing = config.collectStats != 0;
+	double start = timing ? statsClockMs() : 0.0;
+
+	const CameraModel &cameraModel = *frame.camera;
+	PoseSolver::RefineOptions<float> refine = refineOptions(config);
+	PoseBatch batch;
+	int members[PoseBatch::SIZE];		// Result of each marker of the batch
+
+	// Solves the batch and hands every pose back to its marker
+	auto solve = [&]() {
+		estimateSquarePoses(batch, cameraModel.focalX(), cameraModel.focalY(), refine);
+		for (int m = 0; m < batch.count; m++) {
+			CandidateResult &result = frame.results[members[m]];
+			float transformMatrix[16];
+			for (int k = 0; k < 16; k++) {
+				transformMatrix[k] = batch.matrix[k][m];
+			}
+			for (int k = 0; k < 7; k++) {
+				result.pose[k] = batch.pose[k][m];
+			}
+			setMarkerPose(result.marker, transformMatrix);
+		}
+		batch.count = 0;
+	};
+
+	batch.count = 0;
+	for (size_t i = 0; i < frame.results.size(); i++) {
+		const CandidateResult &result = frame.results[i];
+		if (!result.valid || result.boardIndex >= 0) {
+			continue;
+		}
+
+		// Start from the pose of the same marker in the previous frame when there is one
+		int m = batch.count;
+		float prior[7];
+		batch.hasPrior[m] = config.warmStartPose && frame.priorPoses.find(result.marker.id, prior);
+		for (int k = 0; k < 7; k++) {
+			batch.pose[k][m] = batch.hasPrior[m] ? prior[k] : 0.0f;
+		}
+		for (int k = 0; k < 4; k++) {
+			batch.cornerX[k][m] = result.cameraCorners[k].x;
+			batch.cornerY[k][m] = result.cameraCorners[k].y;
+		}
+		batch.markerSize[m] = config.markerSize;
+		members[m] = (int)i;
+		batch.count++;
+
+		if (batch.count == PoseBatch::SIZE) {
+			solve();
+		}
+	}
+	if (batch.count > 0) {
+		solve();
+	}
+
+	if (timing) {
+		frame.stats.stageMs[STAGE_POSE] += statsClockMs() - start;
+	}
+}
+
+
+/*  Solves the board pose from the valid markers of the board, then fills in their poses
+ *	Each marker of the board adds its four corners to one solve, so a board costs a single
+ *	pose estimate however many of its markers are visible. A marker found twice only counts once.
+ *	If the solve fails, the markers of the board fall back to a pose of their own.
+ *
+ *	@param frame: The frame state holding the validated candidates
+ *
+ *	@return void
+ */
+void MarkerDetector::estimateBoard(FrameState &frame) {
+
+	bool timing = config.collectStats != 0;
+	double start = timing ? statsClockMs() : 0.0;
+
+	BoardObservation observations[MarkerBoard::MAX_MARKERS];
+	bool used[MarkerBoard::MAX_MARKERS] = {};
+	int count = 0;
+	for (size_t i = 0; i < frame.results.size(); i++) {
+		const CandidateResult &result = frame.results[i];
+		if (!result.valid || result.boardIndex < 0 || used[result.boardIndex]) {
+			continue;
+		}
+		used[result.boardIndex] = true;
+		observations[count].index = result.boardIndex;
+		std::copy(result.cameraCorners, result.cameraCorners + 4, observations[count].corners);
+
+		// Like correctCornerOrder, the code table turns the corners the other way to the cells for an
+		// odd rotation, so the pose of a lone marker flips by a half turn there. The layout is in the
+		// frame of the printed marker, so those corners are turned back.
+		if (result.rotation & 1) {
+			rotateCorners(observations[count].corners, 2);
+		}
+		count++;
+	}
+	if (count == 0) {
+		board.reset();
+		return;
+	}
+
+	const CameraModel &cameraModel = *frame.camera;
+	PoseSolver::RefineOptions<float> refine = refineOptions(config);
+	float boardMatrix[16];
+	bool found = board.estimate(observations, count, cameraModel.focalX(), cameraModel.focalY(), refine,
+		config.warmStartPose != 0, boardMatrix, frame.board);
+
+	for (size_t i = 0; i < frame.results.size(); i++) {
+		CandidateResult &result = frame.results[i];
+		if (!result.valid || result.boardIndex < 0) {
+			continue;
+		}
+		float transformMatrix[16];
+		if (found) {
+			board.markerPose(transformMatrix, result.boardIndex, boardMatrix);
+		}
+		else {
+			estimateSquarePose(transformMatrix, result.pose, false, result.cameraCorners, board.markerSize(result.boardIndex),
+				cameraModel.focalX(), cameraModel.focalY(), refine);
+		}
+		setMarkerPose(result.marker, transformMatrix);
+	}
+
+	if (timing) {
+		frame.stats.stageMs[STAGE_POSE] += statsClockMs() - start;
+	}
+}
@@ -0,0 +1,204 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the persistent marker detector
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <memory>
+#include <vector>
+
+/* Helper includes */
+#include "UnityStructs.h"
+#include "MarkerTracker.h"
+#include "DetectorStatistics.h"
+#include "DuplicateFilter.h"
+#include "RunLengthExtractor.h"
+#include "ContourArena.h"
+#include "GradientCache.h"
+#include "CameraModel.h"
+#include "MarkerBoard.h"
+
+
+/*  Fills in the default detector configuration */
+void getDefaultConfig(DetectorConfig &config);
+
+
+/*  Tests of the contour filter, in the order they are tried */
+enum ContourRejection
+{
+	CONTOUR_ACCEPTED,			// The contour is a candidate quad
+	CONTOUR_POINT_COUNT,		// Too few points for a quad
+	CONTOUR_BOUNDING_BOX,		// Bounding box smaller than the minimum marker area
+	CONTOUR_ASPECT_RATIO,		// Bounding box too elongated
+	CONTOUR_PERIMETER,			// Contour too short or too long
+	CONTOUR_POLYGON				// Not a large enough convex quad
+};
+
+
+/*  Thresholds of the contour filter for one search image */
+struct ContourLimits
+{
+	ContourLimits(const DetectorConfig &config, int scale);
+
+	double minArea;				// Smallest quad area
+	double minPerimeter;		// Shortest contour that can enclose that area
+	double maxPerimeter;		// Longest contour
+	double maxAspectRatio;		// Most elongated bounding box
+	int minPoints;				// Fewest contour points
+};
+
+
+/*  Decides whether a contour could be a marker, filling in its quad if so */
+int filterContour(const cv::Point* contour, int length, const ContourLimits &limits, std::vector<cv::Point> &polygon);
+
+
+/*  Quad that passed the polygon filter and still has to be validated */
+struct MarkerCandidate
+{
+	cv::Point rect[4];			// Corners of the approximated polygon
+};
+
+
+/*  Reasons a candidate can fail validation */
+enum CandidateRejection
+{
+	REJECT_NONE,				// The candidate is a marker
+	REJECT_BORDER,				// The border of the rectified marker is not black
+	REJECT_CODE					// The code is all black or all white
+};
+
+
+/*  Outcome of validating one candidate */
+struct CandidateResult
+{
+	bool valid;					// True if the candidate is a marker
+	cv::Point2f corners[4];		// Refined corners, in image coordinates
+	cv::Point2f cameraCorners[4];	// Undistorted corners relative to the principal point, as given to the pose solver
+	int boardIndex;				// Position of the marker in the board layout, or -1 if it is not on the board
+	int rotation;				// Quarter turns the code table gave the corners
+	Marker2 marker;				// Marker data sent back to the caller
+	float pose[7];				// Pose of the marker as a rotation quaternion (x, y, z, w), then translation
+	int rejection;				// Why the candidate is not a marker, or REJECT_NONE
+	float refineMs;				// Time spent refining the edges, if statistics are collected
+	float decodeMs;				// Time spent reading the code, if statistics are collected
+	float poseMs;				// Time spent estimating the pose, if statistics are collected
+};
+
+
+/*  Buffers holding the state of one frame as it moves through detection.
+ *	Keeping them together lets several frames be in flight at once.
+ */
+struct FrameState
+{
+	cv::Mat input_frame;					// Header over the first plane of the caller's input
+	int format;								// Pixel format of the input, one of PixelFormat
+	cv::Mat rgba_frame;						// Header over the caller's RGBA or BGRA input, empty unless the overlay is drawn
+	cv::Mat gray_frame;						// Grayscale version of the input, or header over its Y plane
+	cv::Mat gray_buffer;					// Grayscale image converted from inputs without a Y plane
+	cv::Mat binary_im;						// Binarized version of the input
+	cv::Mat pyramid_gray;					// Downsampled grayscale image used for the quad search
+	cv::Mat pyramid_binary;					// Binarized version of the downsampled image
+	ContourArena contours;					// Contours of the binary image, back to back
+	GradientCache gradients;				// Gradients around the candidates, if gradientRefinement is set
+	std::vector<cv::Point> polygon;			// Polygon approximation of the current contour
+	std::vector<cv::Point> quadCorners;		// Corners of the quads found by the run-length extractor
+	std::vector<MarkerCandidate> candidates;	// Quads of the frame, in contour order
+	std::vector<CandidateResult> results;	// Validation result of each candidate
+	std::vector<cv::Rect> searchRegions;	// Regions searched in tracking mode
+	PoseSnapshot priorPoses;				// Marker poses of the previous frame, if warmStartPose is set
+	bool fullScan;							// False if only the search regions were processed
+	DuplicateFilter duplicateFilter;		// Drops quads found more than once
+	RunLengthExtractor runLength;			// Finds quads without a binary image, if enabled
+	FrameStats stats;						// Timings and counts, if statistics are collected
+	std::shared_ptr<const CameraModel> camera;	// Camera model for the size of this frame
+	BoardPose board;						// Pose of the marker board in this frame, if one is set
+};
+
+
+/*  Marker detector that owns every working buffer used during detection.
+ *	Buffers are sized on the first frame and reused afterwards, so repeated
+ *	calls with the same frame size do not reallocate them.
+ *	Detection is split into stages that can also be run separately on
+ *	different frames, which is what the asynchronous pipeline does.
+ */
+class MarkerDetector
+{
+public:
+	MarkerDetector();
+
+	/*  Creates a detector with the given configuration */
+	explicit MarkerDetector(const DetectorConfig &initialConfig);
+
+	/*  Replaces the detector configuration */
+	void configure(const DetectorConfig &newConfig);
+
+	/*  Returns the current detector configuration */
+	const DetectorConfig &getConfig() const { return config; }
+
+	/*  Replaces the layout of the marker board, returning false if it is invalid */
+	bool setBoard(const int* ids, const float* corners, int markerCount);
+
+	/*  Returns the board pose of the latest synchronous detection */
+	const BoardPose &getBoardPose() const { return syncFrame.board; }
+
+	/*  Finds and locates the markers in an RGBA image, returning the number found */
+	int detect(Marker2* outMarks, int maxOutMarkerCount, Color32* raw, int width, int height);
+
+	/*  Finds and locates the markers in an image of any supported pixel format, returning the number found */
+	int detect(Marker2* outMarks, int maxOutMarkerCount, const ImageDescriptor &image);
+
+	/*  Stage 1: converts the input and finds the quads that could be markers */
+	bool extractCandidates(FrameState &frame, Color32* raw, int width, int height);
+
+	/*  Stage 1 for an image of any supported pixel format */
+	bool extractCandidates(FrameState &frame, const ImageDescriptor &image);
+
+	/*  Stage 2: refines, decodes and estimates the pose of every candidate */
+	void validateCandidates(FrameState &frame);
+
+	/*  Stage 3: reports the valid markers in contour order and draws their outlines if requested */
+	int collectMarkers(FrameState &frame, Marker2* outMarks, int maxOutMarkerCount);
+
+	/*  Copies the statistics recorded while collectStats is set */
+	void getStats(DetectorStats &stats) { recorder.read(stats); }
+
+	/*  Forgets the recorded statistics */
+	void resetStats() { recorder.reset(); }
+
+private:
+	/*  Fills in the grayscale image of a region of the frame, and its binary image if requested */
+	void convertRegion(FrameState &frame, const cv::Rect &region, bool binarize);
+
+	/*  Finds the quads in a binary image that could be markers */
+	void findCandidates(FrameState &frame, cv::Mat &binary, const cv::Point &offset, int scale);
+
+	/*  Finds the quads in a grayscale image that could be markers, with the run-length extractor */
+	void findRunLengthCandidates(FrameState &frame, const cv::Mat &gray, const cv::Point &offset, int scale);
+
+	/*  Computes the gradients of the frame over the regions the refinement of the candidates reads */
+	void computeGradients(FrameState &frame);
+
+	/*  Refines, decodes and estimates the pose of one quad candidate */
+	void processCandidate(const FrameState &frame, const MarkerCandidate &candidate, CandidateResult &result);
+
+	/*  Estimates the poses of the valid markers that are not on the board, several at once */
+	void estimatePoses(FrameState &frame);
+
+	/*  Solves the board pose from the valid markers of the board, then fills in their poses */
+	void estimateBoard(FrameState &frame);
+
+	DetectorConfig config;					// Current detector parameters
+	FrameState syncFrame;					// Frame used by synchronous detection
+	MarkerTracker tracker;					// Marker positions used in tracking mode
+	PoseHistory poseHistory;				// Marker poses of the previous frame, used to warm start the pose
+	MarkerBoard board;						// Layout of the marker board and its previous pose
+	StatsRecorder recorder;					// Statistics of the processed frames
+	std::shared_ptr<const CameraModel> camera;	// Camera model of the latest frame size, rebuilt when it changes
+};
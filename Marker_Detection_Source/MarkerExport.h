@@ -0,0 +1,32 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Export and calling convention macros for the library entry points
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+
+/*  MARKER_API marks the functions exported by the library, and MARKER_CALL gives their calling convention
+ *	On Windows the entry points keep __stdcall, which the Unity scripts expect. They are exported from
+ *	the DLL unless MARKER_IMPORT is defined by a program that uses the DLL, or MARKER_STATIC by one that
+ *	links the static library. Elsewhere only the visibility is set, so that a shared library built with
+ *	hidden visibility exports nothing but the entry points.
+ */
+#if defined(_WIN32)
+#if defined(MARKER_STATIC)
+#define MARKER_API
+#elif defined(MARKER_IMPORT)
+#define MARKER_API __declspec(dllimport)
+#else
+#define MARKER_API __declspec(dllexport)
+#endif
+#define MARKER_CALL __stdcall
+#elif defined(__GNUC__) || defined(__clang__)
+#define MARKER_API __attribute__((visibility("default")))
+#define MARKER_CALL
+#else
+#define MARKER_API
+#define MARKER_CALL
+#endif
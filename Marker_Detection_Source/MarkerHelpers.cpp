@@ -60,6 +60,43 @@ void findCorners(cv::Point2f* corners, float* lineParameters) {
 }
 
 
+/*  Finds the perspective transform that maps four points onto four others
+ *	Same linear system as cv::getPerspectiveTransform, but solved into a fixed-size matrix
+ *	so that no cv::Mat has to be allocated for each marker candidate.
+ *
+ *	@param src: The four source points
+ *	@param dst: The four destination points
+ *	@param transform: Container to hold the 3x3 perspective transform
+ *
+ *	@return void
+ */
+void findPerspectiveTransform(const cv::Point2f* src, const cv::Point2f* dst, cv::Matx33d &transform) {
+
+	// Each correspondence gives one equation for x and one for y
+	double a[8][8], b[8];
+	for (int i = 0; i < 4; ++i) {
+		a[i][0] = a[i + 4][3] = src[i].x;
+		a[i][1] = a[i + 4][4] = src[i].y;
+		a[i][2] = a[i + 4][5] = 1;
+		a[i][3] = a[i][4] = a[i][5] = 0;
+		a[i + 4][0] = a[i + 4][1] = a[i + 4][2] = 0;
+		a[i][6] = -src[i].x * dst[i].x;
+		a[i][7] = -src[i].y * dst[i].x;
+		a[i + 4][6] = -src[i].x * dst[i].y;
+		a[i + 4][7] = -src[i].y * dst[i].y;
+		b[i] = dst[i].x;
+		b[i + 4] = dst[i].y;
+	}
+
+	// Solve for the first eight entries, the last one is fixed to 1
+	cv::Mat matA(8, 8, CV_64F, a);
+	cv::Mat matB(8, 1, CV_64F, b);
+	cv::Mat matX(8, 1, CV_64F, transform.val);
+	cv::solve(matA, matB, matX, cv::DECOMP_LU);
+	transform.val[8] = 1.0;
+}
+
+
 /*  Checks that the pixels on the marker border are black to be valid
  *
  *	@param planarMarker: The 6x6 marker pixels
@@ -17,6 +17,9 @@
 /*  Finds the location of the corners given the refined edges */
 void findCorners(cv::Point2f* corners, float* lineParameters);
 
+/*  Finds the perspective transform that maps four points onto four others, without heap allocation */
+void findPerspectiveTransform(const cv::Point2f* src, const cv::Point2f* dst, cv::Matx33d &transform);
+
 /*  Checks that the pixels on the marker border are black to be valid */
 bool checkBorderIsBlack(cv::Mat &planarMarker);
 
@@ -0,0 +1,290 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Asynchronous detection pipeline
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <algorithm>
+#include <climits>
+
+/* Helper includes */
+#include "MarkerPipeline.h"
+#include "ImageInput.h"
+
+
+/*  Creates a pipeline that can hold depth frames in flight and starts its stage threads
+ *	A depth of 1 gives the lowest latency but no overlap between frames, a depth of 2
+ *	lets both stages work at once, and more frames absorb jitter in the caller.
+ *
+ *	@param depth: The maximum number of frames in flight, at least 1
+ */
+MarkerPipeline::MarkerPipeline(int depth)
+	: inFlight(0), nextSequence(0), callback(NULL), userData(NULL), stopping(false) {
+
+	depth = std::max(1, depth);
+	freeSlots.reset(depth);
+	extractQueue.reset(depth);
+	validateQueue.reset(depth);
+	doneQueue.reset(depth);
+
+	for (int i = 0; i < depth; i++) {
+		slots.emplace_back(new PipelineSlot());
+		freeSlots.push(i);
+	}
+
+	extractThread = std::thread(&MarkerPipeline::extractLoop, this);
+	validateThread = std::thread(&MarkerPipeline::validateLoop, this);
+}
+
+
+/*  Stops the stage threads, dropping any frames that have not finished */
+MarkerPipeline::~MarkerPipeline() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	changed.notify_all();
+
+	extractThread.join();
+	validateThread.join();
+}
+
+
+/*  Waits for every frame being processed, then replaces the detector configuration
+ *	Finished frames that have not been polled yet keep their results. The result callback
+ *	cannot wait for the frame it is delivering, so the configuration is left as it is there.
+ *
+ *	@param config: The new detector parameters
+ *
+ *	@return applied: False if called from the result callback
+ */
+bool MarkerPipeline::configure(const DetectorConfig &config) {
+
+	if (onCallbackThread()) {
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return stopping || inFlight == doneQueue.count; });
+	detector.configure(config);
+	return true;
+}
+
+
+/*  Waits for every frame being processed, then replaces the layout of the marker board
+ *
+ *	@param ids: The ID of each marker on the board, or NULL with a count of 0 to remove the board
+ *	@param corners: The board coordinates of the four corners of each marker, 12 values per marker
+ *	@param markerCount: The number of markers on the board
+ *
+ *	@return valid: False if the layout is invalid or if called from the result callback,
+ *		in which case the previous one is kept
+ */
+bool MarkerPipeline::setBoard(const int* ids, const float* corners, int markerCount) {
+
+	if (onCallbackThread()) {
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return stopping || inFlight == doneQueue.count; });
+	return detector.setBoard(ids, corners, markerCount);
+}
+
+
+/*  Queues a frame for detection
+ *
+ *	@param raw: The raw colour image, which must stay valid until its result is delivered
+ *	@param width: The width of the input image
+ *	@param height: The height of the input image
+ *	@param maxOutMarkerCount: The maximum number of markers to be found in the image
+ *	@param wait: If true, block until a slot is free instead of failing, except when called from the result callback
+ *
+ *	@return sequence: The sequence number of the frame, or -1 if it was not queued
+ */
+int MarkerPipeline::submit(Color32* raw, int width, int height, int maxOutMarkerCount, bool wait) {
+	return submit(describeRgbaImage(raw, width, height), maxOutMarkerCount, wait);
+}
+
+
+/*  Queues a frame of any supported pixel format for detection
+ *
+ *	@param image: The description of the input image, whose planes must stay valid until its result is delivered
+ *	@param maxOutMarkerCount: The maximum number of markers to be found in the image
+ *	@param wait: If true, block until a slot is free instead of failing, except when called from the result callback
+ *
+ *	@return sequence: The sequence number of the frame, or -1 if it was not queued
+ */
+int MarkerPipeline::submit(const ImageDescriptor &image, int maxOutMarkerCount, bool wait) {
+
+	// The slot of the frame being delivered is only freed once the callback returns
+	if (onCallbackThread()) {
+		wait = false;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	if (wait) {
+		changed.wait(lock, [this] { return stopping || !freeSlots.empty(); });
+	}
+	if (stopping || freeSlots.empty()) {
+		return -1;
+	}
+
+	int index = freeSlots.pop();
+	PipelineSlot &slot = *slots[index];
+	slot.image = image;
+	slot.maxOutMarkerCount = std::max(0, maxOutMarkerCount);
+	slot.sequence = nextSequence;
+	nextSequence = (nextSequence == INT_MAX) ? 0 : nextSequence + 1;
+
+	inFlight++;
+	extractQueue.push(index);
+	changed.notify_all();
+
+	return slot.sequence;
+}
+
+
+/*  Takes the oldest finished frame
+ *
+ *	@param outMarks: Array to hold a Marker2 for each marker detected in the frame
+ *	@param maxOutMarkerCount: The size of outMarks
+ *	@param outMarkerDetected: The number of markers copied to outMarks
+ *	@param sequence: The sequence number of the frame
+ *	@param board: Container to hold the board pose of the frame, or NULL
+ *
+ *	@return ready: False if no frame has finished yet
+ */
+bool MarkerPipeline::poll(Marker2* outMarks, int maxOutMarkerCount, int &outMarkerDetected, int &sequence, BoardPose* board) {
+
+	std::lock_guard<std::mutex> lock(mutex);
+	if (doneQueue.empty()) {
+		return false;
+	}
+
+	int index = doneQueue.pop();
+	PipelineSlot &slot = *slots[index];
+	outMarkerDetected = std::min(slot.markerCount, std::max(0, maxOutMarkerCount));
+	std::copy(slot.markers.begin(), slot.markers.begin() + outMarkerDetected, outMarks);
+	sequence = slot.sequence;
+	if (board != NULL) {
+		*board = slot.frame.board;
+	}
+
+	inFlight--;
+	freeSlots.push(index);
+	changed.notify_all();
+
+	return true;
+}
+
+
+/*  Delivers finished frames to a callback instead of queueing them for poll
+ *	The callback runs on the pipeline's validation thread, so it should return quickly.
+ *
+ *	@param newCallback: The function to call, or NULL to go back to polling
+ *	@param newUserData: Passed back to the callback
+ *
+ *	@return void
+ */
+void MarkerPipeline::setCallback(MarkerCallback newCallback, void* newUserData) {
+
+	std::lock_guard<std::mutex> lock(mutex);
+	callback = newCallback;
+	userData = newUserData;
+}
+
+
+/*  Waits until every submitted frame has finished
+ *	The result callback cannot wait for the frame it is delivering, so it returns at once there.
+ *
+ *	@return finished: False if called from the result callback
+ */
+bool MarkerPipeline::flush() {
+
+	if (onCallbackThread()) {
+		return false;
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return stopping || inFlight == doneQueue.count; });
+	return true;
+}
+
+
+/*  First stage: conversion, thresholding and contour extraction
+ *
+ *	@return void
+ */
+void MarkerPipeline::extractLoop() {
+
+	while (true) {
+		int index;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this] { return stopping || !extractQueue.empty(); });
+			if (stopping) {
+				return;
+			}
+			index = extractQueue.pop();
+		}
+
+		PipelineSlot &slot = *slots[index];
+		slot.valid = detector.extractCandidates(slot.frame, slot.image);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		validateQueue.push(index);
+		changed.notify_all();
+	}
+}
+
+
+/*  Second stage: edge refinement, decoding and pose estimation, then delivery
+ *
+ *	@return void
+ */
+void MarkerPipeline::validateLoop() {
+
+	while (true) {
+		int index;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this] { return stopping || !validateQueue.empty(); });
+			if (stopping) {
+				return;
+			}
+			index = validateQueue.pop();
+		}
+
+		PipelineSlot &slot = *slots[index];
+		slot.markerCount = 0;
+		if (slot.valid && slot.maxOutMarkerCount > 0) {
+			if ((int)slot.markers.size() < slot.maxOutMarkerCount) {
+				slot.markers.resize(slot.maxOutMarkerCount);
+			}
+			detector.validateCandidates(slot.frame);
+			slot.markerCount = detector.collectMarkers(slot.frame, &slot.markers[0], slot.maxOutMarkerCount);
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		MarkerCallback deliver = callback;
+		void* deliverData = userData;
+		if (deliver == NULL) {
+			doneQueue.push(index);
+			changed.notify_all();
+			continue;
+		}
+
+		// Hand the result to the callback outside of the lock, then recycle the slot
+		lock.unlock();
+		deliver(slot.sequence, slot.markerCount > 0 ? &slot.markers[0] : NULL, slot.markerCount, deliverData);
+		lock.lock();
+
+		inFlight--;
+		freeSlots.push(index);
+		changed.notify_all();
+	}
+}
@@ -0,0 +1,124 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the asynchronous detection pipeline
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Helper includes */
+#include "MarkerExport.h"
+#include "UnityStructs.h"
+#include "MarkerDetector.h"
+
+
+/*  Callback receiving the markers of a finished frame, called on the pipeline's own thread */
+typedef void (MARKER_CALL *MarkerCallback)(int sequence, const Marker2* markers, int markerCount, void* userData);
+
+
+/*  Asynchronous detection pipeline.
+ *	Frames are submitted by the caller and go through two stages on their own threads:
+ *	conversion, thresholding and contour extraction, then candidate validation and
+ *	pose estimation. While one frame is being validated the next one is already being
+ *	extracted, so throughput approaches the rate of the slowest stage.
+ *	The pipeline depth is the number of frames that can be in flight at once.
+ *	A submitted image must stay valid until its result has been delivered, since it is
+ *	read by both stages and the marker outlines may be drawn into it.
+ *	The result callback runs on the validation thread, which would never get to finish the
+ *	frames that configure, setBoard and flush wait for. Called from the callback, these
+ *	return at once without waiting, and submit never blocks.
+ */
+class MarkerPipeline
+{
+public:
+	/*  Creates a pipeline that can hold depth frames in flight */
+	explicit MarkerPipeline(int depth);
+	~MarkerPipeline();
+
+	/*  Waits for every frame in flight, then replaces the detector configuration, returning false if called from the callback */
+	bool configure(const DetectorConfig &config);
+
+	/*  Waits for every frame in flight, then replaces the layout of the marker board, returning false if invalid or called from the callback */
+	bool setBoard(const int* ids, const float* corners, int markerCount);
+
+	/*  Queues a frame, returning its sequence number or -1 if the pipeline is full */
+	int submit(Color32* raw, int width, int height, int maxOutMarkerCount, bool wait);
+
+	/*  Queues a frame of any supported pixel format, returning its sequence number or -1 if the pipeline is full */
+	int submit(const ImageDescriptor &image, int maxOutMarkerCount, bool wait);
+
+	/*  Takes the oldest finished frame, returning false if none is ready */
+	bool poll(Marker2* outMarks, int maxOutMarkerCount, int &outMarkerDetected, int &sequence, BoardPose* board = NULL);
+
+	/*  Delivers finished frames to a callback instead of queueing them for poll */
+	void setCallback(MarkerCallback newCallback, void* newUserData);
+
+	/*  Waits until every submitted frame has finished, returning false if called from the callback */
+	bool flush();
+
+	/*  Copies the statistics recorded while collectStats is set */
+	void getStats(DetectorStats &stats) { detector.getStats(stats); }
+
+	/*  Forgets the recorded statistics */
+	void resetStats() { detector.resetStats(); }
+
+private:
+	/*  One frame in flight and its output */
+	struct PipelineSlot
+	{
+		FrameState frame;				// Detection buffers of this frame
+		ImageDescriptor image;			// Caller's input image
+		int sequence;					// Sequence number given out by submit
+		int maxOutMarkerCount;			// Maximum number of markers to report
+		bool valid;						// False if the input image was empty
+		std::vector<Marker2> markers;	// Markers found in this frame
+		int markerCount;				// Number of valid entries in markers
+	};
+
+	/*  Fixed-capacity FIFO of slot indices */
+	struct SlotQueue
+	{
+		std::vector<int> items;
+		int head;
+		int count;
+
+		void reset(int capacity) { items.assign(capacity, 0); head = 0; count = 0; }
+		bool empty() const { return count == 0; }
+		void push(int slot) { items[(head + count) % items.size()] = slot; count++; }
+		int pop() { int slot = items[head]; head = (head + 1) % items.size(); count--; return slot; }
+	};
+
+	void extractLoop();
+	void validateLoop();
+
+	/*  Tells whether the caller is the result callback, which runs on the validation thread */
+	bool onCallbackThread() const { return std::this_thread::get_id() == validateThread.get_id(); }
+
+	MarkerDetector detector;								// Detector running the stages
+	std::vector<std::unique_ptr<PipelineSlot>> slots;		// Frames in flight
+	SlotQueue freeSlots;									// Slots ready for a new frame
+	SlotQueue extractQueue;									// Submitted frames
+	SlotQueue validateQueue;								// Frames with candidates extracted
+	SlotQueue doneQueue;									// Finished frames waiting for poll
+	int inFlight;											// Frames submitted but not yet delivered
+	int nextSequence;										// Sequence number of the next frame
+	MarkerCallback callback;								// Optional delivery callback
+	void* userData;											// Passed back to the callback
+	bool stopping;											// Set when the pipeline shuts down
+
+	std::mutex mutex;										// Guards all of the queues above
+	std::condition_variable changed;						// Signalled whenever a queue changes
+	std::thread extractThread;								// Runs the first stage
+	std::thread validateThread;								// Runs the second stage
+};
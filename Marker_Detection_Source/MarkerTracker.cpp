@@ -0,0 +1,276 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Temporal marker tracking
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+
+/* Helper includes */
+#include "MarkerTracker.h"
+
+
+/* Number of tracks reserved up front, so that tracking a handful of markers never reallocates */
+static const int RESERVED_TRACKS = 64;
+
+/* Extra margin in pixels around every search region, on top of the relative margin */
+static const int MIN_SEARCH_MARGIN = 8;
+
+
+/*  Creates a tracker with no tracks, so that the first frame is scanned in full */
+MarkerTracker::MarkerTracker() : framesSinceFullScan(0), trackLost(false) {
+	tracks.reserve(RESERVED_TRACKS);
+}
+
+
+/*  Forgets every track, so that the next frame is scanned in full
+ *
+ *	@return void
+ */
+void MarkerTracker::reset() {
+	std::lock_guard<std::mutex> lock(mutex);
+	tracks.clear();
+	framesSinceFullScan = 0;
+	trackLost = false;
+}
+
+
+/*  Decides where to search the next frame
+ *	Each track is moved forward assuming constant velocity, and the search region is the
+ *	bounding box of its last and predicted corners grown by a margin relative to the marker
+ *	size. Overlapping regions are merged so that no pixel is processed twice.
+ *
+ *	@param width: The width of the next frame
+ *	@param height: The height of the next frame
+ *	@param config: The detector configuration holding the tracking parameters
+ *	@param regions: Container to hold the regions to search if no full scan is needed
+ *
+ *	@return fullScan: True if the whole frame should be scanned instead
+ */
+bool MarkerTracker::planSearch(int width, int height, const DetectorConfig &config, std::vector<cv::Rect> &regions) {
+
+	std::lock_guard<std::mutex> lock(mutex);
+	regions.clear();
+
+	// Re-acquire on a fixed interval, whenever we lost a marker, or when there is nothing to follow
+	if (tracks.empty() || trackLost || framesSinceFullScan + 1 >= config.reacquireInterval) {
+		framesSinceFullScan = 0;
+		trackLost = false;
+		return true;
+	}
+	framesSinceFullScan++;
+
+	const cv::Rect image(0, 0, width, height);
+	for (size_t t = 0; t < tracks.size(); t++) {
+		const MarkerTrack &track = tracks[t];
+
+		// Find the bounding box of the last corners and the predicted ones
+		float minX = track.corners[0].x, maxX = minX;
+		float minY = track.corners[0].y, maxY = minY;
+		for (int k = 0; k < 4; k++) {
+			cv::Point2f last = track.corners[k];
+			cv::Point2f predicted = last;
+			if (track.hasPrevious) {
+				predicted.x += last.x - track.previous[k].x;
+				predicted.y += last.y - track.previous[k].y;
+			}
+
+			minX = std::min(minX, std::min(last.x, predicted.x));
+			maxX = std::max(maxX, std::max(last.x, predicted.x));
+			minY = std::min(minY, std::min(last.y, predicted.y));
+			maxY = std::max(maxY, std::max(last.y, predicted.y));
+		}
+
+		// Grow the box so that the marker and its edge stripes stay inside it
+		float size = std::max(maxX - minX, maxY - minY);
+		int margin = (int)(config.trackingMargin * size) + MIN_SEARCH_MARGIN;
+		cv::Rect region((int)floorf(minX) - margin, (int)floorf(minY) - margin,
+			(int)ceilf(maxX - minX) + 2 * margin + 1, (int)ceilf(maxY - minY) + 2 * margin + 1);
+		region &= image;
+		if (!region.empty()) {
+			regions.push_back(region);
+		}
+	}
+
+	// Merge overlapping regions until none overlap
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (size_t i = 0; i < regions.size() && !merged; i++) {
+			for (size_t j = i + 1; j < regions.size(); j++) {
+				if ((regions[i] & regions[j]).empty()) {
+					continue;
+				}
+
+				regions[i] |= regions[j];
+				regions.erase(regions.begin() + j);
+				merged = true;
+				break;
+			}
+		}
+	}
+
+	return false;
+}
+
+
+/*  Updates the tracks with a marker found in the current frame
+ *	The marker is matched to the nearest unmatched track with the same ID, or starts a new one.
+ *
+ *	@param id: The ID of the marker
+ *	@param corners: The refined corners of the marker, in image coordinates
+ *
+ *	@return void
+ */
+void MarkerTracker::update(int id, const cv::Point2f* corners) {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	// Find the closest track of this ID that has not been matched yet
+	int best = -1;
+	float bestDistance = 0.0f;
+	for (size_t t = 0; t < tracks.size(); t++) {
+		if (tracks[t].id != id || tracks[t].seen) {
+			continue;
+		}
+
+		float dx = tracks[t].corners[0].x - corners[0].x;
+		float dy = tracks[t].corners[0].y - corners[0].y;
+		float distance = dx * dx + dy * dy;
+		if (best < 0 || distance < bestDistance) {
+			best = (int)t;
+			bestDistance = distance;
+		}
+	}
+
+	if (best < 0) {
+		MarkerTrack track;
+		track.id = id;
+		track.hasPrevious = false;
+		for (int k = 0; k < 4; k++) {
+			track.corners[k] = corners[k];
+			track.previous[k] = corners[k];
+		}
+		track.seen = true;
+		tracks.push_back(track);
+		return;
+	}
+
+	MarkerTrack &track = tracks[best];
+	for (int k = 0; k < 4; k++) {
+		track.previous[k] = track.corners[k];
+		track.corners[k] = corners[k];
+	}
+	track.hasPrevious = true;
+	track.seen = true;
+}
+
+
+/*  Finishes the update of a frame
+ *	A marker missing from a full scan is gone and its track is dropped. A marker missing
+ *	from its search region may just have moved too fast, so the next frame is scanned in full.
+ *
+ *	@param fullScan: True if the frame was scanned in full
+ *
+ *	@return void
+ */
+void MarkerTracker::endFrame(bool fullScan) {
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (size_t t = 0; t < tracks.size(); ) {
+		if (!tracks[t].seen) {
+			if (fullScan) {
+				tracks.erase(tracks.begin() + t);
+				continue;
+			}
+			trackLost = true;
+		}
+
+		tracks[t].seen = false;
+		t++;
+	}
+}
+
+
+/*  Creates a history with no poses */
+PoseHistory::PoseHistory() {
+	poses.reserve(RESERVED_TRACKS);
+	pending.reserve(RESERVED_TRACKS);
+}
+
+
+/*  Forgets every pose
+ *
+ *	@return void
+ */
+void PoseHistory::reset() {
+	std::lock_guard<std::mutex> lock(mutex);
+	poses.clear();
+	pending.clear();
+}
+
+
+/*  Copies the poses of the previous frame for a frame about to be validated
+ *	The lock is taken once per frame, where looking every candidate up in the history would
+ *	take it once per candidate and have the validation threads wait on each other.
+ *
+ *	@param copy: Container to hold the poses, whose memory is reused from frame to frame
+ *
+ *	@return void
+ */
+void PoseHistory::snapshot(PoseSnapshot &copy) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	copy.poses.assign(poses.begin(), poses.end());
+}
+
+
+/*  Adds the pose of a marker of the frame being finished
+ *
+ *	@param id: The marker ID
+ *	@param pose: The 7 pose parameters
+ *
+ *	@return void
+ */
+void PoseHistory::add(int id, const float* pose) {
+	MarkerPose entry;
+	entry.id = id;
+	std::copy(pose, pose + 7, entry.pose);
+	pending.push_back(entry);
+}
+
+
+/*  Replaces the previous poses with those of the frame being finished
+ *
+ *	@return void
+ */
+void PoseHistory::endFrame() {
+	std::lock_guard<std::mutex> lock(mutex);
+	poses.swap(pending);
+	pending.clear();
+}
+
+
+/*  Copies the previous pose of a marker
+ *	A marker seen more than once gives the first of its poses, which is only a starting point.
+ *	The snapshot is only read while the frame is validated, so no lock is needed.
+ *
+ *	@param id: The marker ID
+ *	@param pose: Container to hold the 7 pose parameters
+ *
+ *	@return found: False if the marker was not in the previous frame
+ */
+bool PoseSnapshot::find(int id, float* pose) const {
+
+	for (size_t i = 0; i < poses.size(); i++) {
+		if (poses[i].id == id) {
+			std::copy(poses[i].pose, poses[i].pose + 7, pose);
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,107 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for temporal marker tracking
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <mutex>
+#include <vector>
+
+/* Helper includes */
+#include "UnityStructs.h"
+
+
+/*  Remembers where each marker was last seen, so that the next frame only has to be
+ *	searched around the predicted marker positions. A full-frame scan is requested
+ *	every few frames, whenever a track is lost, and whenever nothing is being tracked.
+ *	Planning and updating may happen on different threads.
+ */
+class MarkerTracker
+{
+public:
+	MarkerTracker();
+
+	/*  Forgets every track, so that the next frame is scanned in full */
+	void reset();
+
+	/*  Decides where to search the next frame, returning true if the whole frame should be scanned */
+	bool planSearch(int width, int height, const DetectorConfig &config, std::vector<cv::Rect> &regions);
+
+	/*  Updates the tracks with the markers found in a frame */
+	void update(int id, const cv::Point2f* corners);
+
+	/*  Finishes the update of a frame, dropping or flagging the tracks that were not seen */
+	void endFrame(bool fullScan);
+
+private:
+	/*  Last known position of one marker */
+	struct MarkerTrack
+	{
+		int id;						// Marker ID
+		cv::Point2f corners[4];		// Corners in the last frame the marker was seen
+		cv::Point2f previous[4];	// Corners the time before that
+		bool hasPrevious;			// True once previous holds a real position
+		bool seen;					// True if the marker was found in the current frame
+	};
+
+	std::mutex mutex;					// Guards everything below
+	std::vector<MarkerTrack> tracks;	// One track per marker being followed
+	int framesSinceFullScan;			// Frames searched since the last full scan
+	bool trackLost;						// Set when a tracked marker was not found in its region
+};
+
+
+/*  Pose of one marker, kept from one frame to the next */
+struct MarkerPose
+{
+	int id;						// Marker ID
+	float pose[7];				// Rotation quaternion (x, y, z, w), then translation
+};
+
+
+/*  Poses of the previous frame as a frame saw them when its validation started.
+ *	Each frame holds its own copy, so the candidates look poses up without any lock.
+ */
+struct PoseSnapshot
+{
+	std::vector<MarkerPose> poses;	// Poses of the previous frame
+
+	/*  Copies the previous pose of a marker, returning false if it was not in the previous frame */
+	bool find(int id, float* pose) const;
+};
+
+
+/*  Remembers the pose of each marker found in the previous frame, so that the pose of the
+ *	same marker in the next frame can start from it instead of from its homography.
+ *	A frame copies the poses once before its candidates are validated, possibly on several
+ *	threads, and they are replaced by the poses of a frame once it is finished.
+ */
+class PoseHistory
+{
+public:
+	PoseHistory();
+
+	/*  Forgets every pose */
+	void reset();
+
+	/*  Copies the poses of the previous frame for a frame about to be validated */
+	void snapshot(PoseSnapshot &copy) const;
+
+	/*  Adds the pose of a marker of the frame being finished */
+	void add(int id, const float* pose);
+
+	/*  Replaces the previous poses with those added since the last call */
+	void endFrame();
+
+private:
+	mutable std::mutex mutex;			// Guards poses
+	std::vector<MarkerPose> poses;		// Poses of the previous frame
+	std::vector<MarkerPose> pending;	// Poses of the frame being finished, only touched by the finishing thread
+};
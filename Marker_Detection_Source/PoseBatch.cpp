@@ -0,0 +1,145 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Pose of several markers solved at once
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <algorithm>
+
+/* Helper includes */
+#include "PoseBatch.h"
+#include "PoseSolverBatch.h"
+#include "KernelDispatch.h"
+
+
+namespace MARKER_ISA {
+
+/*  Loads one value per lane for a run of markers of a batch
+ *	Lanes past the end of the batch repeat the first marker of the run, so that they
+ *	compute on sensible values until they are masked out.
+ *
+ *	@param values: One value per marker of the batch
+ *	@param first: The first marker of the run
+ *	@param lanes: The number of markers in the run
+ *
+ *	@return loaded: The values of the run
+ */
+static PoseSolverBatch::FloatLanes gatherLanes(const float* values, int first, int lanes) {
+
+	float buffer[PoseSolverBatch::LANES];
+	for (int i = 0; i < PoseSolverBatch::LANES; i++) {
+		buffer[i] = values[first + (i < lanes ? i : 0)];
+	}
+	return PoseSolverBatch::loadLanes(buffer);
+}
+
+
+/*  Stores one value per lane for a run of markers of a batch, leaving the markers past the run alone
+ *
+ *	@param values: One value per marker of the batch
+ *	@param stored: The values of the run
+ *	@param first: The first marker of the run
+ *	@param lanes: The number of markers in the run
+ *
+ *	@return void
+ */
+static void scatterLanes(float* values, const PoseSolverBatch::FloatLanes &stored, int first, int lanes) {
+
+	float buffer[PoseSolverBatch::LANES];
+	PoseSolverBatch::storeLanes(buffer, stored);
+	for (int i = 0; i < lanes; i++) {
+		values[first + i] = buffer[i];
+	}
+}
+
+
+/*  Estimates the pose of every marker of a batch, one marker per vector lane
+ *	The batch is solved in runs of as many markers as there are lanes. Degenerate
+ *	corners give the identity pose, as they do for a single marker.
+ *
+ *	@param batch: The markers, whose poses and matrices are filled in
+ *	@param focalX: The focal length along x in pixels
+ *	@param focalY: The focal length along y in pixels
+ *	@param options: The iteration cap and the tolerances of the refinement
+ *
+ *	@return void
+ */
+static void estimateSquarePoses(PoseBatch &batch, float focalX, float focalY, const PoseSolver::RefineOptions<float> &options) {
+
+	using namespace PoseSolverBatch;
+
+	for (int first = 0; first < batch.count; first += LANES) {
+		int lanes = std::min(LANES, batch.count - first);
+
+		FloatLanes x[4], y[4];
+		for (int i = 0; i < 4; i++) {
+			x[i] = gatherLanes(batch.cornerX[i], first, lanes);
+			y[i] = gatherLanes(batch.cornerY[i], first, lanes);
+		}
+		FloatLanes markerSize = gatherLanes(batch.markerSize, first, lanes);
+		FloatLanes pose[7];
+		for (int i = 0; i < 7; i++) {
+			pose[i] = gatherLanes(batch.pose[i], first, lanes);
+		}
+		float prior[LANES];
+		for (int i = 0; i < LANES; i++) {
+			prior[i] = batch.hasPrior[first + (i < lanes ? i : 0)] ? 1.0f : 0.0f;
+		}
+		MaskLanes hasPrior = loadLanes(prior) > 0;
+
+		FloatLanes mat[16];
+		FloatLanes iterations;
+		MaskLanes valid = estimateSquarePose(mat, pose, hasPrior, x, y, markerSize, focalX, focalY, options,
+			firstLanes(lanes), iterations);
+
+		// Degenerate corners give the identity pose, whose zero translation can never be used as a prior
+		for (int i = 0; i < 16; i++) {
+			scatterLanes(batch.matrix[i], select(valid, mat[i], (i % 5 == 0) ? 1.0f : 0.0f), first, lanes);
+		}
+		for (int i = 0; i < 7; i++) {
+			scatterLanes(batch.pose[i], select(valid, pose[i], (i == 3) ? 1.0f : 0.0f), first, lanes);
+		}
+		float count[LANES];
+		storeLanes(count, iterations);
+		for (int i = 0; i < lanes; i++) {
+			batch.iterations[first + i] = laneSet(valid, i) ? (int)count[i] : -1;
+		}
+	}
+}
+
+
+/*  Fills a table with the batched pose kernel of this level
+ *
+ *	@param table: Container to hold the kernels
+ *
+ *	@return void
+ */
+void fillPoseKernels(KernelTable &table) {
+	table.estimateSquarePoses = estimateSquarePoses;
+}
+
+}
+
+
+#ifndef MARKER_ISA_VARIANT
+/*  Estimates the pose of every marker of a batch
+ *	Takes the same steps as estimateSquarePose with a prior, on as many markers at once as
+ *	the vector registers of this processor hold: 16 with AVX-512, 8 with AVX2 and 4 otherwise.
+ *	Each marker stops refining once it converges, on its own, so the poses match those
+ *	solved one marker at a time.
+ *	Runs the kernel chosen for this processor, see activeKernels.
+ *
+ *	@param batch: The markers, whose poses, matrices and iteration counts are filled in
+ *	@param focalX: The focal length along x in pixels
+ *	@param focalY: The focal length along y in pixels
+ *	@param options: The iteration cap and the tolerances of the refinement
+ *
+ *	@return void
+ */
+void estimateSquarePoses(PoseBatch &batch, float focalX, float focalY, const PoseSolver::RefineOptions<float> &options) {
+	activeKernels().estimateSquarePoses(batch, focalX, focalY, options);
+}
+#endif
@@ -0,0 +1,34 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the pose of several markers solved at once
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* Helper includes */
+#include "PoseSolver.h"
+
+
+/*  Markers whose poses are solved together, in structure-of-arrays form:
+ *	every array holds one value per marker, so that consecutive markers fill the
+ *	lanes of one vector register.
+ */
+struct PoseBatch
+{
+	static const int SIZE = 16;		// Most markers in a batch, a multiple of every vector width
+
+	int count;						// Number of markers in the batch
+	float cornerX[4][SIZE];			// Undistorted corners relative to the principal point with y up, counter-clockwise
+	float cornerY[4][SIZE];
+	float markerSize[SIZE];			// Side length of each marker
+	bool hasPrior[SIZE];			// True if pose holds a prior pose of the marker to try
+	float pose[7][SIZE];			// Prior on input, refined pose on output, as a quaternion (x, y, z, w) then translation
+	float matrix[16][SIZE];			// Refined pose as a 4x4 matrix in row-major order
+	int iterations[SIZE];			// Refinement iterations run, or -1 if the corners are degenerate
+};
+
+
+/*  Estimates the pose of every marker of a batch, several markers per instruction, giving the same poses as estimateSquarePose */
+void estimateSquarePoses(PoseBatch &batch, float focalX, float focalY, const PoseSolver::RefineOptions<float> &options);
@@ -1,6 +1,7 @@
 #pragma once
 #include <opencv2/core.hpp>
 #include <opencv2/core/types_c.h>
+#include "PoseSolver.h"
 
 
 
@@ -15,6 +16,37 @@ void estimateSquarePose_(float* result, CvPoint2D32f* p2D, float markerSize);
 
 
 void estimateSquarePose(float* result, const cv::Point2f* p2D_, float markerSize);
+
+
+/**
+ * computes the orientation and translation of a square seen by a calibrated camera
+ * @param result result as 4x4 matrix in row-major format
+ * @param p2D_ undistorted coordinates of the four corners in counter-clock-wise order,
+ *        relative to the principal point with y pointing up
+ * @param markerSize side-length of marker. Origin is at marker center.
+ * @param focalX focal length along x in pixels
+ * @param focalY focal length along y in pixels
+ */
+void estimateSquarePose(float* result, const cv::Point2f* p2D_, float markerSize, float focalX, float focalY);
+
+
+/**
+ * computes the orientation and translation of a square, starting from a prior pose of the
+ * same marker when it still fits, and refining only until the pose converges
+ * @param result result as 4x4 matrix in row-major format
+ * @param pose the 7 pose parameters (quaternion x, y, z, w, then translation), holding the
+ *        prior on input if hasPrior is set, and the new pose on output
+ * @param hasPrior true if pose holds a prior to try before the homography
+ * @param p2D_ undistorted coordinates of the four corners in counter-clock-wise order,
+ *        relative to the principal point with y pointing up
+ * @param markerSize side-length of marker. Origin is at marker center.
+ * @param focalX focal length along x in pixels
+ * @param focalY focal length along y in pixels
+ * @param options iteration cap and tolerances of the refinement
+ * @return number of refinement iterations run
+ */
+int estimateSquarePose(float* result, float* pose, bool hasPrior, const cv::Point2f* p2D_, float markerSize,
+	float focalX, float focalY, const PoseSolver::RefineOptions<float> &options);
 /**
  * Returns Matrix in Row-major format
  * @param result a 3x3 homogeneous matrix
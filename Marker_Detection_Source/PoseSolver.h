@@ -0,0 +1,693 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header-only fixed-size solver for the pose of a square marker
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* Standard includes */
+#include <cmath>
+
+
+/*  Pose estimation of a square marker from its four corners, in the same steps as the
+ *	original Ubitrack based code: a homography gives an initial pose, which is then refined
+ *	with a few Levenberg-Marquardt iterations on the reprojection error.
+ *	Everything is templated on the scalar type and the number of points, so all of the
+ *	matrices have a fixed size and live on the stack. Solves over a number of points only
+ *	known at run time, such as a board of markers, take their scratch space from the caller.
+ *
+ *	A pose is stored as 7 parameters: the rotation quaternion (x, y, z, w) followed by the
+ *	translation. Image points are undistorted, relative to the principal point with y up,
+ *	and the camera looks down the negative z axis. The focal length can differ along x and y.
+ */
+namespace PoseSolver
+{
+	/*  Stopping rules of the pose refinement, and when a previous pose may replace the homography */
+	template<class T>
+	struct RefineOptions
+	{
+		int maxIterations;		// Most Levenberg-Marquardt iterations
+		T errorTolerance;		// Stop once the RMS reprojection error is at most this many pixels
+		T stepTolerance;		// Stop once a step moves the quaternion and the relative translation by at most this
+		T priorTolerance;		// Largest RMS reprojection error in pixels of a prior pose for it to be used
+	};
+
+
+	/*  Computes the homography mapping the unit square onto a quadrangle
+	 *	Based on Harker & O'Leary, simplified for squares. The corners are centred on their
+	 *	mean, so the 4x3 system for the bottom row of the homography has the form [r; -r; s; -s]
+	 *	and its null vector is the cross product of r and s.
+	 *
+	 *	@param H: Container to hold the 3x3 homography in row-major order
+	 *	@param quad: The four corners as x0, y0, x1, y1, ... in counter-clockwise order
+	 *
+	 *	@return valid: False if the corners are collinear
+	 */
+	template<class T>
+	bool squareHomography(T* H, const T* quad) {
+
+		// Subtract the mean from the corners
+		T meanX = (quad[0] + quad[2] + quad[4] + quad[6]) / 4;
+		T meanY = (quad[1] + quad[3] + quad[5] + quad[7]) / 4;
+		T cx[4], cy[4];
+		for (int i = 0; i < 4; i++) {
+			cx[i] = quad[2 * i] - meanX;
+			cy[i] = quad[2 * i + 1] - meanY;
+		}
+
+		// The two independent rows of the system, each averaged with its negated twin
+		T r[3], s[3];
+		r[0] = cx[0] - cx[1] - cx[2] + cx[3];
+		r[1] = -cx[0] - cx[1] + cx[2] + cx[3];
+		r[2] = (cx[1] + cx[3] - cx[0] - cx[2]);
+		s[0] = cy[0] - cy[1] - cy[2] + cy[3];
+		s[1] = -cy[0] - cy[1] + cy[2] + cy[3];
+		s[2] = (cy[1] + cy[3] - cy[0] - cy[2]);
+
+		// The null vector is the normalized cross product of the rows
+		T v[3] = { r[1] * s[2] - r[2] * s[1], r[2] * s[0] - r[0] * s[2], r[0] * s[1] - r[1] * s[0] };
+		T length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (!(length > 0)) {
+			return false;
+		}
+		for (int i = 0; i < 3; i++) {
+			v[i] /= length;
+		}
+
+		// Compute the first two rows from the bottom one, multiplied by 2 to compensate scaling
+		H[0] = ((cx[0] + cx[1] + cx[2] + cx[3]) * v[0] + (-cx[0] + cx[1] - cx[2] + cx[3]) * v[1] +
+			(-cx[0] - cx[1] + cx[2] + cx[3]) * v[2]) / 2;
+		H[1] = ((-cx[0] + cx[1] - cx[2] + cx[3]) * v[0] + (cx[0] + cx[1] + cx[2] + cx[3]) * v[1] +
+			(cx[0] - cx[1] - cx[2] + cx[3]) * v[2]) / 2;
+		H[3] = ((cy[0] + cy[1] + cy[2] + cy[3]) * v[0] + (-cy[0] + cy[1] - cy[2] + cy[3]) * v[1] +
+			(-cy[0] - cy[1] + cy[2] + cy[3]) * v[2]) / 2;
+		H[4] = ((-cy[0] + cy[1] - cy[2] + cy[3]) * v[0] + (cy[0] + cy[1] + cy[2] + cy[3]) * v[1] +
+			(cy[0] - cy[1] - cy[2] + cy[3]) * v[2]) / 2;
+		H[2] = ((cx[0] + cx[1] - cx[2] - cx[3]) * v[0] + (-cx[0] + cx[1] + cx[2] - cx[3]) * v[1]) / -4;
+		H[5] = ((cy[0] + cy[1] - cy[2] - cy[3]) * v[0] + (-cy[0] + cy[1] + cy[2] - cy[3]) * v[1]) / -4;
+		H[6] = v[0] * 2;
+		H[7] = v[1] * 2;
+		H[8] = v[2];
+
+		// Undo the mean subtraction
+		for (int i = 0; i < 3; i++) {
+			H[i] += H[6 + i] * meanX;
+			H[3 + i] += H[6 + i] * meanY;
+		}
+
+		return true;
+	}
+
+
+	/*  Converts a rotation matrix to a unit quaternion
+	 *	Based on Horn: the largest entry of the quaternion is found first and used to get the others.
+	 *
+	 *	@param m: The 3x3 rotation matrix in row-major order
+	 *	@param q: Container to hold the quaternion (x, y, z, w)
+	 *
+	 *	@return void
+	 */
+	template<class T>
+	void matrixToQuaternion(const T* m, T* q) {
+
+		// Find the entry with the largest absolute value, from 4 * q[..]^2 - 1
+		T tmp[4];
+		tmp[3] = m[0] + m[4] + m[8];
+		tmp[0] = m[0] - m[4] - m[8];
+		tmp[1] = -m[0] + m[4] - m[8];
+		tmp[2] = -m[0] - m[4] + m[8];
+		int max = 3;
+		for (int i = 0; i < 3; i++) {
+			if (tmp[i] > tmp[max]) {
+				max = i;
+			}
+		}
+
+		// Compute the other entries from the largest one
+		q[max] = std::sqrt(tmp[max] + 1) / 2;
+		T scale = 1 / (4 * q[max]);
+		switch (max) {
+		case 3:
+			q[0] = (m[7] - m[5]) * scale;
+			q[1] = (m[2] - m[6]) * scale;
+			q[2] = (m[3] - m[1]) * scale;
+			break;
+		case 0:
+			q[3] = (m[7] - m[5]) * scale;
+			q[1] = (m[3] + m[1]) * scale;
+			q[2] = (m[2] + m[6]) * scale;
+			break;
+		case 1:
+			q[3] = (m[2] - m[6]) * scale;
+			q[0] = (m[3] + m[1]) * scale;
+			q[2] = (m[7] + m[5]) * scale;
+			break;
+		default:
+			q[3] = (m[3] - m[1]) * scale;
+			q[0] = (m[2] + m[6]) * scale;
+			q[1] = (m[7] + m[5]) * scale;
+			break;
+		}
+
+		// Normalize the quaternion
+		T norm = 1 / std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		for (int i = 0; i < 4; i++) {
+			q[i] *= norm;
+		}
+	}
+
+
+	/*  Computes the initial pose of a square from its homography
+	 *	The rotation is R = C^-1 H S^-1, with the camera matrix C and the marker scaling S,
+	 *	after which the columns are orthonormalized.
+	 *
+	 *	@param pose: Container to hold the 7 pose parameters
+	 *	@param H: The homography from squareHomography
+	 *	@param markerSize: The side length of the marker
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *
+	 *	@return void
+	 */
+	template<class T>
+	void poseFromHomography(T* pose, const T* H, T markerSize, T fx, T fy) {
+
+		// Remove the camera and marker scaling
+		const T scaleLeft[3] = { 1 / fx, 1 / fy, -1 };
+		const T scaleRight[3] = { 1 / markerSize, 1 / markerSize, 1 };
+		T R[9];
+		for (int r = 0; r < 3; r++) {
+			for (int c = 0; c < 3; c++) {
+				R[3 * r + c] = H[3 * r + c] * scaleLeft[r] * scaleRight[c];
+			}
+		}
+
+		// The marker must be in front of the camera, which fixes the sign of the homography
+		if (R[8] > 0) {
+			for (int i = 0; i < 9; i++) {
+				R[i] = -R[i];
+			}
+		}
+
+		// Scale the translation by the average length of the first two columns
+		T xLen = std::sqrt(R[0] * R[0] + R[3] * R[3] + R[6] * R[6]);
+		T yLen = std::sqrt(R[1] * R[1] + R[4] * R[4] + R[7] * R[7]);
+		T transScale = 2 / (xLen + yLen);
+		for (int i = 0; i < 3; i++) {
+			pose[4 + i] = R[3 * i + 2] * transScale;
+		}
+
+		// Normalize the first two columns, the third is their cross product
+		for (int i = 0; i < 3; i++) {
+			R[3 * i] /= xLen;
+			R[3 * i + 1] /= yLen;
+		}
+		T z[3] = { R[3] * R[7] - R[6] * R[4], R[6] * R[1] - R[0] * R[7], R[0] * R[4] - R[3] * R[1] };
+		T zLen = std::sqrt(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		for (int i = 0; i < 3; i++) {
+			R[3 * i + 2] = z[i] / zLen;
+		}
+
+		// Recompute the second column from the other two, so that the matrix is orthogonal
+		R[1] = -(R[3] * R[8] - R[6] * R[5]);
+		R[4] = -(R[6] * R[2] - R[0] * R[8]);
+		R[7] = -(R[0] * R[5] - R[3] * R[2]);
+
+		matrixToQuaternion(R, pose);
+	}
+
+
+	/*  Projects a marker point into the image
+	 *
+	 *	@param image: Container to hold the image coordinates of the point
+	 *	@param point: The 3D point in marker coordinates
+	 *	@param pose: The 7 pose parameters, whose quaternion need not be unit length
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *
+	 *	@return void
+	 */
+	template<class T>
+	void projectPoint(T* image, const T* point, const T* pose, T fx, T fy) {
+
+		const T* q = pose;
+		T xy = q[0] * q[1], xz = q[0] * q[2], yz = q[1] * q[2];
+		T ww = q[3] * q[3], wx = q[3] * q[0], wy = q[3] * q[1], wz = q[3] * q[2];
+
+		// Rotate, then translate
+		T p[3];
+		p[0] = point[0] * (2 * (q[0] * q[0] + ww) - 1) + point[1] * 2 * (xy - wz) + point[2] * 2 * (wy + xz);
+		p[1] = point[0] * 2 * (xy + wz) + point[1] * (2 * (q[1] * q[1] + ww) - 1) + point[2] * 2 * (yz - wx);
+		p[2] = point[0] * 2 * (xz - wy) + point[1] * 2 * (wx + yz) + point[2] * (2 * (q[2] * q[2] + ww) - 1);
+		for (int i = 0; i < 3; i++) {
+			p[i] += pose[4 + i];
+		}
+
+		image[0] = p[0] * (-fx / p[2]);
+		image[1] = p[1] * (-fy / p[2]);
+	}
+
+
+	/*  Computes the reprojection error of every point
+	 *
+	 *	@param error: Container to hold (measured - projected) for each point, 2 * count values
+	 *	@param points3D: The 3D points in marker coordinates
+	 *	@param points2D: The measured image points
+	 *	@param count: The number of points
+	 *	@param pose: The 7 pose parameters
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *
+	 *	@return errorSq: The sum of squared errors
+	 */
+	template<class T>
+	T reprojectionError(T* error, const T (*points3D)[3], const T (*points2D)[2], int count, const T* pose, T fx, T fy) {
+
+		T errorSq = 0;
+		for (int i = 0; i < count; i++) {
+			T projected[2];
+			projectPoint(projected, points3D[i], pose, fx, fy);
+			error[2 * i] = points2D[i][0] - projected[0];
+			error[2 * i + 1] = points2D[i][1] - projected[1];
+			errorSq += error[2 * i] * error[2 * i] + error[2 * i + 1] * error[2 * i + 1];
+		}
+
+		return errorSq;
+	}
+
+
+	/*  Computes the reprojection error of every point of a fixed-size set
+	 *
+	 *	@param error: Container to hold (measured - projected) for each point
+	 *	@param points3D: The 3D points in marker coordinates
+	 *	@param points2D: The measured image points
+	 *	@param pose: The 7 pose parameters
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *
+	 *	@return errorSq: The sum of squared errors
+	 */
+	template<class T, int N>
+	T reprojectionError(T (&error)[2 * N], const T (&points3D)[N][3], const T (&points2D)[N][2], const T* pose, T fx, T fy) {
+		return reprojectionError(error, points3D, points2D, N, pose, fx, fy);
+	}
+
+
+	/*  Computes the 2x7 Jacobian of the projection of a point with respect to the pose
+	 *
+	 *	@param J: Container to hold the Jacobian in row-major order
+	 *	@param pose: The 7 pose parameters
+	 *	@param point: The 3D point in marker coordinates
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *
+	 *	@return void
+	 */
+	template<class T>
+	void projectionJacobian(T* J, const T* pose, const T* point, T fx, T fy) {
+
+		// Generated code, from the original implementation, with the x row scaled by fx and the y row by fy
+		const T* p = pose;
+		T t4 = p[0] * point[0] + p[1] * point[1] + p[2] * point[2];
+		T t10 = p[3] * point[0] + p[1] * point[2] - p[2] * point[1];
+		T t15 = p[3] * point[1] - p[0] * point[2] + p[2] * point[0];
+		T t20 = p[3] * point[2] + p[0] * point[1] - p[1] * point[0];
+		T t22 = -t4 * p[2] + t10 * p[1] - t15 * p[0] - t20 * p[3] - p[6];
+		T t23 = 1 / t22;
+		T t24x = 2 * fx * t4 * t23;
+		T t24y = 2 * fy * t4 * t23;
+		T t30 = fx * (t4 * p[0] + t10 * p[3] - t15 * p[2] + t20 * p[1] + p[4]);
+		T t32 = 1 / (t22 * t22);
+		T t33 = -2 * t32 * t15;
+		T t38 = 2 * t32 * t10;
+		T t43 = -2 * t32 * t4;
+		T t47x = 2 * fx * t10 * t23;
+		T t47y = 2 * fy * t10 * t23;
+		T t48 = -2 * t32 * t20;
+		T t51x = fx * t23;
+		T t51y = fy * t23;
+		T t60 = fy * (t4 * p[1] + t10 * p[2] + t15 * p[3] - t20 * p[0] + p[5]);
+
+		J[0] = t24x - t30 * t33;
+		J[1] = 2 * fx * t20 * t23 - t30 * t38;
+		J[2] = -2 * fx * t15 * t23 - t30 * t43;
+		J[3] = t47x - t30 * t48;
+		J[4] = t51x;
+		J[5] = 0;
+		J[6] = t30 * t32;
+		J[7] = -2 * fy * t20 * t23 - t60 * t33;
+		J[8] = t24y - t60 * t38;
+		J[9] = t47y - t60 * t43;
+		J[10] = 2 * fy * t15 * t23 - t60 * t48;
+		J[11] = 0;
+		J[12] = t51y;
+		J[13] = t60 * t32;
+	}
+
+
+	/*  Solves A x = b in place for a symmetric positive definite matrix, by Cholesky decomposition
+	 *	Only the lower triangle of A is read, and it is overwritten with the factor.
+	 *
+	 *	@param A: The K x K matrix in row-major order
+	 *	@param b: The right hand side, overwritten with the solution
+	 *
+	 *	@return solved: False if the matrix is not positive definite
+	 */
+	template<class T, int K>
+	bool choleskySolve(T (&A)[K][K], T (&b)[K]) {
+
+		// Factor A = L L^T, keeping the inverse of the diagonal so that only one division is needed per column
+		T inverseDiagonal[K];
+		for (int j = 0; j < K; j++) {
+			T diagonal = A[j][j];
+			for (int k = 0; k < j; k++) {
+				diagonal -= A[j][k] * A[j][k];
+			}
+			if (!(diagonal > 0)) {
+				return false;
+			}
+			inverseDiagonal[j] = 1 / std::sqrt(diagonal);
+			A[j][j] = diagonal * inverseDiagonal[j];
+
+			for (int i = j + 1; i < K; i++) {
+				T sum = A[i][j];
+				for (int k = 0; k < j; k++) {
+					sum -= A[i][k] * A[j][k];
+				}
+				A[i][j] = sum * inverseDiagonal[j];
+			}
+		}
+
+		// Forward substitution with L, then back substitution with L^T
+		for (int i = 0; i < K; i++) {
+			for (int k = 0; k < i; k++) {
+				b[i] -= A[i][k] * b[k];
+			}
+			b[i] *= inverseDiagonal[i];
+		}
+		for (int i = K - 1; i >= 0; i--) {
+			for (int k = i + 1; k < K; k++) {
+				b[i] -= A[k][i] * b[k];
+			}
+			b[i] *= inverseDiagonal[i];
+		}
+
+		return true;
+	}
+
+
+	/*  Factors the length of the quaternion into the translation, making it a unit quaternion
+	 *
+	 *	@param pose: The 7 pose parameters
+	 *
+	 *	@return void
+	 */
+	template<class T>
+	void normalizePose(T* pose) {
+
+		T lengthSq = pose[0] * pose[0] + pose[1] * pose[1] + pose[2] * pose[2] + pose[3] * pose[3];
+		T length = std::sqrt(lengthSq);
+		for (int i = 0; i < 4; i++) {
+			pose[i] /= length;
+		}
+		for (int i = 4; i < 7; i++) {
+			pose[i] /= lengthSq;
+		}
+	}
+
+
+	/*  Tells whether an accepted step was small enough for the refinement to stop
+	 *	The quaternion is unit length, so its step is compared as is, while the translation
+	 *	step is compared relative to the length of the translation.
+	 *
+	 *	@param step: The 7 parameter step that was taken
+	 *	@param pose: The 7 pose parameters after the step
+	 *	@param tolerance: The step tolerance of the refinement
+	 *
+	 *	@return converged: True if the step is below the tolerance
+	 */
+	template<class T>
+	bool stepConverged(const T* step, const T* pose, T tolerance) {
+
+		for (int i = 0; i < 4; i++) {
+			if (std::fabs(step[i]) > tolerance) {
+				return false;
+			}
+		}
+		T stepSq = step[4] * step[4] + step[5] * step[5] + step[6] * step[6];
+		T translationSq = pose[4] * pose[4] + pose[5] * pose[5] + pose[6] * pose[6];
+		return stepSq <= tolerance * tolerance * translationSq;
+	}
+
+
+	/*  Refines a pose with Levenberg-Marquardt on the reprojection error
+	 *	The normal equations are accumulated point by point, so the full Jacobian is never stored.
+	 *	The refinement stops early once the error or an accepted step falls below its tolerance,
+	 *	so a pose that starts close to the optimum costs one or two iterations.
+	 *	Nothing is allocated: the two error buffers come from the caller.
+	 *
+	 *	@param pose: The 7 pose parameters, used both as initial value and output
+	 *	@param points3D: The 3D points in marker coordinates
+	 *	@param points2D: The measured image points
+	 *	@param count: The number of points
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *	@param options: The iteration cap and the tolerances to stop at
+	 *	@param iterations: Container to hold the number of iterations run
+	 *	@param error: Scratch space of 2 * count values
+	 *	@param newError: Scratch space of 2 * count values
+	 *
+	 *	@return errorSq: The sum of squared reprojection errors of the final pose
+	 */
+	template<class T>
+	T optimizePose(T* pose, const T (*points3D)[3], const T (*points2D)[2], int count, T fx, T fy,
+		const RefineOptions<T> &options, int &iterations, T* error, T* newError) {
+
+		T previousError = reprojectionError(error, points3D, points2D, count, pose, fx, fy);
+		T lambda = 1;
+		T errorLimit = options.errorTolerance * options.errorTolerance * count;
+
+		for (iterations = 0; iterations < options.maxIterations; iterations++) {
+
+			if (previousError <= errorLimit) {
+				break;
+			}
+
+			// Accumulate J^T J and J^T e over the points
+			T JtJ[7][7] = {};
+			T step[7] = {};
+			for (int i = 0; i < count; i++) {
+				T J[14];
+				projectionJacobian(J, pose, points3D[i], fx, fy);
+				for (int r = 0; r < 7; r++) {
+					step[r] += J[r] * error[2 * i] + J[7 + r] * error[2 * i + 1];
+					for (int c = 0; c <= r; c++) {
+						JtJ[r][c] += J[r] * J[c] + J[7 + r] * J[7 + c];
+					}
+				}
+			}
+
+			// Add lambda to the diagonal and solve for the step
+			for (int i = 0; i < 7; i++) {
+				JtJ[i][i] += lambda;
+			}
+			if (!choleskySolve(JtJ, step)) {
+				lambda *= 10;
+				continue;
+			}
+
+			T candidate[7];
+			for (int i = 0; i < 7; i++) {
+				candidate[i] = pose[i] + step[i];
+			}
+			normalizePose(candidate);
+
+			// Keep the step only if it lowers the error
+			T candidateError = reprojectionError(newError, points3D, points2D, count, candidate, fx, fy);
+			if (candidateError >= previousError) {
+				lambda *= 10;
+				continue;
+			}
+
+			lambda /= 10;
+			for (int i = 0; i < 7; i++) {
+				pose[i] = candidate[i];
+			}
+			T* swap = error;
+			error = newError;
+			newError = swap;
+			previousError = candidateError;
+
+			if (stepConverged(step, pose, options.stepTolerance)) {
+				iterations++;
+				break;
+			}
+		}
+
+		return previousError;
+	}
+
+
+	/*  Refines a pose with Levenberg-Marquardt on the reprojection error of a fixed-size set of points
+	 *
+	 *	@param pose: The 7 pose parameters, used both as initial value and output
+	 *	@param points3D: The 3D points in marker coordinates
+	 *	@param points2D: The measured image points
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *	@param options: The iteration cap and the tolerances to stop at
+	 *	@param iterations: Container to hold the number of iterations run
+	 *
+	 *	@return errorSq: The sum of squared reprojection errors of the final pose
+	 */
+	template<class T, int N>
+	T optimizePose(T* pose, const T (&points3D)[N][3], const T (&points2D)[N][2], T fx, T fy,
+		const RefineOptions<T> &options, int &iterations) {
+		T error[2 * N], newError[2 * N];
+		return optimizePose(pose, points3D, points2D, N, fx, fy, options, iterations, error, newError);
+	}
+
+
+	/*  Refines a pose with a fixed number of Levenberg-Marquardt iterations, as the original code did
+	 *
+	 *	@param pose: The 7 pose parameters, used both as initial value and output
+	 *	@param points3D: The 3D points in marker coordinates
+	 *	@param points2D: The measured image points
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *	@param maxIterations: The number of iterations to run
+	 *
+	 *	@return errorSq: The sum of squared reprojection errors of the final pose
+	 */
+	template<class T, int N>
+	T optimizePose(T* pose, const T (&points3D)[N][3], const T (&points2D)[N][2], T fx, T fy, int maxIterations = 3) {
+		const RefineOptions<T> options = { maxIterations, 0, 0, 0 };
+		int iterations;
+		return optimizePose(pose, points3D, points2D, fx, fy, options, iterations);
+	}
+
+
+	/*  Converts pose parameters to a 4x4 transformation matrix in row-major order
+	 *
+	 *	@param mat: Container to hold the 16 entries of the matrix
+	 *	@param pose: The 7 pose parameters with a unit quaternion
+	 *
+	 *	@return void
+	 */
+	template<class T>
+	void poseToMatrix(T* mat, const T* pose) {
+
+		T X = -pose[0], Y = -pose[1], Z = -pose[2], W = pose[3];
+		T xx = X * X, xy = X * Y, xz = X * Z, xw = X * W;
+		T yy = Y * Y, yz = Y * Z, yw = Y * W;
+		T zz = Z * Z, zw = Z * W;
+
+		mat[0] = 1 - 2 * (yy + zz);
+		mat[1] = 2 * (xy + zw);
+		mat[2] = 2 * (xz - yw);
+		mat[4] = 2 * (xy - zw);
+		mat[5] = 1 - 2 * (xx + zz);
+		mat[6] = 2 * (yz + xw);
+		mat[8] = 2 * (xz + yw);
+		mat[9] = 2 * (yz - xw);
+		mat[10] = 1 - 2 * (xx + yy);
+
+		mat[3] = pose[4];
+		mat[7] = pose[5];
+		mat[11] = pose[6];
+		mat[12] = mat[13] = mat[14] = 0;
+		mat[15] = 1;
+	}
+
+
+	/*  Computes the pose of a square marker from its four corners
+	 *
+	 *	@param mat: Container to hold the pose as a 4x4 matrix in row-major order
+	 *	@param corners: The undistorted corners as x0, y0, x1, y1, ... in counter-clockwise order,
+	 *		relative to the principal point
+	 *	@param markerSize: The side length of the marker, whose origin is at its centre
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *
+	 *	@return valid: False if the corners are degenerate
+	 */
+	template<class T>
+	bool estimateSquarePose(T* mat, const T* corners, T markerSize, T fx, T fy) {
+
+		T H[9];
+		if (!squareHomography(H, corners)) {
+			return false;
+		}
+
+		T pose[7];
+		poseFromHomography(pose, H, markerSize, fx, fy);
+
+		// Corner coordinates on the marker, counter-clockwise
+		T half = markerSize / 2;
+		const T points3D[4][3] = { { -half, half, 0 }, { -half, -half, 0 }, { half, -half, 0 }, { half, half, 0 } };
+		T points2D[4][2];
+		for (int i = 0; i < 4; i++) {
+			points2D[i][0] = corners[2 * i];
+			points2D[i][1] = corners[2 * i + 1];
+		}
+		optimizePose(pose, points3D, points2D, fx, fy);
+
+		poseToMatrix(mat, pose);
+		return true;
+	}
+
+
+	/*  Computes the pose of a square marker from its four corners, starting from a prior pose
+	 *	The prior, usually the pose of the same marker in the previous frame, replaces the
+	 *	homography as the initial pose if it reprojects within the prior tolerance. The refinement
+	 *	then stops as soon as it converges.
+	 *
+	 *	@param mat: Container to hold the pose as a 4x4 matrix in row-major order
+	 *	@param pose: The 7 pose parameters, holding the prior on input if there is one, and the refined pose on output
+	 *	@param hasPrior: True if pose holds a prior to try
+	 *	@param corners: The undistorted corners as x0, y0, x1, y1, ... in counter-clockwise order,
+	 *		relative to the principal point
+	 *	@param markerSize: The side length of the marker, whose origin is at its centre
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *	@param options: The iteration cap and the tolerances of the refinement
+	 *
+	 *	@return iterations: The number of refinement iterations run, or -1 if the corners are degenerate
+	 */
+	template<class T>
+	int estimateSquarePose(T* mat, T* pose, bool hasPrior, const T* corners, T markerSize, T fx, T fy,
+		const RefineOptions<T> &options) {
+
+		// Corner coordinates on the marker, counter-clockwise
+		T half = markerSize / 2;
+		const T points3D[4][3] = { { -half, half, 0 }, { -half, -half, 0 }, { half, -half, 0 }, { half, half, 0 } };
+		T points2D[4][2];
+		for (int i = 0; i < 4; i++) {
+			points2D[i][0] = corners[2 * i];
+			points2D[i][1] = corners[2 * i + 1];
+		}
+
+		// Keep the prior only if it still fits the corners, which also rejects a prior that is not finite
+		bool warm = false;
+		if (hasPrior) {
+			T error[8];
+			T errorSq = reprojectionError(error, points3D, points2D, pose, fx, fy);
+			warm = errorSq <= options.priorTolerance * options.priorTolerance * 4;
+		}
+		if (!warm) {
+			T H[9];
+			if (!squareHomography(H, corners)) {
+				return -1;
+			}
+			poseFromHomography(pose, H, markerSize, fx, fy);
+		}
+
+		int iterations;
+		optimizePose(pose, points3D, points2D, fx, fy, options, iterations);
+
+		poseToMatrix(mat, pose);
+		return iterations;
+	}
+}
@@ -0,0 +1,731 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header-only pose solver for several square markers at once, one marker per vector lane
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* Standard includes */
+#include <cmath>
+
+/* SIMD includes */
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MARKER_LANES_SSE2 1
+#endif
+
+/* Helper includes */
+#include "KernelDispatch.h"
+#include "PoseSolver.h"
+
+
+/*  The steps of PoseSolver, rewritten so that every value holds one marker per vector lane:
+ *	16 lanes with AVX-512, 8 with AVX2 and 4 with SSE2 or plain C++. Each step performs the
+ *	same operations in the same order as the scalar solver, and branches become per lane masks,
+ *	so a lane only stops refining once its own marker has converged.
+ *	Everything lives in the MARKER_ISA namespace, so that each instruction set level compiled
+ *	by the build gets its own copy and none of them can be picked up by another level.
+ */
+namespace MARKER_ISA {
+namespace PoseSolverBatch
+{
+#if defined(__AVX512F__)
+	static const int LANES = 16;
+
+	/*  One float per lane */
+	struct FloatLanes
+	{
+		__m512 v;
+		FloatLanes() : v(_mm512_setzero_ps()) {}
+		FloatLanes(float x) : v(_mm512_set1_ps(x)) {}
+		explicit FloatLanes(__m512 x) : v(x) {}
+	};
+
+	/*  One condition per lane */
+	struct MaskLanes
+	{
+		__mmask16 m;
+		explicit MaskLanes(__mmask16 x) : m(x) {}
+	};
+
+	inline FloatLanes loadLanes(const float* p) { return FloatLanes(_mm512_loadu_ps(p)); }
+	inline void storeLanes(float* p, const FloatLanes &a) { _mm512_storeu_ps(p, a.v); }
+	inline FloatLanes operator+(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm512_add_ps(a.v, b.v)); }
+	inline FloatLanes operator-(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm512_sub_ps(a.v, b.v)); }
+	inline FloatLanes operator*(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm512_mul_ps(a.v, b.v)); }
+	inline FloatLanes operator/(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm512_div_ps(a.v, b.v)); }
+	inline FloatLanes operator-(const FloatLanes &a) {
+		return FloatLanes(_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(a.v), _mm512_set1_epi32((int)0x80000000))));
+	}
+MARKER_BEGIN_UNDEFINED_LANES
+	inline FloatLanes sqrtLanes(const FloatLanes &a) { return FloatLanes(_mm512_sqrt_ps(a.v)); }
+MARKER_END_UNDEFINED_LANES
+	inline FloatLanes absLanes(const FloatLanes &a) { return FloatLanes(_mm512_abs_ps(a.v)); }
+	inline MaskLanes operator<(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LT_OQ)); }
+	inline MaskLanes operator<=(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm512_cmp_ps_mask(a.v, b.v, _CMP_LE_OQ)); }
+	inline MaskLanes operator>(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GT_OQ)); }
+	inline MaskLanes operator>=(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm512_cmp_ps_mask(a.v, b.v, _CMP_GE_OQ)); }
+	inline MaskLanes operator&(const MaskLanes &a, const MaskLanes &b) { return MaskLanes((__mmask16)(a.m & b.m)); }
+	inline MaskLanes operator|(const MaskLanes &a, const MaskLanes &b) { return MaskLanes((__mmask16)(a.m | b.m)); }
+	inline MaskLanes operator!(const MaskLanes &a) { return MaskLanes((__mmask16)~a.m); }
+	inline FloatLanes select(const MaskLanes &mask, const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm512_mask_blend_ps(mask.m, b.v, a.v)); }
+	inline bool anyLane(const MaskLanes &mask) { return mask.m != 0; }
+	inline bool laneSet(const MaskLanes &mask, int lane) { return ((mask.m >> lane) & 1) != 0; }
+	inline MaskLanes firstLanes(int count) { return MaskLanes((__mmask16)((count >= 16) ? 0xFFFF : (1 << count) - 1)); }
+
+#elif defined(__AVX2__)
+	static const int LANES = 8;
+
+	/*  One float per lane */
+	struct FloatLanes
+	{
+		__m256 v;
+		FloatLanes() : v(_mm256_setzero_ps()) {}
+		FloatLanes(float x) : v(_mm256_set1_ps(x)) {}
+		explicit FloatLanes(__m256 x) : v(x) {}
+	};
+
+	/*  One condition per lane, as all ones or all zeros */
+	struct MaskLanes
+	{
+		__m256 m;
+		explicit MaskLanes(__m256 x) : m(x) {}
+	};
+
+	inline FloatLanes loadLanes(const float* p) { return FloatLanes(_mm256_loadu_ps(p)); }
+	inline void storeLanes(float* p, const FloatLanes &a) { _mm256_storeu_ps(p, a.v); }
+	inline FloatLanes operator+(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm256_add_ps(a.v, b.v)); }
+	inline FloatLanes operator-(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm256_sub_ps(a.v, b.v)); }
+	inline FloatLanes operator*(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm256_mul_ps(a.v, b.v)); }
+	inline FloatLanes operator/(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm256_div_ps(a.v, b.v)); }
+	inline FloatLanes operator-(const FloatLanes &a) { return FloatLanes(_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f))); }
+	inline FloatLanes sqrtLanes(const FloatLanes &a) { return FloatLanes(_mm256_sqrt_ps(a.v)); }
+	inline FloatLanes absLanes(const FloatLanes &a) { return FloatLanes(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)); }
+	inline MaskLanes operator<(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)); }
+	inline MaskLanes operator<=(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)); }
+	inline MaskLanes operator>(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ)); }
+	inline MaskLanes operator>=(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)); }
+	inline MaskLanes operator&(const MaskLanes &a, const MaskLanes &b) { return MaskLanes(_mm256_and_ps(a.m, b.m)); }
+	inline MaskLanes operator|(const MaskLanes &a, const MaskLanes &b) { return MaskLanes(_mm256_or_ps(a.m, b.m)); }
+	inline MaskLanes operator!(const MaskLanes &a) { return MaskLanes(_mm256_xor_ps(a.m, _mm256_castsi256_ps(_mm256_set1_epi32(-1)))); }
+	inline FloatLanes select(const MaskLanes &mask, const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm256_blendv_ps(b.v, a.v, mask.m)); }
+	inline bool anyLane(const MaskLanes &mask) { return _mm256_movemask_ps(mask.m) != 0; }
+	inline bool laneSet(const MaskLanes &mask, int lane) { return ((_mm256_movemask_ps(mask.m) >> lane) & 1) != 0; }
+	inline MaskLanes firstLanes(int count) {
+		return MaskLanes(_mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32(count), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))));
+	}
+
+#elif defined(MARKER_LANES_SSE2)
+	static const int LANES = 4;
+
+	/*  One float per lane */
+	struct FloatLanes
+	{
+		__m128 v;
+		FloatLanes() : v(_mm_setzero_ps()) {}
+		FloatLanes(float x) : v(_mm_set1_ps(x)) {}
+		explicit FloatLanes(__m128 x) : v(x) {}
+	};
+
+	/*  One condition per lane, as all ones or all zeros */
+	struct MaskLanes
+	{
+		__m128 m;
+		explicit MaskLanes(__m128 x) : m(x) {}
+	};
+
+	inline FloatLanes loadLanes(const float* p) { return FloatLanes(_mm_loadu_ps(p)); }
+	inline void storeLanes(float* p, const FloatLanes &a) { _mm_storeu_ps(p, a.v); }
+	inline FloatLanes operator+(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm_add_ps(a.v, b.v)); }
+	inline FloatLanes operator-(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm_sub_ps(a.v, b.v)); }
+	inline FloatLanes operator*(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm_mul_ps(a.v, b.v)); }
+	inline FloatLanes operator/(const FloatLanes &a, const FloatLanes &b) { return FloatLanes(_mm_div_ps(a.v, b.v)); }
+	inline FloatLanes operator-(const FloatLanes &a) { return FloatLanes(_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))); }
+	inline FloatLanes sqrtLanes(const FloatLanes &a) { return FloatLanes(_mm_sqrt_ps(a.v)); }
+	inline FloatLanes absLanes(const FloatLanes &a) { return FloatLanes(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+	inline MaskLanes operator<(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm_cmplt_ps(a.v, b.v)); }
+	inline MaskLanes operator<=(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm_cmple_ps(a.v, b.v)); }
+	inline MaskLanes operator>(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm_cmpgt_ps(a.v, b.v)); }
+	inline MaskLanes operator>=(const FloatLanes &a, const FloatLanes &b) { return MaskLanes(_mm_cmpge_ps(a.v, b.v)); }
+	inline MaskLanes operator&(const MaskLanes &a, const MaskLanes &b) { return MaskLanes(_mm_and_ps(a.m, b.m)); }
+	inline MaskLanes operator|(const MaskLanes &a, const MaskLanes &b) { return MaskLanes(_mm_or_ps(a.m, b.m)); }
+	inline MaskLanes operator!(const MaskLanes &a) { return MaskLanes(_mm_xor_ps(a.m, _mm_castsi128_ps(_mm_set1_epi32(-1)))); }
+	inline FloatLanes select(const MaskLanes &mask, const FloatLanes &a, const FloatLanes &b) {
+		return FloatLanes(_mm_or_ps(_mm_and_ps(mask.m, a.v), _mm_andnot_ps(mask.m, b.v)));
+	}
+	inline bool anyLane(const MaskLanes &mask) { return _mm_movemask_ps(mask.m) != 0; }
+	inline bool laneSet(const MaskLanes &mask, int lane) { return ((_mm_movemask_ps(mask.m) >> lane) & 1) != 0; }
+	inline MaskLanes firstLanes(int count) {
+		return MaskLanes(_mm_castsi128_ps(_mm_cmpgt_epi32(_mm_set1_epi32(count), _mm_setr_epi32(0, 1, 2, 3))));
+	}
+
+#else
+	static const int LANES = 4;
+
+	/*  One float per lane, left to the compiler to vectorize */
+	struct FloatLanes
+	{
+		float v[LANES];
+		FloatLanes() : v() {}
+		FloatLanes(float x) { for (int i = 0; i < LANES; i++) { v[i] = x; } }
+	};
+
+	/*  One condition per lane, as a bit mask */
+	struct MaskLanes
+	{
+		unsigned m;
+		explicit MaskLanes(unsigned x) : m(x) {}
+	};
+
+#define MARKER_LANEWISE(expression) FloatLanes r; for (int i = 0; i < LANES; i++) { r.v[i] = expression; } return r
+#define MARKER_MASKWISE(expression) unsigned r = 0; for (int i = 0; i < LANES; i++) { r |= (unsigned)(expression) << i; } return MaskLanes(r)
+	inline FloatLanes loadLanes(const float* p) { MARKER_LANEWISE(p[i]); }
+	inline void storeLanes(float* p, const FloatLanes &a) { for (int i = 0; i < LANES; i++) { p[i] = a.v[i]; } }
+	inline FloatLanes operator+(const FloatLanes &a, const FloatLanes &b) { MARKER_LANEWISE(a.v[i] + b.v[i]); }
+	inline FloatLanes operator-(const FloatLanes &a, const FloatLanes &b) { MARKER_LANEWISE(a.v[i] - b.v[i]); }
+	inline FloatLanes operator*(const FloatLanes &a, const FloatLanes &b) { MARKER_LANEWISE(a.v[i] * b.v[i]); }
+	inline FloatLanes operator/(const FloatLanes &a, const FloatLanes &b) { MARKER_LANEWISE(a.v[i] / b.v[i]); }
+	inline FloatLanes operator-(const FloatLanes &a) { MARKER_LANEWISE(-a.v[i]); }
+	inline FloatLanes sqrtLanes(const FloatLanes &a) { MARKER_LANEWISE(std::sqrt(a.v[i])); }
+	inline FloatLanes absLanes(const FloatLanes &a) { MARKER_LANEWISE(std::fabs(a.v[i])); }
+	inline MaskLanes operator<(const FloatLanes &a, const FloatLanes &b) { MARKER_MASKWISE(a.v[i] < b.v[i]); }
+	inline MaskLanes operator<=(const FloatLanes &a, const FloatLanes &b) { MARKER_MASKWISE(a.v[i] <= b.v[i]); }
+	inline MaskLanes operator>(const FloatLanes &a, const FloatLanes &b) { MARKER_MASKWISE(a.v[i] > b.v[i]); }
+	inline MaskLanes operator>=(const FloatLanes &a, const FloatLanes &b) { MARKER_MASKWISE(a.v[i] >= b.v[i]); }
+	inline MaskLanes operator&(const MaskLanes &a, const MaskLanes &b) { return MaskLanes(a.m & b.m); }
+	inline MaskLanes operator|(const MaskLanes &a, const MaskLanes &b) { return MaskLanes(a.m | b.m); }
+	inline MaskLanes operator!(const MaskLanes &a) { return MaskLanes(~a.m & ((1u << LANES) - 1)); }
+	inline FloatLanes select(const MaskLanes &mask, const FloatLanes &a, const FloatLanes &b) { MARKER_LANEWISE(((mask.m >> i) & 1) ? a.v[i] : b.v[i]); }
+	inline bool anyLane(const MaskLanes &mask) { return mask.m != 0; }
+	inline bool laneSet(const MaskLanes &mask, int lane) { return ((mask.m >> lane) & 1) != 0; }
+	inline MaskLanes firstLanes(int count) { MARKER_MASKWISE(i < count); }
+#undef MARKER_LANEWISE
+#undef MARKER_MASKWISE
+#endif
+
+
+	/*  Computes the homography mapping the unit square onto the corners of each lane, as PoseSolver::squareHomography
+	 *
+	 *	@param H: Container to hold the 3x3 homographies in row-major order
+	 *	@param x: The x coordinates of the four corners in counter-clockwise order
+	 *	@param y: The y coordinates of the four corners
+	 *
+	 *	@return valid: The lanes whose corners are not collinear
+	 */
+	inline MaskLanes squareHomography(FloatLanes* H, const FloatLanes* x, const FloatLanes* y) {
+
+		// Subtract the mean from the corners
+		FloatLanes meanX = (x[0] + x[1] + x[2] + x[3]) / 4;
+		FloatLanes meanY = (y[0] + y[1] + y[2] + y[3]) / 4;
+		FloatLanes cx[4], cy[4];
+		for (int i = 0; i < 4; i++) {
+			cx[i] = x[i] - meanX;
+			cy[i] = y[i] - meanY;
+		}
+
+		// The two independent rows of the system, each averaged with its negated twin
+		FloatLanes r[3], s[3];
+		r[0] = cx[0] - cx[1] - cx[2] + cx[3];
+		r[1] = -cx[0] - cx[1] + cx[2] + cx[3];
+		r[2] = (cx[1] + cx[3] - cx[0] - cx[2]);
+		s[0] = cy[0] - cy[1] - cy[2] + cy[3];
+		s[1] = -cy[0] - cy[1] + cy[2] + cy[3];
+		s[2] = (cy[1] + cy[3] - cy[0] - cy[2]);
+
+		// The null vector is the normalized cross product of the rows
+		FloatLanes v[3] = { r[1] * s[2] - r[2] * s[1], r[2] * s[0] - r[0] * s[2], r[0] * s[1] - r[1] * s[0] };
+		FloatLanes length = sqrtLanes(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		MaskLanes valid = length > 0;
+		for (int i = 0; i < 3; i++) {
+			v[i] = v[i] / length;
+		}
+
+		// Compute the first two rows from the bottom one, multiplied by 2 to compensate scaling
+		H[0] = ((cx[0] + cx[1] + cx[2] + cx[3]) * v[0] + (-cx[0] + cx[1] - cx[2] + cx[3]) * v[1] +
+			(-cx[0] - cx[1] + cx[2] + cx[3]) * v[2]) / 2;
+		H[1] = ((-cx[0] + cx[1] - cx[2] + cx[3]) * v[0] + (cx[0] + cx[1] + cx[2] + cx[3]) * v[1] +
+			(cx[0] - cx[1] - cx[2] + cx[3]) * v[2]) / 2;
+		H[3] = ((cy[0] + cy[1] + cy[2] + cy[3]) * v[0] + (-cy[0] + cy[1] - cy[2] + cy[3]) * v[1] +
+			(-cy[0] - cy[1] + cy[2] + cy[3]) * v[2]) / 2;
+		H[4] = ((-cy[0] + cy[1] - cy[2] + cy[3]) * v[0] + (cy[0] + cy[1] + cy[2] + cy[3]) * v[1] +
+			(cy[0] - cy[1] - cy[2] + cy[3]) * v[2]) / 2;
+		H[2] = ((cx[0] + cx[1] - cx[2] - cx[3]) * v[0] + (-cx[0] + cx[1] + cx[2] - cx[3]) * v[1]) / -4;
+		H[5] = ((cy[0] + cy[1] - cy[2] - cy[3]) * v[0] + (-cy[0] + cy[1] + cy[2] - cy[3]) * v[1]) / -4;
+		H[6] = v[0] * 2;
+		H[7] = v[1] * 2;
+		H[8] = v[2];
+
+		// Undo the mean subtraction
+		for (int i = 0; i < 3; i++) {
+			H[i] = H[i] + H[6 + i] * meanX;
+			H[3 + i] = H[3 + i] + H[6 + i] * meanY;
+		}
+
+		return valid;
+	}
+
+
+	/*  Converts the rotation matrix of each lane to a unit quaternion, as PoseSolver::matrixToQuaternion
+	 *	Every lane computes the entry with the largest absolute value first, and the four
+	 *	possible orders are blended by mask instead of being branched to.
+	 *
+	 *	@param m: The 3x3 rotation matrices in row-major order
+	 *	@param q: Container to hold the quaternions (x, y, z, w)
+	 *
+	 *	@return void
+	 */
+	inline void matrixToQuaternion(const FloatLanes* m, FloatLanes* q) {
+
+		// Find the entry with the largest absolute value, from 4 * q[..]^2 - 1, keeping the first largest
+		FloatLanes tmp[4];
+		tmp[3] = m[0] + m[4] + m[8];
+		tmp[0] = m[0] - m[4] - m[8];
+		tmp[1] = -m[0] + m[4] - m[8];
+		tmp[2] = -m[0] - m[4] + m[8];
+		MaskLanes is0 = tmp[0] > tmp[3];
+		FloatLanes largest = select(is0, tmp[0], tmp[3]);
+		MaskLanes is1 = tmp[1] > largest;
+		largest = select(is1, tmp[1], largest);
+		MaskLanes is2 = tmp[2] > largest;
+		largest = select(is2, tmp[2], largest);
+		is1 = is1 & !is2;
+		is0 = is0 & !is1 & !is2;
+
+		// Compute the other entries from the largest one
+		FloatLanes qMax = sqrtLanes(largest + 1) / 2;
+		FloatLanes scale = 1 / (4 * qMax);
+		FloatLanes a = (m[7] - m[5]) * scale;
+		FloatLanes b = (m[2] - m[6]) * scale;
+		FloatLanes c = (m[3] - m[1]) * scale;
+		FloatLanes d = (m[3] + m[1]) * scale;
+		FloatLanes e = (m[2] + m[6]) * scale;
+		FloatLanes f = (m[7] + m[5]) * scale;
+		q[0] = select(is0, qMax, select(is1, d, select(is2, e, a)));
+		q[1] = select(is0, d, select(is1, qMax, select(is2, f, b)));
+		q[2] = select(is0, e, select(is1, f, select(is2, qMax, c)));
+		q[3] = select(is0, a, select(is1, b, select(is2, c, qMax)));
+
+		// Normalize the quaternion
+		FloatLanes norm = 1 / sqrtLanes(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+		for (int i = 0; i < 4; i++) {
+			q[i] = q[i] * norm;
+		}
+	}
+
+
+	/*  Computes the initial pose of the square of each lane from its homography, as PoseSolver::poseFromHomography
+	 *
+	 *	@param pose: Container to hold the 7 pose parameters
+	 *	@param H: The homographies from squareHomography
+	 *	@param markerSize: The side length of each marker
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *
+	 *	@return void
+	 */
+	inline void poseFromHomography(FloatLanes* pose, const FloatLanes* H, const FloatLanes &markerSize, float fx, float fy) {
+
+		// Remove the camera and marker scaling
+		const FloatLanes scaleLeft[3] = { 1 / fx, 1 / fy, -1 };
+		const FloatLanes scaleRight[3] = { 1 / markerSize, 1 / markerSize, 1 };
+		FloatLanes R[9];
+		for (int r = 0; r < 3; r++) {
+			for (int c = 0; c < 3; c++) {
+				R[3 * r + c] = H[3 * r + c] * scaleLeft[r] * scaleRight[c];
+			}
+		}
+
+		// The marker must be in front of the camera, which fixes the sign of the homography
+		MaskLanes behind = R[8] > 0;
+		for (int i = 0; i < 9; i++) {
+			R[i] = select(behind, -R[i], R[i]);
+		}
+
+		// Scale the translation by the average length of the first two columns
+		FloatLanes xLen = sqrtLanes(R[0] * R[0] + R[3] * R[3] + R[6] * R[6]);
+		FloatLanes yLen = sqrtLanes(R[1] * R[1] + R[4] * R[4] + R[7] * R[7]);
+		FloatLanes transScale = 2 / (xLen + yLen);
+		for (int i = 0; i < 3; i++) {
+			pose[4 + i] = R[3 * i + 2] * transScale;
+		}
+
+		// Normalize the first two columns, the third is their cross product
+		for (int i = 0; i < 3; i++) {
+			R[3 * i] = R[3 * i] / xLen;
+			R[3 * i + 1] = R[3 * i + 1] / yLen;
+		}
+		FloatLanes z[3] = { R[3] * R[7] - R[6] * R[4], R[6] * R[1] - R[0] * R[7], R[0] * R[4] - R[3] * R[1] };
+		FloatLanes zLen = sqrtLanes(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		for (int i = 0; i < 3; i++) {
+			R[3 * i + 2] = z[i] / zLen;
+		}
+
+		// Recompute the second column from the other two, so that the matrix is orthogonal
+		R[1] = -(R[3] * R[8] - R[6] * R[5]);
+		R[4] = -(R[6] * R[2] - R[0] * R[8]);
+		R[7] = -(R[0] * R[5] - R[3] * R[2]);
+
+		matrixToQuaternion(R, pose);
+	}
+
+
+	/*  Projects one marker point of each lane into the image, as PoseSolver::projectPoint
+	 *
+	 *	@param image: Container to hold the image point
+	 *	@param point: The 3D point in marker coordinates
+	 *	@param pose: The 7 pose parameters
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *
+	 *	@return void
+	 */
+	inline void projectPoint(FloatLanes* image, const FloatLanes* point, const FloatLanes* pose, float fx, float fy) {
+
+		const FloatLanes* q = pose;
+		FloatLanes xy = q[0] * q[1], xz = q[0] * q[2], yz = q[1] * q[2];
+		FloatLanes ww = q[3] * q[3], wx = q[3] * q[0], wy = q[3] * q[1], wz = q[3] * q[2];
+
+		// Rotate, then translate
+		FloatLanes p[3];
+		p[0] = point[0] * (2 * (q[0] * q[0] + ww) - 1) + point[1] * 2 * (xy - wz) + point[2] * 2 * (wy + xz);
+		p[1] = point[0] * 2 * (xy + wz) + point[1] * (2 * (q[1] * q[1] + ww) - 1) + point[2] * 2 * (yz - wx);
+		p[2] = point[0] * 2 * (xz - wy) + point[1] * 2 * (wx + yz) + point[2] * (2 * (q[2] * q[2] + ww) - 1);
+		for (int i = 0; i < 3; i++) {
+			p[i] = p[i] + pose[4 + i];
+		}
+
+		image[0] = p[0] * (-fx / p[2]);
+		image[1] = p[1] * (-fy / p[2]);
+	}
+
+
+	/*  Computes the reprojection error of the four corners of each lane
+	 *
+	 *	@param error: Container to hold (measured - projected) for each corner
+	 *	@param points3D: The corners in marker coordinates
+	 *	@param points2D: The measured corners
+	 *	@param pose: The 7 pose parameters
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *
+	 *	@return errorSq: The sum of squared errors of each lane
+	 */
+	inline FloatLanes reprojectionError(FloatLanes (&error)[8], const FloatLanes (&points3D)[4][3], const FloatLanes (&points2D)[4][2],
+		const FloatLanes* pose, float fx, float fy) {
+
+		FloatLanes errorSq = 0;
+		for (int i = 0; i < 4; i++) {
+			FloatLanes projected[2];
+			projectPoint(projected, points3D[i], pose, fx, fy);
+			error[2 * i] = points2D[i][0] - projected[0];
+			error[2 * i + 1] = points2D[i][1] - projected[1];
+			errorSq = errorSq + (error[2 * i] * error[2 * i] + error[2 * i + 1] * error[2 * i + 1]);
+		}
+
+		return errorSq;
+	}
+
+
+	/*  Computes the 2x7 Jacobian of the projection of one point of each lane, as PoseSolver::projectionJacobian
+	 *
+	 *	@param J: Container to hold the Jacobian in row-major order
+	 *	@param pose: The 7 pose parameters
+	 *	@param point: The 3D point in marker coordinates
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *
+	 *	@return void
+	 */
+	inline void projectionJacobian(FloatLanes* J, const FloatLanes* pose, const FloatLanes* point, float fx, float fy) {
+
+		const FloatLanes* p = pose;
+		FloatLanes t4 = p[0] * point[0] + p[1] * point[1] + p[2] * point[2];
+		FloatLanes t10 = p[3] * point[0] + p[1] * point[2] - p[2] * point[1];
+		FloatLanes t15 = p[3] * point[1] - p[0] * point[2] + p[2] * point[0];
+		FloatLanes t20 = p[3] * point[2] + p[0] * point[1] - p[1] * point[0];
+		FloatLanes t22 = -t4 * p[2] + t10 * p[1] - t15 * p[0] - t20 * p[3] - p[6];
+		FloatLanes t23 = 1 / t22;
+		FloatLanes t24x = 2 * fx * t4 * t23;
+		FloatLanes t24y = 2 * fy * t4 * t23;
+		FloatLanes t30 = fx * (t4 * p[0] + t10 * p[3] - t15 * p[2] + t20 * p[1] + p[4]);
+		FloatLanes t32 = 1 / (t22 * t22);
+		FloatLanes t33 = -2 * t32 * t15;
+		FloatLanes t38 = 2 * t32 * t10;
+		FloatLanes t43 = -2 * t32 * t4;
+		FloatLanes t47x = 2 * fx * t10 * t23;
+		FloatLanes t47y = 2 * fy * t10 * t23;
+		FloatLanes t48 = -2 * t32 * t20;
+		FloatLanes t51x = fx * t23;
+		FloatLanes t51y = fy * t23;
+		FloatLanes t60 = fy * (t4 * p[1] + t10 * p[2] + t15 * p[3] - t20 * p[0] + p[5]);
+
+		J[0] = t24x - t30 * t33;
+		J[1] = 2 * fx * t20 * t23 - t30 * t38;
+		J[2] = -2 * fx * t15 * t23 - t30 * t43;
+		J[3] = t47x - t30 * t48;
+		J[4] = t51x;
+		J[5] = 0;
+		J[6] = t30 * t32;
+		J[7] = -2 * fy * t20 * t23 - t60 * t33;
+		J[8] = t24y - t60 * t38;
+		J[9] = t47y - t60 * t43;
+		J[10] = 2 * fy * t15 * t23 - t60 * t48;
+		J[11] = 0;
+		J[12] = t51y;
+		J[13] = t60 * t32;
+	}
+
+
+	/*  Solves the 7x7 system of each lane in place by Cholesky decomposition, as PoseSolver::choleskySolve
+	 *
+	 *	@param A: The matrices in row-major order, of which only the lower triangle is read
+	 *	@param b: The right hand sides, overwritten with the solutions
+	 *
+	 *	@return solved: The lanes whose matrix is positive definite
+	 */
+	inline MaskLanes choleskySolve(FloatLanes (&A)[7][7], FloatLanes (&b)[7]) {
+
+		MaskLanes solved = firstLanes(LANES);
+		FloatLanes inverseDiagonal[7];
+		for (int j = 0; j < 7; j++) {
+			FloatLanes diagonal = A[j][j];
+			for (int k = 0; k < j; k++) {
+				diagonal = diagonal - A[j][k] * A[j][k];
+			}
+			solved = solved & (diagonal > 0);
+			inverseDiagonal[j] = 1 / sqrtLanes(diagonal);
+			A[j][j] = diagonal * inverseDiagonal[j];
+
+			for (int i = j + 1; i < 7; i++) {
+				FloatLanes sum = A[i][j];
+				for (int k = 0; k < j; k++) {
+					sum = sum - A[i][k] * A[j][k];
+				}
+				A[i][j] = sum * inverseDiagonal[j];
+			}
+		}
+
+		// Forward substitution with L, then back substitution with L^T
+		for (int i = 0; i < 7; i++) {
+			for (int k = 0; k < i; k++) {
+				b[i] = b[i] - A[i][k] * b[k];
+			}
+			b[i] = b[i] * inverseDiagonal[i];
+		}
+		for (int i = 6; i >= 0; i--) {
+			for (int k = i + 1; k < 7; k++) {
+				b[i] = b[i] - A[k][i] * b[k];
+			}
+			b[i] = b[i] * inverseDiagonal[i];
+		}
+
+		return solved;
+	}
+
+
+	/*  Factors the length of each quaternion into its translation, as PoseSolver::normalizePose
+	 *
+	 *	@param pose: The 7 pose parameters
+	 *
+	 *	@return void
+	 */
+	inline void normalizePose(FloatLanes* pose) {
+
+		FloatLanes lengthSq = pose[0] * pose[0] + pose[1] * pose[1] + pose[2] * pose[2] + pose[3] * pose[3];
+		FloatLanes length = sqrtLanes(lengthSq);
+		for (int i = 0; i < 4; i++) {
+			pose[i] = pose[i] / length;
+		}
+		for (int i = 4; i < 7; i++) {
+			pose[i] = pose[i] / lengthSq;
+		}
+	}
+
+
+	/*  Tells which lanes took a step small enough for the refinement to stop, as PoseSolver::stepConverged
+	 *
+	 *	@param step: The 7 parameter step that was taken
+	 *	@param pose: The 7 pose parameters after the step
+	 *	@param tolerance: The step tolerance of the refinement
+	 *
+	 *	@return converged: The lanes whose step is below the tolerance
+	 */
+	inline MaskLanes stepConverged(const FloatLanes* step, const FloatLanes* pose, float tolerance) {
+
+		MaskLanes converged = firstLanes(LANES);
+		for (int i = 0; i < 4; i++) {
+			converged = converged & !(absLanes(step[i]) > tolerance);
+		}
+		FloatLanes stepSq = step[4] * step[4] + step[5] * step[5] + step[6] * step[6];
+		FloatLanes translationSq = pose[4] * pose[4] + pose[5] * pose[5] + pose[6] * pose[6];
+		return converged & (stepSq <= tolerance * tolerance * translationSq);
+	}
+
+
+	/*  Refines the pose of each lane with Levenberg-Marquardt, as PoseSolver::optimizePose
+	 *	Every lane keeps its own damping, and stops being updated once its error or its accepted
+	 *	step falls below the tolerance. The loop ends when no lane is left refining.
+	 *
+	 *	@param pose: The 7 pose parameters, used both as initial value and output
+	 *	@param points3D: The corners in marker coordinates
+	 *	@param points2D: The measured corners
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *	@param options: The iteration cap and the tolerances to stop at
+	 *	@param active: The lanes to refine
+	 *	@param iterations: Container to hold the number of iterations run by each lane
+	 *
+	 *	@return void
+	 */
+	inline void optimizePose(FloatLanes* pose, const FloatLanes (&points3D)[4][3], const FloatLanes (&points2D)[4][2], float fx, float fy,
+		const PoseSolver::RefineOptions<float> &options, MaskLanes active, FloatLanes &iterations) {
+
+		FloatLanes error[8];
+		FloatLanes previousError = reprojectionError(error, points3D, points2D, pose, fx, fy);
+		FloatLanes lambda = 1;
+		float errorLimit = options.errorTolerance * options.errorTolerance * 4;
+		iterations = 0;
+
+		for (int pass = 0; pass < options.maxIterations; pass++) {
+
+			active = active & !(previousError <= errorLimit);
+			if (!anyLane(active)) {
+				break;
+			}
+			iterations = iterations + select(active, 1, 0);
+
+			// Accumulate J^T J and J^T e over the points
+			FloatLanes JtJ[7][7];
+			FloatLanes step[7];
+			for (int r = 0; r < 7; r++) {
+				step[r] = 0;
+				for (int c = 0; c <= r; c++) {
+					JtJ[r][c] = 0;
+				}
+			}
+			for (int i = 0; i < 4; i++) {
+				FloatLanes J[14];
+				projectionJacobian(J, pose, points3D[i], fx, fy);
+				for (int r = 0; r < 7; r++) {
+					step[r] = step[r] + (J[r] * error[2 * i] + J[7 + r] * error[2 * i + 1]);
+					for (int c = 0; c <= r; c++) {
+						JtJ[r][c] = JtJ[r][c] + (J[r] * J[c] + J[7 + r] * J[7 + c]);
+					}
+				}
+			}
+
+			// Add lambda to the diagonal and solve for the step
+			for (int i = 0; i < 7; i++) {
+				JtJ[i][i] = JtJ[i][i] + lambda;
+			}
+			MaskLanes solved = choleskySolve(JtJ, step);
+
+			FloatLanes candidate[7];
+			for (int i = 0; i < 7; i++) {
+				candidate[i] = pose[i] + step[i];
+			}
+			normalizePose(candidate);
+
+			// Keep the step only in the lanes where it lowers the error
+			FloatLanes newError[8];
+			FloatLanes candidateError = reprojectionError(newError, points3D, points2D, candidate, fx, fy);
+			MaskLanes accept = active & solved & !(candidateError >= previousError);
+			lambda = select(accept, lambda / 10, select(active, lambda * 10, lambda));
+			for (int i = 0; i < 7; i++) {
+				pose[i] = select(accept, candidate[i], pose[i]);
+			}
+			for (int i = 0; i < 8; i++) {
+				error[i] = select(accept, newError[i], error[i]);
+			}
+			previousError = select(accept, candidateError, previousError);
+
+			active = active & !(accept & stepConverged(step, pose, options.stepTolerance));
+		}
+	}
+
+
+	/*  Converts the pose of each lane to a 4x4 transformation matrix in row-major order, as PoseSolver::poseToMatrix
+	 *
+	 *	@param mat: Container to hold the 16 entries of the matrices
+	 *	@param pose: The 7 pose parameters with a unit quaternion
+	 *
+	 *	@return void
+	 */
+	inline void poseToMatrix(FloatLanes* mat, const FloatLanes* pose) {
+
+		FloatLanes X = -pose[0], Y = -pose[1], Z = -pose[2], W = pose[3];
+		FloatLanes xx = X * X, xy = X * Y, xz = X * Z, xw = X * W;
+		FloatLanes yy = Y * Y, yz = Y * Z, yw = Y * W;
+		FloatLanes zz = Z * Z, zw = Z * W;
+
+		mat[0] = 1 - 2 * (yy + zz);
+		mat[1] = 2 * (xy + zw);
+		mat[2] = 2 * (xz - yw);
+		mat[4] = 2 * (xy - zw);
+		mat[5] = 1 - 2 * (xx + zz);
+		mat[6] = 2 * (yz + xw);
+		mat[8] = 2 * (xz + yw);
+		mat[9] = 2 * (yz - xw);
+		mat[10] = 1 - 2 * (xx + yy);
+
+		mat[3] = pose[4];
+		mat[7] = pose[5];
+		mat[11] = pose[6];
+		mat[12] = mat[13] = mat[14] = 0;
+		mat[15] = 1;
+	}
+
+
+	/*  Computes the pose of the square of each lane, starting from a prior pose where there is one,
+	 *	as the scalar PoseSolver::estimateSquarePose with a prior
+	 *
+	 *	@param mat: Container to hold the poses as 4x4 matrices in row-major order
+	 *	@param pose: The 7 pose parameters, holding the priors on input and the refined poses on output
+	 *	@param hasPrior: The lanes whose pose holds a prior to try
+	 *	@param x: The x coordinates of the undistorted corners in counter-clockwise order, relative to the principal point
+	 *	@param y: The y coordinates of the corners
+	 *	@param markerSize: The side length of each marker, whose origin is at its centre
+	 *	@param fx: The focal length along x in pixels
+	 *	@param fy: The focal length along y in pixels
+	 *	@param options: The iteration cap and the tolerances of the refinement
+	 *	@param used: The lanes that hold a marker
+	 *	@param iterations: Container to hold the number of iterations run by each lane
+	 *
+	 *	@return valid: The used lanes whose pose was found, the others have degenerate corners
+	 */
+	inline MaskLanes estimateSquarePose(FloatLanes* mat, FloatLanes* pose, MaskLanes hasPrior, const FloatLanes* x, const FloatLanes* y,
+		const FloatLanes &markerSize, float fx, float fy, const PoseSolver::RefineOptions<float> &options, MaskLanes used,
+		FloatLanes &iterations) {
+
+		// Corner coordinates on the marker, counter-clockwise
+		FloatLanes half = markerSize / 2;
+		const FloatLanes points3D[4][3] = { { -half, half, 0 }, { -half, -half, 0 }, { half, -half, 0 }, { half, half, 0 } };
+		FloatLanes points2D[4][2];
+		for (int i = 0; i < 4; i++) {
+			points2D[i][0] = x[i];
+			points2D[i][1] = y[i];
+		}
+
+		// Keep the prior only where it still fits the corners, which also rejects a prior that is not finite
+		FloatLanes error[8];
+		FloatLanes errorSq = reprojectionError(error, points3D, points2D, pose, fx, fy);
+		MaskLanes warm = hasPrior & (errorSq <= options.priorTolerance * options.priorTolerance * 4);
+
+		FloatLanes H[9];
+		FloatLanes initial[7];
+		MaskLanes valid = used & (warm | squareHomography(H, x, y));
+		poseFromHomography(initial, H, markerSize, fx, fy);
+		for (int i = 0; i < 7; i++) {
+			pose[i] = select(warm, pose[i], initial[i]);
+		}
+
+		optimizePose(pose, points3D, points2D, fx, fy, options, valid, iterations);
+		poseToMatrix(mat, pose);
+		return valid;
+	}
+}
+}
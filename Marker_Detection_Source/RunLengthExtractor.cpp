@@ -0,0 +1,459 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Run-length quad extractor
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+
+/* SIMD includes */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MARKER_SSE2 1
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/* Helper includes */
+#include "RunLengthExtractor.h"
+#include "MarkerDetector.h"
+#include "ThreadPool.h"
+
+
+/* Fewest rows in a band, so that stitching stays cheap compared to labelling */
+static const int MIN_BAND_ROWS = 32;
+
+/* Smallest fraction of its quad a region must cover. The black border alone covers 20/36 of a marker. */
+static const double MIN_FILL_RATIO = 0.35;
+
+
+/*  Returns the index of the lowest set bit of a nonzero mask
+ *
+ *	@param mask: The mask, which must not be zero
+ *
+ *	@return index: The position of the lowest set bit
+ */
+static inline int lowestBit(unsigned int mask) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return (int)index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+
+/*  Finds the root of a run in the union-find, halving the path on the way
+ *
+ *	@param parent: The parent of every run
+ *	@param i: The run to look up
+ *
+ *	@return root: The run that represents the region
+ */
+static inline int findRoot(int* parent, int i) {
+	while (parent[i] != i) {
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+
+/*  Joins the regions of two runs
+ *	The smaller index becomes the root, so every region is represented by its first run.
+ *
+ *	@param parent: The parent of every run
+ *	@param a: The first run
+ *	@param b: The second run
+ *
+ *	@return void
+ */
+static inline void unite(int* parent, int a, int b) {
+	a = findRoot(parent, a);
+	b = findRoot(parent, b);
+	if (a < b) {
+		parent[b] = a;
+	}
+	else if (b < a) {
+		parent[a] = b;
+	}
+}
+
+
+/*  Joins the runs of two consecutive rows that share a column
+ *	Both rows are sorted, so a single merge pass finds every overlap.
+ *
+ *	@param runs: The runs, indexed like parent
+ *	@param parent: The parent of every run
+ *	@param upperBegin: The first run of the upper row
+ *	@param upperEnd: The index after the last run of the upper row
+ *	@param lowerBegin: The first run of the lower row
+ *	@param lowerEnd: The index after the last run of the lower row
+ *
+ *	@return void
+ */
+template <typename RunType>
+static void joinRows(const RunType* runs, int* parent, int upperBegin, int upperEnd, int lowerBegin, int lowerEnd) {
+	int i = upperBegin;
+	int j = lowerBegin;
+	while (i < upperEnd && j < lowerEnd) {
+		const RunType &upper = runs[i];
+		const RunType &lower = runs[j];
+		if (upper.x0 <= lower.x1 && lower.x0 <= upper.x1) {
+			unite(parent, i, j);
+		}
+		if (upper.x1 < lower.x1) {
+			i++;
+		}
+		else {
+			j++;
+		}
+	}
+}
+
+
+/*  Appends the runs of dark pixels of one row
+ *	A pixel is dark if it is at most the threshold, which is where cv::threshold writes 0.
+ *	Sixteen pixels are classified at once and the run ends are read off the bit mask,
+ *	so uniform stretches of the row cost one compare each.
+ *
+ *	@param row: The grayscale pixels of the row
+ *	@param width: The number of pixels in the row
+ *	@param threshold: The binarization threshold, from 0 to 255
+ *	@param y: The row index stored in the runs
+ *	@param runs: Container to append the runs to
+ *
+ *	@return void
+ */
+void RunLengthExtractor::scanRow(const uchar* row, int width, int threshold, int y, std::vector<Run> &runs) {
+
+	int x = 0;
+	int start = 0;
+	bool inRun = false;
+
+#if MARKER_SSE2
+	const __m128i limit = _mm_set1_epi8((char)threshold);
+	for (; x + 16 <= width; x += 16) {
+
+		// A pixel is dark if the unsigned minimum with the threshold leaves it unchanged
+		__m128i pixels = _mm_loadu_si128((const __m128i*)(row + x));
+		unsigned int dark = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(pixels, limit), pixels));
+
+		// Nothing changes within the block
+		if (dark == (inRun ? 0xffffu : 0u)) {
+			continue;
+		}
+
+		// Bits where the pixel differs from the one before it start or end a run
+		unsigned int edges = (dark ^ ((dark << 1) | (inRun ? 1u : 0u))) & 0xffffu;
+		while (edges) {
+			int bit = lowestBit(edges);
+			edges &= edges - 1;
+			if (inRun) {
+				runs.push_back({ start, x + bit - 1, y });
+			}
+			else {
+				start = x + bit;
+			}
+			inRun = !inRun;
+		}
+	}
+#endif
+
+	for (; x < width; x++) {
+		bool dark = row[x] <= threshold;
+		if (dark != inRun) {
+			if (dark) {
+				start = x;
+			}
+			else {
+				runs.push_back({ start, x - 1, y });
+			}
+			inRun = dark;
+		}
+	}
+
+	if (inRun) {
+		runs.push_back({ start, width - 1, y });
+	}
+}
+
+
+/*  Finds the runs of one band and joins those that touch
+ *	Only reads the image and writes the band, so bands can be labelled concurrently.
+ *
+ *	@param band: The band to label, with its rows set
+ *	@param gray: The grayscale image
+ *	@param threshold: The binarization threshold, from 0 to 255
+ *
+ *	@return void
+ */
+void RunLengthExtractor::labelBand(Band &band, const cv::Mat &gray, int threshold) {
+
+	band.runs.clear();
+	band.parent.clear();
+	band.firstRowEnd = 0;
+	band.lastRowBegin = 0;
+
+	int previousBegin = 0;
+	int previousEnd = 0;
+	for (int y = band.y0; y < band.y1; y++) {
+		int rowBegin = (int)band.runs.size();
+		scanRow(gray.ptr<uchar>(y), gray.cols, threshold, y, band.runs);
+		int rowEnd = (int)band.runs.size();
+
+		for (int i = rowBegin; i < rowEnd; i++) {
+			band.parent.push_back(i);
+		}
+		joinRows(band.runs.data(), band.parent.data(), previousBegin, previousEnd, rowBegin, rowEnd);
+
+		if (y == band.y0) {
+			band.firstRowEnd = rowEnd;
+		}
+		band.lastRowBegin = rowBegin;
+		previousBegin = rowBegin;
+		previousEnd = rowEnd;
+	}
+}
+
+
+/*  Finds the quads of the dark regions of a grayscale image
+ *	Regions touching the image border are skipped, as findContours never closes a
+ *	border around them. Every other region goes through the same tests as a contour:
+ *	bounding box, aspect ratio and perimeter first, then polygon approximation of its
+ *	convex hull. The hull runs through the centres of the pixels just outside the
+ *	region, where findContours would trace its border, and the corners come out in
+ *	the same order as that border.
+ *
+ *	@param gray: The grayscale image
+ *	@param threshold: The binarization threshold
+ *	@param limits: The thresholds of the contour tests
+ *	@param bandCount: The number of bands to label in parallel
+ *	@param quads: Container to append four corners per quad to, in image coordinates
+ *	@param stats: The frame statistics to add the counts to
+ *
+ *	@return quadCount: The number of quads appended
+ */
+int RunLengthExtractor::extract(const cv::Mat &gray, int threshold, const ContourLimits &limits, int bandCount, std::vector<cv::Point> &quads, FrameStats &stats) {
+
+	int width = gray.cols;
+	int height = gray.rows;
+	if (width < 3 || height < 3 || threshold < 0) {
+		return 0;
+	}
+	threshold = std::min(threshold, 255);
+
+	// Split the rows into bands and label them, in parallel if there is more than one
+	bandCount = std::max(1, std::min(bandCount, height / MIN_BAND_ROWS));
+	bands.resize(bandCount);
+	for (int b = 0; b < bandCount; b++) {
+		bands[b].y0 = height * b / bandCount;
+		bands[b].y1 = height * (b + 1) / bandCount;
+	}
+
+	if (bandCount > 1) {
+		auto label = [this, &gray, threshold](int b, int) {
+			labelBand(bands[b], gray, threshold);
+		};
+		ThreadPool::shared().parallelFor(bandCount, label);
+	}
+	else {
+		labelBand(bands[0], gray, threshold);
+	}
+
+	// Gather the bands into frame-wide indices, then join the runs across band edges
+	int total = 0;
+	for (int b = 0; b < bandCount; b++) {
+		total += (int)bands[b].runs.size();
+	}
+	runs.resize(total);
+	parent.resize(total);
+
+	int offset = 0;
+	int previousOffset = 0;
+	for (int b = 0; b < bandCount; b++) {
+		const Band &band = bands[b];
+		int count = (int)band.runs.size();
+		std::copy(band.runs.begin(), band.runs.end(), runs.begin() + offset);
+		for (int i = 0; i < count; i++) {
+			parent[offset + i] = offset + band.parent[i];
+		}
+
+		if (b > 0) {
+			const Band &above = bands[b - 1];
+			joinRows(runs.data(), parent.data(), previousOffset + above.lastRowBegin, offset,
+				offset, offset + band.firstRowEnd);
+		}
+		previousOffset = offset;
+		offset += count;
+	}
+
+	// Give every region a compact index. Roots are first runs, so they are met before the rest.
+	regionOfRun.resize(total);
+	regions.clear();
+	for (int i = 0; i < total; i++) {
+		const Run &run = runs[i];
+		int root = findRoot(parent.data(), i);
+		if (root == i) {
+			regionOfRun[i] = (int)regions.size();
+			Region region = { run.x0, run.x1, run.y, run.y, 0, -1 };
+			regions.push_back(region);
+		}
+		else {
+			regionOfRun[i] = regionOfRun[root];
+		}
+
+		Region &region = regions[regionOfRun[i]];
+		region.minX = std::min(region.minX, run.x0);
+		region.maxX = std::max(region.maxX, run.x1);
+		region.maxY = run.y;
+		region.pixels += run.x1 - run.x0 + 1;
+	}
+
+	// Cheap tests on the size of each region
+	int quadRegions = 0;
+	for (size_t r = 0; r < regions.size(); r++) {
+		Region &region = regions[r];
+		if (region.minX == 0 || region.minY == 0 || region.maxX == width - 1 || region.maxY == height - 1) {
+			continue;
+		}
+		stats.contoursFound++;
+
+		// The border points around the region are one pixel outside of it
+		double boxWidth = region.maxX - region.minX + 2;
+		double boxHeight = region.maxY - region.minY + 2;
+		if (region.pixels < MIN_FILL_RATIO * limits.minArea) {
+			stats.rejectedPointCount++;
+		}
+		else if (boxWidth * boxHeight < limits.minArea) {
+			stats.rejectedBoundingBox++;
+		}
+		else if (std::max(boxWidth, boxHeight) > limits.maxAspectRatio * std::min(boxWidth, boxHeight)) {
+			stats.rejectedAspectRatio++;
+		}
+		else {
+			region.quad = quadRegions++;
+		}
+	}
+
+	// Group the runs of the remaining regions, keeping raster order within each
+	quadStarts.assign(quadRegions + 1, 0);
+	for (int i = 0; i < total; i++) {
+		int quad = regions[regionOfRun[i]].quad;
+		if (quad >= 0) {
+			quadStarts[quad + 1]++;
+		}
+	}
+	for (int q = 0; q < quadRegions; q++) {
+		quadStarts[q + 1] += quadStarts[q];
+	}
+	runOrder.resize(quadStarts[quadRegions]);
+	for (int i = 0; i < total; i++) {
+		int quad = regions[regionOfRun[i]].quad;
+		if (quad >= 0) {
+			runOrder[quadStarts[quad]++] = i;
+		}
+	}
+	for (int q = quadRegions; q > 0; q--) {
+		quadStarts[q] = quadStarts[q - 1];
+	}
+	quadStarts[0] = 0;
+
+	int quadCount = 0;
+	for (size_t r = 0; r < regions.size(); r++) {
+		const Region &region = regions[r];
+		if (region.quad < 0) {
+			continue;
+		}
+
+		// Left and right ends of each row, pushed one pixel out, with the rows above and below
+		// the region added. Points are stored as (row, column) so that they come out sorted.
+		points.clear();
+		int k = quadStarts[region.quad];
+		int end = quadStarts[region.quad + 1];
+		int left = 0, right = 0, y = 0;
+		while (k < end) {
+			const Run &first = runs[runOrder[k]];
+			y = first.y;
+			left = first.x0;
+			right = first.x1;
+			for (k++; k < end && runs[runOrder[k]].y == y; k++) {
+				right = std::max(right, runs[runOrder[k]].x1);
+			}
+
+			if (points.empty()) {
+				points.push_back(cv::Point(y - 1, left));
+				points.push_back(cv::Point(y - 1, right));
+			}
+			points.push_back(cv::Point(y, left - 1));
+			points.push_back(cv::Point(y, right + 1));
+		}
+		points.push_back(cv::Point(y + 1, left));
+		points.push_back(cv::Point(y + 1, right));
+
+		// Convex hull by the monotone chain, on the sorted points
+		int n = (int)points.size();
+		hull.resize(2 * n);
+		int h = 0;
+		for (int i = 0; i < n; i++) {
+			while (h >= 2 && (hull[h - 1] - hull[h - 2]).cross(points[i] - hull[h - 2]) <= 0) {
+				h--;
+			}
+			hull[h++] = points[i];
+		}
+		for (int i = n - 2, lower = h + 1; i >= 0; i--) {
+			while (h >= lower && (hull[h - 1] - hull[h - 2]).cross(points[i] - hull[h - 2]) <= 0) {
+				h--;
+			}
+			hull[h++] = points[i];
+		}
+		hull.resize(h - 1);
+		for (size_t i = 0; i < hull.size(); i++) {
+			hull[i] = cv::Point(hull[i].y, hull[i].x);
+		}
+
+		double perimeter = cv::arcLength(hull, true);
+		if (perimeter < limits.minPerimeter || perimeter > limits.maxPerimeter) {
+			stats.rejectedPerimeter++;
+			continue;
+		}
+
+		// Approximate the hull to a polygon with accuracy proportional to its perimeter
+		cv::approxPolyDP(hull, polygon, perimeter * 0.02, true);
+		if (polygon.size() != 4) {
+			stats.rejectedPolygon++;
+			continue;
+		}
+
+		double signedArea = 0.0;
+		for (int c = 0; c < 4; c++) {
+			const cv::Point &p = polygon[c];
+			const cv::Point &q = polygon[(c + 1) % 4];
+			signedArea += ((double)p.x * q.y - (double)q.x * p.y) * 0.5;
+		}
+		double area = std::fabs(signedArea);
+		if (area < limits.minArea || region.pixels < MIN_FILL_RATIO * area || !cv::isContourConvex(polygon)) {
+			stats.rejectedPolygon++;
+			continue;
+		}
+
+		// Go left to right along the top edge, as findContours does around a dark region
+		if (signedArea < 0.0) {
+			std::swap(polygon[1], polygon[3]);
+		}
+		quads.insert(quads.end(), polygon.begin(), polygon.end());
+		quadCount++;
+	}
+
+	return quadCount;
+}
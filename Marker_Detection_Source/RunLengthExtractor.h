@@ -0,0 +1,83 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the run-length quad extractor
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <vector>
+
+/* Helper includes */
+#include "DetectorStatistics.h"
+
+
+struct ContourLimits;
+
+
+/*  Finds the quads that could be markers without a binary image or contours.
+ *	Each row of the grayscale image is thresholded straight into runs of dark pixels,
+ *	and runs that touch in consecutive rows are joined with a union-find, which labels
+ *	the 4-connected dark regions in a single streaming pass. A region is then described
+ *	by the extent of its runs in each row, which is all that is needed for its convex
+ *	hull, and the hull is approximated by a quad as the contour of the region would be.
+ *	Rows are split into horizontal bands that are labelled in parallel and stitched.
+ *	All buffers are flat and reused between frames.
+ */
+class RunLengthExtractor
+{
+public:
+	/*  Appends the four corners of every quad found in the image, returning the number of quads */
+	int extract(const cv::Mat &gray, int threshold, const ContourLimits &limits, int bandCount, std::vector<cv::Point> &quads, FrameStats &stats);
+
+private:
+	/*  Horizontal run of dark pixels, with inclusive ends */
+	struct Run
+	{
+		int x0;						// First column of the run
+		int x1;						// Last column of the run
+		int y;						// Row of the run
+	};
+
+	/*  Runs of one horizontal band, labelled independently of the other bands */
+	struct Band
+	{
+		int y0;						// First row of the band
+		int y1;						// Row after the last row of the band
+		std::vector<Run> runs;		// Runs in raster order
+		std::vector<int> parent;	// Union-find parent of each run, in band indices
+		int firstRowEnd;			// Index after the last run of the first row
+		int lastRowBegin;			// Index of the first run of the last row
+	};
+
+	/*  Size and bounds of one dark region */
+	struct Region
+	{
+		int minX, maxX;				// Columns covered by the region
+		int minY, maxY;				// Rows covered by the region
+		int pixels;					// Number of dark pixels
+		int quad;					// Index among the regions that reach the hull test, or -1
+	};
+
+	/*  Appends the runs of dark pixels of one row */
+	static void scanRow(const uchar* row, int width, int threshold, int y, std::vector<Run> &runs);
+
+	/*  Finds the runs of one band and joins those that touch */
+	static void labelBand(Band &band, const cv::Mat &gray, int threshold);
+
+	std::vector<Band> bands;			// Bands of the current frame
+	std::vector<Run> runs;				// Runs of every band, in raster order
+	std::vector<int> parent;			// Union-find parent of every run of the frame
+	std::vector<int> regionOfRun;		// Region index of every run of the frame
+	std::vector<Region> regions;		// Regions of the current frame
+	std::vector<int> quadStarts;		// First entry of each quad region in runOrder
+	std::vector<int> runOrder;			// Runs grouped by quad region, in raster order
+	std::vector<cv::Point> points;		// Boundary points of the current region
+	std::vector<cv::Point> hull;		// Convex hull of the current region
+	std::vector<cv::Point> polygon;		// Quad approximation of the current hull
+};
@@ -0,0 +1,287 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Persistent work-stealing thread pool
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <algorithm>
+
+/* Helper includes */
+#include "ThreadPool.h"
+
+
+/* Number of tasks each worker queue can hold before the caller runs them inline */
+static const int QUEUE_CAPACITY = 256;
+
+/* Number of tasks a loop is split into for each slot, so that stealing can balance uneven work */
+static const int TASKS_PER_SLOT = 4;
+
+
+/*  Creates a pool with the given number of worker threads
+ *
+ *	@param numWorkers: The number of threads to start, in addition to the calling thread
+ */
+ThreadPool::ThreadPool(int numWorkers) : queuedTasks(0), nextQueue(0), stopping(false) {
+
+	for (int i = 0; i < numWorkers; i++) {
+		queues.emplace_back(new TaskQueue());
+		queues.back()->tasks.resize(QUEUE_CAPACITY);
+		queues.back()->head = 0;
+		queues.back()->count = 0;
+	}
+
+	for (int i = 0; i < numWorkers; i++) {
+		workers.emplace_back(&ThreadPool::workerLoop, this, i + 1);
+	}
+}
+
+
+/*  Finishes the queued tasks and joins the worker threads */
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+
+/*  Returns the process-wide pool, with one worker per additional hardware thread.
+ *	The pool is intentionally never destroyed: joining threads while a DLL is being
+ *	unloaded can deadlock, and the threads end with the process anyway.
+ *
+ *	@return pool: The shared thread pool
+ */
+ThreadPool &ThreadPool::shared() {
+	static ThreadPool* pool = new ThreadPool(std::max(0, (int)std::thread::hardware_concurrency() - 1));
+	return *pool;
+}
+
+
+/*  Runs invoke(body, index, slot) for every index in [0, count) and waits for all of them
+ *	The range is split into tasks that are spread over the worker queues. The calling
+ *	thread runs the first task itself and then helps with the tasks of this job only.
+ *
+ *	@param count: The number of loop indices
+ *	@param invoke: Type-erased function calling the loop body
+ *	@param body: The loop body object
+ *
+ *	@return void
+ */
+void ThreadPool::run(int count, void (*invoke)(void*, int, int), void* body) {
+
+	if (count <= 0) {
+		return;
+	}
+
+	// Nothing to share the work with, so we run everything here
+	if (workers.empty() || count == 1) {
+		for (int i = 0; i < count; i++) {
+			invoke(body, i, 0);
+		}
+		return;
+	}
+
+	// Split the range into tasks of equal size
+	int numTasks = std::min(count, slotCount() * TASKS_PER_SLOT);
+	int taskSize = (count + numTasks - 1) / numTasks;
+	numTasks = (count + taskSize - 1) / taskSize;
+
+	Job job;
+	job.invoke = invoke;
+	job.body = body;
+	job.remainingTasks = numTasks;
+
+	// Queue every task except the first one, which the calling thread keeps
+	int queueIndex = nextQueue.fetch_add(1) % (int)queues.size();
+	int queued = 0;
+	for (int t = 1; t < numTasks; t++) {
+		Task task = { &job, t * taskSize, std::min(count, (t + 1) * taskSize) };
+		if (pushTask(queueIndex, task)) {
+			queued++;
+		}
+		else {
+			runTask(task, 0);
+		}
+		queueIndex = (queueIndex + 1) % (int)queues.size();
+	}
+
+	if (queued > 0) {
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		wake.notify_all();
+	}
+
+	// Run our own task, then help with any of this job's tasks that have not been picked up
+	Task own = { &job, 0, std::min(count, taskSize) };
+	runTask(own, 0);
+
+	Task task;
+	while (stealJobTask(&job, task)) {
+		runTask(task, 0);
+	}
+
+	// Wait for the tasks still running on the workers
+	std::unique_lock<std::mutex> lock(job.mutex);
+	job.finished.wait(lock, [&job] { return job.remainingTasks == 0; });
+}
+
+
+/*  Main loop of a worker thread: run own tasks, then steal, then sleep
+ *
+ *	@param slot: The slot index of this worker, starting at 1
+ *
+ *	@return void
+ */
+void ThreadPool::workerLoop(int slot) {
+
+	int queueIndex = slot - 1;
+	while (true) {
+		Task task;
+		if (popTask(queueIndex, task) || stealTask(queueIndex, task)) {
+			runTask(task, slot);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(wakeMutex);
+		wake.wait(lock, [this] { return stopping || queuedTasks.load() > 0; });
+		if (stopping && queuedTasks.load() == 0) {
+			return;
+		}
+	}
+}
+
+
+/*  Adds a task to the back of a worker queue
+ *
+ *	@param queueIndex: The queue to add the task to
+ *	@param task: The task to add
+ *
+ *	@return queued: False if the queue is full
+ */
+bool ThreadPool::pushTask(int queueIndex, const Task &task) {
+
+	TaskQueue &queue = *queues[queueIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.count == QUEUE_CAPACITY) {
+		return false;
+	}
+
+	queue.tasks[(queue.head + queue.count) % QUEUE_CAPACITY] = task;
+	queue.count++;
+	queuedTasks.fetch_add(1);
+	return true;
+}
+
+
+/*  Takes the most recently added task from a worker's own queue
+ *
+ *	@param queueIndex: The queue of the worker
+ *	@param task: Container to hold the task
+ *
+ *	@return found: True if a task was taken
+ */
+bool ThreadPool::popTask(int queueIndex, Task &task) {
+
+	TaskQueue &queue = *queues[queueIndex];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.count == 0) {
+		return false;
+	}
+
+	queue.count--;
+	task = queue.tasks[(queue.head + queue.count) % QUEUE_CAPACITY];
+	queuedTasks.fetch_sub(1);
+	return true;
+}
+
+
+/*  Takes the oldest task from the first other worker queue that has one
+ *
+ *	@param thiefIndex: The queue of the worker that is stealing
+ *	@param task: Container to hold the task
+ *
+ *	@return found: True if a task was stolen
+ */
+bool ThreadPool::stealTask(int thiefIndex, Task &task) {
+
+	int numQueues = (int)queues.size();
+	for (int k = 1; k < numQueues; k++) {
+		TaskQueue &queue = *queues[(thiefIndex + k) % numQueues];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.count == 0) {
+			continue;
+		}
+
+		task = queue.tasks[queue.head];
+		queue.head = (queue.head + 1) % QUEUE_CAPACITY;
+		queue.count--;
+		queuedTasks.fetch_sub(1);
+		return true;
+	}
+
+	return false;
+}
+
+
+/*  Takes a task belonging to the given job from any worker queue
+ *	The calling thread of parallelFor only helps with its own job, since its
+ *	slot index would clash with another caller's slot 0.
+ *
+ *	@param job: The job the task must belong to
+ *	@param task: Container to hold the task
+ *
+ *	@return found: True if a task was taken
+ */
+bool ThreadPool::stealJobTask(const Job* job, Task &task) {
+
+	for (size_t q = 0; q < queues.size(); q++) {
+		TaskQueue &queue = *queues[q];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		for (int k = 0; k < queue.count; k++) {
+			int index = (queue.head + k) % QUEUE_CAPACITY;
+			if (queue.tasks[index].job != job) {
+				continue;
+			}
+
+			// Fill the hole with the front task and drop the front
+			task = queue.tasks[index];
+			queue.tasks[index] = queue.tasks[queue.head];
+			queue.head = (queue.head + 1) % QUEUE_CAPACITY;
+			queue.count--;
+			queuedTasks.fetch_sub(1);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/*  Runs every index of a task and signals the job when its last task is done
+ *
+ *	@param task: The task to run
+ *	@param slot: The slot index of the running thread
+ *
+ *	@return void
+ */
+void ThreadPool::runTask(const Task &task, int slot) {
+
+	Job* job = task.job;
+	for (int i = task.begin; i < task.end; i++) {
+		job->invoke(job->body, i, slot);
+	}
+
+	// The job lives on the caller's stack, so it must not be touched after the mutex is released
+	std::lock_guard<std::mutex> lock(job->mutex);
+	job->remainingTasks--;
+	if (job->remainingTasks == 0) {
+		job->finished.notify_all();
+	}
+}
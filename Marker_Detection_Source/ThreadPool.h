@@ -0,0 +1,92 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the persistent work-stealing thread pool
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* Standard includes */
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/*  Persistent pool of worker threads with one task queue per worker.
+ *	Idle workers steal tasks from the other queues, and the calling thread
+ *	helps with its own work while it waits. Every task is told which slot
+ *	it runs on (0 for the calling thread, 1..workers for the pool threads),
+ *	so callers can keep per-slot scratch buffers without locking.
+ */
+class ThreadPool
+{
+public:
+	/*  Creates a pool with the given number of worker threads */
+	explicit ThreadPool(int numWorkers);
+	~ThreadPool();
+
+	/*  Returns the process-wide pool, with one worker per additional hardware thread */
+	static ThreadPool &shared();
+
+	/*  Returns the number of slots tasks can run on, including the calling thread */
+	int slotCount() const { return (int)workers.size() + 1; }
+
+	/*  Runs body(index, slot) for every index in [0, count) and waits for all of them */
+	template <typename Body>
+	void parallelFor(int count, Body &body) {
+		run(count, &invokeBody<Body>, &body);
+	}
+
+private:
+	/*  One call to parallelFor, shared by all of its tasks */
+	struct Job
+	{
+		void (*invoke)(void*, int, int);	// Type-erased loop body
+		void* body;							// Loop body object
+		int remainingTasks;					// Tasks not finished yet, guarded by mutex
+		std::mutex mutex;					// Guards remainingTasks
+		std::condition_variable finished;	// Signalled when the last task finishes
+	};
+
+	/*  Contiguous range of loop indices */
+	struct Task
+	{
+		Job* job;
+		int begin;
+		int end;
+	};
+
+	/*  Fixed-capacity ring buffer of tasks owned by one worker */
+	struct TaskQueue
+	{
+		std::mutex mutex;
+		std::vector<Task> tasks;
+		int head;
+		int count;
+	};
+
+	template <typename Body>
+	static void invokeBody(void* body, int index, int slot) {
+		(*static_cast<Body*>(body))(index, slot);
+	}
+
+	void run(int count, void (*invoke)(void*, int, int), void* body);
+	void workerLoop(int slot);
+	bool pushTask(int queueIndex, const Task &task);
+	bool popTask(int queueIndex, Task &task);
+	bool stealTask(int thiefIndex, Task &task);
+	bool stealJobTask(const Job* job, Task &task);
+	void runTask(const Task &task, int slot);
+
+	std::vector<std::thread> workers;					// Pool threads
+	std::vector<std::unique_ptr<TaskQueue>> queues;		// One queue per pool thread
+	std::mutex wakeMutex;								// Guards sleeping workers
+	std::condition_variable wake;						// Signalled when tasks are queued
+	std::atomic<int> queuedTasks;						// Tasks sitting in any queue
+	std::atomic<int> nextQueue;							// Round-robin start for new jobs
+	bool stopping;										// Set when the pool shuts down
+};
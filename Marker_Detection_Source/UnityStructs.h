@@ -18,6 +18,30 @@ struct Color32
 };
 
 
+/*  Pixel formats an input image can be given in */
+enum PixelFormat
+{
+	PIXEL_RGBA32 = 0,		// Packed R, G, B, A bytes, as Color32
+	PIXEL_BGRA32 = 1,		// Packed B, G, R, A bytes
+	PIXEL_GRAY8 = 2,		// One luma byte per pixel
+	PIXEL_NV12 = 3,			// Y plane, then a half resolution plane of interleaved U, V bytes
+	PIXEL_NV21 = 4,			// Y plane, then a half resolution plane of interleaved V, U bytes
+	PIXEL_YUYV = 5,			// Packed 4:2:2 as Y0, U, Y1, V
+	PIXEL_UYVY = 6			// Packed 4:2:2 as U, Y0, V, Y1
+};
+
+
+/*  Structure that describes an input image in any of the pixel formats */
+struct ImageDescriptor
+{
+	int format;				// One of PixelFormat
+	int width;				// Width of the image in pixels
+	int height;				// Height of the image in pixels
+	void* planes[2];		// Pixels or Y plane, then the chroma plane of NV12 and NV21 (required, never read)
+	int strides[2];			// Bytes from one row of each plane to the next, 0 for tightly packed rows
+};
+
+
 /*  Structure that holds characteristics of a detected marker */
 struct Marker2
 {
@@ -37,4 +61,101 @@ struct Marker2
 	float rotate_31;		// Value in row 3 column 1 of rotation matrix
 	float rotate_32;		// Value in row 3 column 2 of rotation matrix
 	float rotate_33;		// Value in row 3 column 3 of rotation matrix
-};
\ No newline at end of file
+};
+
+
+/*  Structure that holds the pose of a board of markers, estimated from all of its visible markers at once */
+struct BoardPose
+{
+	int markers;			// Markers of the board found in the frame, 0 if the board was not seen
+	float error;			// RMS reprojection error of the board corners in pixels
+	float distance;			// Distance from the board origin to camera
+	float translate_x;		// x coordinate of translation of board
+	float translate_y;		// y coordinate of translation of board
+	float translate_z;		// z coordinate of translation of board
+	float rotate_11;		// Value in row 1 column 1 of rotation matrix
+	float rotate_12;		// Value in row 1 column 2 of rotation matrix
+	float rotate_13;		// Value in row 1 column 3 of rotation matrix
+	float rotate_21;		// Value in row 2 column 1 of rotation matrix
+	float rotate_22;		// Value in row 2 column 2 of rotation matrix
+	float rotate_23;		// Value in row 2 column 3 of rotation matrix
+	float rotate_31;		// Value in row 3 column 1 of rotation matrix
+	float rotate_32;		// Value in row 3 column 2 of rotation matrix
+	float rotate_33;		// Value in row 3 column 3 of rotation matrix
+};
+
+
+/*  Structure that holds the calibration of a camera, in the pinhole model with lens distortion used by OpenCV */
+struct CameraIntrinsics
+{
+	float focalX;			// Focal length along x in pixels
+	float focalY;			// Focal length along y in pixels
+	float principalX;		// x coordinate of the principal point in pixels, negative for the image center
+	float principalY;		// y coordinate of the principal point in pixels, negative for the image center
+	float distortion[5];	// Distortion coefficients k1, k2, p1, p2, k3, all zero for an ideal lens
+};
+
+
+/*  Structure that holds the tunable parameters of a marker detector */
+struct DetectorConfig
+{
+	int binaryThreshold;	// Threshold used to binarize the grayscale image
+	int cellThreshold;		// Threshold used to binarize the cells of a rectified marker
+	float minMarkerArea;	// Minimum area in pixels of a marker candidate
+	float markerSize;		// Side length of the marker, in the units of the returned translation
+	int parallelCandidates;	// Nonzero to validate candidates on the shared thread pool
+	int trackingMode;		// Nonzero to search only around previously detected markers
+	int reacquireInterval;	// In tracking mode, scan the whole frame every this many frames
+	float trackingMargin;	// In tracking mode, search margin around a marker relative to its size
+	int pyramidLevels;		// Search for quads on an image downsampled 2^levels times (0 for full resolution)
+	int collectStats;		// Nonzero to record per-stage timings and counts, read with getMarkerDetectorStats
+	int suppressDuplicates;	// Nonzero to drop quads that repeat another quad of the same frame
+	int minContourPoints;	// Contours with fewer points are rejected before polygon approximation
+	float maxAspectRatio;	// Largest ratio between the sides of a contour's bounding box (0 for no limit)
+	float maxMarkerPerimeter;	// Longest contour perimeter in pixels at full resolution (0 for no limit)
+	int runLengthExtraction;	// Nonzero to find quads from runs of dark pixels instead of findContours
+	int drawOverlay;		// Nonzero to draw the outline of every marker into RGBA and BGRA inputs
+	CameraIntrinsics camera;	// Calibration of the camera, used for the pose of every marker
+	int poseIterations;		// Most Levenberg-Marquardt iterations refining the pose of a marker
+	float poseErrorTolerance;	// Pose refinement stops once the RMS reprojection error is at most this many pixels
+	float poseStepTolerance;	// Pose refinement stops once a step moves the rotation and relative translation by at most this
+	int warmStartPose;		// Nonzero to start the pose of a marker from its pose in the previous frame
+	float warmStartTolerance;	// Largest RMS reprojection error in pixels of the previous pose for it to be used
+	int batchPose;			// Nonzero to solve the poses of the markers of a frame together, several per instruction
+	int gradientRefinement;	// Nonzero to refine edges on one gradient image per frame, shared by overlapping candidates
+};
+
+
+/*  Structure that holds the rolling latency of one detection stage, in milliseconds */
+struct StageLatency
+{
+	float p50;				// Median over the recent frames
+	float p99;				// 99th percentile over the recent frames
+	float last;				// Latency of the latest frame
+	int samples;			// Number of recent frames the percentiles are taken over
+};
+
+
+/*  Structure that holds the statistics recorded by a detector while collectStats is set */
+struct DetectorStats
+{
+	int frames;					// Frames recorded since the last reset
+	StageLatency conversion;	// Grayscale conversion and thresholding
+	StageLatency contours;		// Contour extraction
+	StageLatency polygonFilter;	// Polygon approximation and quad filter
+	StageLatency refinement;	// Edge refinement, summed over the candidates of a frame
+	StageLatency decoding;		// Rectification and code reading, summed over the candidates of a frame
+	StageLatency pose;			// Pose estimation, summed over the markers of a frame
+	StageLatency total;			// Whole frame, excluding time spent waiting in a pipeline queue
+	int contoursFound;			// Contours found in the latest frame
+	int quadsPassed;			// Quads that passed the polygon filter in the latest frame
+	int borderRejects;			// Candidates whose border was not black in the latest frame
+	int codeRejects;			// Candidates with an all black or all white code in the latest frame
+	int markersEmitted;			// Markers reported in the latest frame
+	int duplicatesSuppressed;	// Duplicate quads dropped before validation in the latest frame
+	int rejectedPointCount;		// Contours with too few points in the latest frame
+	int rejectedBoundingBox;	// Contours whose bounding box is too small in the latest frame
+	int rejectedAspectRatio;	// Contours whose bounding box is too elongated in the latest frame
+	int rejectedPerimeter;		// Contours too short or too long in the latest frame
+	int rejectedPolygon;		// Contours that are not a large convex quad in the latest frame
+};
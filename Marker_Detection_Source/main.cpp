@@ -7,28 +7,464 @@
 
 /* OpenCV includes */
 #include <opencv2/core.hpp>
-#include <opencv2/imgcodecs.hpp>
-#include <opencv2/imgproc.hpp>
-#include <opencv2/highgui.hpp>
 
-/* File I/O (for debugging) includes */
-#include <iostream>
-#include <iomanip>
+/* Standard includes */
+#include <atomic>
+#include <mutex>
 
 /* Helper function includes */
-#include "PoseEstimation.h"
+#include "MarkerExport.h"
 #include "UnityStructs.h"
-#include "MarkerHelpers.h"
-#include "EdgeRefinement.h"
+#include "MarkerDetector.h"
+#include "MarkerPipeline.h"
 
 
-/* Namespaces */
-using namespace cv;
-using namespace std;
+/*  Creates a persistent marker detector with the default configuration.
+ *	The detector owns all of its working buffers and reuses them between frames.
+ *	Extern C enables this function to be callable as a library function when linked to its .dll.
+ *
+ *	@return detector: Handle to the new detector, to be released with destroyMarkerDetector
+ */
+extern "C" MARKER_API void* MARKER_CALL createMarkerDetector() {
+	return new MarkerDetector();
+}
+
+
+/*  Fills in the configuration that a newly created detector uses.
+ *
+ *	@param config: The configuration to fill in
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL getDefaultDetectorConfig(DetectorConfig* config) {
+	if (config) {
+		getDefaultConfig(*config);
+	}
+}
+
+
+/*  Replaces the configuration of a detector.
+ *
+ *	@param detector: Handle returned by createMarkerDetector
+ *	@param config: The new detector parameters
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL configureMarkerDetector(void* detector, const DetectorConfig* config) {
+	if (detector && config) {
+		static_cast<MarkerDetector*>(detector)->configure(*config);
+	}
+}
+
+
+/*  Finds and locates the AR markers in the image using a persistent detector.
+ *	The marker outlines are only drawn into the image if drawOverlay is set in its configuration.
+ *
+ *	@param detector: Handle returned by createMarkerDetector
+ *	@param outMarks: Array to hold a Marker2 for each marker detected in the image
+ *	@param raw: The raw colour image that we want to locate markers in
+ *	@param width: The width of the input image
+ *	@param height: The height of the input image
+ *	@param maxOutMarkerCount: The maximum number of markers to be found in the image
+ *
+ *	@return outMarkerDetected: The number of markers detected in the image
+ */
+extern "C" MARKER_API int MARKER_CALL detectMarkers(void* detector, Marker2* outMarks, Color32* raw, int width, int height, int maxOutMarkerCount) {
+	if (!detector || !outMarks || !raw) {
+		return 0;
+	}
+
+	return static_cast<MarkerDetector*>(detector)->detect(outMarks, maxOutMarkerCount, raw, width, height);
+}
+
+
+/*  Finds and locates the AR markers in an image of any supported pixel format using a persistent detector.
+ *	Grayscale, NV12 and NV21 images are searched in their Y plane without any copy, and
+ *	outlines are only drawn into RGBA and BGRA images. The chroma plane must be given but is
+ *	never read, and an image that does not fit its format gives no markers.
+ *
+ *	@param detector: Handle returned by createMarkerDetector
+ *	@param outMarks: Array to hold a Marker2 for each marker detected in the image
+ *	@param image: The pixel format, size, plane pointers and strides of the input image
+ *	@param maxOutMarkerCount: The maximum number of markers to be found in the image
+ *
+ *	@return outMarkerDetected: The number of markers detected in the image
+ */
+extern "C" MARKER_API int MARKER_CALL detectMarkersInImage(void* detector, Marker2* outMarks, const ImageDescriptor* image, int maxOutMarkerCount) {
+	if (!detector || !outMarks || !image) {
+		return 0;
+	}
+
+	return static_cast<MarkerDetector*>(detector)->detect(outMarks, maxOutMarkerCount, *image);
+}
+
+
+/*  Registers a board of markers with a known rigid layout, such as several markers on one fixture.
+ *	Each marker is given by the board coordinates of its four corners, in the order of the
+ *	corners of a lone marker: (-s/2, s/2, 0), (-s/2, -s/2, 0), (s/2, -s/2, 0), (s/2, s/2, 0)
+ *	in the frame of the marker with its cells read as its ID. The board pose is then solved once per frame from every visible
+ *	corner of the board, and the markers of the board report the pose that follows from it.
+ *
+ *	@param detector: Handle returned by createMarkerDetector
+ *	@param ids: The ID of each marker on the board, or NULL with a count of 0 to remove the board
+ *	@param corners: The 12 coordinates of the corners of each marker, in the order of ids
+ *	@param markerCount: The number of markers on the board, at most 64
+ *
+ *	@return valid: 1 if the board was registered, 0 if the layout is invalid
+ */
+extern "C" MARKER_API int MARKER_CALL setMarkerBoard(void* detector, const int* ids, const float* corners, int markerCount) {
+	if (!detector) {
+		return 0;
+	}
+
+	return static_cast<MarkerDetector*>(detector)->setBoard(ids, corners, markerCount) ? 1 : 0;
+}
+
+
+/*  Reads the board pose of the latest frame given to detectMarkers or detectMarkersInImage.
+ *	The markers field is 0 if no marker of the board was found.
+ *
+ *	@param detector: Handle returned by createMarkerDetector
+ *	@param pose: Container to hold the board pose
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL getMarkerBoardPose(void* detector, BoardPose* pose) {
+	if (detector && pose) {
+		*pose = static_cast<MarkerDetector*>(detector)->getBoardPose();
+	}
+}
+
+
+/*  Reads the per-stage latencies and counts recorded by a detector.
+ *	Nothing is recorded unless collectStats is set in the detector configuration.
+ *	Latencies are in milliseconds, as percentiles over the most recent frames.
+ *
+ *	@param detector: Handle returned by createMarkerDetector
+ *	@param stats: Container to hold the statistics
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL getMarkerDetectorStats(void* detector, DetectorStats* stats) {
+	if (detector && stats) {
+		static_cast<MarkerDetector*>(detector)->getStats(*stats);
+	}
+}
+
+
+/*  Forgets the statistics recorded by a detector.
+ *
+ *	@param detector: Handle returned by createMarkerDetector
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL resetMarkerDetectorStats(void* detector) {
+	if (detector) {
+		static_cast<MarkerDetector*>(detector)->resetStats();
+	}
+}
+
+
+/*  Releases a detector and all of its buffers.
+ *
+ *	@param detector: Handle returned by createMarkerDetector
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL destroyMarkerDetector(void* detector) {
+	delete static_cast<MarkerDetector*>(detector);
+}
+
+
+/*  Creates an asynchronous detection pipeline.
+ *	Frames are submitted with submitMarkerFrame and their markers come back through
+ *	pollMarkerResults, or through a callback set with setMarkerResultCallback.
+ *
+ *	@param depth: The maximum number of frames in flight, trading latency for throughput
+ *
+ *	@return pipeline: Handle to the new pipeline, to be released with destroyMarkerPipeline
+ */
+extern "C" MARKER_API void* MARKER_CALL createMarkerPipeline(int depth) {
+	return new MarkerPipeline(depth);
+}
+
+
+/*  Replaces the configuration of a pipeline, once the frames being processed are done.
+ *	The result callback cannot wait for the frame it is delivering, so this fails when called from it.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *	@param config: The new detector parameters
+ *
+ *	@return applied: 1 if the configuration was replaced, 0 if called from the result callback
+ */
+extern "C" MARKER_API int MARKER_CALL configureMarkerPipeline(void* pipeline, const DetectorConfig* config) {
+	if (!pipeline || !config) {
+		return 0;
+	}
+
+	return static_cast<MarkerPipeline*>(pipeline)->configure(*config) ? 1 : 0;
+}
+
+
+/*  Registers a board of markers in a pipeline, once the frames being processed are done.
+ *	The layout is given as for setMarkerBoard. Fails when called from the result callback.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *	@param ids: The ID of each marker on the board, or NULL with a count of 0 to remove the board
+ *	@param corners: The 12 coordinates of the corners of each marker, in the order of ids
+ *	@param markerCount: The number of markers on the board, at most 64
+ *
+ *	@return valid: 1 if the board was registered, 0 if the layout is invalid or if called from the result callback
+ */
+extern "C" MARKER_API int MARKER_CALL setMarkerPipelineBoard(void* pipeline, const int* ids, const float* corners, int markerCount) {
+	if (!pipeline) {
+		return 0;
+	}
+
+	return static_cast<MarkerPipeline*>(pipeline)->setBoard(ids, corners, markerCount) ? 1 : 0;
+}
+
+
+/*  Queues a frame for asynchronous detection.
+ *	The image must stay valid until its result has been delivered.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *	@param raw: The raw colour image that we want to locate markers in
+ *	@param width: The width of the input image
+ *	@param height: The height of the input image
+ *	@param maxOutMarkerCount: The maximum number of markers to be found in the image
+ *	@param wait: Nonzero to block until the pipeline has room for the frame, ignored in the result callback
+ *
+ *	@return sequence: The sequence number of the frame, or -1 if the pipeline is full
+ */
+extern "C" MARKER_API int MARKER_CALL submitMarkerFrame(void* pipeline, Color32* raw, int width, int height, int maxOutMarkerCount, int wait) {
+	if (!pipeline || !raw) {
+		return -1;
+	}
+
+	return static_cast<MarkerPipeline*>(pipeline)->submit(raw, width, height, maxOutMarkerCount, wait != 0);
+}
+
+
+/*  Queues a frame of any supported pixel format for asynchronous detection.
+ *	The planes of the image must stay valid until its result has been delivered.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *	@param image: The pixel format, size, plane pointers and strides of the input image
+ *	@param maxOutMarkerCount: The maximum number of markers to be found in the image
+ *	@param wait: Nonzero to block until the pipeline has room for the frame, ignored in the result callback
+ *
+ *	@return sequence: The sequence number of the frame, or -1 if the pipeline is full
+ */
+extern "C" MARKER_API int MARKER_CALL submitMarkerImage(void* pipeline, const ImageDescriptor* image, int maxOutMarkerCount, int wait) {
+	if (!pipeline || !image) {
+		return -1;
+	}
+
+	return static_cast<MarkerPipeline*>(pipeline)->submit(*image, maxOutMarkerCount, wait != 0);
+}
+
+
+/*  Takes the markers of the oldest finished frame.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *	@param outMarks: Array to hold a Marker2 for each marker detected in the frame
+ *	@param maxOutMarkerCount: The size of outMarks
+ *	@param outMarkerDetected: The number of markers detected in the frame
+ *	@param outSequence: The sequence number of the frame
+ *
+ *	@return ready: 1 if a frame was returned, 0 if none has finished yet
+ */
+extern "C" MARKER_API int MARKER_CALL pollMarkerResults(void* pipeline, Marker2* outMarks, int maxOutMarkerCount, int& outMarkerDetected, int& outSequence) {
+	if (!pipeline) {
+		return 0;
+	}
+
+	return static_cast<MarkerPipeline*>(pipeline)->poll(outMarks, maxOutMarkerCount, outMarkerDetected, outSequence) ? 1 : 0;
+}
+
+
+/*  Takes the markers and the board pose of the oldest finished frame.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *	@param outMarks: Array to hold a Marker2 for each marker detected in the frame
+ *	@param maxOutMarkerCount: The size of outMarks
+ *	@param outMarkerDetected: The number of markers detected in the frame
+ *	@param outSequence: The sequence number of the frame
+ *	@param outBoard: Container to hold the board pose of the frame
+ *
+ *	@return ready: 1 if a frame was returned, 0 if none has finished yet
+ */
+extern "C" MARKER_API int MARKER_CALL pollMarkerBoardResults(void* pipeline, Marker2* outMarks, int maxOutMarkerCount, int& outMarkerDetected, int& outSequence, BoardPose* outBoard) {
+	if (!pipeline) {
+		return 0;
+	}
+
+	return static_cast<MarkerPipeline*>(pipeline)->poll(outMarks, maxOutMarkerCount, outMarkerDetected, outSequence, outBoard) ? 1 : 0;
+}
+
+
+/*  Delivers finished frames to a callback instead of queueing them for polling.
+ *	The callback runs on a pipeline thread. From the callback, configureMarkerPipeline and
+ *	setMarkerPipelineBoard fail, flushMarkerPipeline returns at once and submitting never waits.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *	@param callback: The function to call, or NULL to go back to polling
+ *	@param userData: Passed back to the callback
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL setMarkerResultCallback(void* pipeline, MarkerCallback callback, void* userData) {
+	if (pipeline) {
+		static_cast<MarkerPipeline*>(pipeline)->setCallback(callback, userData);
+	}
+}
+
+
+/*  Waits until every frame submitted to a pipeline has finished.
+ *	Returns at once when called from the result callback, which holds up the frame it is delivering.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL flushMarkerPipeline(void* pipeline) {
+	if (pipeline) {
+		static_cast<MarkerPipeline*>(pipeline)->flush();
+	}
+}
+
+
+/*  Reads the per-stage latencies and counts recorded by a pipeline.
+ *	Nothing is recorded unless collectStats is set in the pipeline configuration.
+ *	The total latency excludes the time frames spend waiting between the pipeline stages.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *	@param stats: Container to hold the statistics
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL getMarkerPipelineStats(void* pipeline, DetectorStats* stats) {
+	if (pipeline && stats) {
+		static_cast<MarkerPipeline*>(pipeline)->getStats(*stats);
+	}
+}
+
+
+/*  Forgets the statistics recorded by a pipeline.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL resetMarkerPipelineStats(void* pipeline) {
+	if (pipeline) {
+		static_cast<MarkerPipeline*>(pipeline)->resetStats();
+	}
+}
+
+
+/*  Stops a pipeline and releases it. Frames that have not finished are dropped.
+ *
+ *	@param pipeline: Handle returned by createMarkerPipeline
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL destroyMarkerPipeline(void* pipeline) {
+	delete static_cast<MarkerPipeline*>(pipeline);
+}
+
+
+/* Camera and marker size used by FindMarkers2 and FindMarkersInImage, set with setFindMarkersCamera */
+static std::mutex findMarkersCameraMutex;
+static CameraIntrinsics findMarkersCamera;
+static float findMarkersMarkerSize;
+
+/* Incremented whenever the camera above changes, so that every thread's detector picks it up */
+static std::atomic<int> findMarkersCameraVersion(0);
+
+
+/*  Sets the camera calibration and marker size that FindMarkers2 and FindMarkersInImage use.
+ *	Until this is called they assume a focal length of 400 pixels, the principal point at the
+ *	image center, no lens distortion and a marker size of 4.5.
+ *	Extern C enables this function to be callable as a library function when linked to its .dll.
+ *
+ *	@param camera: The focal lengths, principal point and distortion coefficients of the camera
+ *	@param markerSize: The side length of the markers, in the units of the returned translation
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL setFindMarkersCamera(const CameraIntrinsics* camera, float markerSize) {
+	if (!camera) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(findMarkersCameraMutex);
+	findMarkersCamera = *camera;
+	findMarkersMarkerSize = markerSize;
+	findMarkersCameraVersion++;
+}
+
+
+/*  Reconfigures a detector of FindMarkers2 or FindMarkersInImage if the camera has changed since it was last used
+ *
+ *	@param detector: The detector of the calling thread
+ *	@param version: The camera version the detector was configured with, updated here
+ *
+ *	@return void
+ */
+static void refreshFindMarkersCamera(MarkerDetector &detector, int &version) {
+
+	// Only an atomic load on every call, the lock is taken when the camera has changed
+	if (version == findMarkersCameraVersion.load()) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(findMarkersCameraMutex);
+	DetectorConfig config = detector.getConfig();
+	config.camera = findMarkersCamera;
+	config.markerSize = findMarkersMarkerSize;
+	detector.configure(config);
+	version = findMarkersCameraVersion.load();
+}
+
+
+/*  Returns the configuration of FindMarkers2 and FindMarkersInImage, which keep no pose from one call to the next
+ *	Every pose starts from the homography and runs the three iterations it always has, so the
+ *	result of a call never depends on the calls before it. Warm starts and early stopping are
+ *	left to the detector handles, see createMarkerDetector.
+ *
+ *	@return config: The default configuration without warm starts or early stopping
+ */
+static DetectorConfig statelessConfig() {
+	DetectorConfig config;
+	getDefaultConfig(config);
+	config.warmStartPose = 0;
+	config.poseErrorTolerance = 0.0f;
+	config.poseStepTolerance = 0.0f;
+	return config;
+}
+
+
+/*  Returns the configuration FindMarkers2 runs with, which draws the marker outlines as it always has
+ *
+ *	@return config: The stateless configuration with the overlay enabled
+ */
+static DetectorConfig overlayConfig() {
+	DetectorConfig config = statelessConfig();
+	config.drawOverlay = 1;
+	return config;
+}
 
 
 /*  Main function to find and locate the AR Markers located in the image.
  *	Extern C enables this function to be callable as a library function when linked to its .dll.
+ *	Uses a detector per calling thread, so buffers are reused across calls.
+ *	The green outline of every detected marker is drawn into the input image. Only the outline
+ *	pixels are written, with an opaque alpha, and every other pixel keeps the alpha it came with.
+ *	Every pose is refined from scratch with three iterations, as it always has been, so a call
+ *	never depends on the frames before it. Warm starts from the previous frame and early stopping
+ *	are only used by the detector handles and pipelines.
  *
  *	@param outMarks: A list of Marker2 for each marker detected in the image
  *	@param raw: The raw colour image that we want to locate markers in
@@ -39,141 +475,40 @@ using namespace std;
  *
  *	@return void
  */
-extern "C" void __declspec(dllexport) __stdcall FindMarkers2(Marker2** outMarks, Color32** raw, int width, int height, int maxOutMarkerCount, int& outMarkerDetected) {
+extern "C" MARKER_API void MARKER_CALL FindMarkers2(Marker2** outMarks, Color32** raw, int width, int height, int maxOutMarkerCount, int& outMarkerDetected) {
+
+	static thread_local MarkerDetector detector(overlayConfig());
+	static thread_local int cameraVersion = 0;
+	refreshFindMarkersCamera(detector, cameraVersion);
+
+	outMarkerDetected = detector.detect(*outMarks, maxOutMarkerCount, *raw, width, height);
+	return;
+}
+
+
+/*  Finds and locates the AR Markers in an image of any supported pixel format.
+ *	Behaves as FindMarkers2, but takes NV12, NV21, YUYV, UYVY, BGRA and grayscale images with
+ *	any row stride as well. Images with a Y plane are searched in place without any copy.
+ *	The input is treated as read-only, so no outline is drawn.
+ *
+ *	@param outMarks: A list of Marker2 for each marker detected in the image
+ *	@param image: The pixel format, size, plane pointers and strides of the input image
+ *	@param maxOutMarkerCount: The maximum number of markers to be found in the image
+ *	@param outMarkerDetected: The number of markers detected in the image
+ *
+ *	@return void
+ */
+extern "C" MARKER_API void MARKER_CALL FindMarkersInImage(Marker2** outMarks, const ImageDescriptor* image, int maxOutMarkerCount, int& outMarkerDetected) {
 
-	// Convert the input raw image to cv::Mat format
-	Mat old_frame(height, width, CV_8UC4, *raw);
+	static thread_local MarkerDetector detector(statelessConfig());
+	static thread_local int cameraVersion = 0;
 
-	// If there is nothing provided in the input image, we return
-	if (old_frame.empty())
-	{
+	outMarkerDetected = 0;
+	if (!outMarks || !image) {
 		return;
 	}
+	refreshFindMarkersCamera(detector, cameraVersion);
 
-	// We find the grayscale image, and then binarize it via thresholding
-	Mat frame, binary_im, gray_frame;
-	cv::cvtColor(old_frame, frame, cv::COLOR_RGBA2BGR);
-	cv::cvtColor(frame, gray_frame, cv::COLOR_BGR2GRAY);
-	cv::threshold(gray_frame, binary_im, 105, 255, cv::THRESH_BINARY);
-
-	// We then find the contours from the binary image
-	vector<vector<Point>> contours;
-	cv::findContours(binary_im, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
-
-	// We then process each contour individually
-	vector<Point> polygon;
-	for (size_t i = 0; i < contours.size(); i++) {
-
-		// Approximate contour to polygon with accuracy proportional to contour perimeter
-		approxPolyDP(contours[i], polygon, arcLength(contours[i], true)*0.02, true);
-
-		// We ignore the polygon if it is too small, is nonconvex, or does not have 4 sides
-		if (polygon.size() != 4 || fabs(contourArea(polygon)) < 1000 || !isContourConvex(polygon)) {
-			continue;
-		}
-
-		int n = polygon.size();					// Size of the approximated marker square
-		const Point* rect = &polygon[0];			// Holds the corners to this marker
-		float lineParameters[16];					// Container to hold edge line equation parameters
-		cv::Mat lineParamsMat(cv::Size(4, 4), CV_32F, lineParameters); 
-
-		// Refines line position
-		refineEdges(lineParamsMat, rect, gray_frame);
-
-		// Finds the refined corners given the refined lines
-		cv::Point2f corners[4];
-		findCorners(corners, lineParameters);
-
-		// Now perform a homography of the marker 
-		cv::Point2f squareCorners[4];
-		squareCorners[0].x = -0.5;
-		squareCorners[0].y = -0.5;
-		squareCorners[1].x = 5.5;
-		squareCorners[1].y = -0.5;
-		squareCorners[2].x = 5.5;
-		squareCorners[2].y = 5.5;
-		squareCorners[3].x = -0.5;
-		squareCorners[3].y = 5.5;
-
-		// Create and calculate the matrix of perspective transform
-		cv::Mat projectionMatrix(cv::Size(3, 3), CV_32FC1);
-		projectionMatrix = cv::getPerspectiveTransform(corners, squareCorners);
-
-		// Create image for the marker by warping marker in image to an orthogonal projection
-		cv::Mat planarMarker(cv::Size(6, 6), CV_8UC1);
-		cv::warpPerspective(gray_frame, planarMarker, projectionMatrix, cv::Size(6, 6));
-		cv::threshold(planarMarker, planarMarker, 100, 255, THRESH_BINARY);
-
-		// Check if the border is black for a valid marker. If not, we skip this polygon.
-		if (!checkBorderIsBlack(planarMarker)) {
-			continue;
-		}
-
-		// Find the marker ID given the projected marker
-		int codes[4];
-		getMarkerIDs(planarMarker, codes);
-
-		// If they're all black or white then it is an invalid marker, so we move to the next polygon
-		if ((codes[0] == 0) || (codes[0] == 0xffff)) {
-			continue;
-		}
-
-		// We draw the edges of the marker on the image for display when returned
-		cv::line(frame, corners[0], corners[1], CV_RGB(0, 255, 0), 2, 8, 0);
-		cv::line(frame, corners[1], corners[2], CV_RGB(0, 255, 0), 2, 8, 0);
-		cv::line(frame, corners[2], corners[3], CV_RGB(0, 255, 0), 2, 8, 0);
-		cv::line(frame, corners[3], corners[0], CV_RGB(0, 255, 0), 2, 8, 0);
-
-		// Account for symmetry in the codes to find the representative code of the marker
-		int code = correctCornerOrder(codes, corners);
-
-		// Obtain the center of the marker
-		float center_x, center_y;
-		findMarkerCenter(corners, center_x, center_y);
-
-		// Transfer screen coordinates to camera coordinates
-		for (int i = 0; i < 4; i++) {
-			corners[i].x -= frame.cols * 0.5;
-			corners[i].y = -corners[i].y + frame.rows * 0.5;
-		}
-
-		// Estimate the transformation matrix from optical center to marker center
-		float transformMatrix[16];
-		estimateSquarePose(transformMatrix, (cv::Point2f*)corners, 4.5);
-
-		// Find the distance from the marker to the optical center
-		float x = transformMatrix[3];
-		float y = transformMatrix[7];
-		float z = transformMatrix[11];
-		float distance_to_mark = sqrt(x * x + y * y + z * z);
-
-		// Create the Marker2 object to be sent to Unity
-		*outMarks[0] = {
-						code, distance_to_mark,
-						center_x, center_y,
-						transformMatrix[3], transformMatrix[7], transformMatrix[11],
-						transformMatrix[0], transformMatrix[1], transformMatrix[2],
-						transformMatrix[4], transformMatrix[5], transformMatrix[6],
-						transformMatrix[8], transformMatrix[9], transformMatrix[10]
-					   };
-
-		// Increment the number of markers detected and pointer to Marker2 array
-		outMarkerDetected++;
-		*outMarks[0]++;	
-
-		// If we've detected the maximum number of markers, we exit
-		if (outMarkerDetected == maxOutMarkerCount) {
-			break;
-		}
-
-	}
-
-	// We move the pointer back to the first Marker2 object in the array
-	for (int i = 0; i < outMarkerDetected; i++) {
-		*outMarks[0]--;
-	}
-
-	// Convert the image with drawn lines back to Color32 format
-	cvtColor(frame, old_frame, COLOR_BGR2RGBA);
+	outMarkerDetected = detector.detect(*outMarks, maxOutMarkerCount, *image);
 	return;
 }
\ No newline at end of file
@@ -0,0 +1,165 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test that detection allocates nothing once the detector is warmed up
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "MarkerDetector.h"
+
+
+/* Frames run before counting, long enough for tracking to settle and every buffer to reach its size */
+static const int WARM_UP_FRAMES = 40;
+
+/* Frames counted, more than the reacquire interval of the tracking configuration */
+static const int COUNTED_FRAMES = 20;
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int MAX_MARKERS = 64;
+
+
+/*  Calls to the global operator new, from any thread
+ *	OpenCV allocates Mat buffers and its own scratch space with cv::fastMalloc rather than operator
+ *	new, so only the allocations of the detector and of the standard library are counted.
+ */
+static std::atomic<long> allocationCount(0);
+
+void* operator new(size_t size) {
+	allocationCount++;
+	void* memory = malloc(size ? size : 1);
+	if (memory == NULL) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t &) noexcept {
+	allocationCount++;
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t &) noexcept {
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	free(memory);
+}
+
+
+/*  Renders a frame of upright markers
+ *	Upright markers keep their contours short. OpenCV approximates polygons in a buffer on the
+ *	stack, but allocates one with operator new for contours of more than about 130 points.
+ *
+ *	@param pixels: Container to hold the RGBA frame
+ *	@param shift: Horizontal shift of every marker, so that consecutive frames differ
+ *
+ *	@return expected: The number of markers drawn
+ */
+static int renderFrame(std::vector<Color32> &pixels, int shift) {
+
+	const Color32 background = { 190, 190, 190, 255 };
+	pixels.assign((size_t)WIDTH * HEIGHT, background);
+
+	const int codes[6] = { 0x1234, 0x0f0f, 0x5a5a, 0x00ff, 0x3c3c, 0x7e01 };
+	for (int i = 0; i < 6; i++) {
+		drawUprightMarker(pixels, WIDTH, 40 + 200 * (i % 3) + shift, 60 + 200 * (i / 3), 10, codes[i]);
+	}
+	return 6;
+}
+
+
+/*  Runs a detector on moving frames and checks that the frames after warm-up allocate nothing
+ *
+ *	@param name: The name of the configuration, for the output
+ *	@param config: The detector configuration
+ *	@param frames: The frames to run, in a loop
+ *
+ *	@return void
+ */
+static void checkConfiguration(const char* name, const DetectorConfig &config, std::vector<std::vector<Color32> > &frames) {
+
+	MarkerDetector detector(config);
+	std::vector<Marker2> markers(MAX_MARKERS);
+
+	for (int i = 0; i < WARM_UP_FRAMES; i++) {
+		std::vector<Color32> &frame = frames[i % frames.size()];
+		detector.detect(&markers[0], MAX_MARKERS, &frame[0], WIDTH, HEIGHT);
+	}
+
+	long worst = 0;
+	int found = 0;
+	for (int i = 0; i < COUNTED_FRAMES; i++) {
+		std::vector<Color32> &frame = frames[(WARM_UP_FRAMES + i) % frames.size()];
+		long before = allocationCount.load();
+		found += detector.detect(&markers[0], MAX_MARKERS, &frame[0], WIDTH, HEIGHT);
+		long allocations = allocationCount.load() - before;
+		if (allocations > worst) {
+			worst = allocations;
+		}
+	}
+
+	printf("%s: %d markers over %d frames, at most %ld allocations per frame\n", name, found, COUNTED_FRAMES, worst);
+	TEST_CHECK(found > 0);
+	TEST_CHECK(worst == 0);
+}
+
+
+int main() {
+
+	// A few frames with the markers in different places, so tracking follows them around
+	std::vector<std::vector<Color32> > frames(4);
+	for (size_t i = 0; i < frames.size(); i++) {
+		renderFrame(frames[i], 4 * (int)i);
+	}
+
+	DetectorConfig defaults;
+	getDefaultConfig(defaults);
+	checkConfiguration("default", defaults, frames);
+
+	DetectorConfig tracking = defaults;
+	tracking.trackingMode = 1;
+	tracking.reacquireInterval = 7;
+	checkConfiguration("tracking", tracking, frames);
+
+	DetectorConfig pyramid = defaults;
+	pyramid.pyramidLevels = 1;
+	checkConfiguration("pyramid", pyramid, frames);
+
+	DetectorConfig gradient = defaults;
+	gradient.gradientRefinement = 1;
+	checkConfiguration("gradient", gradient, frames);
+
+	DetectorConfig runLength = defaults;
+	runLength.runLengthExtraction = 1;
+	checkConfiguration("run_length", runLength, frames);
+
+	return testResult("AllocationTest");
+}
@@ -0,0 +1,503 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the joint pose of a board of markers
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "MarkerBoard.h"
+#include "MarkerDetector.h"
+#include "PoseSolver.h"
+
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int MAX_MARKERS = 16;
+static const float FOCAL_LENGTH = 400.0f;
+static const float MARKER_SIZE = 4.5f;
+
+/* Board poses solved from exact corners, and frames rendered for the detector */
+static const int POSES = 40;
+static const int FRAMES = 24;
+
+/* Largest error of a pose solved from exact corners, in rotation entries and relative to the distance */
+static const float EXACT_TOLERANCE = 1e-4f;
+
+/* Standard deviation in pixels of the noise added to the corners */
+static const float CORNER_NOISE = 0.5f;
+
+/* Largest error of the board pose found in a rendered frame, in rotation entries and relative to the distance,
+ * and largest RMS reprojection error in pixels. The stripe refinement places every edge up to a pixel inside
+ * the drawn marker, which shrinks the markers but not the gaps between them. */
+static const float RENDERED_ROTATION_TOLERANCE = 0.05f;
+static const float RENDERED_DISTANCE_TOLERANCE = 0.05f;
+static const float RENDERED_REPROJECTION_TOLERANCE = 2.0f;
+
+/* Markers of the board the detector sees, and a marker that is not on it */
+static const int BOARD_IDS[] = { 0x0137, 0x0258, 0x036c, 0x0456 };
+static const int LONE_ID = 0x0789;
+
+
+/* Rigid transformation, as a rotation in row-major order and a translation */
+struct Transform {
+	float R[9];
+	float t[3];
+};
+
+
+/*  Builds a transformation from rotations about x, y and z, applied in that order
+ *
+ *	@param ax: The angle about x in radians
+ *	@param ay: The angle about y in radians
+ *	@param az: The angle about z in radians
+ *	@param x: The translation along x
+ *	@param y: The translation along y
+ *	@param z: The translation along z
+ *
+ *	@return transform: The transformation
+ */
+static Transform makeTransform(float ax, float ay, float az, float x, float y, float z) {
+
+	const float Rx[9] = { 1, 0, 0, 0, cosf(ax), -sinf(ax), 0, sinf(ax), cosf(ax) };
+	const float Ry[9] = { cosf(ay), 0, sinf(ay), 0, 1, 0, -sinf(ay), 0, cosf(ay) };
+	const float Rz[9] = { cosf(az), -sinf(az), 0, sinf(az), cosf(az), 0, 0, 0, 1 };
+	float Ryx[9];
+	Transform transform;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			Ryx[3 * r + c] = Ry[3 * r] * Rx[c] + Ry[3 * r + 1] * Rx[3 + c] + Ry[3 * r + 2] * Rx[6 + c];
+		}
+	}
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			transform.R[3 * r + c] = Rz[3 * r] * Ryx[c] + Rz[3 * r + 1] * Ryx[3 + c] + Rz[3 * r + 2] * Ryx[6 + c];
+		}
+	}
+	transform.t[0] = x;
+	transform.t[1] = y;
+	transform.t[2] = z;
+	return transform;
+}
+
+
+/*  Composes two transformations
+ *
+ *	@param a: The outer transformation
+ *	@param b: The inner transformation
+ *
+ *	@return ab: The transformation applying b, then a
+ */
+static Transform compose(const Transform &a, const Transform &b) {
+
+	Transform ab;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			ab.R[3 * r + c] = a.R[3 * r] * b.R[c] + a.R[3 * r + 1] * b.R[3 + c] + a.R[3 * r + 2] * b.R[6 + c];
+		}
+		ab.t[r] = a.t[r] + a.R[3 * r] * b.t[0] + a.R[3 * r + 1] * b.t[1] + a.R[3 * r + 2] * b.t[2];
+	}
+	return ab;
+}
+
+
+/*  Applies a transformation to a point
+ *
+ *	@param transform: The transformation
+ *	@param point: The point
+ *	@param out: Container to hold the transformed point
+ *
+ *	@return void
+ */
+static void apply(const Transform &transform, const float* point, float* out) {
+	for (int r = 0; r < 3; r++) {
+		out[r] = transform.t[r] + transform.R[3 * r] * point[0] + transform.R[3 * r + 1] * point[1] + transform.R[3 * r + 2] * point[2];
+	}
+}
+
+
+/*  Projects a point of a marker into the camera, as the pose solver does
+ *
+ *	@param pose: The marker to camera transformation
+ *	@param point: The point in marker coordinates
+ *
+ *	@return image: The image point relative to the principal point, with y up
+ */
+static cv::Point2f project(const Transform &pose, const float* point) {
+	float p[3];
+	apply(pose, point, p);
+	return cv::Point2f(p[0] * (-FOCAL_LENGTH / p[2]), p[1] * (-FOCAL_LENGTH / p[2]));
+}
+
+
+/*  Returns a corner of a lone marker, in the order the pose solver takes them
+ *
+ *	@param k: The corner
+ *	@param point: Container to hold the corner in marker coordinates
+ *
+ *	@return void
+ */
+static void markerCorner(int k, float* point) {
+	const float unit[4][2] = { { -0.5f, 0.5f }, { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f } };
+	point[0] = MARKER_SIZE * unit[k][0];
+	point[1] = MARKER_SIZE * unit[k][1];
+	point[2] = 0.0f;
+}
+
+
+/*  Returns how far a pose matrix is from a transformation
+ *
+ *	@param mat: The 4x4 pose in row-major order
+ *	@param truth: The transformation it should be
+ *	@param rotationError: Container to hold the largest difference of a rotation entry
+ *
+ *	@return translationError: The distance between the translations, relative to the distance of the truth
+ */
+static float poseError(const float* mat, const Transform &truth, float &rotationError) {
+
+	rotationError = 0.0f;
+	float distanceSq = 0.0f, errorSq = 0.0f;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 3; c++) {
+			rotationError = std::max(rotationError, std::fabs(mat[4 * r + c] - truth.R[3 * r + c]));
+		}
+		float d = mat[4 * r + 3] - truth.t[r];
+		errorSq += d * d;
+		distanceSq += truth.t[r] * truth.t[r];
+	}
+	return std::sqrt(errorSq / distanceSq);
+}
+
+
+/*  Returns a random board pose that faces the camera and keeps the board in the image
+ *
+ *	@param rng: The random generator of the test
+ *	@param maxTilt: The largest rotation about x and y in radians
+ *	@param nearest: The smallest distance from the camera
+ *	@param farthest: The largest distance from the camera
+ *
+ *	@return pose: The board to camera transformation
+ */
+static Transform randomPose(std::mt19937 &rng, float maxTilt, float nearest, float farthest) {
+
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	float depth = nearest + (farthest - nearest) * (0.5f + 0.5f * unit(rng));
+	return makeTransform(maxTilt * unit(rng), maxTilt * unit(rng), 3.1415927f * unit(rng),
+		0.12f * depth * unit(rng), 0.08f * depth * unit(rng), -depth);
+}
+
+
+/*  Checks the board solve on exact and noisy corners of a layout with one marker out of the plane
+ *	Exact corners of any subset of the markers give the true pose, and every marker of the board
+ *	gets the pose of its placement. With noisy corners, the board pose must be steadier than
+ *	the poses of its markers solved one at a time.
+ *
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void checkSolve(std::mt19937 &rng) {
+
+	// Five markers in a row of three and a row of two, and a sixth raised on a wedge
+	const int count = 6;
+	Transform placements[count];
+	for (int m = 0; m < 5; m++) {
+		placements[m] = makeTransform(0.0f, 0.0f, 0.0f, 6.0f * (m % 3) - 6.0f, (m < 3) ? 3.0f : -3.0f, 0.0f);
+	}
+	placements[5] = makeTransform(0.5f, 0.0f, 0.3f, 6.0f, -3.0f, 1.5f);
+
+	int ids[count];
+	float layout[12 * count];
+	for (int m = 0; m < count; m++) {
+		ids[m] = 100 + m;
+		for (int k = 0; k < 4; k++) {
+			float corner[3];
+			markerCorner(k, corner);
+			apply(placements[m], corner, &layout[12 * m + 3 * k]);
+		}
+	}
+
+	MarkerBoard board;
+	TEST_CHECK(board.empty());
+	TEST_CHECK(board.setLayout(ids, layout, count));
+	TEST_CHECK(board.find(105) == 5 && board.find(99) == -1);
+
+	PoseSolver::RefineOptions<float> options;
+	options.maxIterations = 10;
+	options.errorTolerance = 1e-4f;
+	options.stepTolerance = 0.0f;
+	options.priorTolerance = 2.0f;
+
+	std::normal_distribution<float> noise(0.0f, CORNER_NOISE);
+	float worstRotation = 0.0f, worstTranslation = 0.0f;
+	double boardNoiseError = 0.0, markerNoiseError = 0.0;
+	int boardSolves = 0, markerSolves = 0;
+
+	for (int p = 0; p < POSES; p++) {
+		Transform truth = randomPose(rng, 0.6f, 30.0f, 70.0f);
+		BoardObservation exact[count], noisy[count];
+		for (int m = 0; m < count; m++) {
+			Transform markerPose = compose(truth, placements[m]);
+			exact[m].index = m;
+			noisy[m].index = m;
+			for (int k = 0; k < 4; k++) {
+				float corner[3];
+				markerCorner(k, corner);
+				exact[m].corners[k] = project(markerPose, corner);
+				noisy[m].corners[k] = exact[m].corners[k] + cv::Point2f(noise(rng), noise(rng));
+			}
+		}
+
+		// All of the markers, then a random subset of them in a random order
+		int subsetSize = 1 + (int)(rng() % count);
+		BoardObservation subset[count];
+		std::copy(exact, exact + count, subset);
+		std::shuffle(subset, subset + count, rng);
+		for (int pass = 0; pass < 2; pass++) {
+			float mat[16];
+			BoardPose boardPose;
+			const BoardObservation* observations = (pass == 0) ? exact : subset;
+			int used = (pass == 0) ? count : subsetSize;
+			TEST_CHECK(board.estimate(observations, used, FOCAL_LENGTH, FOCAL_LENGTH, options, false, mat, boardPose));
+			TEST_CHECK(boardPose.markers == used && boardPose.error < 1e-2f);
+
+			float rotationError;
+			float translationError = poseError(mat, truth, rotationError);
+			worstRotation = std::max(worstRotation, rotationError);
+			worstTranslation = std::max(worstTranslation, translationError);
+			TEST_CHECK(rotationError < EXACT_TOLERANCE && translationError < EXACT_TOLERANCE);
+			TEST_CHECK(boardPose.rotate_23 == mat[6] && boardPose.translate_z == mat[11]);
+
+			for (int m = 0; m < count; m++) {
+				float markerMat[16];
+				board.markerPose(markerMat, m, mat);
+				translationError = poseError(markerMat, compose(truth, placements[m]), rotationError);
+				TEST_CHECK(rotationError < EXACT_TOLERANCE && translationError < EXACT_TOLERANCE);
+			}
+		}
+
+		// Starting from the pose just found, the same corners keep it
+		float mat[16];
+		BoardPose boardPose;
+		TEST_CHECK(board.estimate(exact, count, FOCAL_LENGTH, FOCAL_LENGTH, options, true, mat, boardPose));
+		float rotationError;
+		float translationError = poseError(mat, truth, rotationError);
+		TEST_CHECK(rotationError < EXACT_TOLERANCE && translationError < EXACT_TOLERANCE);
+
+		// Noisy corners, for the board and for each of its flat markers on its own
+		TEST_CHECK(board.estimate(noisy, count, FOCAL_LENGTH, FOCAL_LENGTH, options, false, mat, boardPose));
+		poseError(mat, truth, rotationError);
+		boardNoiseError += rotationError;
+		boardSolves++;
+		for (int m = 0; m < 5; m++) {
+			float corners[8], markerMat[16], pose[7];
+			for (int k = 0; k < 4; k++) {
+				corners[2 * k] = noisy[m].corners[k].x;
+				corners[2 * k + 1] = noisy[m].corners[k].y;
+			}
+			PoseSolver::estimateSquarePose(markerMat, pose, false, corners, MARKER_SIZE, FOCAL_LENGTH, FOCAL_LENGTH, options);
+			poseError(markerMat, compose(truth, placements[m]), rotationError);
+			markerNoiseError += rotationError;
+			markerSolves++;
+		}
+	}
+
+	// The board is wider than any one marker and has more corners, so its rotation is steadier
+	double boardMean = boardNoiseError / boardSolves, markerMean = markerNoiseError / markerSolves;
+	TEST_CHECK(boardMean < 0.5 * markerMean);
+
+	// No marker of the board found
+	float mat[16];
+	BoardPose boardPose;
+	TEST_CHECK(!board.estimate(NULL, 0, FOCAL_LENGTH, FOCAL_LENGTH, options, true, mat, boardPose));
+	TEST_CHECK(boardPose.markers == 0);
+
+	// Invalid layouts are refused and the board keeps its layout
+	int repeated[count];
+	std::copy(ids, ids + count, repeated);
+	repeated[4] = repeated[1];
+	float degenerate[12 * count];
+	std::copy(layout, layout + 12 * count, degenerate);
+	for (int i = 3; i < 12; i++) {
+		degenerate[12 * 2 + i] = degenerate[12 * 2 + i % 3];
+	}
+	TEST_CHECK(!board.setLayout(repeated, layout, count));
+	TEST_CHECK(!board.setLayout(ids, degenerate, count));
+	TEST_CHECK(!board.setLayout(ids, layout, MarkerBoard::MAX_MARKERS + 1));
+	TEST_CHECK(!board.setLayout(NULL, layout, count));
+	TEST_CHECK(board.find(105) == 5);
+	TEST_CHECK(board.setLayout(NULL, NULL, 0) && board.empty());
+
+	printf("BoardPoseTest: exact corners within %.2g in rotation and %.2g in translation, noisy rotation error %.4f for the board and %.4f for its markers\n",
+		worstRotation, worstTranslation, boardMean, markerMean);
+}
+
+
+/*  Renders a frame of the board and of the marker that is not on it
+ *	The detector reports a marker drawn with its top left cell first and its corners in the order
+ *	of the code as turned half about its x axis, so the markers are projected with that turn.
+ *
+ *	@param board: The board to camera transformation
+ *	@param centers: The centers of the board markers on the board
+ *	@param hidden: Bit m set if board marker m is left out
+ *	@param lone: The pose of the marker that is not on the board
+ *	@param pixels: Container to hold the RGBA frame
+ *
+ *	@return void
+ */
+static void renderBoard(const Transform &board, const float (*centers)[2], int hidden, const Transform &lone, std::vector<Color32> &pixels) {
+
+	const Transform halfTurn = makeTransform(3.1415927f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+	const int count = sizeof(BOARD_IDS) / sizeof(BOARD_IDS[0]);
+	cv::Mat gray(HEIGHT, WIDTH, CV_8UC1, cv::Scalar(TEST_WHITE));
+	for (int m = 0; m <= count; m++) {
+		if (m < count && (hidden & (1 << m))) {
+			continue;
+		}
+		Transform markerPose = (m < count) ? compose(board, makeTransform(0, 0, 0, centers[m][0], centers[m][1], 0)) : lone;
+		Transform drawn = compose(markerPose, halfTurn);
+
+		cv::Point2f image[4];
+		for (int k = 0; k < 4; k++) {
+			float corner[3];
+			markerCorner(k, corner);
+			cv::Point2f p = project(drawn, corner);
+			image[k] = cv::Point2f(WIDTH * 0.5f + p.x, HEIGHT * 0.5f - p.y);
+		}
+		const cv::Point2f order[4] = { image[1], image[0], image[3], image[2] };
+		drawMarker(gray, order, (m < count) ? BOARD_IDS[m] : LONE_ID);
+	}
+
+	pixels.resize((size_t)WIDTH * HEIGHT);
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			uchar value = gray.at<uchar>(y, x);
+			const Color32 color = { value, value, value, 255 };
+			pixels[(size_t)y * WIDTH + x] = color;
+		}
+	}
+}
+
+
+/*  Checks the board pose of a detector on rendered frames of a 2x2 board and one marker off it
+ *	The board pose must be close to the drawn pose, every marker of the board must report the
+ *	pose of its placement, and the marker off the board must get the bytes of a detector that
+ *	has no board.
+ *
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void checkDetector(std::mt19937 &rng) {
+
+	const int count = sizeof(BOARD_IDS) / sizeof(BOARD_IDS[0]);
+	const float centers[count][2] = { { -3.0f, 3.0f }, { 3.0f, 3.0f }, { 3.0f, -3.0f }, { -3.0f, -3.0f } };
+	float layout[12 * count];
+	for (int m = 0; m < count; m++) {
+		for (int k = 0; k < 4; k++) {
+			markerCorner(k, &layout[12 * m + 3 * k]);
+			layout[12 * m + 3 * k] += centers[m][0];
+			layout[12 * m + 3 * k + 1] += centers[m][1];
+		}
+	}
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	MarkerDetector detector(config);
+	MarkerDetector noBoard(config);
+	TEST_CHECK(detector.setBoard(BOARD_IDS, layout, count));
+
+	const Transform lone = makeTransform(3.1415927f + 0.3f, -0.2f, 0.4f, 14.0f, -8.0f, -42.0f);
+	std::vector<Color32> pixels;
+	std::vector<Marker2> markers(MAX_MARKERS), reference(MAX_MARKERS);
+	float worstRotation = 0.0f, worstDistance = 0.0f, worstError = 0.0f;
+
+	for (int f = 0; f < FRAMES; f++) {
+		Transform board = compose(randomPose(rng, 0.5f, 35.0f, 45.0f), makeTransform(3.1415927f, 0, 0, 0, 0, 0));
+		board.t[0] = std::max(-4.0f, std::min(4.0f, board.t[0]));
+		int hidden = (f % 4 == 3) ? 1 << (int)(rng() % count) : 0;
+		renderBoard(board, centers, hidden, lone, pixels);
+
+		int found = detector.detect(&markers[0], MAX_MARKERS, &pixels[0], WIDTH, HEIGHT);
+		int referenceCount = noBoard.detect(&reference[0], MAX_MARKERS, &pixels[0], WIDTH, HEIGHT);
+		int expected = (hidden == 0) ? count : count - 1;
+		TEST_CHECK(found == expected + 1 && referenceCount == found);
+
+		const BoardPose &boardPose = detector.getBoardPose();
+		TEST_CHECK(boardPose.markers == expected);
+		worstError = std::max(worstError, boardPose.error);
+		TEST_CHECK(boardPose.error < RENDERED_REPROJECTION_TOLERANCE);
+
+		const float mat[16] = { boardPose.rotate_11, boardPose.rotate_12, boardPose.rotate_13, boardPose.translate_x,
+			boardPose.rotate_21, boardPose.rotate_22, boardPose.rotate_23, boardPose.translate_y,
+			boardPose.rotate_31, boardPose.rotate_32, boardPose.rotate_33, boardPose.translate_z, 0, 0, 0, 1 };
+		float rotationError;
+		float distanceError = poseError(mat, board, rotationError);
+		worstRotation = std::max(worstRotation, rotationError);
+		worstDistance = std::max(worstDistance, distanceError);
+		TEST_CHECK(rotationError < RENDERED_ROTATION_TOLERANCE && distanceError < RENDERED_DISTANCE_TOLERANCE);
+
+		for (int i = 0; i < found; i++) {
+			int m = -1;
+			for (int b = 0; b < count; b++) {
+				m = (markers[i].id == BOARD_IDS[b]) ? b : m;
+			}
+
+			// The marker off the board is solved on its own, as without a board
+			if (m < 0) {
+				TEST_CHECK(markers[i].id == LONE_ID);
+				bool same = false;
+				for (int j = 0; j < referenceCount; j++) {
+					same = same || memcmp(&markers[i], &reference[j], sizeof(Marker2)) == 0;
+				}
+				TEST_CHECK(same);
+				continue;
+			}
+
+			// A marker of the board has the board rotation, and its center on the board
+			TEST_CHECK(!(hidden & (1 << m)));
+			const float markerRotation[9] = { markers[i].rotate_11, markers[i].rotate_12, markers[i].rotate_13,
+				markers[i].rotate_21, markers[i].rotate_22, markers[i].rotate_23,
+				markers[i].rotate_31, markers[i].rotate_32, markers[i].rotate_33 };
+			for (int k = 0; k < 9; k++) {
+				TEST_CHECK(std::fabs(markerRotation[k] - mat[4 * (k / 3) + k % 3]) < 1e-6f);
+			}
+			const float translation[3] = { markers[i].translate_x, markers[i].translate_y, markers[i].translate_z };
+			for (int r = 0; r < 3; r++) {
+				float expectedTranslation = mat[4 * r + 3] + mat[4 * r] * centers[m][0] + mat[4 * r + 1] * centers[m][1];
+				TEST_CHECK(std::fabs(translation[r] - expectedTranslation) < 1e-4f);
+			}
+		}
+	}
+
+	// A frame without the board
+	renderBoard(lone, centers, (1 << count) - 1, lone, pixels);
+	TEST_CHECK(detector.detect(&markers[0], MAX_MARKERS, &pixels[0], WIDTH, HEIGHT) == 1);
+	TEST_CHECK(detector.getBoardPose().markers == 0);
+
+	printf("BoardPoseTest: %d rendered frames, board pose within %.4f in rotation and %.4f in distance, reprojection error at most %.3f px\n",
+		FRAMES, worstRotation, worstDistance, worstError);
+}
+
+
+int main() {
+
+	std::mt19937 rng(654);
+	checkSolve(rng);
+	checkDetector(rng);
+
+	return testResult("BoardPoseTest");
+}
@@ -0,0 +1,177 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the undistortion table of the camera model against the lens model it inverts
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "CameraModel.h"
+
+
+/* Largest distance in pixels between an image point and the distorted point of its table lookup */
+static const double TABLE_TOLERANCE = 0.05;
+
+/* Largest distance in pixels for the points solved without the table */
+static const double SOLVE_TOLERANCE = 1e-3;
+
+
+/* A calibrated camera and the size of its images */
+struct TestCamera {
+	const char* name;
+	int width;
+	int height;
+	CameraIntrinsics intrinsics;
+};
+
+
+/* A webcam with barrel distortion, and a wider lens with the principal point at the image center */
+static const TestCamera CAMERAS[] = {
+	{ "webcam", 640, 480, { 520.0f, 518.0f, 318.5f, 243.2f, { -0.28f, 0.09f, 0.0008f, -0.0005f, -0.012f } } },
+	{ "wide", 1280, 720, { 900.0f, 900.0f, -1.0f, -1.0f, { -0.3f, 0.1f, 0.001f, 0.0005f, -0.01f } } }
+};
+
+
+/*  Distorts a point given by the camera model back into the image, with the lens model of OpenCV
+ *
+ *	@param intrinsics: The calibration of the camera
+ *	@param center: The principal point in pixels
+ *	@param camera: The undistorted point in pixels relative to the principal point, with y up
+ *
+ *	@return point: The distorted point in image pixels
+ */
+static cv::Point2d distort(const CameraIntrinsics &intrinsics, const cv::Point2d &center, const cv::Point2f &camera) {
+
+	const float* k = intrinsics.distortion;
+	double x = camera.x / (double)intrinsics.focalX;
+	double y = -camera.y / (double)intrinsics.focalY;
+	double r2 = x * x + y * y;
+	double radial = 1.0 + ((k[4] * r2 + k[1]) * r2 + k[0]) * r2;
+	double xd = x * radial + 2.0 * k[2] * x * y + k[3] * (r2 + 2.0 * x * x);
+	double yd = y * radial + k[2] * (r2 + 2.0 * y * y) + 2.0 * k[3] * x * y;
+	return cv::Point2d(xd * intrinsics.focalX + center.x, yd * intrinsics.focalY + center.y);
+}
+
+
+/*  Returns how far the distorted point of a table lookup lands from the point looked up
+ *
+ *	@param model: The camera model
+ *	@param camera: The calibration of the model
+ *	@param center: The principal point in pixels
+ *	@param point: The image point
+ *
+ *	@return error: The distance in pixels
+ */
+static double roundTripError(const CameraModel &model, const TestCamera &camera, const cv::Point2d &center, const cv::Point2f &point) {
+
+	cv::Point2d back = distort(camera.intrinsics, center, model.toCamera(point));
+	return std::hypot(back.x - point.x, back.y - point.y);
+}
+
+
+/*  Checks every pixel of a distorted camera against the lens model, and points off the image
+ *	Grid nodes are solved exactly and the bilinear lookup between them stays within
+ *	TABLE_TOLERANCE. Points outside of the table go to the iterative solve.
+ *
+ *	@param camera: The camera to check
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void checkTable(const TestCamera &camera, std::mt19937 &rng) {
+
+	CameraModel model(camera.intrinsics, camera.width, camera.height);
+	cv::Point2d center(camera.intrinsics.principalX, camera.intrinsics.principalY);
+	if (center.x < 0) {
+		center = cv::Point2d(camera.width * 0.5, camera.height * 0.5);
+	}
+
+	// Every pixel, and a sub-pixel point in each
+	std::uniform_real_distribution<float> fraction(0.0f, 1.0f);
+	double maxError = 0.0, sumSq = 0.0;
+	int count = 0;
+	for (int y = 0; y < camera.height; y++) {
+		for (int x = 0; x < camera.width; x++) {
+			double error = roundTripError(model, camera, center, cv::Point2f((float)x, (float)y));
+			double subError = roundTripError(model, camera, center, cv::Point2f(x + fraction(rng), y + fraction(rng)));
+			maxError = std::max(maxError, std::max(error, subError));
+			sumSq += error * error + subError * subError;
+			count += 2;
+
+			if (x % CameraModel::GRID_STEP == 0 && y % CameraModel::GRID_STEP == 0) {
+				TEST_CHECK(error < SOLVE_TOLERANCE);
+			}
+		}
+	}
+	TEST_CHECK(maxError < TABLE_TOLERANCE);
+
+	// Points off the image, which refined corners can be
+	const cv::Point2f outside[] = { cv::Point2f(-3.5f, 20.0f), cv::Point2f(40.0f, -0.25f),
+		cv::Point2f((float)camera.width + 2, camera.height * 0.5f), cv::Point2f(camera.width * 0.5f, (float)camera.height + 1) };
+	for (size_t i = 0; i < sizeof(outside) / sizeof(outside[0]); i++) {
+		TEST_CHECK(roundTripError(model, camera, center, outside[i]) < SOLVE_TOLERANCE);
+	}
+
+	printf("CameraModelTest: %s lens, %d points, round trip error %.5f px RMS and %.5f px at most\n",
+		camera.name, count, std::sqrt(sumSq / count), maxError);
+}
+
+
+/*  Checks the principal point default and the camera without distortion
+ *	A negative principal point stands for the image center, and an ideal lens only moves the
+ *	origin to it and turns y up.
+ *
+ *	@return void
+ */
+static void checkCenterDefault() {
+
+	CameraIntrinsics centered = CAMERAS[0].intrinsics;
+	centered.principalX = -1.0f;
+	centered.principalY = -1.0f;
+	CameraIntrinsics explicitCenter = centered;
+	explicitCenter.principalX = 320.0f;
+	explicitCenter.principalY = 240.0f;
+
+	CameraModel byDefault(centered, 640, 480);
+	CameraModel byValue(explicitCenter, 640, 480);
+	TEST_CHECK(byDefault.matches(centered, 640, 480));
+	TEST_CHECK(!byDefault.matches(explicitCenter, 640, 480));
+	TEST_CHECK(!byDefault.matches(centered, 480, 640));
+
+	CameraIntrinsics ideal = { 400.0f, 400.0f, -1.0f, -1.0f, { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f } };
+	CameraModel pinhole(ideal, 640, 480);
+	TEST_CHECK(pinhole.focalX() == 400.0f && pinhole.focalY() == 400.0f);
+
+	const cv::Point2f points[] = { cv::Point2f(0, 0), cv::Point2f(320, 240), cv::Point2f(639.5f, 17.25f), cv::Point2f(-8, 500) };
+	for (size_t i = 0; i < sizeof(points) / sizeof(points[0]); i++) {
+		cv::Point2f a = byDefault.toCamera(points[i]);
+		cv::Point2f b = byValue.toCamera(points[i]);
+		TEST_CHECK(a.x == b.x && a.y == b.y);
+
+		cv::Point2f p = pinhole.toCamera(points[i]);
+		TEST_CHECK(p.x == points[i].x - 320.0f && p.y == 240.0f - points[i].y);
+	}
+}
+
+
+int main() {
+
+	std::mt19937 rng(654);
+	for (size_t c = 0; c < sizeof(CAMERAS) / sizeof(CAMERAS[0]); c++) {
+		checkTable(CAMERAS[c], rng);
+	}
+	checkCenterDefault();
+
+	return testResult("CameraModelTest");
+}
@@ -0,0 +1,177 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the fused colour conversion and threshold kernels against OpenCV
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Standard includes */
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "ColorConversion.h"
+#include "CpuFeatures.h"
+#include "KernelDispatch.h"
+
+
+/* Row widths, odd and around the 16, 32 and 64 pixel steps of the vector loops */
+static const int WIDTHS[] = { 1, 3, 7, 15, 17, 31, 33, 47, 63, 65, 127, 129, 255, 641 };
+
+/* Thresholds, including both ends of the byte range and values outside of it */
+static const int THRESHOLDS[] = { -1, 0, 1, 64, 105, 127, 128, 200, 254, 255, 300 };
+
+
+/*  Fills a row of four-channel pixels with random bytes, starting with the extreme colours
+ *
+ *	@param row: The CV_8UC4 row to fill
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void fillRow(cv::Mat &row, std::mt19937 &rng) {
+
+	uchar* pixels = row.ptr<uchar>(0);
+	for (int i = 0; i < 4 * row.cols; i++) {
+		pixels[i] = (uchar)(rng() & 0xff);
+	}
+
+	const uchar extremes[3][4] = { { 255, 255, 255, 255 }, { 0, 0, 0, 0 }, { 255, 0, 255, 0 } };
+	for (int i = 0; i < 3 && i < row.cols; i++) {
+		memcpy(pixels + 4 * i, extremes[i], 4);
+	}
+}
+
+
+/*  Tells whether two single row images hold the same bytes
+ *
+ *	@param a: The first row
+ *	@param b: The second row
+ *	@param width: The number of bytes to compare
+ *
+ *	@return equal: True if every byte matches
+ */
+static bool sameRow(const cv::Mat &a, const cv::Mat &b, int width) {
+	return memcmp(a.ptr<uchar>(0), b.ptr<uchar>(0), width) == 0;
+}
+
+
+/*  Checks one four-channel row kernel against cvtColor and threshold, with and without a binary row
+ *
+ *	@param kernel: The row kernel, as rgbaToGrayRow
+ *	@param row: The CV_8UC4 input row
+ *	@param toBgr: The cvtColor code that turns the input into BGR
+ *
+ *	@return void
+ */
+static void checkColorKernel(void (*kernel)(const uchar*, uchar*, uchar*, int, int), const cv::Mat &row, int toBgr) {
+
+	int width = row.cols;
+	cv::Mat bgr, expectedGray, expectedBinary;
+	cv::cvtColor(row, bgr, toBgr);
+	cv::cvtColor(bgr, expectedGray, cv::COLOR_BGR2GRAY);
+
+	cv::Mat gray(1, width, CV_8UC1), binary(1, width, CV_8UC1);
+	kernel(row.ptr<uchar>(0), gray.ptr<uchar>(0), NULL, width, 0);
+	TEST_CHECK(sameRow(gray, expectedGray, width));
+
+	for (size_t t = 0; t < sizeof(THRESHOLDS) / sizeof(THRESHOLDS[0]); t++) {
+		int thresh = THRESHOLDS[t];
+		cv::threshold(expectedGray, expectedBinary, thresh, 255, cv::THRESH_BINARY);
+
+		gray.setTo(cv::Scalar(0));
+		kernel(row.ptr<uchar>(0), gray.ptr<uchar>(0), binary.ptr<uchar>(0), width, thresh);
+		TEST_CHECK(sameRow(gray, expectedGray, width));
+		TEST_CHECK(sameRow(binary, expectedBinary, width));
+	}
+}
+
+
+/*  Checks the packed 4:2:2 kernel against its scalar reference for both luma positions
+ *
+ *	@param row: Random bytes, two per pixel
+ *
+ *	@return void
+ */
+static void checkYuvKernel(const cv::Mat &row) {
+
+	int width = row.cols;
+	cv::Mat gray(1, width, CV_8UC1), binary(1, width, CV_8UC1);
+	cv::Mat expectedGray(1, width, CV_8UC1), expectedBinary(1, width, CV_8UC1);
+
+	for (int lumaOffset = 0; lumaOffset < 2; lumaOffset++) {
+		for (size_t t = 0; t < sizeof(THRESHOLDS) / sizeof(THRESHOLDS[0]); t++) {
+			int thresh = THRESHOLDS[t];
+			yuv422ToGrayRowScalar(row.ptr<uchar>(0), expectedGray.ptr<uchar>(0), expectedBinary.ptr<uchar>(0), width, lumaOffset, thresh);
+			yuv422ToGrayRow(row.ptr<uchar>(0), gray.ptr<uchar>(0), binary.ptr<uchar>(0), width, lumaOffset, thresh);
+			TEST_CHECK(sameRow(gray, expectedGray, width));
+			TEST_CHECK(sameRow(binary, expectedBinary, width));
+		}
+	}
+}
+
+
+/*  Checks the whole image conversion on a region of a larger image, whose rows are not contiguous
+ *
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void checkImageRegion(std::mt19937 &rng) {
+
+	cv::Mat image(21, 97, CV_8UC4);
+	for (int y = 0; y < image.rows; y++) {
+		cv::Mat row = image(cv::Rect(0, y, image.cols, 1));
+		fillRow(row, rng);
+	}
+	cv::Mat region = image(cv::Rect(3, 2, 71, 17));
+
+	cv::Mat bgr, expectedGray, expectedBinary;
+	cv::cvtColor(region, bgr, cv::COLOR_RGBA2BGR);
+	cv::cvtColor(bgr, expectedGray, cv::COLOR_BGR2GRAY);
+	cv::threshold(expectedGray, expectedBinary, 105, 255, cv::THRESH_BINARY);
+
+	cv::Mat gray, binary;
+	rgbaToGrayThreshold(region, gray, binary, 105);
+	for (int y = 0; y < region.rows; y++) {
+		TEST_CHECK(memcmp(gray.ptr<uchar>(y), expectedGray.ptr<uchar>(y), region.cols) == 0);
+		TEST_CHECK(memcmp(binary.ptr<uchar>(y), expectedBinary.ptr<uchar>(y), region.cols) == 0);
+	}
+}
+
+
+int main() {
+
+	// MARKER_CPU_LEVEL picks the level under test, ctest runs this once for each
+	printf("ColorConversionTest: kernels at level %s\n", cpuLevelName(activeKernels().level));
+
+	std::mt19937 rng(654);
+	for (size_t w = 0; w < sizeof(WIDTHS) / sizeof(WIDTHS[0]); w++) {
+		int width = WIDTHS[w];
+
+		for (int repeat = 0; repeat < 4; repeat++) {
+			cv::Mat row(1, width, CV_8UC4);
+			fillRow(row, rng);
+
+			checkColorKernel(rgbaToGrayRowScalar, row, cv::COLOR_RGBA2BGR);
+			checkColorKernel(rgbaToGrayRow, row, cv::COLOR_RGBA2BGR);
+			checkColorKernel(bgraToGrayRow, row, cv::COLOR_BGRA2BGR);
+
+			cv::Mat packed(1, width, CV_8UC2);
+			memcpy(packed.ptr<uchar>(0), row.ptr<uchar>(0), 2 * width);
+			checkYuvKernel(packed);
+		}
+	}
+
+	checkImageRegion(rng);
+
+	return testResult("ColorConversionTest");
+}
@@ -0,0 +1,97 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the contour arena against cv::findContours
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Standard includes */
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "ContourArena.h"
+
+
+/*  Checks that the contours an arena added match cv::findContours in order and in every point
+ *
+ *	@param arena: The arena
+ *	@param first: The first contour the arena added for the image
+ *	@param binary: The image that was traced
+ *	@param offset: The shift that was added to every point
+ *
+ *	@return count: The number of contours compared
+ */
+static int checkContours(const ContourArena &arena, int first, const cv::Mat &binary, const cv::Point &offset) {
+
+	// cv::findContours is not allowed to change the image it is given
+	cv::Mat copy = binary.clone();
+	std::vector<std::vector<cv::Point> > expected;
+	cv::findContours(copy, expected, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE, offset);
+
+	TEST_CHECK(arena.size() - first == (int)expected.size());
+	if (arena.size() - first != (int)expected.size()) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < expected.size(); i++) {
+		int index = first + (int)i;
+		TEST_CHECK(arena.length(index) == (int)expected[i].size());
+		if (arena.length(index) != (int)expected[i].size()) {
+			continue;
+		}
+		for (size_t k = 0; k < expected[i].size(); k++) {
+			TEST_CHECK(arena.contour(index)[k] == expected[i][k]);
+		}
+	}
+	return (int)expected.size();
+}
+
+
+int main() {
+
+	std::mt19937 rng(654);
+	ContourArena arena;
+	cv::Mat frame(240, 320, CV_8UC1);
+	int compared = 0;
+
+	for (int i = 0; i < 20; i++) {
+		fillClutter(frame, rng);
+
+		// The whole frame, as a full scan traces it
+		arena.reset();
+		int count = arena.findContours(frame, cv::Point(0, 0));
+		TEST_CHECK(count == arena.size());
+		compared += checkContours(arena, 0, frame, cv::Point(0, 0));
+
+		// Two regions appended after it, as tracking traces them, each shifted back into the frame.
+		// The regions are views into the frame, so their rows are not contiguous.
+		cv::Rect regions[2] = { cv::Rect(13, 7, 150, 101), cv::Rect(120, 90, 199, 149) };
+		for (int r = 0; r < 2; r++) {
+			int first = arena.size();
+			cv::Mat region = frame(regions[r]);
+			arena.findContours(region, regions[r].tl());
+			compared += checkContours(arena, first, region, regions[r].tl());
+		}
+	}
+
+	// A frame with nothing to trace, and one that is all foreground
+	arena.reset();
+	frame.setTo(0);
+	TEST_CHECK(arena.findContours(frame, cv::Point(0, 0)) == 0);
+	frame.setTo(255);
+	TEST_CHECK(arena.findContours(frame, cv::Point(0, 0)) == 1);
+	compared += checkContours(arena, 0, frame, cv::Point(0, 0));
+	TEST_CHECK(arena.length(0) == 4);
+
+	printf("ContourArenaTest: %d contours compared with cv::findContours\n", compared);
+
+	return testResult("ContourArenaTest");
+}
@@ -0,0 +1,260 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the contour filter cascade against the polygon filter it runs in front of
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "ContourArena.h"
+#include "MarkerDetector.h"
+
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int MAX_MARKERS = 16;
+
+
+/*  Tells whether the polygon filter the detector had before the cascade accepts a contour
+ *
+ *	@param contour: The points of the contour
+ *	@param length: The number of points
+ *	@param minArea: The smallest quad area
+ *	@param polygon: Container to hold the quad
+ *
+ *	@return accepted: True if the contour approximates to a large enough convex quad
+ */
+static bool baselineAccepts(const cv::Point* contour, int length, double minArea, std::vector<cv::Point> &polygon) {
+
+	std::vector<cv::Point> points(contour, contour + length);
+	cv::approxPolyDP(points, polygon, cv::arcLength(points, true) * 0.02, true);
+	return polygon.size() == 4 && fabs(cv::contourArea(polygon)) >= minArea && cv::isContourConvex(polygon);
+}
+
+
+/*  Draws dark quads into a grayscale image, from just over the minimum marker area to slivers
+ *
+ *	@param gray: The grayscale image to draw into
+ *	@param minSide: The side of a square of the minimum marker area
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void drawQuads(cv::Mat &gray, float minSide, std::mt19937 &rng) {
+
+	std::uniform_real_distribution<float> turn(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> skew(-0.1f, 0.1f);
+	std::uniform_real_distribution<float> grow(1.0f, 1.3f);
+	std::uniform_real_distribution<float> stretch(1.0f, 30.0f);
+
+	for (int i = 0; i < 12; i++) {
+		float cx = 60.0f + 130.0f * (i % 4) + skew(rng) * 50;
+		float cy = 60.0f + 150.0f * (i / 4) + skew(rng) * 50;
+		float halfX = minSide / 2 * grow(rng);
+		float halfY = halfX;
+
+		// A third of the quads are thin bars with the area of a marker
+		if (i % 3 == 2) {
+			float ratio = stretch(rng);
+			halfX *= std::sqrt(ratio);
+			halfY /= std::sqrt(ratio);
+		}
+
+		float angle = (i % 2) ? turn(rng) : 0.0f;
+		float c = cos(angle), s = sin(angle);
+		const float unit[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+		cv::Point2f corners[4];
+		for (int k = 0; k < 4; k++) {
+			float ux = halfX * (unit[k][0] + skew(rng));
+			float uy = halfY * (unit[k][1] + skew(rng));
+			corners[k] = cv::Point2f(cx + c * ux - s * uy, cy + s * ux + c * uy);
+		}
+		drawQuad(gray, corners);
+	}
+}
+
+
+/*  Checks every contour of a binary image against the polygon filter
+ *	With the aspect ratio and maximum perimeter off, the cascade must accept exactly the
+ *	contours the polygon filter accepts, with the same quad. With the default limits, the only
+ *	contours it may drop in addition are those whose bounding box is too elongated.
+ *
+ *	@param binary: The binary image
+ *	@param scale: How many times smaller the image is than the frame
+ *	@param accepted: Counter of the contours the polygon filter accepts
+ *	@param elongated: Counter of those the default aspect ratio drops
+ *
+ *	@return void
+ */
+static void checkContours(const cv::Mat &binary, int scale, int &accepted, int &elongated) {
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	ContourLimits defaults(config, scale);
+	config.minContourPoints = 0;
+	config.maxAspectRatio = 0.0f;
+	config.maxMarkerPerimeter = 0.0f;
+	ContourLimits exact(config, scale);
+
+	ContourArena contours;
+	contours.findContours(binary, cv::Point(0, 0));
+
+	std::vector<cv::Point> expected, polygon;
+	for (int i = 0; i < contours.size(); i++) {
+		bool baseline = baselineAccepts(contours.contour(i), contours.length(i), exact.minArea, expected);
+
+		int stage = filterContour(contours.contour(i), contours.length(i), exact, polygon);
+		TEST_CHECK((stage == CONTOUR_ACCEPTED) == baseline);
+		if (stage == CONTOUR_ACCEPTED && baseline) {
+			TEST_CHECK(polygon == expected);
+		}
+
+		if (baseline) {
+			accepted++;
+			stage = filterContour(contours.contour(i), contours.length(i), defaults, polygon);
+			TEST_CHECK(stage == CONTOUR_ACCEPTED || stage == CONTOUR_ASPECT_RATIO);
+			if (stage == CONTOUR_ASPECT_RATIO) {
+				cv::Rect box = cv::boundingRect(std::vector<cv::Point>(contours.contour(i), contours.contour(i) + contours.length(i)));
+				double longer = std::max(box.width, box.height) - 1;
+				double shorter = std::min(box.width, box.height) - 1;
+				TEST_CHECK(longer > defaults.maxAspectRatio * shorter);
+				elongated++;
+			}
+		}
+	}
+}
+
+
+/*  Checks the cascade against the polygon filter on drawn quads and on clutter
+ *
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void checkAgainstBaseline(std::mt19937 &rng) {
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	int accepted = 0, elongated = 0;
+
+	cv::Mat gray(HEIGHT, WIDTH, CV_8UC1), binary;
+	for (int i = 0; i < 10; i++) {
+		gray.setTo(TEST_WHITE);
+		drawQuads(gray, std::sqrt(config.minMarkerArea), rng);
+		cv::threshold(gray, binary, config.binaryThreshold, 255, cv::THRESH_BINARY);
+		checkContours(binary, 1, accepted, elongated);
+
+		// The pyramid searches with limits scaled down for the smaller image
+		gray.setTo(TEST_WHITE);
+		drawQuads(gray, std::sqrt(config.minMarkerArea) / 2, rng);
+		cv::threshold(gray, binary, config.binaryThreshold, 255, cv::THRESH_BINARY);
+		checkContours(binary, 2, accepted, elongated);
+
+		fillClutter(binary, rng);
+		checkContours(binary, 1, accepted, elongated);
+	}
+
+	// Both kinds of contour must have been met
+	TEST_CHECK(accepted > elongated && elongated > 0);
+	printf("ContourFilterTest: %d quads accepted by the polygon filter, %d of them too elongated for the default limit\n",
+		accepted, elongated);
+}
+
+
+/*  Fills a rectangle of an RGBA image with a grey level
+ *
+ *	@param pixels: The RGBA image
+ *	@param area: The rectangle to fill
+ *	@param level: The grey level
+ *
+ *	@return void
+ */
+static void fillRect(std::vector<Color32> &pixels, const cv::Rect &area, uchar level) {
+
+	for (int y = area.y; y < area.y + area.height; y++) {
+		for (int x = area.x; x < area.x + area.width; x++) {
+			Color32 &pixel = pixels[(size_t)y * WIDTH + x];
+			pixel.r = pixel.g = pixel.b = level;
+		}
+	}
+}
+
+
+/*  Checks that a detector counts each reason a contour can be rejected for
+ *
+ *	@return void
+ */
+static void checkRejectionCounts() {
+
+	const Color32 background = { TEST_WHITE, TEST_WHITE, TEST_WHITE, 255 };
+	std::vector<Color32> pixels((size_t)WIDTH * HEIGHT, background);
+
+	// Light single pixels and pairs on a dark patch have too few points, small blobs too small a box
+	fillRect(pixels, cv::Rect(100, 14, 80, 16), TEST_BLACK);
+	for (int i = 0; i < 5; i++) {
+		fillRect(pixels, cv::Rect(104 + 12 * i, 20, 1 + i % 2, 1), TEST_WHITE);
+		fillRect(pixels, cv::Rect(20 + 15 * i, 40, 8, 6), TEST_BLACK);
+	}
+
+	// A bar far too elongated, a square too long around, and a disc that is no quad
+	fillRect(pixels, cv::Rect(20, 80, 400, 12), TEST_BLACK);
+	fillRect(pixels, cv::Rect(20, 120, 300, 300), TEST_BLACK);
+	for (int y = -40; y <= 40; y++) {
+		for (int x = -40; x <= 40; x++) {
+			if (x * x + y * y <= 40 * 40) {
+				fillRect(pixels, cv::Rect(500 + x, 300 + y, 1, 1), TEST_BLACK);
+			}
+		}
+	}
+	drawUprightMarker(pixels, WIDTH, 420, 120, 10, 0x1234);
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	config.collectStats = 1;
+	config.maxMarkerPerimeter = 800.0f;
+
+	std::vector<Marker2> markers(MAX_MARKERS);
+	MarkerDetector detector(config);
+	int found = detector.detect(&markers[0], MAX_MARKERS, &pixels[0], WIDTH, HEIGHT);
+	DetectorStats stats;
+	detector.getStats(stats);
+
+	TEST_CHECK(found == 1);
+	TEST_CHECK(stats.rejectedPointCount > 0);
+	TEST_CHECK(stats.rejectedBoundingBox > 0);
+	TEST_CHECK(stats.rejectedAspectRatio > 0);
+	TEST_CHECK(stats.rejectedPerimeter > 0);
+	TEST_CHECK(stats.rejectedPolygon > 0);
+
+	// Every contour either passed or was counted once
+	int rejected = stats.rejectedPointCount + stats.rejectedBoundingBox + stats.rejectedAspectRatio +
+		stats.rejectedPerimeter + stats.rejectedPolygon;
+	TEST_CHECK(rejected + stats.quadsPassed == stats.contoursFound);
+
+	printf("ContourFilterTest: %d contours, rejected for point count %d, bounding box %d, aspect ratio %d, perimeter %d, polygon %d\n",
+		stats.contoursFound, stats.rejectedPointCount, stats.rejectedBoundingBox, stats.rejectedAspectRatio,
+		stats.rejectedPerimeter, stats.rejectedPolygon);
+}
+
+
+int main() {
+
+	std::mt19937 rng(654);
+	checkAgainstBaseline(rng);
+	checkRejectionCounts();
+
+	return testResult("ContourFilterTest");
+}
@@ -0,0 +1,212 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the duplicate quad filter
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "DuplicateFilter.h"
+#include "MarkerDetector.h"
+
+
+/* Cell size the detector uses for its default minimum marker area */
+static const float CELL_SIZE = 31.6f;
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int MAX_MARKERS = 16;
+
+
+/*  Makes a square candidate turned in the image
+ *
+ *	@param centerX: The x coordinate of the centre
+ *	@param centerY: The y coordinate of the centre
+ *	@param side: The side length in pixels
+ *	@param angle: The turn in radians
+ *
+ *	@return candidate: The candidate, with its corners rounded to pixels
+ */
+static MarkerCandidate makeSquare(float centerX, float centerY, float side, float angle) {
+
+	const float unit[4][2] = { { -1, -1 }, { -1, 1 }, { 1, 1 }, { 1, -1 } };
+	float c = cos(angle), s = sin(angle);
+	MarkerCandidate candidate;
+	for (int k = 0; k < 4; k++) {
+		float ux = unit[k][0] * side / 2;
+		float uy = unit[k][1] * side / 2;
+		candidate.rect[k] = cv::Point(cvRound(centerX + c * ux - s * uy), cvRound(centerY + s * ux + c * uy));
+	}
+	return candidate;
+}
+
+
+/*  Runs the filter on a list of quads and checks which survive
+ *
+ *	@param name: What the quads show, for the output
+ *	@param candidates: The quads in contour order
+ *	@param expected: The indices of the quads that must be kept, in order
+ *
+ *	@return void
+ */
+static void checkKept(const char* name, const std::vector<MarkerCandidate> &candidates, const std::vector<int> &expected) {
+
+	DuplicateFilter filter;
+	std::vector<MarkerCandidate> filtered = candidates;
+	int removed = filter.filter(filtered, CELL_SIZE);
+
+	bool same = (removed == (int)(candidates.size() - expected.size())) && (filtered.size() == expected.size());
+	for (size_t i = 0; same && i < expected.size(); i++) {
+		for (int k = 0; k < 4; k++) {
+			same = same && filtered[i].rect[k] == candidates[expected[i]].rect[k];
+		}
+	}
+	TEST_CHECK(same);
+	if (!same) {
+		printf("DuplicateFilterTest: %s kept %d of %d quads\n", name, (int)filtered.size(), (int)candidates.size());
+	}
+}
+
+
+/*  Checks quads that are or are not the same square
+ *
+ *	@return void
+ */
+static void checkQuads() {
+
+	std::vector<MarkerCandidate> quads;
+
+	// Both sides of a thin outline, traced inside first: the outer one is kept in its place
+	quads.clear();
+	quads.push_back(makeSquare(200, 150, 96, 0.3f));
+	quads.push_back(makeSquare(200, 150, 100, 0.3f));
+	checkKept("thin outline", quads, std::vector<int>(1, 1));
+
+	// A marker inside a paper margin is not a duplicate of the paper
+	quads.clear();
+	quads.push_back(makeSquare(200, 150, 100, 0.0f));
+	quads.push_back(makeSquare(200, 150, 80, 0.0f));
+	checkKept("marker in a margin", quads, std::vector<int>{ 0, 1 });
+
+	// Centroids apart by less and by more than a tenth of the side
+	quads.clear();
+	quads.push_back(makeSquare(100, 100, 60, 0.5f));
+	quads.push_back(makeSquare(105, 102, 60, 0.5f));
+	quads.push_back(makeSquare(300, 100, 60, 0.5f));
+	quads.push_back(makeSquare(308, 100, 60, 0.5f));
+	checkKept("offset squares", quads, std::vector<int>{ 0, 2, 3 });
+
+	// Large squares whose centroids lie two hash cells apart, still within a tenth of the side
+	quads.clear();
+	quads.push_back(makeSquare(400, 400, 800, 0.0f));
+	quads.push_back(makeSquare(470, 400, 790, 0.0f));
+	quads.push_back(makeSquare(400, 470, 810, 0.0f));
+	checkKept("large squares", quads, std::vector<int>(1, 2));
+
+	// The same large squares further apart than a tenth of the side
+	quads.clear();
+	quads.push_back(makeSquare(400, 400, 800, 0.0f));
+	quads.push_back(makeSquare(490, 400, 800, 0.0f));
+	checkKept("large squares apart", quads, std::vector<int>{ 0, 1 });
+
+	// Many small squares, each traced twice, with a few far ones in between
+	quads.clear();
+	std::vector<int> kept;
+	for (int i = 0; i < 40; i++) {
+		float x = 40.0f + 55.0f * (i % 10);
+		float y = 40.0f + 60.0f * (i / 10);
+		quads.push_back(makeSquare(x, y, 40, 0.1f * i));
+		if (i % 3 == 0) {
+			quads.push_back(makeSquare(x + 1, y, 42, 0.1f * i));
+		}
+		kept.push_back((int)quads.size() - 1);
+	}
+	checkKept("grid of squares", quads, kept);
+}
+
+
+/*  Draws a thin dark square outline into an RGBA image, both of whose sides are traced
+ *
+ *	@param pixels: The RGBA image to draw into
+ *	@param left: The column of the outer top left corner
+ *	@param top: The row of the outer top left corner
+ *	@param side: The outer side length in pixels
+ *	@param thickness: The width of the outline in pixels
+ *
+ *	@return void
+ */
+static void drawOutline(std::vector<Color32> &pixels, int left, int top, int side, int thickness) {
+
+	for (int y = top; y < top + side; y++) {
+		for (int x = left; x < left + side; x++) {
+			bool inside = x >= left + thickness && x < left + side - thickness && y >= top + thickness && y < top + side - thickness;
+			if (!inside) {
+				Color32 &pixel = pixels[(size_t)y * WIDTH + x];
+				pixel.r = pixel.g = pixel.b = TEST_BLACK;
+			}
+		}
+	}
+}
+
+
+/*  Checks the count of dropped quads a detector reports, and that dropping them keeps the markers
+ *
+ *	@return void
+ */
+static void checkDetector() {
+
+	const Color32 background = { TEST_WHITE, TEST_WHITE, TEST_WHITE, 255 };
+	std::vector<Color32> pixels((size_t)WIDTH * HEIGHT, background);
+	drawUprightMarker(pixels, WIDTH, 40, 60, 12, 0x1234);
+	drawUprightMarker(pixels, WIDTH, 360, 220, 14, 0x0f0f);
+	drawOutline(pixels, 200, 40, 120, 3);
+	drawOutline(pixels, 60, 280, 150, 2);
+	drawOutline(pixels, 420, 40, 110, 4);
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	config.collectStats = 1;
+	config.parallelCandidates = 0;
+
+	std::vector<Marker2> filtered(MAX_MARKERS), unfiltered(MAX_MARKERS);
+	MarkerDetector detector(config);
+	int found = detector.detect(&filtered[0], MAX_MARKERS, &pixels[0], WIDTH, HEIGHT);
+	DetectorStats stats;
+	detector.getStats(stats);
+
+	config.suppressDuplicates = 0;
+	MarkerDetector plain(config);
+	int foundPlain = plain.detect(&unfiltered[0], MAX_MARKERS, &pixels[0], WIDTH, HEIGHT);
+	DetectorStats plainStats;
+	plain.getStats(plainStats);
+
+	// Each outline gives one duplicate, and none of them is a marker. Quads are counted before the filter.
+	TEST_CHECK(stats.duplicatesSuppressed == 3);
+	TEST_CHECK(plainStats.duplicatesSuppressed == 0);
+	TEST_CHECK(stats.quadsPassed == plainStats.quadsPassed);
+	TEST_CHECK(found == 2 && foundPlain == 2);
+	for (int i = 0; i < found && i < foundPlain; i++) {
+		TEST_CHECK(filtered[i].id == unfiltered[i].id);
+		TEST_CHECK(filtered[i].center_x == unfiltered[i].center_x && filtered[i].center_y == unfiltered[i].center_y);
+	}
+	printf("DuplicateFilterTest: %d of %d quads dropped as duplicates\n", stats.duplicatesSuppressed, stats.quadsPassed);
+}
+
+
+int main() {
+
+	checkQuads();
+	checkDetector();
+
+	return testResult("DuplicateFilterTest");
+}
@@ -0,0 +1,330 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the stripe edge refinement against the reference refinement
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "CpuFeatures.h"
+#include "EdgeRefinement.h"
+#include "GradientCache.h"
+#include "KernelDispatch.h"
+#include "MarkerHelpers.h"
+
+
+/* Side lengths of the quads, from a small marker to a large one */
+static const float SIZES[] = { 48.0f, 96.0f, 180.0f };
+
+/* Largest mean corner error in pixels of the gradient refinement beyond that of the stripe refinement,
+ * and largest distance between a corner of one and the same corner of the other */
+static const double GRADIENT_MEAN_MARGIN = 0.05;
+static const double GRADIENT_CORNER_TOLERANCE = 0.6;
+
+
+/*  Tells whether all 16 line parameters are finite
+ *
+ *	@param lineParameters: The 4x4 line parameters
+ *
+ *	@return finite: True if no parameter is infinite or NaN
+ */
+static bool allFinite(const float* lineParameters) {
+
+	for (int i = 0; i < 16; i++) {
+		if (!std::isfinite(lineParameters[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+/*  Draws a rotated, slightly skewed quad and rounds its corners as the contour search would
+ *
+ *	@param gray: The grayscale image to draw into
+ *	@param size: The side length of the quad
+ *	@param degrees: The rotation of the quad
+ *	@param rng: The random generator of the test
+ *	@param exact: Container to hold the drawn corners
+ *	@param corners: Container to hold the rounded corners
+ *
+ *	@return void
+ */
+static void drawSkewedQuad(cv::Mat &gray, float size, int degrees, std::mt19937 &rng, cv::Point2f* exact, cv::Point* corners) {
+
+	std::uniform_real_distribution<float> skew(-0.08f, 0.08f);
+	std::uniform_real_distribution<float> shift(-10.0f, 10.0f);
+	float angle = degrees * (float)CV_PI / 180;
+	float c = cos(angle), sn = sin(angle);
+	float half = size / 2;
+	cv::Point2f center(gray.cols / 2 + shift(rng), gray.rows / 2 + shift(rng));
+
+	const float unit[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+	for (int i = 0; i < 4; i++) {
+		float ux = half * (unit[i][0] + skew(rng));
+		float uy = half * (unit[i][1] + skew(rng));
+		exact[i] = cv::Point2f(center.x + c * ux - sn * uy, center.y + sn * ux + c * uy);
+		corners[i] = cv::Point(cvRound(exact[i].x), cvRound(exact[i].y));
+	}
+
+	gray.setTo(TEST_WHITE);
+	drawQuad(gray, exact);
+}
+
+
+/*  Refines a quad on the gradients of an image, computing only the tiles its edges need
+ *
+ *	@param lineParameters: Container to hold the 4x4 line parameters
+ *	@param corners: The corners of the quad
+ *	@param cache: The gradient cache, already reset to the image
+ *
+ *	@return void
+ */
+static void refineOnGradients(float* lineParameters, const cv::Point* corners, GradientCache &cache) {
+
+	cv::Rect regions[4];
+	refinementRegions(corners, regions);
+	for (int k = 0; k < 4; k++) {
+		cache.request(regions[k]);
+	}
+	for (int i = 0; i < cache.pendingCount(); i++) {
+		cache.computePending(i);
+	}
+	cache.finishPending();
+	refineEdges(lineParameters, corners, cache.view());
+}
+
+
+/*  Checks that both refinements give the same bits on rotated, slightly skewed quads
+ *	Every stripe of these quads crosses an edge, so none is skipped and the claim is exact.
+ *
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void checkCleanQuads(std::mt19937 &rng) {
+
+	cv::Mat gray(400, 400, CV_8UC1);
+	int quads = 0;
+
+	for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+		for (int degrees = 0; degrees < 360; degrees += 10) {
+			cv::Point2f exact[4];
+			cv::Point corners[4];
+			drawSkewedQuad(gray, SIZES[s], degrees, rng, exact, corners);
+
+			cv::Mat reference(4, 4, CV_32F);
+			refineEdgesReference(reference, corners, gray);
+			float lineParameters[16];
+			refineEdges(lineParameters, corners, gray);
+
+			TEST_CHECK(allFinite(reference.ptr<float>(0)));
+			TEST_CHECK(memcmp(reference.ptr<float>(0), lineParameters, sizeof(lineParameters)) == 0);
+			quads++;
+		}
+	}
+
+	printf("EdgeRefinementTest: %d quads compared with the reference\n", quads);
+}
+
+
+/*  Checks an edge whose last three stripes see a flat image
+ *	The reference fits those stripes too and its line for that edge is lost, where the
+ *	stripe refinement leaves them out and fits the edge to the other three. The other
+ *	three edges have no flat stripe and still match the reference bit for bit.
+ *
+ *	@return void
+ */
+static void checkSkippedStripes() {
+
+	cv::Mat gray(260, 260, CV_8UC1, cv::Scalar(TEST_WHITE));
+	gray(cv::Rect(60, 60, 140, 140)).setTo(TEST_BLACK);
+
+	// Wipes out the top edge around its stripes at x = 140, 160 and 180
+	gray(cv::Rect(130, 46, 58, 29)).setTo(TEST_WHITE);
+
+	const cv::Point corners[4] = { cv::Point(60, 60), cv::Point(200, 60), cv::Point(200, 200), cv::Point(60, 200) };
+	cv::Mat reference(4, 4, CV_32F);
+	refineEdgesReference(reference, corners, gray);
+	float lineParameters[16];
+	refineEdges(lineParameters, corners, gray);
+
+	TEST_CHECK(allFinite(lineParameters));
+	for (int i = 1; i < 4; i++) {
+		for (int r = 0; r < 4; r++) {
+			TEST_CHECK(memcmp(&reference.at<float>(r, i), &lineParameters[4 * r + i], sizeof(float)) == 0);
+		}
+	}
+
+	// The top edge is still fitted to the three stripes that cross it, along y = 60
+	TEST_CHECK(std::fabs(lineParameters[4]) < 1e-3f);
+	TEST_CHECK(std::fabs(lineParameters[12] - 60) < 1.0f);
+}
+
+
+/*  Checks a quad on a flat image, where no stripe has a maximum
+ *	Every edge keeps the line through its two corners.
+ *
+ *	@return void
+ */
+static void checkFlatImage() {
+
+	cv::Mat gray(200, 200, CV_8UC1, cv::Scalar(TEST_WHITE));
+	const cv::Point corners[4] = { cv::Point(40, 50), cv::Point(150, 40), cv::Point(160, 150), cv::Point(50, 160) };
+	float lineParameters[16];
+	refineEdges(lineParameters, corners, gray);
+
+	for (int i = 0; i < 4; i++) {
+		const cv::Point &a = corners[i];
+		const cv::Point &b = corners[(i + 1) % 4];
+		double length = sqrt((double)(b.x - a.x) * (b.x - a.x) + (double)(b.y - a.y) * (b.y - a.y));
+		TEST_CHECK(std::fabs(lineParameters[i] - (b.x - a.x) / length) < 1e-6);
+		TEST_CHECK(std::fabs(lineParameters[4 + i] - (b.y - a.y) / length) < 1e-6);
+		TEST_CHECK(lineParameters[8 + i] == 0.5f * (a.x + b.x));
+		TEST_CHECK(lineParameters[12 + i] == 0.5f * (a.y + b.y));
+	}
+}
+
+
+/*  Returns the distance of each refined corner from the corner it should be at
+ *	The corner between edge i and the next one is the drawn corner i + 1. drawQuad covers
+ *	pixel x with [x, x + 1], where the refinement puts the pixel center at x.
+ *
+ *	@param lineParameters: The 4x4 line parameters of the refined edges
+ *	@param exact: The drawn corners
+ *	@param refined: Container to hold the refined corners
+ *	@param errors: Container to hold the error of each corner in pixels
+ *
+ *	@return void
+ */
+static void cornerErrors(float* lineParameters, const cv::Point2f* exact, cv::Point2f* refined, double* errors) {
+
+	findCorners(refined, lineParameters);
+	for (int i = 0; i < 4; i++) {
+		cv::Point2f d = refined[i] - exact[(i + 1) % 4] + cv::Point2f(0.5f, 0.5f);
+		errors[i] = sqrt((double)d.x * d.x + (double)d.y * d.y);
+	}
+}
+
+
+/*  Checks that the corners refined on the gradient image are as accurate as those of the stripes
+ *	Both are measured against the drawn corners of the clean quads. Both find each edge about a
+ *	pixel inside the quad, so their corners sit inside it too. The gradient image has its own
+ *	Sobel and bilinear samples, so the bits differ, but its mean error may not be much above that
+ *	of the stripes and no corner may move far from the one the stripes give.
+ *
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void checkGradientAccuracy(std::mt19937 &rng) {
+
+	cv::Mat gray(400, 400, CV_8UC1);
+	GradientCache cache;
+	double stripeSum = 0, gradientSum = 0, stripeMax = 0, gradientMax = 0, differenceMax = 0;
+	int corners = 0;
+
+	for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+		for (int degrees = 5; degrees < 360; degrees += 10) {
+			cv::Point2f exact[4];
+			cv::Point rounded[4];
+			drawSkewedQuad(gray, SIZES[s], degrees, rng, exact, rounded);
+
+			float stripeLines[16], gradientLines[16];
+			refineEdges(stripeLines, rounded, gray);
+			cache.reset(gray);
+			refineOnGradients(gradientLines, rounded, cache);
+			TEST_CHECK(allFinite(gradientLines));
+
+			cv::Point2f stripeCorners[4], gradientCorners[4];
+			double stripeErrors[4], gradientErrors[4];
+			cornerErrors(stripeLines, exact, stripeCorners, stripeErrors);
+			cornerErrors(gradientLines, exact, gradientCorners, gradientErrors);
+			for (int i = 0; i < 4; i++) {
+				cv::Point2f d = gradientCorners[i] - stripeCorners[i];
+				differenceMax = std::max(differenceMax, sqrt((double)d.x * d.x + (double)d.y * d.y));
+				stripeSum += stripeErrors[i];
+				gradientSum += gradientErrors[i];
+				stripeMax = std::max(stripeMax, stripeErrors[i]);
+				gradientMax = std::max(gradientMax, gradientErrors[i]);
+				corners++;
+			}
+		}
+	}
+
+	double stripeMean = stripeSum / corners, gradientMean = gradientSum / corners;
+	TEST_CHECK(gradientMean < stripeMean + GRADIENT_MEAN_MARGIN);
+	TEST_CHECK(differenceMax < GRADIENT_CORNER_TOLERANCE);
+	printf("EdgeRefinementTest: %d corners, mean and worst error %.3f and %.3f px on the stripes, %.3f and %.3f px on the gradient image, at most %.3f px apart\n",
+		corners, stripeMean, stripeMax, gradientMean, gradientMax, differenceMax);
+}
+
+
+/*  Checks that quads sharing tiles of the gradient image get the lines of a cache of their own
+ *	Two squares side by side ask for some of the same tiles, which are computed only once.
+ *
+ *	@return void
+ */
+static void checkSharedTiles() {
+
+	cv::Mat gray(200, 300, CV_8UC1, cv::Scalar(TEST_WHITE));
+	const cv::Point2f left[4] = { cv::Point2f(40.3f, 52.6f), cv::Point2f(131.2f, 48.1f), cv::Point2f(135.7f, 139.4f), cv::Point2f(44.8f, 143.9f) };
+	const cv::Point2f right[4] = { cv::Point2f(151.5f, 60.2f), cv::Point2f(240.9f, 57.7f), cv::Point2f(243.4f, 147.1f), cv::Point2f(154.0f, 149.6f) };
+	drawQuad(gray, left);
+	drawQuad(gray, right);
+
+	cv::Point corners[2][4];
+	for (int i = 0; i < 4; i++) {
+		corners[0][i] = cv::Point(cvRound(left[i].x), cvRound(left[i].y));
+		corners[1][i] = cv::Point(cvRound(right[i].x), cvRound(right[i].y));
+	}
+
+	GradientCache shared;
+	shared.reset(gray);
+	float sharedLines[2][16];
+	refineOnGradients(sharedLines[0], corners[0], shared);
+	int firstTiles = shared.computedCount();
+	refineOnGradients(sharedLines[1], corners[1], shared);
+
+	int ownTiles = 0;
+	for (int q = 0; q < 2; q++) {
+		GradientCache own;
+		own.reset(gray);
+		float ownLines[16];
+		refineOnGradients(ownLines, corners[q], own);
+		ownTiles += own.computedCount();
+		TEST_CHECK(memcmp(sharedLines[q], ownLines, sizeof(ownLines)) == 0);
+	}
+
+	// The second quad reused tiles of the first, and the first was not recomputed
+	TEST_CHECK(shared.computedCount() < ownTiles);
+	TEST_CHECK(firstTiles > 0 && firstTiles < shared.computedCount());
+}
+
+
+int main() {
+
+	// MARKER_CPU_LEVEL picks the level under test, ctest runs this once for each
+	printf("EdgeRefinementTest: kernels at level %s\n", cpuLevelName(activeKernels().level));
+
+	std::mt19937 rng(654);
+	checkCleanQuads(rng);
+	checkSkippedStripes();
+	checkFlatImage();
+	checkGradientAccuracy(rng);
+	checkSharedTiles();
+
+	return testResult("EdgeRefinementTest");
+}
@@ -0,0 +1,229 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the input image descriptors and of detection on strided planes
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "ImageInput.h"
+#include "MarkerDetector.h"
+
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int MAX_MARKERS = 16;
+
+/* Bytes of padding after every row of the strided planes */
+static const int PADDING = 29;
+
+
+/*  Describes an image of one plane, or of a Y plane and a chroma plane
+ *
+ *	@param format: The pixel format, one of PixelFormat
+ *	@param width: The width of the image
+ *	@param height: The height of the image
+ *	@param plane: The pixels or the Y plane
+ *	@param stride: The bytes from one row to the next, 0 for packed rows
+ *	@param chroma: The chroma plane, or NULL
+ *	@param chromaStride: The bytes from one chroma row to the next, 0 for packed rows
+ *
+ *	@return image: The description of the image
+ */
+static ImageDescriptor describe(int format, int width, int height, void* plane, int stride, void* chroma, int chromaStride) {
+
+	ImageDescriptor image;
+	image.format = format;
+	image.width = width;
+	image.height = height;
+	image.planes[0] = plane;
+	image.planes[1] = chroma;
+	image.strides[0] = stride;
+	image.strides[1] = chromaStride;
+	return image;
+}
+
+
+/*  Checks that wrapImage refuses every malformed descriptor and keeps the rows of the others
+ *
+ *	@return void
+ */
+static void checkDescriptors() {
+
+	std::vector<uchar> plane(4 * (WIDTH + PADDING) * HEIGHT), chroma(WIDTH * HEIGHT);
+	cv::Mat pixels;
+
+	// Empty images and unknown formats
+	TEST_CHECK(!wrapImage(describe(PIXEL_GRAY8, WIDTH, HEIGHT, NULL, 0, NULL, 0), pixels));
+	TEST_CHECK(!wrapImage(describe(PIXEL_GRAY8, 0, HEIGHT, &plane[0], 0, NULL, 0), pixels));
+	TEST_CHECK(!wrapImage(describe(PIXEL_GRAY8, WIDTH, -1, &plane[0], 0, NULL, 0), pixels));
+	TEST_CHECK(!wrapImage(describe(PIXEL_UYVY + 1, WIDTH, HEIGHT, &plane[0], 0, NULL, 0), pixels));
+	TEST_CHECK(!wrapImage(describe(-1, WIDTH, HEIGHT, &plane[0], 0, NULL, 0), pixels));
+
+	// A zero stride means packed rows, a longer one is kept and a shorter one refused
+	const int formats[] = { PIXEL_RGBA32, PIXEL_BGRA32, PIXEL_GRAY8, PIXEL_NV12, PIXEL_NV21, PIXEL_YUYV, PIXEL_UYVY };
+	const int pixelBytes[] = { 4, 4, 1, 1, 1, 2, 2 };
+	const int types[] = { CV_8UC4, CV_8UC4, CV_8UC1, CV_8UC1, CV_8UC1, CV_8UC2, CV_8UC2 };
+	for (int f = 0; f < 7; f++) {
+		int rowBytes = WIDTH * pixelBytes[f];
+		TEST_CHECK(wrapImage(describe(formats[f], WIDTH, HEIGHT, &plane[0], 0, &chroma[0], 0), pixels));
+		TEST_CHECK(pixels.type() == types[f] && pixels.cols == WIDTH && pixels.rows == HEIGHT);
+		TEST_CHECK(pixels.data == &plane[0] && pixels.step == (size_t)rowBytes);
+
+		TEST_CHECK(wrapImage(describe(formats[f], WIDTH, HEIGHT, &plane[0], rowBytes + PADDING, &chroma[0], 0), pixels));
+		TEST_CHECK(pixels.data == &plane[0] && pixels.step == (size_t)(rowBytes + PADDING));
+
+		TEST_CHECK(!wrapImage(describe(formats[f], WIDTH, HEIGHT, &plane[0], rowBytes - 1, &chroma[0], 0), pixels));
+	}
+
+	// Chroma is shared by pixel pairs in 4:2:2 and by 2x2 blocks in NV12 and NV21
+	TEST_CHECK(!wrapImage(describe(PIXEL_YUYV, WIDTH - 1, HEIGHT, &plane[0], 0, NULL, 0), pixels));
+	TEST_CHECK(!wrapImage(describe(PIXEL_UYVY, WIDTH - 1, HEIGHT, &plane[0], 0, NULL, 0), pixels));
+	TEST_CHECK(wrapImage(describe(PIXEL_YUYV, WIDTH, HEIGHT - 1, &plane[0], 0, NULL, 0), pixels));
+	TEST_CHECK(!wrapImage(describe(PIXEL_NV12, WIDTH - 1, HEIGHT, &plane[0], 0, &chroma[0], 0), pixels));
+	TEST_CHECK(!wrapImage(describe(PIXEL_NV21, WIDTH, HEIGHT - 1, &plane[0], 0, &chroma[0], 0), pixels));
+	TEST_CHECK(wrapImage(describe(PIXEL_GRAY8, WIDTH - 1, HEIGHT - 1, &plane[0], 0, NULL, 0), pixels));
+
+	// NV12 and NV21 need their chroma plane, with rows long enough for the pairs
+	TEST_CHECK(!wrapImage(describe(PIXEL_NV12, WIDTH, HEIGHT, &plane[0], 0, NULL, 0), pixels));
+	TEST_CHECK(!wrapImage(describe(PIXEL_NV21, WIDTH, HEIGHT, &plane[0], 0, NULL, WIDTH), pixels));
+	TEST_CHECK(!wrapImage(describe(PIXEL_NV12, WIDTH, HEIGHT, &plane[0], 0, &chroma[0], WIDTH - 2), pixels));
+	TEST_CHECK(wrapImage(describe(PIXEL_NV12, WIDTH, HEIGHT, &plane[0], 0, &chroma[0], WIDTH + PADDING), pixels));
+
+	// The detector finds nothing in a refused image rather than reading it
+	DetectorConfig config;
+	getDefaultConfig(config);
+	MarkerDetector detector(config);
+	Marker2 markers[MAX_MARKERS];
+	TEST_CHECK(detector.detect(markers, MAX_MARKERS, describe(PIXEL_NV12, WIDTH, HEIGHT, &plane[0], 0, NULL, 0)) == 0);
+}
+
+
+/*  Draws markers at random poses into a grayscale image
+ *
+ *	@param gray: The grayscale image to draw into
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void drawMarkers(cv::Mat &gray, std::mt19937 &rng) {
+
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	gray.setTo(TEST_WHITE);
+	for (int i = 0; i < 6; i++) {
+		cv::Point2f center(110.0f + 210.0f * (i % 3), 130.0f + 220.0f * (i / 3));
+		float side = 60 + 50 * unit(rng);
+		float angle = 6.2831853f * unit(rng);
+		float c = std::cos(angle), s = std::sin(angle);
+		const float square[4][2] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+		cv::Point2f corners[4];
+		for (int k = 0; k < 4; k++) {
+			float ux = side * (square[k][0] + 0.08f * (unit(rng) - 0.5f));
+			float uy = side * (square[k][1] + 0.08f * (unit(rng) - 0.5f));
+			corners[k] = cv::Point2f(center.x + c * ux - s * uy, center.y + s * ux + c * uy);
+		}
+		drawMarker(gray, corners, 1 + (int)(rng() % 0xfffe));
+	}
+}
+
+
+/*  Detects the markers of an image and checks that they are those of the packed gray image
+ *	A new detector is used, so that no pose of an earlier image is refined further.
+ *
+ *	@param config: The detector parameters
+ *	@param image: The description of the image
+ *	@param expected: The markers found in the packed gray image
+ *	@param expectedCount: The number of those markers
+ *
+ *	@return void
+ */
+static void checkSameMarkers(const DetectorConfig &config, const ImageDescriptor &image, const Marker2* expected, int expectedCount) {
+
+	MarkerDetector detector(config);
+	Marker2 markers[MAX_MARKERS];
+	int found = detector.detect(markers, MAX_MARKERS, image);
+	TEST_CHECK(found == expectedCount);
+	TEST_CHECK(memcmp(markers, expected, sizeof(Marker2) * std::min(found, expectedCount)) == 0);
+}
+
+
+/*  Checks that detection on strided Y planes and 4:2:2 rows gives the markers of the packed gray copy
+ *	The padding after every row is filled with dark noise, so reading past a row would show.
+ *
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void checkStridedDetection(std::mt19937 &rng) {
+
+	cv::Mat gray(HEIGHT, WIDTH, CV_8UC1);
+	drawMarkers(gray, rng);
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	MarkerDetector detector(config);
+	Marker2 expected[MAX_MARKERS];
+	int expectedCount = detector.detect(expected, MAX_MARKERS, describe(PIXEL_GRAY8, WIDTH, HEIGHT, gray.data, 0, NULL, 0));
+	TEST_CHECK(expectedCount == 6);
+
+	// A Y plane with padded rows, followed by a padded chroma plane
+	int stride = WIDTH + PADDING;
+	std::vector<uchar> yPlane((size_t)stride * HEIGHT), chroma((size_t)stride * HEIGHT / 2);
+	for (size_t i = 0; i < yPlane.size(); i++) {
+		yPlane[i] = (uchar)(rng() % 64);
+	}
+	for (size_t i = 0; i < chroma.size(); i++) {
+		chroma[i] = (uchar)(rng() % 256);
+	}
+	for (int y = 0; y < HEIGHT; y++) {
+		memcpy(&yPlane[(size_t)y * stride], gray.ptr<uchar>(y), WIDTH);
+	}
+
+	checkSameMarkers(config, describe(PIXEL_GRAY8, WIDTH, HEIGHT, &yPlane[0], stride, NULL, 0), expected, expectedCount);
+	checkSameMarkers(config, describe(PIXEL_NV12, WIDTH, HEIGHT, &yPlane[0], stride, &chroma[0], stride), expected, expectedCount);
+	checkSameMarkers(config, describe(PIXEL_NV21, WIDTH, HEIGHT, &yPlane[0], stride, &chroma[0], stride), expected, expectedCount);
+
+	// Padded YUYV and UYVY rows, with the luma of the gray image and chroma noise
+	int packedStride = 2 * WIDTH + PADDING;
+	std::vector<uchar> yuyv((size_t)packedStride * HEIGHT), uyvy((size_t)packedStride * HEIGHT);
+	for (size_t i = 0; i < yuyv.size(); i++) {
+		yuyv[i] = (uchar)(rng() % 64);
+		uyvy[i] = (uchar)(rng() % 64);
+	}
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			size_t at = (size_t)y * packedStride + 2 * x;
+			yuyv[at] = gray.at<uchar>(y, x);
+			yuyv[at + 1] = (uchar)(rng() % 256);
+			uyvy[at] = (uchar)(rng() % 256);
+			uyvy[at + 1] = gray.at<uchar>(y, x);
+		}
+	}
+
+	checkSameMarkers(config, describe(PIXEL_YUYV, WIDTH, HEIGHT, &yuyv[0], packedStride, NULL, 0), expected, expectedCount);
+	checkSameMarkers(config, describe(PIXEL_UYVY, WIDTH, HEIGHT, &uyvy[0], packedStride, NULL, 0), expected, expectedCount);
+
+	printf("ImageInputTest: %d markers found in every strided layout\n", expectedCount);
+}
+
+
+int main() {
+
+	std::mt19937 rng(654);
+	checkDescriptors();
+	checkStridedDetection(rng);
+
+	return testResult("ImageInputTest");
+}
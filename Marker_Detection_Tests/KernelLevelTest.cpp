@@ -0,0 +1,299 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test that every kernel level gives the same bits as the baseline kernels
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "CpuFeatures.h"
+#include "EdgeRefinement.h"
+#include "GradientCache.h"
+#include "KernelDispatch.h"
+
+
+/* Size of the test scene */
+static const int SCENE_WIDTH = 320;
+static const int SCENE_HEIGHT = 240;
+
+/* Row widths, odd and around the 16, 32 and 64 pixel steps of the vector loops */
+static const int WIDTHS[] = { 1, 7, 15, 17, 33, 63, 65, 129, 641 };
+
+/* Thresholds, including both ends of the byte range */
+static const int THRESHOLDS[] = { -1, 0, 105, 128, 255 };
+
+
+/*  Scene shared by the checks: a noisy image with upright markers and rotated quads */
+struct Scene
+{
+	std::vector<Color32> rgba;					// The scene in colour, before the quads
+	cv::Mat gray;								// The scene in grayscale, with the quads
+	std::vector<std::vector<cv::Point2f> > quads;	// Corners of the markers and quads, and of a few random quads
+};
+
+
+/*  Draws the scene the kernels are compared on
+ *	The colour image holds upright markers under noise, and is converted by the baseline kernel.
+ *	Rotated quads are then drawn into the grayscale image, and random corners added that follow
+ *	no edge, so that the refinement also meets stripes without a maximum.
+ *
+ *	@param reference: The baseline kernels
+ *	@param scene: Container to hold the scene
+ *
+ *	@return void
+ */
+static void drawScene(const KernelTable &reference, Scene &scene) {
+
+	std::mt19937 rng(654);
+	std::uniform_int_distribution<int> noise(-12, 12);
+	std::uniform_real_distribution<float> jitter(-1.5f, 1.5f);
+
+	Color32 white = { TEST_WHITE, TEST_WHITE, TEST_WHITE, 255 };
+	scene.rgba.assign((size_t)SCENE_WIDTH * SCENE_HEIGHT, white);
+	const int markers[3][3] = { { 10, 12, 6 }, { 120, 20, 8 }, { 30, 150, 10 } };
+	for (int i = 0; i < 3; i++) {
+		drawUprightMarker(scene.rgba, SCENE_WIDTH, markers[i][0], markers[i][1], markers[i][2], 0x1234 * (i + 1));
+
+		float cell = (float)markers[i][2];
+		float left = markers[i][0] + cell, top = markers[i][1] + cell, side = 6 * cell;
+		std::vector<cv::Point2f> corners(4);
+		corners[0] = cv::Point2f(left + jitter(rng), top + jitter(rng));
+		corners[1] = cv::Point2f(left + side + jitter(rng), top + jitter(rng));
+		corners[2] = cv::Point2f(left + side + jitter(rng), top + side + jitter(rng));
+		corners[3] = cv::Point2f(left + jitter(rng), top + side + jitter(rng));
+		scene.quads.push_back(corners);
+	}
+	for (size_t i = 0; i < scene.rgba.size(); i++) {
+		Color32 &pixel = scene.rgba[i];
+		pixel.r = (uchar)std::min(255, std::max(0, pixel.r + noise(rng)));
+		pixel.g = (uchar)std::min(255, std::max(0, pixel.g + noise(rng)));
+		pixel.b = (uchar)std::min(255, std::max(0, pixel.b + noise(rng)));
+	}
+
+	scene.gray.create(SCENE_HEIGHT, SCENE_WIDTH, CV_8UC1);
+	cv::Mat binary(SCENE_HEIGHT, SCENE_WIDTH, CV_8UC1);
+	for (int y = 0; y < SCENE_HEIGHT; y++) {
+		reference.rgbaToGrayRow((const uchar*)&scene.rgba[(size_t)y * SCENE_WIDTH], scene.gray.ptr<uchar>(y),
+			binary.ptr<uchar>(y), SCENE_WIDTH, 105);
+	}
+
+	const float quads[3][4] = { { 240, 70, 30, 0.4f }, { 200, 180, 40, 1.1f }, { 270, 190, 20, 2.5f } };
+	for (int i = 0; i < 3; i++) {
+		float c = cos(quads[i][3]), s = sin(quads[i][3]), half = quads[i][2];
+		const float unit[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+		std::vector<cv::Point2f> corners(4);
+		for (int k = 0; k < 4; k++) {
+			corners[k] = cv::Point2f(quads[i][0] + half * (c * unit[k][0] - s * unit[k][1]),
+				quads[i][1] + half * (s * unit[k][0] + c * unit[k][1]));
+		}
+		drawQuad(scene.gray, &corners[0]);
+		scene.quads.push_back(corners);
+	}
+
+	std::uniform_real_distribution<float> x(20.0f, SCENE_WIDTH - 20.0f), y(20.0f, SCENE_HEIGHT - 20.0f);
+	for (int i = 0; i < 4; i++) {
+		std::vector<cv::Point2f> corners(4);
+		for (int k = 0; k < 4; k++) {
+			corners[k] = cv::Point2f(x(rng), y(rng));
+		}
+		scene.quads.push_back(corners);
+	}
+}
+
+
+/*  Checks the colour conversion row kernels on random rows
+ *
+ *	@param reference: The baseline kernels
+ *	@param table: The kernels of the level under test
+ *
+ *	@return void
+ */
+static void checkColorKernels(const KernelTable &reference, const KernelTable &table) {
+
+	std::mt19937 rng(654);
+	for (size_t w = 0; w < sizeof(WIDTHS) / sizeof(WIDTHS[0]); w++) {
+		int width = WIDTHS[w];
+		std::vector<uchar> pixels(4 * width);
+		for (size_t i = 0; i < pixels.size(); i++) {
+			pixels[i] = (uchar)(rng() & 0xff);
+		}
+
+		for (size_t t = 0; t < sizeof(THRESHOLDS) / sizeof(THRESHOLDS[0]); t++) {
+			int thresh = THRESHOLDS[t];
+			std::vector<uchar> gray(width), binary(width), expectedGray(width), expectedBinary(width);
+
+			reference.rgbaToGrayRow(&pixels[0], &expectedGray[0], &expectedBinary[0], width, thresh);
+			table.rgbaToGrayRow(&pixels[0], &gray[0], &binary[0], width, thresh);
+			TEST_CHECK(gray == expectedGray && binary == expectedBinary);
+
+			reference.bgraToGrayRow(&pixels[0], &expectedGray[0], &expectedBinary[0], width, thresh);
+			table.bgraToGrayRow(&pixels[0], &gray[0], &binary[0], width, thresh);
+			TEST_CHECK(gray == expectedGray && binary == expectedBinary);
+
+			for (int lumaOffset = 0; lumaOffset < 2; lumaOffset++) {
+				reference.yuv422ToGrayRow(&pixels[0], &expectedGray[0], &expectedBinary[0], width, lumaOffset, thresh);
+				table.yuv422ToGrayRow(&pixels[0], &gray[0], &binary[0], width, lumaOffset, thresh);
+				TEST_CHECK(gray == expectedGray && binary == expectedBinary);
+			}
+		}
+	}
+}
+
+
+/*  Checks the Sobel gradients over regions inside the scene and against its borders
+ *
+ *	@param reference: The baseline kernels
+ *	@param table: The kernels of the level under test
+ *	@param scene: The scene to take the gradients of
+ *
+ *	@return void
+ */
+static void checkSobelGradients(const KernelTable &reference, const KernelTable &table, const Scene &scene) {
+
+	const cv::Rect regions[] = { cv::Rect(0, 0, SCENE_WIDTH, SCENE_HEIGHT), cv::Rect(0, 0, 33, 33),
+		cv::Rect(SCENE_WIDTH - 33, SCENE_HEIGHT - 33, 33, 33), cv::Rect(5, 7, 1, 1), cv::Rect(100, 50, 61, 17) };
+
+	for (size_t r = 0; r < sizeof(regions) / sizeof(regions[0]); r++) {
+		const cv::Rect &region = regions[r];
+		size_t step = 2 * region.width;
+		std::vector<short> gradients(step * region.height), expected(step * region.height);
+
+		reference.sobelGradients(scene.gray, region, &expected[0], step);
+		table.sobelGradients(scene.gray, region, &gradients[0], step);
+		TEST_CHECK(gradients == expected);
+	}
+}
+
+
+/*  Checks both edge refinements and the cell decoding on every quad of the scene
+ *
+ *	@param reference: The baseline kernels
+ *	@param table: The kernels of the level under test
+ *	@param scene: The scene holding the quads
+ *	@param gradients: The gradients of the scene around the quads
+ *
+ *	@return void
+ */
+static void checkQuadKernels(const KernelTable &reference, const KernelTable &table, const Scene &scene,
+	const GradientImage &gradients) {
+
+	for (size_t q = 0; q < scene.quads.size(); q++) {
+		const cv::Point2f* corners = &scene.quads[q][0];
+		cv::Point pixelCorners[4];
+		for (int k = 0; k < 4; k++) {
+			pixelCorners[k] = cv::Point(cvRound(corners[k].x), cvRound(corners[k].y));
+		}
+
+		float lineParameters[16], expectedLines[16];
+		reference.refineEdges(expectedLines, pixelCorners, scene.gray);
+		table.refineEdges(lineParameters, pixelCorners, scene.gray);
+		TEST_CHECK(memcmp(lineParameters, expectedLines, sizeof(lineParameters)) == 0);
+
+		reference.refineEdgesGradient(expectedLines, pixelCorners, gradients);
+		table.refineEdgesGradient(lineParameters, pixelCorners, gradients);
+		TEST_CHECK(memcmp(lineParameters, expectedLines, sizeof(lineParameters)) == 0);
+
+		for (int cellThreshold = 60; cellThreshold <= 180; cellThreshold += 60) {
+			int pattern = -1, expectedPattern = -1;
+			bool expectedFound = reference.decodeMarkerCells(scene.gray, corners, cellThreshold, expectedPattern);
+			bool found = table.decodeMarkerCells(scene.gray, corners, cellThreshold, pattern);
+			TEST_CHECK(found == expectedFound);
+			TEST_CHECK(pattern == expectedPattern);
+		}
+	}
+}
+
+
+/*  Checks the batched pose solver on full and partial batches of every kind of marker
+ *
+ *	@param reference: The baseline kernels
+ *	@param table: The kernels of the level under test
+ *
+ *	@return void
+ */
+static void checkPoseKernels(const KernelTable &reference, const KernelTable &table) {
+
+	PoseSolver::RefineOptions<float> options;
+	options.maxIterations = 3;
+	options.errorTolerance = 0.02f;
+	options.stepTolerance = 1e-3f;
+	options.priorTolerance = 2.0f;
+
+	std::mt19937 rng(654);
+	const int counts[] = { PoseBatch::SIZE, 11, 1 };
+	for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+		PoseBatch expected;
+		fillPoseBatch(expected, counts[c], 400.0f, 400.0f, options, rng);
+		PoseBatch batch = expected;
+
+		reference.estimateSquarePoses(expected, 400.0f, 400.0f, options);
+		table.estimateSquarePoses(batch, 400.0f, 400.0f, options);
+		for (int m = 0; m < expected.count; m++) {
+			TEST_CHECK(batch.iterations[m] == expected.iterations[m]);
+			for (int k = 0; k < 7; k++) {
+				TEST_CHECK(memcmp(&batch.pose[k][m], &expected.pose[k][m], sizeof(float)) == 0);
+			}
+			for (int k = 0; k < 16; k++) {
+				TEST_CHECK(memcmp(&batch.matrix[k][m], &expected.matrix[k][m], sizeof(float)) == 0);
+			}
+		}
+	}
+}
+
+
+int main() {
+
+	KernelTable reference;
+	TEST_CHECK(kernelsForLevel(CPU_BASELINE, reference));
+
+	Scene scene;
+	drawScene(reference, scene);
+
+	// Gradients of the regions the refinement reads, computed once and shared by every level
+	GradientCache cache;
+	cache.reset(scene.gray);
+	for (size_t q = 0; q < scene.quads.size(); q++) {
+		cv::Point pixelCorners[4];
+		for (int k = 0; k < 4; k++) {
+			pixelCorners[k] = cv::Point(cvRound(scene.quads[q][k].x), cvRound(scene.quads[q][k].y));
+		}
+		cv::Rect regions[4];
+		refinementRegions(pixelCorners, regions);
+		for (int i = 0; i < 4; i++) {
+			cache.request(regions[i]);
+		}
+	}
+	for (int i = 0; i < cache.pendingCount(); i++) {
+		cache.computePending(i);
+	}
+	cache.finishPending();
+	GradientImage gradients = cache.view();
+
+	for (int level = CPU_SSE42; level < CPU_LEVEL_COUNT; level++) {
+		KernelTable table;
+		if (!kernelsForLevel(level, table)) {
+			printf("KernelLevelTest: level %s is not available, skipped\n", cpuLevelName(level));
+			continue;
+		}
+
+		checkColorKernels(reference, table);
+		checkSobelGradients(reference, table, scene);
+		checkQuadKernels(reference, table, scene, gradients);
+		checkPoseKernels(reference, table);
+		printf("KernelLevelTest: level %s compared with the baseline\n", cpuLevelName(level));
+	}
+
+	return testResult("KernelLevelTest");
+}
@@ -0,0 +1,74 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the marker code table against getMarkerIDs and correctCornerOrder
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <cstdio>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "MarkerCodes.h"
+#include "MarkerHelpers.h"
+
+
+/*  Fills a thresholded 6x6 marker with a black border and the inner cells of a raw pattern
+ *	Bit i of the pattern is the black cell in row i / 4 and column 3 - i % 4 of the inner grid.
+ *
+ *	@param pattern: The raw 16-bit cell pattern
+ *	@param planarMarker: The 6x6 CV_8UC1 marker to fill
+ *
+ *	@return void
+ */
+static void fillMarker(int pattern, cv::Mat &planarMarker) {
+
+	planarMarker.setTo(0);
+	for (int row = 0; row < 4; row++) {
+		for (int col = 0; col < 4; col++) {
+			bool black = ((pattern >> (row * 4 + 3 - col)) & 1) != 0;
+			planarMarker.at<uchar>(row + 1, col + 1) = black ? 0 : 255;
+		}
+	}
+}
+
+
+int main() {
+
+	const cv::Point2f corners[4] = { cv::Point2f(10, 20), cv::Point2f(30, 21), cv::Point2f(31, 42), cv::Point2f(9, 40) };
+	cv::Mat planarMarker(6, 6, CV_8UC1);
+	int validPatterns = 0;
+
+	for (int pattern = 0; pattern < (1 << 16); pattern++) {
+		fillMarker(pattern, planarMarker);
+		TEST_CHECK(packMarkerCells(planarMarker) == pattern);
+
+		// The decoding the table replaced, including its rejection of all black and all white markers
+		int codes[4];
+		getMarkerIDs(planarMarker, codes);
+		bool valid = (codes[0] != 0) && (codes[0] != 0xffff);
+		cv::Point2f expectedCorners[4] = { corners[0], corners[1], corners[2], corners[3] };
+		int id = correctCornerOrder(codes, expectedCorners);
+
+		const MarkerCode &markerCode = lookupMarkerCode(pattern);
+		cv::Point2f tableCorners[4] = { corners[0], corners[1], corners[2], corners[3] };
+		rotateCorners(tableCorners, markerCode.rotation);
+
+		TEST_CHECK(codes[0] == pattern);
+		TEST_CHECK((markerCode.valid != 0) == valid);
+		TEST_CHECK(markerCode.id == id);
+		for (int i = 0; i < 4; i++) {
+			TEST_CHECK(tableCorners[i] == expectedCorners[i]);
+		}
+		validPatterns += valid ? 1 : 0;
+	}
+
+	TEST_CHECK(validPatterns == (1 << 16) - 2);
+
+	return testResult("MarkerCodesTest");
+}
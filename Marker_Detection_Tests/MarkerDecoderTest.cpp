@@ -0,0 +1,216 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the cell decoder against the warp, threshold and border check it replaced
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Standard includes */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "CpuFeatures.h"
+#include "KernelDispatch.h"
+#include "MarkerDecoder.h"
+#include "MarkerHelpers.h"
+
+
+/* Values above this are white, the default cellThreshold of the detector */
+static const int CELL_THRESHOLD = 100;
+
+/* Sigmas of the blur applied to the rendered markers, 0 for none */
+static const double BLURS[] = { 0.0, 0.8, 1.6, 2.4 };
+
+/* Distance from the threshold within which the two decoders may read a cell differently.
+ * warpPerspective rounds the sample position to 1/32 of a pixel, which moves a sample on a
+ * sharp edge by a few grey levels, where the decoder interpolates at the exact position. */
+static const int NEAR_THRESHOLD = 6;
+
+/* Corners of the 6x6 marker image in the warp the decoder replaced */
+static const cv::Point2f SQUARE_CORNERS[4] = {
+	cv::Point2f(-0.5f, -0.5f), cv::Point2f(5.5f, -0.5f), cv::Point2f(5.5f, 5.5f), cv::Point2f(-0.5f, 5.5f)
+};
+
+
+/* Counts of the comparisons, by outcome */
+struct DecoderCounts {
+	int quads = 0;
+	int accepted = 0;
+	int rejected = 0;
+	int nearThreshold = 0;
+};
+
+
+/*  Tells whether any of the given warped cells lies close to the threshold
+ *
+ *	@param samples: The 6x6 warped marker before thresholding
+ *	@param cells: The cells to look at, as row * 6 + column
+ *	@param count: The number of cells
+ *
+ *	@return near: True if a cell is within NEAR_THRESHOLD of the threshold
+ */
+static bool anyNearThreshold(const cv::Mat &samples, const int* cells, int count) {
+
+	for (int i = 0; i < count; i++) {
+		int value = samples.at<uchar>(cells[i] / 6, cells[i] % 6);
+		if (std::abs(value - CELL_THRESHOLD) <= NEAR_THRESHOLD) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+/*  Decodes a quad with both decoders and checks that they agree
+ *	The old path warps the quad into a 6x6 image, thresholds it, checks the border and reads
+ *	the pattern with getMarkerIDs. A difference is only allowed where a cell it depends on
+ *	lies within NEAR_THRESHOLD of the threshold in the warped image.
+ *
+ *	@param gray: The grayscale image
+ *	@param corners: The corners of the quad
+ *	@param counts: The counts to update
+ *
+ *	@return void
+ */
+static void compareDecoders(const cv::Mat &gray, const cv::Point2f* corners, DecoderCounts &counts) {
+
+	cv::Matx33d projectionMatrix;
+	findPerspectiveTransform(corners, SQUARE_CORNERS, projectionMatrix);
+	cv::Mat samples, planarMarker;
+	cv::warpPerspective(gray, samples, cv::Mat(3, 3, CV_64F, projectionMatrix.val), cv::Size(6, 6));
+	cv::threshold(samples, planarMarker, CELL_THRESHOLD, 255, cv::THRESH_BINARY);
+
+	bool oldValid = checkBorderIsBlack(planarMarker);
+	int oldPattern = -1;
+	if (oldValid) {
+		int codes[4];
+		getMarkerIDs(planarMarker, codes);
+		oldPattern = codes[0];
+	}
+
+	int pattern = -1;
+	bool valid = decodeMarkerCells(gray, corners, CELL_THRESHOLD, pattern);
+	counts.quads++;
+
+	if (valid != oldValid) {
+		int borderCells[20], count = 0;
+		for (int i = 0; i < 36; i++) {
+			if (i / 6 == 0 || i / 6 == 5 || i % 6 == 0 || i % 6 == 5) {
+				borderCells[count++] = i;
+			}
+		}
+		TEST_CHECK(anyNearThreshold(samples, borderCells, count));
+		counts.nearThreshold++;
+		return;
+	}
+
+	if (valid && pattern != oldPattern) {
+		int innerCells[16], count = 0;
+		for (int bit = 0; bit < 16; bit++) {
+			if (((pattern ^ oldPattern) >> bit) & 1) {
+				innerCells[count++] = (bit / 4 + 1) * 6 + 4 - bit % 4;
+			}
+		}
+		TEST_CHECK(anyNearThreshold(samples, innerCells, count));
+		counts.nearThreshold++;
+		return;
+	}
+
+	counts.accepted += valid ? 1 : 0;
+	counts.rejected += valid ? 0 : 1;
+}
+
+
+int main() {
+
+	// MARKER_CPU_LEVEL picks the level under test, ctest runs this once for each
+	printf("MarkerDecoderTest: kernels at level %s\n", cpuLevelName(activeKernels().level));
+
+	std::mt19937 rng(654);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::uniform_real_distribution<float> jitter(-1.0f, 1.0f);
+	cv::Mat gray(240, 240, CV_8UC1);
+	DecoderCounts total;
+
+	for (size_t b = 0; b < sizeof(BLURS) / sizeof(BLURS[0]); b++) {
+		DecoderCounts counts;
+
+		for (int pose = 0; pose < 60; pose++) {
+
+			// A rotated square of 30 to 150 pixels, skewed for perspective, and every
+			// eighth one moved so far that part of it leaves the image
+			float side = 30 + 120 * unit(rng);
+			float angle = 2 * (float)CV_PI * unit(rng);
+			float c = std::cos(angle), sn = std::sin(angle);
+			float margin = 0.75f * side;
+			cv::Point2f center(margin + (240 - 2 * margin) * unit(rng), margin + (240 - 2 * margin) * unit(rng));
+			if (pose % 8 == 7) {
+				center = cv::Point2f(side * 0.3f, 240 - side * 0.2f);
+			}
+
+			const float square[4][2] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+			cv::Point2f corners[4];
+			for (int i = 0; i < 4; i++) {
+				float ux = side * (square[i][0] + 0.12f * jitter(rng));
+				float uy = side * (square[i][1] + 0.12f * jitter(rng));
+				corners[i] = cv::Point2f(center.x + c * ux - sn * uy, center.y + sn * ux + c * uy);
+			}
+
+			int pattern = (int)(rng() & 0xffff);
+			gray.setTo(TEST_WHITE);
+			drawMarker(gray, corners, pattern);
+			if (BLURS[b] > 0) {
+				cv::GaussianBlur(gray, gray, cv::Size(0, 0), BLURS[b]);
+			}
+
+			// The exact corners, corners off by up to a pixel as the refinement leaves them,
+			// and quads that cover only part of the marker or reach past it
+			compareDecoders(gray, corners, counts);
+
+			// A marker inside the image must read back as it was rendered, where cells beyond
+			// the image edge read as black. The strongest blur washes out the cells of the
+			// smallest markers, which is where the decoders are compared near the threshold.
+			if (pose % 8 != 7 && BLURS[b] < 2) {
+				int decoded = -1;
+				TEST_CHECK(decodeMarkerCells(gray, corners, CELL_THRESHOLD, decoded) && decoded == pattern);
+			}
+			for (int k = 0; k < 4; k++) {
+				cv::Point2f moved[4];
+				for (int i = 0; i < 4; i++) {
+					moved[i] = corners[i] + cv::Point2f(jitter(rng), jitter(rng));
+				}
+				compareDecoders(gray, moved, counts);
+			}
+			for (int k = 0; k < 2; k++) {
+				float scale = (k == 0) ? 0.6f : 1.3f;
+				cv::Point2f resized[4];
+				for (int i = 0; i < 4; i++) {
+					resized[i] = center + (corners[i] - center) * scale;
+				}
+				compareDecoders(gray, resized, counts);
+			}
+		}
+
+		// Every blur level must give both accepted and rejected quads for the comparison to cover it
+		TEST_CHECK(counts.accepted > 0 && counts.rejected > 0);
+		printf("MarkerDecoderTest: blur %.1f, %d quads, %d accepted, %d rejected, %d near the threshold\n",
+			BLURS[b], counts.quads, counts.accepted, counts.rejected, counts.nearThreshold);
+
+		total.quads += counts.quads;
+		total.nearThreshold += counts.nearThreshold;
+	}
+
+	// Rounding the sample position may only tip a rare cell that sits on the threshold
+	TEST_CHECK(total.nearThreshold * 100 <= total.quads);
+
+	return testResult("MarkerDecoderTest");
+}
@@ -0,0 +1,284 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the parallel candidate validation against the serial loop
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "MarkerDetector.h"
+#include "ThreadPool.h"
+
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int MAX_MARKERS = 64;
+static const int SCENES = 12;
+
+/* Detectors running the scenes at the same time, all on the shared pool */
+static const int CONCURRENT_DETECTORS = 3;
+
+
+/* Markers of one frame, in the order they were reported */
+typedef std::vector<Marker2> FrameMarkers;
+
+
+/*  Renders a grid of markers at random angles, one in five of them with an all white or all black code
+ *	The rejected candidates sit between the valid ones, so their results are interleaved.
+ *
+ *	@param pixels: Container to hold the RGBA frame
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static void renderScene(std::vector<Color32> &pixels, std::mt19937 &rng) {
+
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	cv::Mat gray(HEIGHT, WIDTH, CV_8UC1, cv::Scalar(TEST_WHITE));
+
+	for (int row = 0; row < 4; row++) {
+		for (int col = 0; col < 6; col++) {
+			float side = 50 + 20 * unit(rng);
+			float angle = 6.2831853f * unit(rng);
+			float c = cos(angle), s = sin(angle);
+			cv::Point2f center(60 + 104 * col + 8 * (unit(rng) - 0.5f), 60 + 118 * row + 8 * (unit(rng) - 0.5f));
+
+			const float square[4][2] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+			cv::Point2f corners[4];
+			for (int k = 0; k < 4; k++) {
+				float ux = side * square[k][0], uy = side * square[k][1];
+				corners[k] = cv::Point2f(center.x + c * ux - s * uy, center.y + s * ux + c * uy);
+			}
+
+			int kind = (int)(rng() % 10);
+			int pattern = (kind == 0) ? 0 : (kind == 1) ? 0xffff : 1 + (int)(rng() % 0xfffe);
+			drawMarker(gray, corners, pattern);
+		}
+	}
+
+	pixels.resize((size_t)WIDTH * HEIGHT);
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			uchar value = gray.at<uchar>(y, x);
+			const Color32 color = { value, value, value, 255 };
+			pixels[(size_t)y * WIDTH + x] = color;
+		}
+	}
+}
+
+
+/*  Runs one detector over every scene in turn
+ *
+ *	@param config: The detector configuration
+ *	@param scenes: The frames to run
+ *	@param output: Container to hold the markers of every frame
+ *
+ *	@return void
+ */
+static void runScenes(const DetectorConfig &config, std::vector<std::vector<Color32> > &scenes, std::vector<FrameMarkers> &output) {
+
+	MarkerDetector detector(config);
+	std::vector<Marker2> markers(MAX_MARKERS);
+	output.resize(scenes.size());
+	for (size_t s = 0; s < scenes.size(); s++) {
+		int count = detector.detect(&markers[0], MAX_MARKERS, &scenes[s][0], WIDTH, HEIGHT);
+		output[s].assign(markers.begin(), markers.begin() + count);
+	}
+}
+
+
+/*  Tells whether two frames gave the same markers, in the same order and with the same bytes
+ *
+ *	@param a: The markers of one frame
+ *	@param b: The markers of the other
+ *
+ *	@return same: True if they match
+ */
+static bool sameMarkers(const FrameMarkers &a, const FrameMarkers &b) {
+	return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(Marker2)) == 0);
+}
+
+
+/*  Checks that a pool runs every index of a job once, on a valid slot, while two callers share it
+ *
+ *	@return void
+ */
+static void checkPool() {
+
+	ThreadPool pool(3);
+	const int count = 997;
+	std::vector<std::atomic<int> > visits[2] = { std::vector<std::atomic<int> >(count), std::vector<std::atomic<int> >(count) };
+	std::atomic<int> badSlots(0);
+
+	auto caller = [&pool, &visits, &badSlots](int c) {
+		for (int i = 0; i < count; i++) {
+			visits[c][i] = 0;
+		}
+		auto body = [&pool, &visits, &badSlots, c](int index, int slot) {
+			visits[c][index]++;
+			if (slot < 0 || slot >= pool.slotCount()) {
+				badSlots++;
+			}
+
+			// Uneven work, so that the tasks finish out of order
+			volatile int spin = 0;
+			for (int k = 0; k < (index * 7919) % 2000; k++) {
+				spin += k;
+			}
+		};
+		for (int round = 0; round < 20; round++) {
+			pool.parallelFor(count, body);
+		}
+	};
+
+	std::thread other(caller, 1);
+	caller(0);
+	other.join();
+
+	for (int c = 0; c < 2; c++) {
+		for (int i = 0; i < count; i++) {
+			TEST_CHECK(visits[c][i] == 20);
+		}
+	}
+	TEST_CHECK(badSlots == 0);
+}
+
+
+/*  Checks that parallel validation reports the markers of the serial loop, in the same order
+ *	Several detectors run at once on the shared pool, so that their tasks are interleaved
+ *	even on a machine whose shared pool has no worker of its own.
+ *
+ *	@param scenes: The frames to run
+ *
+ *	@return void
+ */
+static void checkOrder(std::vector<std::vector<Color32> > &scenes) {
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	config.parallelCandidates = 0;
+	std::vector<FrameMarkers> serial;
+	runScenes(config, scenes, serial);
+
+	config.parallelCandidates = 1;
+	std::vector<FrameMarkers> parallel[CONCURRENT_DETECTORS];
+	std::vector<std::thread> threads;
+	for (int d = 1; d < CONCURRENT_DETECTORS; d++) {
+		threads.push_back(std::thread(runScenes, std::cref(config), std::ref(scenes), std::ref(parallel[d])));
+	}
+	runScenes(config, scenes, parallel[0]);
+	for (size_t t = 0; t < threads.size(); t++) {
+		threads[t].join();
+	}
+
+	int markers = 0;
+	for (size_t s = 0; s < scenes.size(); s++) {
+		for (int d = 0; d < CONCURRENT_DETECTORS; d++) {
+			TEST_CHECK(sameMarkers(parallel[d][s], serial[s]));
+		}
+
+		// Two in ten markers are rejected, so most of the grid must be found
+		TEST_CHECK(serial[s].size() >= 12);
+		markers += (int)serial[s].size();
+	}
+
+	printf("ParallelDetectionTest: %d markers over %d scenes in the serial order, from %d detectors at once on %d pool slots\n",
+		markers, (int)scenes.size(), CONCURRENT_DETECTORS, ThreadPool::shared().slotCount());
+}
+
+
+/*  Checks that maxOutMarkerCount keeps the first markers of the full list
+ *	The markers beyond the count are still remembered, so the next frame starts their poses
+ *	from this one just as it would without the limit. Outlines are only drawn for the markers
+ *	that are returned.
+ *
+ *	@param scene: The frame to run
+ *
+ *	@return void
+ */
+static void checkTruncation(std::vector<Color32> &scene) {
+
+	// The next frame moves every marker by a few pixels, so that where its pose starts matters
+	std::vector<Color32> next(scene.size());
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			next[(size_t)y * WIDTH + x] = scene[(size_t)std::max(y - 1, 0) * WIDTH + std::max(x - 1, 0)];
+		}
+	}
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	std::vector<Marker2> reference(MAX_MARKERS), nextReference(MAX_MARKERS);
+	MarkerDetector unlimited(config);
+	int total = unlimited.detect(&reference[0], MAX_MARKERS, &scene[0], WIDTH, HEIGHT);
+	int nextTotal = unlimited.detect(&nextReference[0], MAX_MARKERS, &next[0], WIDTH, HEIGHT);
+	TEST_CHECK(nextTotal == total);
+
+	for (int limit = 1; limit <= total; limit++) {
+		MarkerDetector detector(config);
+		std::vector<Marker2> markers(MAX_MARKERS);
+		int count = detector.detect(&markers[0], limit, &scene[0], WIDTH, HEIGHT);
+		TEST_CHECK(count == limit);
+		TEST_CHECK(memcmp(&markers[0], &reference[0], count * sizeof(Marker2)) == 0);
+
+		count = detector.detect(&markers[0], MAX_MARKERS, &next[0], WIDTH, HEIGHT);
+		TEST_CHECK(count == nextTotal);
+		TEST_CHECK(memcmp(&markers[0], &nextReference[0], count * sizeof(Marker2)) == 0);
+	}
+
+	// A count of zero returns before the frame is processed, so the next frame is the first one seen
+	MarkerDetector skipped(config);
+	std::vector<Marker2> markers(MAX_MARKERS);
+	TEST_CHECK(skipped.detect(&markers[0], 0, &scene[0], WIDTH, HEIGHT) == 0);
+	TEST_CHECK(skipped.detect(&markers[0], MAX_MARKERS, &scene[0], WIDTH, HEIGHT) == total);
+	TEST_CHECK(memcmp(&markers[0], &reference[0], total * sizeof(Marker2)) == 0);
+
+	// Only the outline of the one marker returned is drawn
+	config.drawOverlay = 1;
+	MarkerDetector overlay(config);
+	std::vector<Color32> copy = scene;
+	TEST_CHECK(overlay.detect(&markers[0], 1, &copy[0], WIDTH, HEIGHT) == 1);
+	int changed = 0, outside = 0;
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			size_t i = (size_t)y * WIDTH + x;
+			if (memcmp(&copy[i], &scene[i], sizeof(Color32)) == 0) {
+				continue;
+			}
+			changed++;
+			float dx = x - markers[0].center_x, dy = y - markers[0].center_y;
+			outside += (dx * dx + dy * dy > 60.0f * 60.0f) ? 1 : 0;
+		}
+	}
+	TEST_CHECK(changed > 0 && outside == 0);
+}
+
+
+int main() {
+
+	std::mt19937 rng(654);
+	std::vector<std::vector<Color32> > scenes(SCENES);
+	for (int s = 0; s < SCENES; s++) {
+		renderScene(scenes[s], rng);
+	}
+
+	checkPool();
+	checkOrder(scenes);
+	checkTruncation(scenes[0]);
+
+	return testResult("ParallelDetectionTest");
+}
@@ -0,0 +1,94 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the pipeline calls made from its own result callback
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <atomic>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "MarkerPipeline.h"
+
+
+static const int WIDTH = 320;
+static const int HEIGHT = 240;
+static const int FRAMES = 6;
+
+
+/*  What the callback saw when it called back into the pipeline */
+struct CallbackState
+{
+	MarkerPipeline* pipeline;
+	std::vector<Color32>* frame;
+	std::atomic<int> delivered;
+	std::atomic<int> configured;
+	std::atomic<int> boardsSet;
+	std::atomic<int> flushed;
+	std::atomic<int> resubmitted;
+};
+
+
+/*  Result callback that calls every waiting function of the pipeline that delivers to it
+ *	Each of them used to wait for the frame that is being delivered, which never finishes.
+ */
+static void MARKER_CALL onResult(int, const Marker2*, int, void* userData) {
+
+	CallbackState &state = *static_cast<CallbackState*>(userData);
+	DetectorConfig config;
+	getDefaultConfig(config);
+	const int ids[1] = { 1 };
+	const float corners[12] = { -1, 1, 0, -1, -1, 0, 1, -1, 0, 1, 1, 0 };
+
+	state.configured += state.pipeline->configure(config) ? 1 : 0;
+	state.boardsSet += state.pipeline->setBoard(ids, corners, 1) ? 1 : 0;
+	state.flushed += state.pipeline->flush() ? 1 : 0;
+	if (state.delivered == 0) {
+		state.resubmitted += state.pipeline->submit(&(*state.frame)[0], WIDTH, HEIGHT, 8, true) >= 0 ? 1 : 0;
+	}
+	state.delivered++;
+}
+
+
+int main() {
+
+	const Color32 background = { 190, 190, 190, 255 };
+	std::vector<Color32> frame((size_t)WIDTH * HEIGHT, background);
+	drawUprightMarker(frame, WIDTH, 40, 40, 10, 0x1234);
+
+	// A depth of one leaves no free slot while the callback runs, so a waiting submit would block forever
+	MarkerPipeline pipeline(1);
+	CallbackState state;
+	state.pipeline = &pipeline;
+	state.frame = &frame;
+	state.delivered = 0;
+	state.configured = 0;
+	state.boardsSet = 0;
+	state.flushed = 0;
+	state.resubmitted = 0;
+	pipeline.setCallback(onResult, &state);
+
+	int submitted = 0;
+	for (int i = 0; i < FRAMES; i++) {
+		submitted += pipeline.submit(&frame[0], WIDTH, HEIGHT, 8, true) >= 0 ? 1 : 0;
+	}
+	TEST_CHECK(pipeline.flush());
+
+	// The calls from the callback refuse rather than wait, the same calls from here succeed
+	TEST_CHECK(submitted == FRAMES);
+	TEST_CHECK(state.delivered == FRAMES + state.resubmitted);
+	TEST_CHECK(state.resubmitted == 0);
+	TEST_CHECK(state.configured == 0);
+	TEST_CHECK(state.boardsSet == 0);
+	TEST_CHECK(state.flushed == 0);
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	TEST_CHECK(pipeline.configure(config));
+
+	return testResult("PipelineTest");
+}
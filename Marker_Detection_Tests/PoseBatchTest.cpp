@@ -0,0 +1,137 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the batched pose solver against the solver of one marker
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* Standard includes */
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "CpuFeatures.h"
+#include "KernelDispatch.h"
+#include "PoseBatch.h"
+#include "PoseSolver.h"
+
+
+/* Number of batches solved, of every size from 1 to PoseBatch::SIZE markers */
+static const int BATCHES = 320;
+
+
+/*  Tells whether two floats hold the same bits
+ *
+ *	@param a: The first value
+ *	@param b: The second value
+ *
+ *	@return same: True if the bits match, so NaNs of the same payload compare equal
+ */
+static bool sameBits(float a, float b) {
+	return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+
+/*  Tells whether the prior of a marker reprojects close enough for the solver to start from it
+ *
+ *	@param input: The batch as it was before solving
+ *	@param m: The marker
+ *	@param corners: The corners of the marker as x0, y0, x1, y1, ...
+ *	@param focalX: The focal length along x in pixels
+ *	@param focalY: The focal length along y in pixels
+ *	@param options: The options the batch is solved with
+ *
+ *	@return accepted: True if the solver starts from the prior
+ */
+static bool priorAccepted(const PoseBatch &input, int m, const float* corners, float focalX, float focalY,
+	const PoseSolver::RefineOptions<float> &options) {
+
+	float half = input.markerSize[m] / 2;
+	const float points3D[4][3] = { { -half, half, 0 }, { -half, -half, 0 }, { half, -half, 0 }, { half, half, 0 } };
+	float points2D[4][2], pose[7], error[8];
+	for (int k = 0; k < 4; k++) {
+		points2D[k][0] = corners[2 * k];
+		points2D[k][1] = corners[2 * k + 1];
+	}
+	for (int k = 0; k < 7; k++) {
+		pose[k] = input.pose[k][m];
+	}
+
+	float errorSq = PoseSolver::reprojectionError(error, points3D, points2D, pose, focalX, focalY);
+	return errorSq <= options.priorTolerance * options.priorTolerance * 4;
+}
+
+
+int main() {
+
+	// MARKER_CPU_LEVEL picks the level under test, ctest runs this once for each
+	printf("PoseBatchTest: kernels at level %s\n", cpuLevelName(activeKernels().level));
+
+	PoseSolver::RefineOptions<float> options;
+	options.maxIterations = 3;
+	options.errorTolerance = 0.02f;
+	options.stepTolerance = 1e-3f;
+	options.priorTolerance = 2.0f;
+
+	std::mt19937 rng(654);
+	int markers = 0, degenerate = 0, accepted = 0, rejected = 0;
+
+	for (int b = 0; b < BATCHES; b++) {
+		float focalX = (b & 1) ? 520.0f : 400.0f;
+		float focalY = (b & 1) ? 500.0f : 400.0f;
+
+		PoseBatch input;
+		fillPoseBatch(input, 1 + b % PoseBatch::SIZE, focalX, focalY, options, rng);
+		PoseBatch batch = input;
+		estimateSquarePoses(batch, focalX, focalY, options);
+
+		for (int m = 0; m < input.count; m++) {
+			float corners[8], pose[7], mat[16];
+			for (int k = 0; k < 4; k++) {
+				corners[2 * k] = input.cornerX[k][m];
+				corners[2 * k + 1] = input.cornerY[k][m];
+			}
+			for (int k = 0; k < 7; k++) {
+				pose[k] = input.pose[k][m];
+			}
+
+			int iterations = PoseSolver::estimateSquarePose(mat, pose, input.hasPrior[m], corners, input.markerSize[m],
+				focalX, focalY, options);
+			TEST_CHECK(batch.iterations[m] == iterations);
+
+			// Degenerate corners give the identity pose, as they do for a single marker in estimateSquarePose
+			if (iterations < 0) {
+				for (int k = 0; k < 16; k++) {
+					mat[k] = (k % 5 == 0) ? 1.0f : 0.0f;
+				}
+				for (int k = 0; k < 7; k++) {
+					pose[k] = (k == 3) ? 1.0f : 0.0f;
+				}
+				degenerate++;
+			}
+			else if (input.hasPrior[m]) {
+				bool warm = priorAccepted(input, m, corners, focalX, focalY, options);
+				accepted += warm ? 1 : 0;
+				rejected += warm ? 0 : 1;
+			}
+
+			for (int k = 0; k < 7; k++) {
+				TEST_CHECK(sameBits(batch.pose[k][m], pose[k]));
+			}
+			for (int k = 0; k < 16; k++) {
+				TEST_CHECK(sameBits(batch.matrix[k][m], mat[k]));
+			}
+			markers++;
+		}
+	}
+
+	// Every kind of marker must have been met for the comparison to cover it
+	TEST_CHECK(degenerate > 0 && accepted > 0 && rejected > 0);
+	printf("PoseBatchTest: %d markers compared, %d degenerate, %d priors used and %d rejected\n",
+		markers, degenerate, accepted, rejected);
+
+	return testResult("PoseBatchTest");
+}
@@ -0,0 +1,195 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the pose solver against poses recorded from the CvMat solver it replaced
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <cmath>
+#include <cstdio>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "PoseEstimation.h"
+#include "PoseSolver.h"
+
+
+/* Side length of the markers, and the focal length the CvMat solver had built in */
+static const float MARKER_SIZE = 4.5f;
+static const float FOCAL_LENGTH = 400.0f;
+
+/* Largest difference allowed in a rotation entry, and in the translation relative to the depth */
+static const float ROTATION_TOLERANCE = 1e-5f;
+static const float TRANSLATION_TOLERANCE = 1e-5f;
+
+
+/*  Corners of a marker and the pose the CvMat solver gave for them */
+struct RecordedPose
+{
+	const char* name;			// What the corners show
+	float corners[8];			// Corners as x0, y0, x1, y1, ... counter-clockwise, relative to the principal point with y up
+	float matrix[12];			// Top three rows of the pose matrix the CvMat solver returned
+};
+
+
+/* Poses recorded from the cvSVD, cvMulTransposed, cvGEMM and cvSolve solver, with a 4.5 marker and f = 400.
+ * Most corners are projections of known poses rounded to a thousandth of a pixel. The nearly parallel
+ * quads put the bottom row of the homography close to zero, and the rounded corners are not a
+ * projection of any square. */
+static const RecordedPose RECORDED[] = {
+	{ "facing the camera",
+		{ -40.0f, 40.0f, -40.0f, -40.0f, 40.0f, -40.0f, 40.0f, 40.0f },
+		{ 1.0f, 0.0f, 0.0f, 0.0f,
+		  0.0f, 1.0f, 0.0f, 0.0f,
+		  0.0f, 0.0f, 1.0f, -22.500002f } },
+	{ "off centre",
+		{ 50.0f, -23.333f, 50.0f, -83.333f, 110.0f, -83.333f, 110.0f, -23.333f },
+		{ 1.0f, 0.0f, 0.0f, 6.0f,
+		  0.0f, 1.0f, 0.0f, -3.999975f,
+		  0.0f, 0.0f, 1.0f, -30.000002f } },
+	{ "turned in the image",
+		{ -33.177f, 45.177f, 2.823f, -17.177f, 65.177f, 18.823f, 29.177f, 81.177f },
+		{ 0.86602598f, -0.49999899f, -1.4239077e-07f, 0.99999785f,
+		  0.49999899f, 0.86602598f, -4.7323107e-07f, 1.9999958f,
+		  3.5992917e-07f, 3.3863517e-07f, 1.0f, -24.999948f } },
+	{ "upside down",
+		{ -42.857f, -31.171f, 2.6f, 14.286f, -42.857f, 59.743f, -88.314f, 14.286f },
+		{ -0.70710671f, -0.70710677f, 7.3844569e-07f, -2.9999809f,
+		  0.70710677f, -0.70710671f, 2.8421709e-14f, 1.0000169f,
+		  5.2215989e-07f, 5.2215989e-07f, 1.0f, -27.999916f } },
+	{ "tilted back",
+		{ -31.037f, 12.833f, -27.509f, -42.813f, 43.228f, -42.813f, 48.772f, 12.833f },
+		{ 1.0f, 4.0227711e-08f, 3.8879648e-08f, 0.49999014f,
+		  -5.8244023e-09f, 0.76603913f, -0.64279389f, -1.0000046f,
+		  -5.5641458e-08f, 0.64279389f, 0.76603913f, -24.00012f } },
+	{ "tilted sideways",
+		{ -55.054f, 31.553f, -41.456f, -38.478f, -10.921f, -11.809f, -21.04f, 49.728f },
+		{ 0.39713269f, -0.14454937f, 0.90630639f, -2.0000215f,
+		  0.34201792f, 0.93969345f, 6.1839819e-06f, 0.50001192f,
+		  -0.85165107f, 0.30997056f, 0.42262143f, -26.000149f } },
+	{ "tilted both ways",
+		{ 108.173f, 111.803f, 46.471f, 99.771f, 50.348f, 5.478f, 107.241f, 27.687f },
+		{ 0.082193732f, 0.76975298f, 0.63302803f, 4.0000091f,
+		  -0.93455875f, 0.28016603f, -0.21933268f, 3.0000072f,
+		  -0.34618491f, -0.57357413f, 0.74240732f, -20.000029f } },
+	{ "small and far",
+		{ 19.798f, -16.83f, 21.671f, -27.7f, 33.478f, -25.799f, 31.722f, -14.89f },
+		{ 0.9848038f, -0.17367072f, 7.8268349e-06f, 9.9999151f,
+		  0.16319667f, 0.92539501f, -0.34206855f, -7.9998875f,
+		  0.059400056f, 0.33687168f, 0.93967497f, -149.99939f } },
+	{ "large and close",
+		{ -120.854f, 131.559f, -101.041f, -121.635f, 174.096f, -118.951f, 145.756f, 183.4f },
+		{ 0.96224981f, -0.084187783f, -0.25881988f, 0.19999634f,
+		  0.087156214f, 0.99619466f, -5.2917749e-06f, 0.29998961f,
+		  0.25783545f, -0.022552669f, 0.96592557f, -6.5000062f } },
+	{ "nearly edge on",
+		{ -18.004f, 4.51f, -15.514f, -3.887f, 40.337f, -3.887f, 46.81f, 4.51f },
+		{ 1.0f, -1.0778174e-07f, -1.5308323e-08f, 1.0000005f,
+		  -1.5836932e-10f, 0.13917905f, -0.99026728f, -2.4095509e-05f,
+		  1.0886333e-07f, 0.99026728f, 0.13917905f, -30.000097f } },
+	{ "nearly parallel edges",
+		{ -40.0f, 40.0f, -40.0f, -40.0f, 40.0f, -40.0f, 40.04f, 40.03f },
+		{ 0.99999833f, 2.9003842e-05f, -0.001815708f, 0.00015402072f,
+		  -3.3485106e-05f, 0.99999696f, -0.0024680721f, -0.00013357148f,
+		  0.0018156309f, 0.0024681289f, 0.99999529f, -22.495031f } },
+	{ "parallel edges far off centre",
+		{ 150.0f, -80.0f, 150.0f, -100.0f, 170.0f, -100.0f, 170.0f, -80.0f },
+		{ 1.0f, 1.6025139e-07f, 7.115064e-07f, 35.999996f,
+		  -1.6025167e-07f, 1.0f, 4.0128575e-07f, -20.249994f,
+		  -7.1150629e-07f, -4.0128586e-07f, 1.0f, -89.999985f } },
+	{ "rounded corners",
+		{ -31.0f, 53.0f, -44.0f, -36.0f, 41.0f, -41.0f, 47.0f, 46.0f },
+		{ 0.99407923f, 0.090501145f, 0.060133465f, 0.18922585f,
+		  -0.091052368f, 0.99582499f, 0.006484922f, 0.29541552f,
+		  -0.059295513f, -0.011921819f, 0.9981693f, -21.097717f } },
+};
+
+
+/* Corners that have no pose. The CvMat solver returned an arbitrary pose for the line and NaN
+ * for the single point, where the solver now reports them as degenerate. */
+static const float DEGENERATE[][8] = {
+	{ 0.0f, -20.0f, 10.0f, -15.0f, 20.0f, -10.0f, 30.0f, -5.0f },
+	{ 12.0f, 7.0f, 12.0f, 7.0f, 12.0f, 7.0f, 12.0f, 7.0f },
+};
+
+
+/*  Checks the solver and the wrapper of the library against a recorded pose
+ *
+ *	@param recorded: The corners and the recorded pose
+ *
+ *	@return void
+ */
+static void checkRecordedPose(const RecordedPose &recorded) {
+
+	float mat[16];
+	TEST_CHECK(PoseSolver::estimateSquarePose(mat, recorded.corners, MARKER_SIZE, FOCAL_LENGTH, FOCAL_LENGTH));
+
+	float depth = std::fabs(recorded.matrix[11]);
+	bool close = true;
+	for (int r = 0; r < 3; r++) {
+		for (int c = 0; c < 4; c++) {
+			float tolerance = (c == 3) ? TRANSLATION_TOLERANCE * depth : ROTATION_TOLERANCE;
+			close = close && std::fabs(mat[4 * r + c] - recorded.matrix[4 * r + c]) <= tolerance;
+		}
+	}
+	TEST_CHECK(close);
+	TEST_CHECK(mat[12] == 0 && mat[13] == 0 && mat[14] == 0 && mat[15] == 1);
+	if (!close) {
+		printf("PoseRegressionTest: %s differs from the recorded pose\n", recorded.name);
+	}
+
+	// The entry point the library kept for the old signature solves the same pose
+	cv::Point2f points[4];
+	for (int i = 0; i < 4; i++) {
+		points[i] = cv::Point2f(recorded.corners[2 * i], recorded.corners[2 * i + 1]);
+	}
+	float wrapped[16];
+	estimateSquarePose(wrapped, points, MARKER_SIZE);
+	for (int i = 0; i < 16; i++) {
+		TEST_CHECK(wrapped[i] == mat[i]);
+	}
+}
+
+
+/*  Checks that corners without a pose are reported, and that the wrapper gives the identity
+ *
+ *	@param corners: The degenerate corners
+ *
+ *	@return void
+ */
+static void checkDegenerate(const float* corners) {
+
+	float mat[16];
+	TEST_CHECK(!PoseSolver::estimateSquarePose(mat, corners, MARKER_SIZE, FOCAL_LENGTH, FOCAL_LENGTH));
+
+	cv::Point2f points[4];
+	for (int i = 0; i < 4; i++) {
+		points[i] = cv::Point2f(corners[2 * i], corners[2 * i + 1]);
+	}
+	float wrapped[16];
+	estimateSquarePose(wrapped, points, MARKER_SIZE);
+	for (int i = 0; i < 16; i++) {
+		TEST_CHECK(wrapped[i] == ((i % 5 == 0) ? 1.0f : 0.0f));
+	}
+}
+
+
+int main() {
+
+	int count = sizeof(RECORDED) / sizeof(RECORDED[0]);
+	for (int i = 0; i < count; i++) {
+		checkRecordedPose(RECORDED[i]);
+	}
+	for (size_t i = 0; i < sizeof(DEGENERATE) / sizeof(DEGENERATE[0]); i++) {
+		checkDegenerate(DEGENERATE[i]);
+	}
+
+	printf("PoseRegressionTest: %d recorded poses compared\n", count);
+
+	return testResult("PoseRegressionTest");
+}
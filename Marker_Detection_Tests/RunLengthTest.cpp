@@ -0,0 +1,255 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the run-length quad extractor against the contours of the binary image
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Standard includes */
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "MarkerDetector.h"
+#include "RunLengthExtractor.h"
+
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int SCENES = 40;
+
+/* Furthest a corner of the extractor may be from the corner of the contour */
+static const int CORNER_TOLERANCE = 2;
+
+
+/*  Finds the quads of a grayscale image as the contour path of the detector does
+ *	The image is thresholded, its contours are found and each goes through filterContour.
+ *
+ *	@param gray: The grayscale image
+ *	@param threshold: The binarization threshold
+ *	@param limits: The thresholds of the contour tests
+ *	@param quads: Container to hold four corners per quad
+ *
+ *	@return void
+ */
+static void findContourQuads(const cv::Mat &gray, int threshold, const ContourLimits &limits, std::vector<cv::Point> &quads) {
+
+	cv::Mat binary;
+	cv::threshold(gray, binary, threshold, 255, cv::THRESH_BINARY);
+	std::vector<std::vector<cv::Point>> contours;
+	cv::findContours(binary, contours, cv::RETR_LIST, cv::CHAIN_APPROX_NONE);
+
+	quads.clear();
+	std::vector<cv::Point> polygon;
+	for (size_t i = 0; i < contours.size(); i++) {
+		if (filterContour(contours[i].data(), (int)contours[i].size(), limits, polygon) == CONTOUR_ACCEPTED) {
+			quads.insert(quads.end(), polygon.begin(), polygon.end());
+		}
+	}
+}
+
+
+/*  Finds the corners of a marker at a random pose within a square of the image
+ *
+ *	@param center: The centre of the marker
+ *	@param side: The side of the marker before skewing
+ *	@param rng: The random generator of the test
+ *	@param corners: Container to hold the four corners
+ *
+ *	@return void
+ */
+static void poseMarker(const cv::Point2f &center, float side, std::mt19937 &rng, cv::Point2f* corners) {
+
+	std::uniform_real_distribution<float> turn(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> skew(-0.1f, 0.1f);
+	float angle = turn(rng);
+	float c = std::cos(angle), s = std::sin(angle);
+	const float unit[4][2] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+	for (int k = 0; k < 4; k++) {
+		float ux = side * (unit[k][0] + skew(rng));
+		float uy = side * (unit[k][1] + skew(rng));
+		corners[k] = cv::Point2f(center.x + c * ux - s * uy, center.y + s * ux + c * uy);
+	}
+}
+
+
+/*  Draws a scene of markers and dark clutter on a white background
+ *	Markers sit in two rows, with the clutter in a band between them so that no region
+ *	joins another: slivers, small blobs, quads of marker size and pieces cut off by the
+ *	side borders. One marker slot holds a marker cut off by the left border and another an
+ *	upright marker whose border just reaches the top row. Pixel noise goes over everything.
+ *
+ *	@param gray: The grayscale image to draw into
+ *	@param rng: The random generator of the test
+ *	@param centers: Container to hold the centres of the markers inside the image
+ *	@param borderCenters: Container to hold the centres of the markers that touch the border
+ *
+ *	@return void
+ */
+static void drawScene(cv::Mat &gray, std::mt19937 &rng, std::vector<cv::Point2f> &centers, std::vector<cv::Point2f> &borderCenters) {
+
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	gray.setTo(TEST_WHITE);
+	centers.clear();
+	borderCenters.clear();
+
+	cv::Point2f corners[4];
+	for (int i = 0; i < 8; i++) {
+		cv::Point2f center(80.0f + 160.0f * (i % 4) + 20 * unit(rng) - 10, 120.0f + 240.0f * (i / 4) + 20 * unit(rng) - 10);
+		if (i == 1) {
+			float left = center.x - 30;
+			const cv::Point2f upright[4] = { cv::Point2f(left, -0.4f), cv::Point2f(left + 60, -0.4f),
+				cv::Point2f(left + 60, 59.6f), cv::Point2f(left, 59.6f) };
+			drawMarker(gray, upright, (int)(rng() & 0xffff));
+			borderCenters.push_back(cv::Point2f(left + 30, 30));
+			continue;
+		}
+		if (i == 4) {
+			center.x = 15;
+			poseMarker(center, 70, rng, corners);
+			drawMarker(gray, corners, (int)(rng() & 0xffff));
+			borderCenters.push_back(center);
+			continue;
+		}
+
+		poseMarker(center, 40 + 40 * unit(rng), rng, corners);
+		drawMarker(gray, corners, (int)(rng() & 0xffff));
+		centers.push_back(center);
+	}
+
+	// Clutter in the band between the rows, a third of it thin bars
+	for (int i = 0; i < 10; i++) {
+		cv::Point2f center(-10 + (WIDTH + 20) * (i + unit(rng)) / 10, 225 + 30 * unit(rng));
+		float halfX = 3 + 15 * unit(rng);
+		float halfY = (i % 3 == 0) ? 1 + 2 * unit(rng) : 3 + 15 * unit(rng);
+		float angle = (i % 2) ? 6.2831853f * unit(rng) : 0.0f;
+		float c = std::cos(angle), s = std::sin(angle);
+		const float signs[4][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, 1 } };
+		for (int k = 0; k < 4; k++) {
+			corners[k] = cv::Point2f(center.x + c * halfX * signs[k][0] - s * halfY * signs[k][1],
+				center.y + s * halfX * signs[k][0] + c * halfY * signs[k][1]);
+		}
+		drawQuad(gray, corners);
+	}
+
+	for (int i = 0; i < WIDTH * HEIGHT / 400; i++) {
+		gray.at<uchar>((int)(rng() % HEIGHT), (int)(rng() % WIDTH)) = TEST_BLACK;
+	}
+}
+
+
+/*  Tells whether the corners of two quads match, in the same order from the same corner
+ *	approxPolyDP keeps its vertices from the hull rather than from the contour, and the hull
+ *	cuts across the rounded corners the contour follows, so a corner can move a pixel or two.
+ *
+ *	@param expected: The four corners to match
+ *	@param quad: The four corners to match them with
+ *	@param moved: Counter of the matched corners that are not exactly the same
+ *
+ *	@return match: True if every corner is within CORNER_TOLERANCE of the expected one
+ */
+static bool cornersMatch(const cv::Point* expected, const cv::Point* quad, int &moved) {
+
+	int differ = 0;
+	for (int k = 0; k < 4; k++) {
+		cv::Point d = quad[k] - expected[k];
+		if (std::abs(d.x) > CORNER_TOLERANCE || std::abs(d.y) > CORNER_TOLERANCE) {
+			return false;
+		}
+		differ += (d.x != 0 || d.y != 0) ? 1 : 0;
+	}
+	moved += differ;
+	return true;
+}
+
+
+/*  Tells whether a point lies inside a convex quad
+ *
+ *	@param quad: The four corners of the quad, in order around it
+ *	@param point: The point
+ *
+ *	@return inside: True if the point is on the inner side of all four edges
+ */
+static bool quadContains(const cv::Point* quad, const cv::Point2f &point) {
+
+	int positive = 0, negative = 0;
+	for (int k = 0; k < 4; k++) {
+		cv::Point2f a((float)quad[k].x, (float)quad[k].y);
+		cv::Point2f b((float)quad[(k + 1) % 4].x, (float)quad[(k + 1) % 4].y);
+		double side = (b - a).cross(point - a);
+		positive += (side > 0) ? 1 : 0;
+		negative += (side < 0) ? 1 : 0;
+	}
+	return positive == 4 || negative == 4;
+}
+
+
+int main() {
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	ContourLimits limits(config, 1);
+
+	std::mt19937 rng(654);
+	cv::Mat gray(HEIGHT, WIDTH, CV_8UC1);
+	std::vector<cv::Point2f> centers, borderCenters;
+	std::vector<cv::Point> contourQuads, quads, bandedQuads;
+	RunLengthExtractor extractor;
+	int compared = 0, moved = 0, markersFound = 0;
+
+	for (int scene = 0; scene < SCENES; scene++) {
+		drawScene(gray, rng, centers, borderCenters);
+		findContourQuads(gray, config.binaryThreshold, limits, contourQuads);
+
+		// Serial and banded labelling must give the same quads in the same order
+		FrameStats stats, bandedStats;
+		quads.clear();
+		bandedQuads.clear();
+		int count = extractor.extract(gray, config.binaryThreshold, limits, 1, quads, stats);
+		int bandedCount = extractor.extract(gray, config.binaryThreshold, limits, 4, bandedQuads, bandedStats);
+		TEST_CHECK(count * 4 == (int)quads.size());
+		TEST_CHECK(bandedCount == count && bandedQuads == quads);
+
+		// The same quads as the contours, though not in the same order, each going the same
+		// way around from the same corner
+		TEST_CHECK(quads.size() == contourQuads.size());
+		for (size_t i = 0; i < contourQuads.size() / 4; i++) {
+			bool found = false;
+			for (int j = 0; j < count && !found; j++) {
+				found = cornersMatch(&contourQuads[4 * i], &quads[4 * j], moved);
+			}
+			TEST_CHECK(found);
+			compared++;
+		}
+
+		// Every marker inside the image gives a quad, and no marker touching the border does
+		for (size_t m = 0; m < centers.size(); m++) {
+			bool found = false;
+			for (int i = 0; i < count && !found; i++) {
+				found = quadContains(&quads[4 * i], centers[m]);
+			}
+			TEST_CHECK(found);
+			markersFound += found ? 1 : 0;
+		}
+		for (size_t m = 0; m < borderCenters.size(); m++) {
+			for (size_t i = 0; i < contourQuads.size() / 4; i++) {
+				TEST_CHECK(!quadContains(&contourQuads[4 * i], borderCenters[m]));
+			}
+			for (int i = 0; i < count; i++) {
+				TEST_CHECK(!quadContains(&quads[4 * i], borderCenters[m]));
+			}
+		}
+	}
+
+	printf("RunLengthTest: %d quads compared, %d corners moved along the border, %d markers found\n", compared, moved, markersFound);
+
+	return testResult("RunLengthTest");
+}
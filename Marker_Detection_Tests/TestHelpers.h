@@ -0,0 +1,325 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Header file for the checks and test images shared by the tests
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+#pragma once
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/* Helper includes */
+#include "UnityStructs.h"
+#include "MarkerHelpers.h"
+#include "PoseBatch.h"
+
+
+/* Number of checks of the running test that failed */
+static int testFailures = 0;
+
+/* Grey levels of the background and of the markers, as in the synthetic scenes */
+static const uchar TEST_WHITE = 225;
+static const uchar TEST_BLACK = 30;
+
+
+/*  Records a failed check with its location, and carries on with the test */
+#define TEST_CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			testFailures++; \
+		} \
+	} while (0)
+
+
+/*  Prints the outcome of a test and returns its exit code
+ *
+ *	@param name: The name of the test
+ *
+ *	@return code: 0 if every check passed, 1 otherwise
+ */
+static inline int testResult(const char* name) {
+
+	if (testFailures > 0) {
+		printf("%s: %d checks failed\n", name, testFailures);
+		return 1;
+	}
+
+	printf("%s: passed\n", name);
+	return 0;
+}
+
+
+/*  Draws an upright marker with its one cell wide white quiet zone into an RGBA image
+ *	Bit i of the code is row (i / 4) + 1 and column 4 - (i % 4) of the marker, as in the synthetic scenes.
+ *
+ *	@param pixels: The RGBA image to draw into
+ *	@param width: The width of the image
+ *	@param left: The column of the top left corner of the quiet zone
+ *	@param top: The row of the top left corner of the quiet zone
+ *	@param cellPixels: The side length of a cell in pixels
+ *	@param code: The 16-bit code of the marker
+ *
+ *	@return void
+ */
+static inline void drawUprightMarker(std::vector<Color32> &pixels, int width, int left, int top, int cellPixels, int code) {
+
+	for (int row = -1; row < 7; row++) {
+		for (int col = -1; col < 7; col++) {
+			bool black = row >= 0 && row < 6 && col >= 0 && col < 6;
+			if (row >= 1 && row <= 4 && col >= 1 && col <= 4) {
+				black = ((code >> ((row - 1) * 4 + (4 - col))) & 1) != 0;
+			}
+
+			uchar level = black ? TEST_BLACK : TEST_WHITE;
+			for (int y = 0; y < cellPixels; y++) {
+				for (int x = 0; x < cellPixels; x++) {
+					Color32 &pixel = pixels[(size_t)(top + (row + 1) * cellPixels + y) * width + left + (col + 1) * cellPixels + x];
+					pixel.r = pixel.g = pixel.b = level;
+					pixel.a = 255;
+				}
+			}
+		}
+	}
+}
+
+
+/*  Draws a dark convex quad into a grayscale image, antialiased with 4x4 samples per pixel
+ *	The smooth edges give every refinement stripe across them a single sharp maximum.
+ *
+ *	@param gray: The grayscale image to draw into
+ *	@param corners: The corners of the quad, in order around it
+ *
+ *	@return void
+ */
+static inline void drawQuad(cv::Mat &gray, const cv::Point2f* corners) {
+
+	float area = 0;
+	for (int i = 0; i < 4; i++) {
+		const cv::Point2f &a = corners[i];
+		const cv::Point2f &b = corners[(i + 1) % 4];
+		area += a.x * b.y - b.x * a.y;
+	}
+	float orientation = (area > 0) ? 1.0f : -1.0f;
+
+	for (int y = 0; y < gray.rows; y++) {
+		for (int x = 0; x < gray.cols; x++) {
+
+			int covered = 0;
+			for (int s = 0; s < 16; s++) {
+				float sx = x + ((s & 3) + 0.5f) / 4;
+				float sy = y + ((s >> 2) + 0.5f) / 4;
+
+				bool inside = true;
+				for (int i = 0; i < 4 && inside; i++) {
+					const cv::Point2f &a = corners[i];
+					const cv::Point2f &b = corners[(i + 1) % 4];
+					inside = orientation * ((b.x - a.x) * (sy - a.y) - (b.y - a.y) * (sx - a.x)) >= 0;
+				}
+				covered += inside ? 1 : 0;
+			}
+
+			if (covered > 0) {
+				gray.at<uchar>(y, x) = (uchar)(gray.at<uchar>(y, x) - ((gray.at<uchar>(y, x) - TEST_BLACK) * covered + 8) / 16);
+			}
+		}
+	}
+}
+
+
+/*  Draws a marker seen under a homography, antialiased with 4x4 samples per pixel
+ *	Pixel centres are at integer positions, as the warp and the cell decoder read them.
+ *	Pixels the marker only partly covers are blended with what was drawn before.
+ *
+ *	@param gray: The grayscale image to draw into
+ *	@param corners: The corners of the marker, from its top left cell around its top row
+ *	@param pattern: The raw 16-bit cell pattern, with black cells as ones
+ *
+ *	@return void
+ */
+static inline void drawMarker(cv::Mat &gray, const cv::Point2f* corners, int pattern) {
+
+	const cv::Point2f unit[4] = { cv::Point2f(0, 0), cv::Point2f(1, 0), cv::Point2f(1, 1), cv::Point2f(0, 1) };
+	cv::Matx33d toUnit;
+	findPerspectiveTransform(corners, unit, toUnit);
+	const double* M = toUnit.val;
+
+	float minX = corners[0].x, maxX = corners[0].x, minY = corners[0].y, maxY = corners[0].y;
+	for (int i = 1; i < 4; i++) {
+		minX = std::min(minX, corners[i].x);
+		maxX = std::max(maxX, corners[i].x);
+		minY = std::min(minY, corners[i].y);
+		maxY = std::max(maxY, corners[i].y);
+	}
+
+	for (int y = std::max((int)minY, 0); y <= std::min((int)maxY + 1, gray.rows - 1); y++) {
+		for (int x = std::max((int)minX, 0); x <= std::min((int)maxX + 1, gray.cols - 1); x++) {
+
+			int black = 0, white = 0;
+			for (int s = 0; s < 16; s++) {
+				double sx = x - 0.5 + ((s & 3) + 0.5) / 4;
+				double sy = y - 0.5 + ((s >> 2) + 0.5) / 4;
+				double w = M[6] * sx + M[7] * sy + M[8];
+				int col = (int)std::floor(6 * (M[0] * sx + M[1] * sy + M[2]) / w);
+				int row = (int)std::floor(6 * (M[3] * sx + M[4] * sy + M[5]) / w);
+				if (col < 0 || row < 0 || col > 5 || row > 5) {
+					continue;
+				}
+
+				bool border = (row == 0 || col == 0 || row == 5 || col == 5);
+				bool dark = border || ((pattern >> ((row - 1) * 4 + 4 - col)) & 1) != 0;
+				black += dark ? 1 : 0;
+				white += dark ? 0 : 1;
+			}
+
+			if (black + white > 0) {
+				int outside = 16 - black - white;
+				uchar &pixel = gray.at<uchar>(y, x);
+				pixel = (uchar)((pixel * outside + TEST_WHITE * white + TEST_BLACK * black + 8) / 16);
+			}
+		}
+	}
+}
+
+
+/*  Fills a binary image with the clutter of a thresholded frame
+ *	Filled and hollow boxes, boxes that flip what is under them so that holes nest in holes,
+ *	thin lines, single pixels and pixel noise, some of them cut off by the image border.
+ *
+ *	@param binary: The CV_8UC1 image to fill, with 0 and 255
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static inline void fillClutter(cv::Mat &binary, std::mt19937 &rng) {
+
+	binary.setTo(0);
+	for (int i = 0; i < 60; i++) {
+		int left = (int)(rng() % binary.cols) - 10;
+		int top = (int)(rng() % binary.rows) - 10;
+		int width = 1 + (int)(rng() % 50);
+		int height = 1 + (int)(rng() % 50);
+		int kind = (int)(rng() % 4);
+
+		for (int y = std::max(top, 0); y < std::min(top + height, binary.rows); y++) {
+			for (int x = std::max(left, 0); x < std::min(left + width, binary.cols); x++) {
+				uchar &pixel = binary.at<uchar>(y, x);
+				bool edge = (y == top || x == left || y == top + height - 1 || x == left + width - 1);
+				if (kind == 0) {
+					pixel = 255;
+				}
+				else if (kind == 1) {
+					pixel = (uchar)(255 - pixel);
+				}
+				else if (kind == 2 && edge) {
+					pixel = 255;
+				}
+				else if (kind == 3 && (x - left) == (y - top)) {
+					pixel = 255;
+				}
+			}
+		}
+	}
+
+	for (int i = 0; i < binary.rows * binary.cols / 40; i++) {
+		uchar &pixel = binary.at<uchar>((int)(rng() % binary.rows), (int)(rng() % binary.cols));
+		pixel = (uchar)(255 - pixel);
+	}
+}
+
+
+/*  Fills the corners of one lane of a pose batch with a skewed square seen by the camera
+ *	The corners are counter-clockwise with y up and relative to the principal point, as the
+ *	detector hands them to the solver.
+ *
+ *	@param batch: The batch to fill
+ *	@param m: The lane to fill
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static inline void fillPoseCorners(PoseBatch &batch, int m, std::mt19937 &rng) {
+
+	std::uniform_real_distribution<float> centre(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> size(15.0f, 100.0f);
+	std::uniform_real_distribution<float> turn(0.0f, 6.2831853f);
+	std::uniform_real_distribution<float> skew(-0.15f, 0.15f);
+
+	float cx = centre(rng), cy = centre(rng), half = size(rng), angle = turn(rng);
+	float c = cos(angle), s = sin(angle);
+	const float unit[4][2] = { { -1, 1 }, { -1, -1 }, { 1, -1 }, { 1, 1 } };
+	for (int k = 0; k < 4; k++) {
+		float ux = half * (unit[k][0] + skew(rng));
+		float uy = half * (unit[k][1] + skew(rng));
+		batch.cornerX[k][m] = cx + c * ux - s * uy;
+		batch.cornerY[k][m] = cy + s * ux + c * uy;
+	}
+}
+
+
+/*  Fills a pose batch with the kinds of markers the detector hands the solver
+ *	Lanes cycle through a marker without a prior, one whose prior fits its corners, one whose
+ *	prior is too far off and is rejected, one whose prior is not finite, and one whose corners
+ *	lie on a line and have no pose. A prior whose own corners are degenerate is dropped, and
+ *	the marker is solved without one, as the detector does.
+ *
+ *	@param batch: The batch to fill
+ *	@param count: The number of markers, at most PoseBatch::SIZE
+ *	@param focalX: The focal length along x in pixels
+ *	@param focalY: The focal length along y in pixels
+ *	@param options: The options the priors are solved with
+ *	@param rng: The random generator of the test
+ *
+ *	@return void
+ */
+static inline void fillPoseBatch(PoseBatch &batch, int count, float focalX, float focalY,
+	const PoseSolver::RefineOptions<float> &options, std::mt19937 &rng) {
+
+	std::uniform_real_distribution<float> nudge(-0.3f, 0.3f);
+	batch.count = count;
+	for (int m = 0; m < count; m++) {
+		int kind = m % 5;
+		fillPoseCorners(batch, m, rng);
+		batch.markerSize[m] = 50.0f;
+		batch.hasPrior[m] = (kind == 1 || kind == 2 || kind == 3);
+		for (int k = 0; k < 7; k++) {
+			batch.pose[k][m] = 0.0f;
+		}
+
+		if (kind == 1 || kind == 2) {
+
+			// The prior is the pose of the same marker a little, or a lot, further along
+			float offset = (kind == 1) ? 0.0f : 30.0f;
+			float corners[8], mat[16], prior[7] = { 0 };
+			for (int k = 0; k < 4; k++) {
+				corners[2 * k] = batch.cornerX[k][m] + offset + nudge(rng);
+				corners[2 * k + 1] = batch.cornerY[k][m] + nudge(rng);
+			}
+			if (PoseSolver::estimateSquarePose(mat, prior, false, corners, batch.markerSize[m], focalX, focalY, options) < 0) {
+				batch.hasPrior[m] = false;
+				continue;
+			}
+			for (int k = 0; k < 7; k++) {
+				batch.pose[k][m] = prior[k];
+			}
+		}
+		else if (kind == 3) {
+			batch.pose[4][m] = NAN;
+		}
+		else if (kind == 4) {
+			for (int k = 0; k < 4; k++) {
+				batch.cornerX[k][m] = 10.0f * k;
+				batch.cornerY[k][m] = 5.0f * k - 20.0f;
+			}
+		}
+	}
+}
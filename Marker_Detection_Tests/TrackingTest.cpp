@@ -0,0 +1,259 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of tracking mode against full scans of the same frames
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "MarkerCodes.h"
+#include "MarkerDetector.h"
+
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int MAX_MARKERS = 16;
+static const int FRAMES = 60;
+
+/* Frames between full scans of the tracking detector, short enough for several to happen */
+static const int REACQUIRE_INTERVAL = 10;
+
+/* Side length of the markers in pixels */
+static const float MARKER_SIDE = 70.0f;
+
+
+/* Path of one marker through the frames */
+struct MarkerPath {
+	int pattern;		// Raw cell pattern drawn
+	float x;			// Center in the first frame
+	float y;
+	float dx;			// Motion per frame
+	float dy;
+	float spin;			// Rotation per frame in radians
+	int hiddenFrom;		// First frame the marker is hidden, or FRAMES
+	int hiddenUntil;	// First frame the marker is seen again
+	int jumpFrame;		// Frame the marker jumps by jumpX and jumpY, or FRAMES
+	float jumpX;
+	float jumpY;
+};
+
+
+/* Two markers moving and turning, one that leaves and comes back somewhere else, one that jumps
+ * further than its search region reaches, and one that only comes in after the first full scan */
+static const MarkerPath PATHS[] = {
+	{ 0x1234, 100, 100, 3, 1, 0.01f, FRAMES, FRAMES, FRAMES, 0, 0 },
+	{ 0x0f0f, 500, 120, -2, 2, -0.015f, FRAMES, FRAMES, FRAMES, 0, 0 },
+	{ 0x5a5a, 150, 350, 2, -1, 0.0f, 23, 36, FRAMES, 0, 0 },
+	{ 0x00ff, 470, 380, 0, 0, 0.0f, FRAMES, FRAMES, 47, 90, -80 },
+	{ 0x3c3c, 330, 420, 1, 0, 0.005f, 0, 12, FRAMES, 0, 0 }
+};
+
+static const int PATH_COUNT = sizeof(PATHS) / sizeof(PATHS[0]);
+
+
+/*  Tells whether a marker is in a frame, and where
+ *
+ *	@param path: The path of the marker
+ *	@param f: The frame
+ *	@param corners: Container to hold the corners of the marker
+ *
+ *	@return visible: True if the marker is drawn in the frame
+ */
+static bool markerAt(const MarkerPath &path, int f, cv::Point2f* corners) {
+
+	if (f >= path.hiddenFrom && f < path.hiddenUntil) {
+		return false;
+	}
+
+	float x = path.x + path.dx * f;
+	float y = path.y + path.dy * f;
+	if (f >= path.jumpFrame) {
+		x += path.jumpX;
+		y += path.jumpY;
+	}
+
+	const float unit[4][2] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+	float c = cos(path.spin * f), s = sin(path.spin * f);
+	for (int k = 0; k < 4; k++) {
+		float ux = MARKER_SIDE * unit[k][0], uy = MARKER_SIDE * unit[k][1];
+		corners[k] = cv::Point2f(x + c * ux - s * uy, y + s * ux + c * uy);
+	}
+	return true;
+}
+
+
+/*  Returns the last frame up to f where a marker came into view or jumped
+ *	Tracking only finds such a marker at the next full scan.
+ *
+ *	@param path: The path of the marker
+ *	@param f: The frame
+ *
+ *	@return event: The frame, or -1 if the marker has been in place since the first frame
+ */
+static int lastEvent(const MarkerPath &path, int f) {
+
+	int event = -1;
+	if (path.hiddenUntil <= f && path.hiddenFrom < path.hiddenUntil) {
+		event = path.hiddenUntil;
+	}
+	if (path.jumpFrame <= f) {
+		event = std::max(event, path.jumpFrame);
+	}
+	return event;
+}
+
+
+/*  Renders a frame into a gray image and its RGBA copy
+ *	RGBA input is converted into the detector's own gray buffer, which keeps the pixels of
+ *	earlier frames outside of the regions a tracked frame converts.
+ *
+ *	@param f: The frame
+ *	@param gray: Container to hold the grayscale frame
+ *	@param pixels: Container to hold the RGBA frame
+ *
+ *	@return visible: Bit m set if marker m is in the frame
+ */
+static int renderFrame(int f, cv::Mat &gray, std::vector<Color32> &pixels) {
+
+	gray.setTo(TEST_WHITE);
+	int visible = 0;
+	for (int m = 0; m < PATH_COUNT; m++) {
+		cv::Point2f corners[4];
+		if (markerAt(PATHS[m], f, corners)) {
+			drawMarker(gray, corners, PATHS[m].pattern);
+			visible |= 1 << m;
+		}
+	}
+
+	pixels.resize((size_t)WIDTH * HEIGHT);
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			uchar value = gray.at<uchar>(y, x);
+			const Color32 color = { value, value, value, 255 };
+			pixels[(size_t)y * WIDTH + x] = color;
+		}
+	}
+	return visible;
+}
+
+
+/*  Finds a marker by ID among the markers of a frame
+ *
+ *	@param markers: The markers found
+ *	@param count: The number of markers found
+ *	@param id: The marker ID
+ *
+ *	@return index: The index of the marker, or -1
+ */
+static int findMarker(const std::vector<Marker2> &markers, int count, int id) {
+
+	for (int i = 0; i < count; i++) {
+		if (markers[i].id == id) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+/*  Runs a tracking detector and a full-scan detector side by side over the frames
+ *	Every marker tracking reports must be reported by the full scan with the same bytes. A
+ *	marker it misses must have come into view or jumped since the last full scan: one that
+ *	came into view is found within REACQUIRE_INTERVAL frames, and one that jumped loses its
+ *	track, so it is found the very next frame.
+ *
+ *	@param name: The name of the configuration, for the output
+ *	@param config: The configuration of both detectors, tracking is turned on for one of them
+ *
+ *	@return void
+ */
+static void checkConfiguration(const char* name, DetectorConfig config) {
+
+	MarkerDetector fullScan(config);
+	config.trackingMode = 1;
+	config.reacquireInterval = REACQUIRE_INTERVAL;
+	MarkerDetector tracking(config);
+
+	cv::Mat gray(HEIGHT, WIDTH, CV_8UC1);
+	std::vector<Color32> pixels;
+	std::vector<Marker2> full(MAX_MARKERS), tracked(MAX_MARKERS);
+	int matched = 0, missed = 0;
+
+	for (int f = 0; f < FRAMES; f++) {
+		int visible = renderFrame(f, gray, pixels);
+		int fullCount = fullScan.detect(&full[0], MAX_MARKERS, &pixels[0], WIDTH, HEIGHT);
+		int trackedCount = tracking.detect(&tracked[0], MAX_MARKERS, &pixels[0], WIDTH, HEIGHT);
+
+		// The full scan finds every marker in view, and nothing else
+		int inView = 0;
+		for (int m = 0; m < PATH_COUNT; m++) {
+			if (visible & (1 << m)) {
+				TEST_CHECK(findMarker(full, fullCount, lookupMarkerCode(PATHS[m].pattern).id) >= 0);
+				inView++;
+			}
+		}
+		TEST_CHECK(fullCount == inView);
+
+		// Tracking reports a subset of the full scan, bit for bit
+		for (int i = 0; i < trackedCount; i++) {
+			int j = findMarker(full, fullCount, tracked[i].id);
+			TEST_CHECK(j >= 0);
+			if (j >= 0) {
+				TEST_CHECK(memcmp(&tracked[i], &full[j], sizeof(Marker2)) == 0);
+				matched++;
+			}
+		}
+
+		// Only markers that turned up since the last full scan may be missing
+		for (int m = 0; m < PATH_COUNT; m++) {
+			if (!(visible & (1 << m)) || findMarker(tracked, trackedCount, lookupMarkerCode(PATHS[m].pattern).id) >= 0) {
+				continue;
+			}
+
+			int event = lastEvent(PATHS[m], f);
+			TEST_CHECK(event >= 0 && f - event < REACQUIRE_INTERVAL);
+			TEST_CHECK(event != PATHS[m].jumpFrame || f == event);
+			missed++;
+		}
+	}
+
+	// Tracking must have skipped full scans for the comparison to mean anything
+	TEST_CHECK(missed > 0);
+	printf("TrackingTest: %s, %d tracked markers match the full scan, %d missed until the next full scan\n",
+		name, matched, missed);
+}
+
+
+int main() {
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+
+	// Without warm starts, a marker missed in one frame gets the same pose in the next from both detectors
+	config.warmStartPose = 0;
+
+	// The markers need distinct IDs to be told apart
+	for (int m = 0; m < PATH_COUNT; m++) {
+		for (int n = 0; n < m; n++) {
+			TEST_CHECK(lookupMarkerCode(PATHS[m].pattern).id != lookupMarkerCode(PATHS[n].pattern).id);
+		}
+	}
+
+	checkConfiguration("contours", config);
+	config.runLengthExtraction = 1;
+	checkConfiguration("run-length", config);
+
+	return testResult("TrackingTest");
+}
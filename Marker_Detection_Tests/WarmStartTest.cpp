@@ -0,0 +1,302 @@
+/*	EN.601.654 Augmented Reality
+ *	Final Project Marker Detection Code
+ *	Test of the pose warm start of the single-marker solver, and of the stateless FindMarkers2
+ *	Alan Lai, alai13@jhu.edu
+ *	2020/05/02
+ */
+
+
+/* OpenCV includes */
+#include <opencv2/core.hpp>
+
+/* Standard includes */
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+/* Helper includes */
+#include "TestHelpers.h"
+#include "MarkerCodes.h"
+#include "MarkerDetector.h"
+#include "MarkerExport.h"
+
+
+/* Entry point of the library, as a Unity script declares it */
+extern "C" MARKER_API void MARKER_CALL FindMarkers2(Marker2** outMarks, Color32** raw, int width, int height, int maxOutMarkerCount, int& outMarkerDetected);
+
+
+static const int WIDTH = 640;
+static const int HEIGHT = 480;
+static const int MAX_MARKERS = 16;
+static const int FRAMES = 40;
+
+/* Frame at which the second marker jumps further than its prior is trusted */
+static const int JUMP_FRAME = 20;
+
+/* Largest difference allowed between a warm and a cold pose, in rotation entries and in translation.
+ * Both stop once the reprojection error is below the default tolerance, not at the same point. */
+static const float ROTATION_TOLERANCE = 5e-3f;
+static const float TRANSLATION_TOLERANCE = 2e-2f;
+
+
+/* Pose of one marker in the first frame, and how it moves from frame to frame */
+struct MarkerMotion {
+	int pattern;		// Raw cell pattern drawn
+	float x;			// Position in the marker's units, with y down
+	float y;
+	float z;
+	float tilt;			// Rotation about the x axis in radians
+	float turn;			// Rotation about the optical axis in radians
+	float dx;			// Motion per frame
+	float dy;
+	float dTilt;
+	float dTurn;
+};
+
+
+/* Three markers turning slowly at different depths, in the marker units of the default configuration.
+ * None of them comes close to facing the camera, where a warm and a cold start may settle on
+ * the two mirrored tilts a square gives there. */
+static const MarkerMotion MOTIONS[] = {
+	{ 0x1234, -9.0f, -5.0f, 30.0f, 0.3f, 0.1f, 0.03f, 0.01f, -0.004f, 0.006f },
+	{ 0x5a5a, 6.0f, -4.0f, 34.0f, -0.25f, -0.4f, -0.02f, 0.02f, -0.003f, 0.004f },
+	{ 0x3c3c, 0.0f, 6.0f, 26.0f, 0.4f, 0.8f, 0.01f, -0.02f, -0.003f, -0.005f }
+};
+
+static const int MOTION_COUNT = sizeof(MOTIONS) / sizeof(MOTIONS[0]);
+
+
+/*  Projects the corners of a marker in a frame with the default camera
+ *
+ *	@param motion: The motion of the marker
+ *	@param f: The frame
+ *	@param markerSize: The side length of the marker
+ *	@param corners: Container to hold the image corners, from the top left cell around the top row
+ *
+ *	@return void
+ */
+static void projectMarker(const MarkerMotion &motion, int f, float markerSize, cv::Point2f* corners) {
+
+	float x = motion.x + motion.dx * f;
+	float y = motion.y + motion.dy * f;
+	if (&motion == &MOTIONS[1] && f >= JUMP_FRAME) {
+		x -= 8.0f;
+	}
+	float tilt = motion.tilt + motion.dTilt * f;
+	float turn = motion.turn + motion.dTurn * f;
+
+	const float unit[4][2] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+	for (int k = 0; k < 4; k++) {
+		float px = markerSize * unit[k][0], py = markerSize * unit[k][1];
+
+		// Tilt about x, then turn about the optical axis
+		float ty = py * cos(tilt), tz = py * sin(tilt);
+		float rx = px * cos(turn) - ty * sin(turn);
+		float ry = px * sin(turn) + ty * cos(turn);
+		float depth = motion.z + tz;
+		corners[k] = cv::Point2f(WIDTH * 0.5f + 400.0f * (x + rx) / depth, HEIGHT * 0.5f + 400.0f * (y + ry) / depth);
+	}
+}
+
+
+/*  Renders the markers of a frame as RGBA
+ *
+ *	@param f: The frame
+ *	@param markerSize: The side length of the markers
+ *	@param pixels: Container to hold the RGBA frame
+ *
+ *	@return void
+ */
+static void renderFrame(int f, float markerSize, std::vector<Color32> &pixels) {
+
+	cv::Mat gray(HEIGHT, WIDTH, CV_8UC1, cv::Scalar(TEST_WHITE));
+	for (int m = 0; m < MOTION_COUNT; m++) {
+		cv::Point2f corners[4];
+		projectMarker(MOTIONS[m], f, markerSize, corners);
+		drawMarker(gray, corners, MOTIONS[m].pattern);
+	}
+
+	pixels.resize((size_t)WIDTH * HEIGHT);
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < WIDTH; x++) {
+			uchar value = gray.at<uchar>(y, x);
+			const Color32 color = { value, value, value, 255 };
+			pixels[(size_t)y * WIDTH + x] = color;
+		}
+	}
+}
+
+
+/*  Tells whether two markers have poses that agree within the tolerances
+ *
+ *	@param a: One marker
+ *	@param b: The other
+ *
+ *	@return close: True if every rotation entry and the translation agree
+ */
+static bool closePoses(const Marker2 &a, const Marker2 &b) {
+
+	const float ra[9] = { a.rotate_11, a.rotate_12, a.rotate_13, a.rotate_21, a.rotate_22, a.rotate_23, a.rotate_31, a.rotate_32, a.rotate_33 };
+	const float rb[9] = { b.rotate_11, b.rotate_12, b.rotate_13, b.rotate_21, b.rotate_22, b.rotate_23, b.rotate_31, b.rotate_32, b.rotate_33 };
+	for (int k = 0; k < 9; k++) {
+		if (!(std::fabs(ra[k] - rb[k]) < ROTATION_TOLERANCE)) {
+			return false;
+		}
+	}
+	return std::fabs(a.translate_x - b.translate_x) < TRANSLATION_TOLERANCE &&
+		std::fabs(a.translate_y - b.translate_y) < TRANSLATION_TOLERANCE &&
+		std::fabs(a.translate_z - b.translate_z) < TRANSLATION_TOLERANCE;
+}
+
+
+/*  Finds a marker by ID among the markers of a frame
+ *
+ *	@param markers: The markers found
+ *	@param count: The number of markers found
+ *	@param id: The marker ID
+ *
+ *	@return index: The index of the marker, or -1
+ */
+static int findMarker(const std::vector<Marker2> &markers, int count, int id) {
+
+	for (int i = 0; i < count; i++) {
+		if (markers[i].id == id) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+/*  Checks the warm start of the single-marker solver over the moving frames
+ *	The poses must be the bytes of the batch solver given the same priors, and stay within
+ *	the tolerances of a detector that starts every pose from its homography. The marker that
+ *	jumps has its prior rejected, so in that frame it gets the cold pose bit for bit.
+ *
+ *	@param frames: The RGBA frames
+ *
+ *	@return void
+ */
+static void checkSingleWarmStart(std::vector<std::vector<Color32> > &frames) {
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	config.batchPose = 0;
+	MarkerDetector single(config);
+	config.batchPose = 1;
+	MarkerDetector batch(config);
+	config.batchPose = 0;
+	config.warmStartPose = 0;
+	MarkerDetector cold(config);
+
+	std::vector<Marker2> warm(MAX_MARKERS), batched(MAX_MARKERS), reference(MAX_MARKERS);
+	int warmStarted = 0, compared = 0;
+	for (int f = 0; f < FRAMES; f++) {
+		int count = single.detect(&warm[0], MAX_MARKERS, &frames[f][0], WIDTH, HEIGHT);
+		int batchCount = batch.detect(&batched[0], MAX_MARKERS, &frames[f][0], WIDTH, HEIGHT);
+		int coldCount = cold.detect(&reference[0], MAX_MARKERS, &frames[f][0], WIDTH, HEIGHT);
+
+		TEST_CHECK(count == MOTION_COUNT && batchCount == count && coldCount == count);
+		TEST_CHECK(memcmp(&warm[0], &batched[0], count * sizeof(Marker2)) == 0);
+
+		for (int i = 0; i < count; i++) {
+			int j = findMarker(reference, coldCount, warm[i].id);
+			TEST_CHECK(j >= 0);
+			if (j < 0) {
+				continue;
+			}
+
+			bool same = memcmp(&warm[i], &reference[j], sizeof(Marker2)) == 0;
+			TEST_CHECK(same || closePoses(warm[i], reference[j]));
+			warmStarted += (f > 0 && !same) ? 1 : 0;
+			compared++;
+
+			// The first frame has no prior, and the jump is beyond the prior tolerance
+			bool jumped = (f == JUMP_FRAME) && (warm[i].id == lookupMarkerCode(MOTIONS[1].pattern).id);
+			if (f == 0 || jumped) {
+				TEST_CHECK(same);
+			}
+		}
+	}
+
+	// Some poses must have started from their prior for the comparison to mean anything
+	TEST_CHECK(warmStarted > 0);
+	printf("WarmStartTest: %d single-marker poses, %d started from the previous frame, all within tolerance of a cold start\n",
+		compared, warmStarted);
+}
+
+
+/*  Calls FindMarkers2 on the frames and returns the markers of the last one
+ *
+ *	@param frames: The RGBA frames
+ *	@param first: The first frame to detect in
+ *	@param last: The last frame to detect in
+ *	@param markers: Container to hold the markers of the last frame
+ *
+ *	@return count: The number of markers of the last frame
+ */
+static int findMarkersInFrames(const std::vector<std::vector<Color32> > &frames, int first, int last, std::vector<Marker2> &markers) {
+
+	int count = 0;
+	for (int f = first; f <= last; f++) {
+		std::vector<Color32> copy = frames[f];
+		Marker2* out = &markers[0];
+		Color32* raw = &copy[0];
+		FindMarkers2(&out, &raw, WIDTH, HEIGHT, MAX_MARKERS, count);
+	}
+	return count;
+}
+
+
+/*  Checks that FindMarkers2 gives the same markers for a frame whatever it saw before
+ *	Its detector lives on the calling thread, so a new thread starts from nothing. Its poses
+ *	must also be those of a detector solving each marker on its own, from the homography,
+ *	with the three full iterations FindMarkers2 always ran.
+ *
+ *	@param frames: The RGBA frames
+ *
+ *	@return void
+ */
+static void checkStatelessFindMarkers(const std::vector<std::vector<Color32> > &frames) {
+
+	std::vector<Marker2> afterSequence(MAX_MARKERS), alone(MAX_MARKERS), reference(MAX_MARKERS);
+	int afterCount = findMarkersInFrames(frames, 0, FRAMES - 1, afterSequence);
+	int aloneCount = 0;
+	std::thread fresh([&frames, &alone, &aloneCount]() {
+		aloneCount = findMarkersInFrames(frames, FRAMES - 1, FRAMES - 1, alone);
+	});
+	fresh.join();
+
+	TEST_CHECK(afterCount == MOTION_COUNT && aloneCount == afterCount);
+	TEST_CHECK(memcmp(&afterSequence[0], &alone[0], afterCount * sizeof(Marker2)) == 0);
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	config.batchPose = 0;
+	config.warmStartPose = 0;
+	config.poseErrorTolerance = 0.0f;
+	config.poseStepTolerance = 0.0f;
+	MarkerDetector detector(config);
+	std::vector<Color32> copy = frames[FRAMES - 1];
+	int count = detector.detect(&reference[0], MAX_MARKERS, &copy[0], WIDTH, HEIGHT);
+	TEST_CHECK(count == afterCount);
+	TEST_CHECK(memcmp(&afterSequence[0], &reference[0], count * sizeof(Marker2)) == 0);
+}
+
+
+int main() {
+
+	DetectorConfig config;
+	getDefaultConfig(config);
+	std::vector<std::vector<Color32> > frames(FRAMES);
+	for (int f = 0; f < FRAMES; f++) {
+		renderFrame(f, config.markerSize, frames[f]);
+	}
+
+	checkSingleWarmStart(frames);
+	checkStatelessFindMarkers(frames);
+
+	return testResult("WarmStartTest");
+}